@@ -65,6 +65,7 @@ time warp info and AudioIOListener and whether the playback is looped.
 
 #include "float_cast.h"
 #include "DeviceManager.h"
+#include "WorkerPool.h"
 
 #include <cfloat>
 #include <math.h>
@@ -303,6 +304,10 @@ AudioIO::AudioIO()
 
 void AudioIO::StartThread()
 {
+   // A pool dedicated to playback, so that its work never waits behind
+   // unrelated background tasks; nothing may Enqueue to it
+   if (const auto nWorkers = WorkerPool::DefaultWorkerCount())
+      mpMixerPool = std::make_unique<WorkerPool>(nWorkers);
    mAudioThread = std::thread(AudioThread, ref(mFinishAudioThread));
 }
 
@@ -336,6 +341,7 @@ AudioIO::~AudioIO()
 
    mFinishAudioThread.store(true, std::memory_order_release);
    mAudioThread.join();
+   mpMixerPool.reset();
 }
 
 std::shared_ptr<RealtimeEffectState>
@@ -872,8 +878,10 @@ int AudioIO::StartStream(const TransportSequences &sequences,
    });
 
    mPlaybackBuffers.clear();
+   mPlaybackBufferStarts.clear();
    mScratchBuffers.clear();
    mScratchPointers.clear();
+   mScratchBusy.clear();
    mPlaybackMixers.clear();
    mCaptureBuffers.clear();
    mResample.clear();
@@ -980,8 +988,10 @@ int AudioIO::StartStream(const TransportSequences &sequences,
    // so that they will have data in them when the stream starts.  Having the
    // audio thread call SequenceBufferExchange here makes the code more predictable, since
    // SequenceBufferExchange will ALWAYS get called from the Audio thread.
+   mPlaybackBelowLowWater = false;
    mAudioThreadShouldCallSequenceBufferExchangeOnce
       .store(true, std::memory_order_release);
+   WakeAudioThread();
 
    while( mAudioThreadShouldCallSequenceBufferExchangeOnce
       .load(std::memory_order_acquire)) {
@@ -990,7 +1000,11 @@ int AudioIO::StartStream(const TransportSequences &sequences,
       if (options.playbackStreamPrimer) {
          interval = options.playbackStreamPrimer();
       }
-      std::this_thread::sleep_for(interval);
+      // Return at the end of the interval to call the primer again
+      std::unique_lock<std::mutex> lock{ mAudioThreadMutex };
+      mAudioThreadProgress.wait_for(lock, interval, [this]{
+         return !mAudioThreadShouldCallSequenceBufferExchangeOnce
+            .load(std::memory_order_acquire); });
    }
 
    if(mNumPlaybackChannels > 0 || mNumCaptureChannels > 0) {
@@ -1180,15 +1194,22 @@ bool AudioIO::AllocateBuffers(
             mPlaybackBuffers.resize(0);
             mPlaybackBuffers.resize(
                std::max<size_t>(1, totalWidth));
-            // Number of scratch buffers depends on device playback channels
+            // Number of scratch buffers depends on device playback channels,
+            // and a set of them is needed for each thread that may transform
+            // the buffers with realtime effects concurrently
             if (mNumPlaybackChannels > 0) {
-               mScratchBuffers.resize(mNumPlaybackChannels * 2 + 1);
+               const size_t nSets = std::max<size_t>(1, std::min(
+                  mPlaybackSequences.size(),
+                  1 + (mpMixerPool ? mpMixerPool->GetWorkerCount() : 0)));
+               mScratchBuffers.resize(
+                  nSets * (mNumPlaybackChannels * 2 + 1));
                mScratchPointers.clear();
                for (auto &buffer : mScratchBuffers) {
                   buffer.Allocate(playbackBufferSize, floatSample);
                   mScratchPointers.push_back(
                      reinterpret_cast<float*>(buffer.ptr()));
                }
+               mScratchBusy = std::vector<std::atomic<bool>>(nSets);
             }
             mPlaybackMixers.clear();
 
@@ -1213,9 +1234,11 @@ bool AudioIO::AllocateBuffers(
                   std::make_unique<RingBuffer>(floatSample, playbackBufferSize);
 
             mOldChannelGains.resize(mPlaybackSequences.size());
+            mPlaybackBufferStarts.clear();
             size_t iBuffer = 0;
             for (unsigned int i = 0; i < mPlaybackSequences.size(); i++) {
                const auto &pSequence = mPlaybackSequences[i];
+               mPlaybackBufferStarts.push_back(iBuffer);
                // Bug 1763 - We must fade in from zero to avoid a click on starting.
                mOldChannelGains[i][0] = 0.0;
                mOldChannelGains[i][1] = 0.0;
@@ -1332,8 +1355,10 @@ void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
    mpTransportState.reset();
 
    mPlaybackBuffers.clear();
+   mPlaybackBufferStarts.clear();
    mScratchBuffers.clear();
    mScratchPointers.clear();
+   mScratchBusy.clear();
    mPlaybackMixers.clear();
    mCaptureBuffers.clear();
    mResample.clear();
@@ -1495,8 +1520,10 @@ void AudioIO::StopStream()
    // we allocated in StartStream()
    //
    mPlaybackBuffers.clear();
+   mPlaybackBufferStarts.clear();
    mScratchBuffers.clear();
    mScratchPointers.clear();
+   mScratchBusy.clear();
    mPlaybackMixers.clear();
    mPlaybackSchedule.mTimeQueue.Clear();
 
@@ -1802,8 +1829,11 @@ void AudioIO::AudioThread(std::atomic<bool> &finish)
 
       gAudioIO->mAudioThreadSequenceBufferExchangeLoopActive
          .store(false, std::memory_order_relaxed);
+      gAudioIO->NotifyAudioThreadProgress();
 
-      std::this_thread::sleep_until( loopPassStart + interval );
+      // Sleep, unless the PortAudio callback finds the playback buffers
+      // running low, or the main thread has new orders
+      gAudioIO->WaitForWakeup( loopPassStart + interval );
    }
 }
 
@@ -1942,7 +1972,9 @@ bool AudioIO::ProcessPlaybackSlices(
    do {
       const auto slice =
          policy.GetPlaybackSlice(mPlaybackSchedule, available);
-      const auto &[frames, toProduce] = slice;
+      // Not structured bindings, which the lambda below could not capture
+      const auto frames = slice.frames;
+      const auto toProduce = slice.toProduce;
       progress = progress || toProduce > 0;
 
       // Update the time queue.  This must be done before writing to the
@@ -1952,21 +1984,25 @@ bool AudioIO::ProcessPlaybackSlices(
       // atomic variables, the time queue doesn't.
       mPlaybackSchedule.mTimeQueue.Producer(mPlaybackSchedule, slice);
 
-      // mPlaybackMixers correspond one-to-one with mPlaybackSequences
-      size_t iSequence = 0;
-      // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
-      size_t iBuffer = 0;
-      for (auto &mixer : mPlaybackMixers) {
-         // The mixer here isn't actually mixing: it's just doing
-         // resampling, format conversion, and possibly time track
-         // warping
-         if (frames > 0) {
+      if (frames > 0) {
+         // The mixers are independent of each other, and each one writes
+         // only its own ring buffers, so they may run in parallel.  The Puts
+         // are not yet flushed, so the consumer sees nothing until all are
+         // done, and the order of the flushes is unchanged.
+         const auto processMixer = [&](size_t iSequence) {
+            // mPlaybackMixers correspond one-to-one with mPlaybackSequences
+            auto &mixer = mPlaybackMixers[iSequence];
+            // The mixer here isn't actually mixing: it's just doing
+            // resampling, format conversion, and possibly time track
+            // warping
             size_t produced = 0;
             if (toProduce)
                produced = mixer->Process(toProduce);
             //wxASSERT(produced <= toProduce);
             // Copy (non-interleaved) mixer outputs to one or more ring buffers
-            const auto nChannels = mPlaybackSequences[iSequence++]->NChannels();
+            // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
+            auto iBuffer = mPlaybackBufferStarts[iSequence];
+            const auto nChannels = mPlaybackSequences[iSequence]->NChannels();
             for (size_t j = 0; j < nChannels; ++j) {
                auto warpedSamples = mixer->GetBuffer(j);
                const auto put = mPlaybackBuffers[iBuffer++]->Put(
@@ -1975,7 +2011,13 @@ bool AudioIO::ProcessPlaybackSlices(
                // but we can't assert in this thread
                wxUnusedVar(put);
             }
-         }
+         };
+         if (mpMixerPool)
+            mpMixerPool->ParallelFor(mPlaybackMixers.size(), processMixer);
+         else
+            for (size_t iSequence = 0, nSequences = mPlaybackMixers.size();
+               iSequence < nSequences; ++iSequence)
+               processMixer(iSequence);
       }
 
       if (mPlaybackSequences.empty())
@@ -2001,22 +2043,53 @@ void AudioIO::TransformPlayBuffers(
    std::optional<RealtimeEffects::ProcessingScope> &pScope)
 {
    // Transform written but un-flushed samples in the RingBuffers in-place.
+   if (!pScope)
+      return;
 
-   // Avoiding std::vector
-   const auto pointers = stackAllocate(float*, mNumPlaybackChannels);
+   using Lists = RealtimeEffectManager::Lists;
+   const auto nScratches = 2 * mNumPlaybackChannels + 1;
+
+   // Per-project effects are shared by all sequences, and apply before the
+   // sequence's own effects.  Sequences take turns applying them, in order.
+   // Meanwhile the independent lists of the sequences may be processed
+   // concurrently, each in its own set of scratch buffers.
+   std::atomic<size_t> masterTurn{ 0 };
+   const auto waitForTurn = [&](size_t iSequence) {
+      while (masterTurn.load(std::memory_order_acquire) != iSequence)
+         std::this_thread::yield();
+   };
+   const auto passTurn = [&](size_t iSequence) {
+      masterTurn.store(iSequence + 1, std::memory_order_release);
+   };
+   const auto transform = [&](size_t iSequence) {
+      const auto vt = mPlaybackSequences[iSequence];
+      if (!vt) {
+         waitForTurn(iSequence);
+         passTurn(iSequence);
+         return;
+      }
+
+      // Claim a set of scratch buffers.  There are enough sets for all of
+      // the threads that the pool can use at once, so this does not spin long
+      size_t iSet = 0;
+      while (mScratchBusy[iSet].exchange(true, std::memory_order_acquire))
+         iSet = (iSet + 1) % mScratchBusy.size();
+      Finally Release{ [&]{
+         mScratchBusy[iSet].store(false, std::memory_order_release); } };
+      float *const *const scratchPointers =
+         &mScratchPointers[iSet * nScratches];
+
+      // Avoiding std::vector
+      const auto pointers = stackAllocate(float*, mNumPlaybackChannels);
 
-   const auto numPlaybackSequences = mPlaybackSequences.size();
-   // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
-   size_t iBuffer = 0;
-   for (const auto vt : mPlaybackSequences) {
-      if (!vt)
-         continue;
       // vt is mono, or is the first of its group of channels
       const auto nChannels = std::min<size_t>(
          mNumPlaybackChannels, vt->NChannels());
+      // mPlaybackBuffers correspond many-to-one with mPlaybackSequences
+      const auto iBuffer = mPlaybackBufferStarts[iSequence];
 
-      // Loop over the blocks of unflushed data, at most two
-      for (unsigned iBlock : {0, 1}) {
+      // Point at one block of unflushed data and return its length
+      const auto getBlock = [&](unsigned iBlock) {
          size_t len = 0;
          size_t iChannel = 0;
          for (; iChannel < nChannels; ++iChannel) {
@@ -2037,26 +2110,50 @@ void AudioIO::TransformPlayBuffers(
          // Then supply some non-null fake input buffers, because the
          // various ProcessBlock overrides of effects may crash without it.
          // But it would be good to find the fixes to make this unnecessary.
-         float **scratch = &mScratchPointers[mNumPlaybackChannels + 1];
+         auto scratch = &scratchPointers[mNumPlaybackChannels + 1];
          while (iChannel < mNumPlaybackChannels)
             memset((pointers[iChannel++] = *scratch++), 0, len * sizeof(float));
+         return len;
+      };
+      const auto process = [&](size_t len, Lists lists) {
+         return pScope->Process( *vt, &pointers[0],
+            scratchPointers,
+            // The single dummy output buffer:
+            scratchPointers[mNumPlaybackChannels],
+            mNumPlaybackChannels, len, lists);
+      };
 
-         if (len && pScope) {
-            auto discardable = pScope->Process( *vt, &pointers[0],
-               mScratchPointers.data(),
-               // The single dummy output buffer:
-               mScratchPointers[mNumPlaybackChannels],
-               mNumPlaybackChannels, len);
-            iChannel = 0;
-            for (; iChannel < nChannels; ++iChannel) {
+      // Loop over the blocks of unflushed data, at most two
+      size_t discardable[2]{};
+      {
+         waitForTurn(iSequence);
+         Finally Pass{ [&]{ passTurn(iSequence); } };
+         for (unsigned iBlock : {0, 1})
+            if (const auto len = getBlock(iBlock))
+               discardable[iBlock] = process(len, Lists::Master);
+      }
+      for (unsigned iBlock : {0, 1}) {
+         const auto len = getBlock(iBlock);
+         if (len)
+            discardable[iBlock] += process(len, Lists::Sequence);
+         if (discardable[iBlock]) {
+            for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
                auto &ringBuffer = *mPlaybackBuffers[iBuffer + iChannel];
-               auto discarded = ringBuffer.Unput(discardable);
+               auto discarded = ringBuffer.Unput(discardable[iBlock]);
                // assert(discarded == discardable);
             }
          }
       }
-      iBuffer += vt->NChannels();
-   }
+   };
+
+   // Indices are claimed in increasing order, so waiting for the turn in
+   // transform cannot deadlock
+   if (mpMixerPool)
+      mpMixerPool->ParallelFor(mPlaybackSequences.size(), transform);
+   else
+      for (size_t iSequence = 0, nSequences = mPlaybackSequences.size();
+         iSequence < nSequences; ++iSequence)
+         transform(iSequence);
 }
 
 void AudioIO::DrainRecordBuffers()
@@ -3140,6 +3237,16 @@ int AudioIoCallback::AudioCallback(
 
    SendVuOutputMeterData( outputMeterFloats, framesPerBuffer);
 
+   // Wake the audio thread early when the playback queue falls below the
+   // minimum occupancy it tries to maintain, but only at the crossing, so
+   // that it is not woken repeatedly when it has nothing more to produce
+   if (numPlaybackChannels > 0) {
+      const bool below = GetCommonlyReadyPlayback() < mPlaybackQueueMinimum;
+      if (below && !mPlaybackBelowLowWater)
+         WakeAudioThreadFromCallback();
+      mPlaybackBelowLowWater = below;
+   }
+
    return mCallbackReturn;
 }
 
@@ -3169,12 +3276,10 @@ int AudioIoCallback::CallbackDoSeek()
    mAudioThreadSequenceBufferExchangeLoopRunning
       .store(false, std::memory_order_relaxed);
 
-   while( mAudioThreadSequenceBufferExchangeLoopActive
-      .load(std::memory_order_relaxed ) )
-   {
-      using namespace std::chrono;
-      std::this_thread::sleep_for(50ms);
-   }
+   using namespace std::chrono;
+   WaitForAudioThread([this]{
+      return !mAudioThreadSequenceBufferExchangeLoopActive
+         .load(std::memory_order_relaxed ); }, 50ms);
 
    // Calculate the NEW time position, in the PortAudio callback
    const auto time =
@@ -3203,6 +3308,7 @@ int AudioIoCallback::CallbackDoSeek()
    // Reenable the audio thread
    mAudioThreadSequenceBufferExchangeLoopRunning
       .store(true, std::memory_order_relaxed);
+   WakeAudioThreadFromCallback();
 
    return paContinue;
 }
@@ -3234,30 +3340,30 @@ auto AudioIoCallback::AudioIOExtIterator::operator *() const -> AudioIOExt &
 void AudioIoCallback::StartAudioThread()
 {
    mAudioThreadSequenceBufferExchangeLoopRunning.store(true, std::memory_order_release);
+   WakeAudioThread();
 }
 
 void AudioIoCallback::WaitForAudioThreadStarted()
 {
-   while (mAudioThreadAcknowledge.load(std::memory_order_acquire) != Acknowledge::eStart)
-   {
-      using namespace std::chrono;
-      std::this_thread::sleep_for(50ms);
-   }
+   using namespace std::chrono;
+   WaitForAudioThread([this]{
+      return mAudioThreadAcknowledge.load(std::memory_order_acquire)
+         == Acknowledge::eStart; }, 50ms);
    mAudioThreadAcknowledge.store(Acknowledge::eNone, std::memory_order_release);
 }
 
 void AudioIoCallback::StopAudioThread()
 {
    mAudioThreadSequenceBufferExchangeLoopRunning.store(false, std::memory_order_release);
+   WakeAudioThread();
 }
 
 void AudioIoCallback::WaitForAudioThreadStopped()
 {
-   while (mAudioThreadAcknowledge.load(std::memory_order_acquire) != Acknowledge::eStop)
-   {
-      using namespace std::chrono;
-      std::this_thread::sleep_for(50ms);
-   }
+   using namespace std::chrono;
+   WaitForAudioThread([this]{
+      return mAudioThreadAcknowledge.load(std::memory_order_acquire)
+         == Acknowledge::eStop; }, 50ms);
    mAudioThreadAcknowledge.store(Acknowledge::eNone, std::memory_order_release);
 }
 
@@ -3265,13 +3371,48 @@ void AudioIoCallback::ProcessOnceAndWait(std::chrono::milliseconds sleepTime)
 {
    mAudioThreadShouldCallSequenceBufferExchangeOnce
       .store(true, std::memory_order_release);
+   // This is also called from CallbackDoSeek, so do not lock to wake
+   WakeAudioThreadFromCallback();
 
-   while (mAudioThreadShouldCallSequenceBufferExchangeOnce
-      .load(std::memory_order_acquire))
+   WaitForAudioThread([this]{
+      return !mAudioThreadShouldCallSequenceBufferExchangeOnce
+         .load(std::memory_order_acquire); }, sleepTime);
+}
+
+void AudioIoCallback::WakeAudioThread()
+{
    {
-      using namespace std::chrono;
-      std::this_thread::sleep_for(sleepTime);
+      // Lock so that the wakeup is not lost between the AudioThread's test
+      // of the flag and its wait
+      std::lock_guard<std::mutex> lock{ mAudioThreadMutex };
+      mAudioThreadWakeupPending.store(true, std::memory_order_release);
+   }
+   mAudioThreadWakeup.notify_one();
+}
+
+void AudioIoCallback::WakeAudioThreadFromCallback()
+{
+   if (!mAudioThreadWakeupPending.exchange(true, std::memory_order_release))
+      mAudioThreadWakeup.notify_one();
+}
+
+void AudioIoCallback::WaitForWakeup(
+   std::chrono::steady_clock::time_point deadline)
+{
+   std::unique_lock<std::mutex> lock{ mAudioThreadMutex };
+   mAudioThreadWakeup.wait_until(lock, deadline, [this]{
+      return mAudioThreadWakeupPending.exchange(false,
+         std::memory_order_acquire); });
+}
+
+void AudioIoCallback::NotifyAudioThreadProgress()
+{
+   {
+      // Lock so that the notification is not lost between a waiter's test
+      // of its predicate and its wait
+      std::lock_guard<std::mutex> lock{ mAudioThreadMutex };
    }
+   mAudioThreadProgress.notify_all();
 }
 
 
@@ -17,6 +17,9 @@
 #include "AudioIOSequences.h"
 #include "PlaybackSchedule.h" // member variable
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -34,6 +37,7 @@ class AudioIOBase;
 class AudioIO;
 class RingBuffer;
 class Mixer;
+class WorkerPool;
 class OtherPlayableSequence;
 class RealtimeEffectState;
 class Resample;
@@ -273,6 +277,10 @@ public:
    RecordableSequences mCaptureSequences;
    /*! Read by worker threads but unchanging during playback */
    RingBuffers mPlaybackBuffers;
+   /*! Index into mPlaybackBuffers of the first channel of each of
+    mPlaybackSequences; read by worker threads but unchanging during playback
+    */
+   std::vector<size_t> mPlaybackBufferStarts;
    ConstPlayableSequences      mPlaybackSequences;
    // Old gain is used in playback in linearly interpolating
    // the gain.
@@ -280,8 +288,15 @@ public:
    // Temporary buffers, each as large as the playback buffers
    std::vector<SampleBuffer> mScratchBuffers;
    std::vector<float *> mScratchPointers; //!< pointing into mScratchBuffers
+   //! Whether each set of 2 * mNumPlaybackChannels + 1 scratch buffers is
+   //! claimed by a thread transforming the playback buffers
+   std::vector<std::atomic<bool>> mScratchBusy;
 
    std::vector<std::unique_ptr<Mixer>> mPlaybackMixers;
+   //! Runs the independent mPlaybackMixers concurrently; may be null
+   /*! Used only by the audio thread, through ParallelFor, which does not
+    block on the pool's workers */
+   std::unique_ptr<WorkerPool> mpMixerPool;
 
    std::atomic<float>  mMixerOutputVol{ 1.0 };
    static int          mNextStreamToken;
@@ -330,6 +345,45 @@ public:
 
    void ProcessOnceAndWait( std::chrono::milliseconds sleepTime = std::chrono::milliseconds(50) );
 
+   //! @name Event-driven wakeup of the AudioThread, and of its waiters
+   //! @{
+
+   //! Make the AudioThread begin its next pass without waiting for the
+   //! rest of its sleep interval; not for use in the PortAudio callback
+   void WakeAudioThread();
+   //! Like WakeAudioThread, but never locks a mutex
+   /*!
+    A wakeup may be lost, if the AudioThread was about to wait; then it
+    sleeps only until the end of its usual interval, as it would without
+    the wakeup
+    */
+   void WakeAudioThreadFromCallback();
+   //! AudioThread sleeps until the deadline or a wakeup
+   void WaitForWakeup(std::chrono::steady_clock::time_point deadline);
+   //! AudioThread signals changes of its atomic state to waiting threads
+   void NotifyAudioThreadProgress();
+   //! Block until pred() is true, re-evaluating it when the AudioThread
+   //! notifies progress, and at least once in each interval
+   template<typename Pred>
+   void WaitForAudioThread(Pred &&pred, std::chrono::milliseconds interval)
+   {
+      std::unique_lock<std::mutex> lock{ mAudioThreadMutex };
+      while (!pred())
+         mAudioThreadProgress.wait_for(lock, interval);
+   }
+
+   std::mutex mAudioThreadMutex;
+   //! AudioThread waits for this between passes
+   std::condition_variable mAudioThreadWakeup;
+   //! Other threads wait for this in handshakes with the AudioThread
+   std::condition_variable mAudioThreadProgress;
+   std::atomic<bool> mAudioThreadWakeupPending{ false };
+   //! Written only in the PortAudio callback, to detect the crossing of the
+   //! low-water mark (mPlaybackQueueMinimum) of the playback buffers
+   bool mPlaybackBelowLowWater{ false };
+
+   //! @}
+
 
 
    std::atomic<bool>   mForceFadeOut{ false };
@@ -199,6 +199,12 @@ bool EffectInstance::NeedsDither() const
    return true;
 }
 
+auto EffectInstance::GetHistoryLength(const EffectSettings &, double) const
+   -> std::optional<SampleCount>
+{
+   return {};
+}
+
 EffectInstanceWithBlockSize::~EffectInstanceWithBlockSize() = default;
 
 size_t EffectInstanceWithBlockSize::GetBlockSize() const
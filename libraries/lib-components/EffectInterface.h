@@ -566,6 +566,20 @@ public:
     to a narrower sample format */
    virtual bool NeedsDither() const;
 
+   //! How many samples of earlier input the output may depend on, if bounded
+   /*!
+    If not null, then each output sample depends only on the input sample at
+    the same position and the given number of samples before it, and not on
+    its position in the track.  Then a long track may be divided into chunks
+    that separate instances process concurrently, each starting that many
+    samples early.  Such instances must be safe to use from other threads and
+    must share no mutable state, so instances that forward to one stateful
+    effect object must not override this.
+    Default implementation returns null.
+    */
+   virtual std::optional<SampleCount> GetHistoryLength(
+      const EffectSettings &settings, double sampleRate) const;
+
    //! Called at start of destructive processing, for each (mono/stereo) track
    //! Default implementation does nothing, returns true
    /*!
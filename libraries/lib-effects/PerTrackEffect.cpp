@@ -30,9 +30,88 @@
 #include "WaveTrack.h"
 #include "WaveTrackSink.h"
 #include "WideSampleSource.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
 
 AudioGraph::Sink::~Sink() = default;
 
+namespace {
+//! Chunks are long enough that the samples processed twice, to prime the
+//! history of each instance, are a small part of the work
+sampleCount ChunkLength(size_t maxBlockSize, EffectInstance::SampleCount history)
+{
+   const auto nBlocks = std::max<EffectInstance::SampleCount>(4,
+      (4 * history + maxBlockSize - 1) / maxBlockSize);
+   return sampleCount(nBlocks * maxBlockSize);
+}
+
+//! Accumulates the output of one chunk in memory, dropping the first
+//! samples, which only primed the effect
+class ChunkSink final : public AudioGraph::Sink {
+public:
+   ChunkSink(size_t nChannels, size_t skip, size_t len)
+      : mChannels(nChannels), mSkip{ skip }, mLen{ len }
+   {
+      for (auto &channel : mChannels)
+         channel.reserve(len);
+   }
+
+   bool AcceptsBuffers(const Buffers &buffers) const override
+   {
+      return buffers.Channels() > 0;
+   }
+
+   bool Acquire(Buffers &data) override
+   {
+      if (data.BlockSize() > data.Remaining())
+         DoConsume(data);
+      return true;
+   }
+
+   bool Release(const Buffers &, size_t) override
+   {
+      return true;
+   }
+
+   void Flush(Buffers &data)
+   {
+      DoConsume(data);
+   }
+
+   size_t Length() const { return mChannels[0].size(); }
+   constSamplePtr Get(size_t iChannel) const
+   {
+      return reinterpret_cast<constSamplePtr>(mChannels[iChannel].data());
+   }
+
+private:
+   void DoConsume(Buffers &data)
+   {
+      const auto count = data.Position();
+      const auto skip = std::min(mSkip, count);
+      mSkip -= skip;
+      const auto keep = std::min(count - skip, mLen - Length());
+      for (size_t iChannel = 0; iChannel < mChannels.size(); ++iChannel) {
+         const auto begin = reinterpret_cast<const float*>(
+            data.GetReadPosition(iChannel)) + skip;
+         mChannels[iChannel].insert(
+            mChannels[iChannel].end(), begin, begin + keep);
+      }
+      data.Rewind();
+   }
+
+   std::vector<std::vector<float>> mChannels;
+   size_t mSkip;
+   const size_t mLen;
+};
+}
+
 PerTrackEffect::Instance::~Instance() = default;
 
 bool PerTrackEffect::Instance::Process(EffectSettings &settings)
@@ -63,6 +142,11 @@ bool PerTrackEffect::DoPass2() const
    return false;
 }
 
+bool PerTrackEffect::ProcessesTracksInParallel() const
+{
+   return false;
+}
+
 bool PerTrackEffect::Process(
    EffectInstance &instance, EffectSettings &settings) const
 {
@@ -90,6 +174,11 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
    bool isGenerator = GetType() == EffectTypeGenerate;
    bool isProcessor = GetType() == EffectTypeProcess;
 
+   if (isProcessor && ProcessesTracksInParallel() &&
+       WorkerPool::Get().GetWorkerCount() > 0 &&
+       outputs.SelectedLeaders<WaveTrack>().size() > 1)
+      return ProcessPassInParallel(outputs, instance, settings);
+
    Buffers inBuffers, outBuffers;
    ChannelName map[3];
    size_t prevBufferSize = 0;
@@ -248,6 +337,25 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
             return true;
          };
 
+         // Effects that look only a bounded distance back may divide a long
+         // track among threads
+         if (isProcessor && WorkerPool::Get().GetWorkerCount() > 0 &&
+             instance.GetLatency(settings, sampleRate) == 0) {
+            const auto history =
+               instance.GetHistoryLength(settings, sampleRate);
+            if (history &&
+                len > ChunkLength(left.GetMaxBlockSize(), *history)) {
+               bGoodResult = ProcessTrackInChunks(channel, settings,
+                  *history, left, pRight, *leader, start, len,
+                  instance.NeedsDither()
+                     ? widestSampleFormat : narrowestSampleFormat,
+                  pollUser);
+               if (bGoodResult)
+                  ++count;
+               return;
+            }
+         }
+
          // Assured above
          assert(len == 0 || inBuffers.Channels() > 0);
          // TODO fix this hack to make the time remaining of the generator
@@ -326,6 +434,369 @@ bool PerTrackEffect::ProcessPass(TrackList &outputs,
    return bGoodResult;
 }
 
+bool PerTrackEffect::ProcessPassInParallel(TrackList &outputs,
+   Instance &instance, EffectSettings &settings)
+{
+   const auto duration = settings.extra.GetDuration();
+   const auto numAudioIn = instance.GetAudioInCount();
+   const auto numAudioOut = instance.GetAudioOutCount();
+   if (numAudioOut < 1)
+      return false;
+   const bool multichannel = numAudioIn > 1;
+   const auto format =
+      instance.NeedsDither() ? widestSampleFormat : narrowestSampleFormat;
+
+   // One job for each selected leader, processing its channels in turn, so
+   // that no two threads write the same track; bounds are found in advance
+   struct Pass {
+      WaveTrack *pLeft;
+      WaveTrack *pRight;
+      int channel;
+      sampleCount start;
+      sampleCount len;
+   };
+   struct Job {
+      const WaveTrack *pLeader;
+      std::vector<Pass> passes;
+      std::atomic<double> progress{ 0 };
+      std::exception_ptr pException;
+      bool result{ true };
+   };
+   std::vector<std::unique_ptr<Job>> jobs;
+   bool bGoodResult = true;
+   outputs.Leaders().VisitWhile(bGoodResult,
+      [&](auto &&fallthrough){ return [&](WaveTrack &wt) {
+         if (!wt.GetSelected())
+            return fallthrough();
+         auto &job = *jobs.emplace_back(std::make_unique<Job>());
+         job.pLeader = &wt;
+         const auto channels = TrackList::Channels(&wt);
+         int iChannel = 0;
+         for (const auto pChannel : channels) {
+            Pass pass{ pChannel, nullptr, multichannel ? -1 : iChannel++ };
+            ChannelName map[3];
+            if (multichannel &&
+                MakeChannelMap(wt, pass.channel, map) == 2)
+               // TODO: more-than-two-channels
+               pass.pRight = *channels.rbegin();
+            GetBounds(*pChannel, pass.pRight, &pass.start, &pass.len);
+            if (pass.len > 0 && numAudioIn < 1) {
+               bGoodResult = false;
+               return;
+            }
+            job.passes.push_back(pass);
+            if (multichannel)
+               break;
+         }
+      }; },
+      [&](Track &t) {
+         if (SyncLock::IsSyncLockSelected(&t))
+            t.SyncLockAdjust(mT1, mT0 + duration);
+      }
+   );
+   if (!bGoodResult)
+      return false;
+
+#ifndef NDEBUG
+   {
+      // Instances made here must not differ from the given one in anything
+      // that was fixed above
+      const auto pFresh =
+         std::dynamic_pointer_cast<EffectInstanceEx>(MakeInstance());
+      assert(pFresh);
+      assert(pFresh->GetAudioInCount() == numAudioIn);
+      assert(pFresh->GetAudioOutCount() == numAudioOut);
+      assert(pFresh->NeedsDither() == instance.NeedsDither());
+   }
+#endif
+
+   std::atomic<bool> cancelled{ false };
+   const auto runJob = [&](Job &job) {
+      for (const auto &pass : job.passes) {
+         auto &left = *pass.pLeft;
+         // As in the serial loop, the given instance processes the first
+         // track; other threads need their own instances, which
+         // ProcessesTracksInParallel() promises are interchangeable with it
+         std::vector<std::shared_ptr<EffectInstance>> instances;
+         if (&job == jobs.front().get())
+            instances.push_back(std::dynamic_pointer_cast<EffectInstanceEx>(
+               instance.shared_from_this()));
+         size_t counter = 0;
+         const auto factory = [&]() -> std::shared_ptr<EffectInstance> {
+            auto index = counter++;
+            if (index < instances.size())
+               return instances[index];
+            else
+               return instances.emplace_back(MakeInstance());
+         };
+
+         // Get the block size the client wants to use
+         const auto max = left.GetMaxBlockSize() * 2;
+         const auto pFirst =
+            std::dynamic_pointer_cast<EffectInstanceEx>(factory());
+         const auto blockSize = pFirst ? pFirst->SetBlockSize(max) : 0;
+         if (blockSize == 0)
+            return false;
+         counter = 0;
+         const auto bufferSize =
+            ((max + (blockSize - 1)) / blockSize) * blockSize;
+
+         Buffers inBuffers, outBuffers;
+         inBuffers.Reinit(std::max(1u, numAudioIn), blockSize,
+            std::max<size_t>(1, bufferSize / blockSize));
+         for (size_t i = 2; i < numAudioIn; i++)
+            inBuffers.ClearBuffer(i, bufferSize);
+         if (!pass.pRight && numAudioIn > 1)
+            inBuffers.ClearBuffer(1, bufferSize);
+         outBuffers.Reinit(numAudioOut, blockSize,
+            (bufferSize / blockSize) + 1);
+         inBuffers.Rewind();
+
+         const auto iPass = &pass - job.passes.data();
+         const auto nPasses = job.passes.size();
+         const auto pollUser = [&, iPass, nPasses,
+            start = pass.start,
+            length = std::max(1.0, pass.len.as_double())
+         ](sampleCount inPos){
+            job.progress.store(
+               (iPass + (inPos - start).as_double() / length) / nPasses,
+               std::memory_order_relaxed);
+            return !cancelled.load(std::memory_order_relaxed);
+         };
+         WideSampleSource source{
+            left, size_t(pass.pRight ? 2 : 1), pass.start, pass.len, pollUser };
+         WaveTrackSink sink{ left, pass.pRight, pass.start, false, true,
+            format };
+
+         // Each thread gets its own settings, which instances may modify
+         auto mySettings = settings;
+         if (!ProcessTrack(pass.channel, factory, mySettings, source, sink,
+            {}, left.GetRate(), left, *job.pLeader, inBuffers, outBuffers))
+            return false;
+         sink.Flush(outBuffers);
+      }
+      return true;
+   };
+
+   // Worker threads process the tracks, while this thread reports progress
+   std::mutex mutex;
+   std::condition_variable done;
+   size_t nDone = 0;
+   auto &pool = WorkerPool::Get();
+   for (auto &pJob : jobs)
+      pool.Enqueue([&, &job = *pJob]{
+         try {
+            job.result = runJob(job);
+         }
+         catch (...) {
+            job.pException = std::current_exception();
+         }
+         if (!job.result || job.pException)
+            cancelled.store(true, std::memory_order_relaxed);
+         // Notify while locked, because the waiting thread may destroy
+         // the condition variable as soon as it sees the count complete
+         std::lock_guard<std::mutex> lock{ mutex };
+         ++nDone;
+         done.notify_one();
+      });
+
+   std::unique_lock<std::mutex> lock{ mutex };
+   while (nDone < jobs.size()) {
+      done.wait_for(lock, std::chrono::milliseconds{ 100 });
+      lock.unlock();
+      double total = 0;
+      for (auto &pJob : jobs)
+         total += pJob->progress.load(std::memory_order_relaxed);
+      if (TotalProgress(total / jobs.size()))
+         cancelled.store(true, std::memory_order_relaxed);
+      lock.lock();
+   }
+   lock.unlock();
+
+   // Report the first failure in track order, whatever the timing was
+   for (auto &pJob : jobs) {
+      if (pJob->pException)
+         std::rethrow_exception(pJob->pException);
+      if (!pJob->result)
+         return false;
+   }
+   return !cancelled.load();
+}
+
+bool PerTrackEffect::ProcessTrackInChunks(int channel,
+   EffectSettings &settings, EffectInstance::SampleCount history,
+   WaveTrack &left, WaveTrack *pRight, const WaveTrack &leader,
+   sampleCount start, sampleCount len, sampleFormat format,
+   const std::function<bool(sampleCount)> &pollUser)
+{
+   const auto nChannels = size_t(pRight ? 2 : 1);
+   const auto maxBlockSize = left.GetMaxBlockSize();
+   const auto chunkLen = ChunkLength(maxBlockSize, history);
+   const auto nChunks = ((len + chunkLen - 1) / chunkLen).as_size_t();
+
+   // Read from a copy, which shares the sample blocks, because chunks are
+   // written back while later chunks still read their history
+   const auto copyList = TrackList::Temporary(nullptr, left.Duplicate(),
+      pRight ? pRight->Duplicate() : nullptr);
+   const auto &copy = **copyList->Any<const WaveTrack>().begin();
+
+   std::atomic<bool> cancelled{ false };
+   struct Chunk {
+      sampleCount start;
+      size_t len;
+      EffectSettings settings;
+      std::vector<std::shared_ptr<EffectInstance>> instances;
+      Buffers inBuffers, outBuffers;
+      std::optional<WideSampleSource> source;
+      std::optional<ChunkSink> sink;
+      std::unique_ptr<EffectStage> stage;
+      bool done{ false };
+      bool result{ false };
+      std::exception_ptr pException;
+   };
+
+   // Construct the stage on this thread, as for any other effect
+   const auto makeChunk = [&](size_t iChunk) -> std::unique_ptr<Chunk> {
+      auto pChunk = std::make_unique<Chunk>();
+      auto &chunk = *pChunk;
+      chunk.start = start + chunkLen * iChunk;
+      chunk.len = std::min(chunkLen, start + len - chunk.start).as_size_t();
+      const auto preroll = std::min<sampleCount>(history, chunk.start - start)
+         .as_size_t();
+      chunk.settings = settings;
+
+      size_t counter = 0;
+      const auto factory = [&]() -> std::shared_ptr<EffectInstance> {
+         auto index = counter++;
+         if (index < chunk.instances.size())
+            return chunk.instances[index];
+         else
+            return chunk.instances.emplace_back(MakeInstance());
+      };
+      const auto max = maxBlockSize * 2;
+      const auto pFirst =
+         std::dynamic_pointer_cast<EffectInstanceEx>(factory());
+      const auto blockSize = pFirst ? pFirst->SetBlockSize(max) : 0;
+      if (blockSize == 0)
+         return nullptr;
+      counter = 0;
+      const auto bufferSize =
+         ((max + (blockSize - 1)) / blockSize) * blockSize;
+      const auto numAudioIn = pFirst->GetAudioInCount();
+      const auto numAudioOut = pFirst->GetAudioOutCount();
+      if (numAudioIn < 1 || numAudioOut < 1)
+         return nullptr;
+      chunk.inBuffers.Reinit(numAudioIn, blockSize, bufferSize / blockSize);
+      for (size_t i = 2; i < numAudioIn; i++)
+         chunk.inBuffers.ClearBuffer(i, bufferSize);
+      if (!pRight && numAudioIn > 1)
+         chunk.inBuffers.ClearBuffer(1, bufferSize);
+      chunk.outBuffers.Reinit(numAudioOut, blockSize,
+         (bufferSize / blockSize) + 1);
+      chunk.inBuffers.Rewind();
+
+      chunk.source.emplace(copy, nChannels, chunk.start - preroll,
+         preroll + chunk.len, [&cancelled](sampleCount) {
+            return !cancelled.load(std::memory_order_relaxed);
+         });
+      chunk.sink.emplace(nChannels, preroll, chunk.len);
+      chunk.stage = EffectStage::Create(channel, *chunk.source,
+         chunk.inBuffers, factory, chunk.settings, left.GetRate(), {}, leader);
+      if (!chunk.stage)
+         return nullptr;
+      return pChunk;
+   };
+
+   std::mutex mutex;
+   std::condition_variable done;
+   const auto runChunk = [&](Chunk &chunk) {
+      try {
+         AudioGraph::Task task{ *chunk.stage, chunk.outBuffers, *chunk.sink };
+         chunk.result = task.RunLoop();
+         if (chunk.result)
+            chunk.sink->Flush(chunk.outBuffers);
+      }
+      catch (...) {
+         chunk.pException = std::current_exception();
+      }
+      // Notify while locked, as in ProcessPassInParallel
+      std::lock_guard<std::mutex> lock{ mutex };
+      chunk.done = true;
+      done.notify_one();
+   };
+
+   // Keep every worker busy while this thread writes finished chunks, but
+   // bound the memory holding results
+   auto &pool = WorkerPool::Get();
+   const auto window = pool.GetWorkerCount() + 1;
+   std::deque<std::unique_ptr<Chunk>> inFlight;
+   size_t iNext = 0;
+   sampleCount written = 0;
+   bool result = true;
+   std::exception_ptr pException;
+   const auto wait = [&](Chunk &chunk, bool poll) {
+      std::unique_lock<std::mutex> lock{ mutex };
+      while (!chunk.done) {
+         done.wait_for(lock, std::chrono::milliseconds{ 100 });
+         if (poll) {
+            lock.unlock();
+            if (!pollUser(start + written))
+               cancelled.store(true, std::memory_order_relaxed);
+            lock.lock();
+         }
+      }
+   };
+   try {
+      while (result && (iNext < nChunks || !inFlight.empty())) {
+         while (iNext < nChunks && inFlight.size() < window) {
+            auto pChunk = makeChunk(iNext++);
+            if (!pChunk) {
+               result = false;
+               break;
+            }
+            auto &chunk = *inFlight.emplace_back(move(pChunk));
+            pool.Enqueue([&runChunk, &chunk]{ runChunk(chunk); });
+         }
+         if (!result || inFlight.empty())
+            break;
+
+         auto &chunk = *inFlight.front();
+         wait(chunk, true);
+         if (chunk.pException) {
+            pException = chunk.pException;
+            result = false;
+         }
+         else if (!chunk.result || cancelled.load())
+            result = false;
+         else {
+            left.Set(chunk.sink->Get(0), floatSample, chunk.start, chunk.len,
+               format);
+            if (pRight)
+               pRight->Set(chunk.sink->Get(1), floatSample, chunk.start,
+                  chunk.len, format);
+            written += chunk.len;
+            if (!pollUser(start + written))
+               cancelled.store(true, std::memory_order_relaxed);
+         }
+         // Finalizes the instances on this thread
+         inFlight.pop_front();
+      }
+   }
+   catch (...) {
+      pException = std::current_exception();
+   }
+
+   // Stop any remaining chunks before destroying them
+   cancelled.store(true, std::memory_order_relaxed);
+   for (auto &pChunk : inFlight)
+      wait(*pChunk, false);
+   inFlight.clear();
+
+   if (pException)
+      std::rethrow_exception(pException);
+   return result;
+}
+
 bool PerTrackEffect::ProcessTrack(int channel, const Factory &factory,
    EffectSettings &settings,
    AudioGraph::Source &upstream, AudioGraph::Sink &sink,
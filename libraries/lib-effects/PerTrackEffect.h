@@ -19,9 +19,11 @@
 #include "Effect.h" // to inherit
 #include "MemoryX.h"
 #include "SampleCount.h"
+#include "SampleFormat.h"
 #include <functional>
 
 class SampleTrack;
+class WaveTrack;
 
 //! Base class for Effects that treat each (mono or stereo) track independently
 //! of other tracks.
@@ -61,6 +63,19 @@ protected:
    /* virtual */ bool DoPass1() const;
    /* virtual */ bool DoPass2() const;
 
+   //! Whether Process() may apply the effect to several tracks at once
+   /*!
+    If so, each (mono or stereo) track gets its own thread and copy of the
+    settings, and only the total progress is reported.  The first track is
+    processed by the given instance, the others by instances made by
+    MakeInstance().  Override to return true only if a new instance is
+    interchangeable with the given one after ProcessInitialize(), instances
+    share no mutable state with each other or with the effect, do not use
+    mSampleCnt, and do not interact with the user.  Not used for generators.
+    Default returns false.
+    */
+   virtual bool ProcessesTracksInParallel() const;
+
    // non-virtual
    bool Process(EffectInstance &instance, EffectSettings &settings) const;
 
@@ -71,6 +86,21 @@ private:
 
    bool ProcessPass(TrackList &outputs,
       Instance &instance, EffectSettings &settings);
+   //! ProcessPass for a processor, when ProcessesTracksInParallel()
+   bool ProcessPassInParallel(TrackList &outputs,
+      Instance &instance, EffectSettings &settings);
+   //! Process one long track (or pair of channels) with an effect of bounded
+   //! history, dividing it into chunks for worker threads
+   /*!
+    Chunks are written in order on this thread, which also polls the user
+    @param history as given by EffectInstance::GetHistoryLength()
+    @return false if the user cancelled or the effect failed
+    */
+   bool ProcessTrackInChunks(int channel, EffectSettings &settings,
+      EffectInstance::SampleCount history,
+      WaveTrack &left, WaveTrack *pRight, const WaveTrack &leader,
+      sampleCount start, sampleCount len, sampleFormat format,
+      const std::function<bool(sampleCount)> &pollUser);
    using Factory = std::function<std::shared_ptr<EffectInstance>()>;
    /*!
     Previous contents of inBuffers and outBuffers are ignored
@@ -0,0 +1,175 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PerTrackEffectTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "PerTrackEffect.h"
+#include "TestSampleBlockFactory.h"
+#include "WaveTrack.h"
+
+#include <random>
+
+namespace {
+constexpr double rate = 44100.0;
+
+//! A two-tap lowpass, whose state belongs to each instance, and which may
+//! declare its history
+class TestEffect final : public PerTrackEffect
+{
+public:
+   struct Instance final
+      : PerTrackEffect::Instance
+      , EffectInstanceWithBlockSize
+   {
+      explicit Instance(const TestEffect &effect)
+         : PerTrackEffect::Instance{ effect }
+         , mHistory{ effect.mHistory }
+      {}
+      bool ProcessInitialize(EffectSettings &, double, ChannelNames) override
+      {
+         mLast = 0;
+         return true;
+      }
+      size_t ProcessBlock(EffectSettings &, const float *const *inBlock,
+         float *const *outBlock, size_t blockLen) override
+      {
+         for (size_t ii = 0; ii < blockLen; ++ii) {
+            outBlock[0][ii] = inBlock[0][ii] + 0.5f * mLast;
+            mLast = inBlock[0][ii];
+         }
+         ++nBlocks;
+         return blockLen;
+      }
+      unsigned GetAudioInCount() const override { return 1; }
+      unsigned GetAudioOutCount() const override { return 1; }
+      std::optional<SampleCount> GetHistoryLength(
+         const EffectSettings &, double) const override
+      {
+         return mHistory;
+      }
+
+      const std::optional<SampleCount> mHistory;
+      float mLast{ 0 };
+      size_t nBlocks{ 0 };
+   };
+
+   explicit TestEffect(bool parallel,
+      std::optional<EffectInstance::SampleCount> history = {}
+   )  : mParallel{ parallel }, mHistory{ history }
+   {}
+
+   EffectType GetType() const override { return EffectTypeProcess; }
+   std::shared_ptr<EffectInstance> MakeInstance() const override
+   {
+      return std::make_shared<Instance>(*this);
+   }
+   bool ProcessesTracksInParallel() const override { return mParallel; }
+
+   bool Apply(TrackList &tracks, double t0, double t1)
+   {
+      const auto pInstance =
+         std::dynamic_pointer_cast<Instance>(MakeInstance());
+      SetTracks(&tracks);
+      mT0 = t0;
+      mT1 = t1;
+      auto settings = MakeSettings();
+      const auto result = pInstance->Process(settings);
+      // The given instance processed the first track, either way
+      return result && pInstance->nBlocks > 0;
+   }
+
+private:
+   const bool mParallel;
+   const std::optional<EffectInstance::SampleCount> mHistory;
+};
+
+TrackListHolder MakeTracks(const SampleBlockFactoryPtr &pFactory,
+   const std::vector<size_t> &lengths, bool stereo)
+{
+   std::mt19937 engine{ 42 };
+   std::uniform_real_distribution<float> distribution{ -1.0f, 1.0f };
+   const auto tracks = TrackList::Create(nullptr);
+   for (const auto length : lengths) {
+      const auto track =
+         std::make_shared<WaveTrack>(pFactory, floatSample, rate);
+      std::vector<float> samples(length);
+      for (auto &sample : samples)
+         sample = distribution(engine);
+      track->Append(reinterpret_cast<constSamplePtr>(samples.data()),
+         floatSample, length);
+      track->Flush();
+      track->SetSelected(true);
+      tracks->Add(track);
+   }
+   if (stereo)
+      tracks->MakeMultiChannelTrack(**tracks->Any().begin(), 2, true);
+   return tracks;
+}
+
+size_t MaxBlockSize(const SampleBlockFactoryPtr &pFactory)
+{
+   return WaveTrack{ pFactory, floatSample, rate }.GetMaxBlockSize();
+}
+
+std::vector<std::vector<float>> GetChannels(const TrackList &tracks)
+{
+   std::vector<std::vector<float>> result;
+   for (const auto pTrack : tracks.Any<const WaveTrack>()) {
+      const auto len =
+         pTrack->TimeToLongSamples(pTrack->GetEndTime()).as_size_t();
+      auto &samples = result.emplace_back(len);
+      float *buffers[]{ samples.data() };
+      pTrack->GetFloats(0, 1, buffers, 0, len);
+   }
+   return result;
+}
+
+//! Process copies of the same tracks with each effect, selecting all but a
+//! few samples at either end of the first track
+void Compare(TestEffect &effect1, TestEffect &effect2,
+   const std::vector<size_t> &lengths, bool stereo)
+{
+   const auto pFactory = std::make_shared<TestSampleBlockFactory>();
+   const auto tracks1 = MakeTracks(pFactory, lengths, stereo);
+   const auto tracks2 = MakeTracks(pFactory, lengths, stereo);
+   const auto original = GetChannels(*tracks1);
+   REQUIRE(original == GetChannels(*tracks2));
+
+   const double t0 = 10 / rate,
+      t1 = (*tracks1->Any<const WaveTrack>().begin())->GetEndTime() - t0;
+   REQUIRE(effect1.Apply(*tracks1, t0, t1));
+   REQUIRE(effect2.Apply(*tracks2, t0, t1));
+
+   const auto result = GetChannels(*tracks1);
+   REQUIRE(result != original);
+   REQUIRE(result == GetChannels(*tracks2));
+}
+}
+
+TEST_CASE("PerTrackEffect processes tracks in parallel as it does serially")
+{
+   const auto maxBlockSize =
+      MaxBlockSize(std::make_shared<TestSampleBlockFactory>());
+   // Mono tracks of different lengths; then a stereo track among others
+   TestEffect serial{ false }, parallel{ true };
+   Compare(serial, parallel, { 3 * maxBlockSize + 17, 2 * maxBlockSize + 5,
+      2 * maxBlockSize + 5, 100 }, false);
+   Compare(serial, parallel, { 2 * maxBlockSize + 5, 2 * maxBlockSize + 5,
+      3 * maxBlockSize + 17, 100 }, true);
+}
+
+TEST_CASE("PerTrackEffect processes chunks of a long track as it does serially")
+{
+   const auto maxBlockSize =
+      MaxBlockSize(std::make_shared<TestSampleBlockFactory>());
+   // Long enough for several chunks, and a partial one at the end
+   const auto length = 13 * maxBlockSize + 123;
+   TestEffect serial{ false }, chunked{ false, 1 };
+   Compare(serial, chunked, { length }, false);
+   Compare(serial, chunked, { length, length }, true);
+}
@@ -0,0 +1,82 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file CpuFeatures.cpp
+
+**********************************************************************/
+#include "CpuFeatures.h"
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace {
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+bool DetectSSE2()
+{
+   int info[4];
+   __cpuid(info, 1);
+   return (info[3] & (1 << 26)) != 0;
+}
+
+bool DetectAVX2()
+{
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return false;
+
+   // The operating system must also save the upper halves of the registers
+   __cpuid(info, 1);
+   constexpr int osxsave = 1 << 27, avx = 1 << 28;
+   if ((info[2] & (osxsave | avx)) != (osxsave | avx) ||
+       (_xgetbv(0) & 6) != 6)
+      return false;
+
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+}
+#elif defined(CPU_FEATURES_X86)
+bool DetectSSE2()
+{
+   return __builtin_cpu_supports("sse2");
+}
+
+bool DetectAVX2()
+{
+   return __builtin_cpu_supports("avx2");
+}
+#else
+bool DetectSSE2()
+{
+   return false;
+}
+
+bool DetectAVX2()
+{
+   return false;
+}
+#endif
+}
+
+bool CpuFeatures::HasSSE2()
+{
+   static const bool result = DetectSSE2();
+   return result;
+}
+
+bool CpuFeatures::HasAVX2()
+{
+   static const bool result = DetectAVX2();
+   return result;
+}
+
+bool CpuFeatures::HasNEON()
+{
+#if defined(CPU_FEATURES_ARM64)
+   return true;
+#else
+   return false;
+#endif
+}
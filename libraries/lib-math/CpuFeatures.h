@@ -0,0 +1,38 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file CpuFeatures.h
+  @brief Detection of instruction set extensions, for choosing vectorized
+  implementations at run time
+
+**********************************************************************/
+
+#ifndef __AUDACITY_CPU_FEATURES__
+#define __AUDACITY_CPU_FEATURES__
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#   define CPU_FEATURES_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+//! NEON is part of the base instruction set, needing no detection
+#   define CPU_FEATURES_ARM64 1
+#endif
+
+//! Mark a function to be compiled for an extension that the rest of the
+//! translation unit may not assume; call it only after detection
+#if defined(__GNUC__)
+#   define CPU_FEATURES_TARGET(isa) __attribute__((target(isa)))
+#else
+#   define CPU_FEATURES_TARGET(isa)
+#endif
+
+namespace CpuFeatures {
+
+//! Results are computed once and cached
+MATH_API bool HasSSE2();
+MATH_API bool HasAVX2();
+MATH_API bool HasNEON();
+
+}
+
+#endif
@@ -27,6 +27,9 @@
   - Triangle dithering
   - Noise-shaped dithering
 
+  All but noise-shaped dithering, and the conversions that need no
+  dither, are done by the vector kernels of SampleConvert.
+
 Dither class. You must construct an instance because it keeps
 state. Call Dither::Apply() to apply the dither. You can call
 Reset() between subsequent dithers to reset the dither state
@@ -63,12 +66,8 @@ constexpr int BUF_MASK = 7;
 // Lipshitz's minimally audible FIR
 const float SHAPED_BS[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
 
-// Dither state
-struct State {
-    int mPhase;
-    float mTriangleState;
-    float mBuffer[8 /* = BUF_SIZE */];
-} mState;
+using State = Dither::State;
+static_assert(sizeof(State::mBuffer) == BUF_SIZE * sizeof(float));
 
 using Ditherer = float (*)(State &, float);
 
@@ -83,11 +82,6 @@ constexpr auto CONVERT_DIV16 = float(1<<15);
 constexpr auto CONVERT_DIV24 = float(1<<23);
 
 // Dereference sample pointer and convert to float sample
-static inline float FROM_INT16(const short *ptr)
-{
-    return *ptr / CONVERT_DIV16;
-}
-
 static inline float FROM_INT24(const int *ptr)
 {
     return *ptr / CONVERT_DIV24;
@@ -179,9 +173,6 @@ static inline void DITHER( Ditherer dither, State &state,
 }
 
 
-static inline float NoDither(State &, float sample);
-static inline float RectangleDither(State &, float sample);
-static inline float TriangleDither(State &state, float sample);
 static inline float ShapedDither(State &state, float sample);
 
 Dither::Dither()
@@ -192,9 +183,9 @@ Dither::Dither()
 
 void Dither::Reset()
 {
-    mState.mTriangleState = 0;
     mState.mPhase = 0;
     memset(mState.mBuffer, 0, sizeof(float) * BUF_SIZE);
+    mNoise.Reset();
 }
 
 // This only decides if we must dither at all, the dithers
@@ -220,8 +211,6 @@ void Dither::Apply(enum DitherType ditherType,
                    unsigned int sourceStride /* = 1 */,
                    unsigned int destStride /* = 1 */)
 {
-    unsigned int i;
-
     // This code is not designed for 16-bit or 64-bit machine
     wxASSERT(sizeof(int) == 4);
     wxASSERT(sizeof(short) == 2);
@@ -236,119 +225,23 @@ void Dither::Apply(enum DitherType ditherType,
     if (len == 0)
         return; // nothing to do
 
-    if (destFormat == sourceFormat)
-    {
-        // No need to dither, because source and destination
-        // format are the same. Just copy samples.
-        if (destStride == 1 && sourceStride == 1)
-            memcpy(dest, source, len * SAMPLE_SIZE(destFormat));
-        else
-        {
-            if (sourceFormat == floatSample)
-            {
-                auto d = (float*)dest;
-                auto s = (const float*)source;
-
-                for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-                    *d = *s;
-            } else
-            if (sourceFormat == int24Sample)
-            {
-                auto d = (int*)dest;
-                auto s = (const int*)source;
-
-                for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-                    *d = *s;
-            } else
-            if (sourceFormat == int16Sample)
-            {
-                auto d = (short*)dest;
-                auto s = (const short*)source;
-
-                for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-                    *d = *s;
-            } else {
-                wxASSERT(false); // source format unknown
-            }
-        }
-    } else
-    if (destFormat == floatSample)
-    {
-        // No need to dither, just convert samples to float.
-        // No clipping should be necessary.
-        auto d = (float*)dest;
-
-        if (sourceFormat == int16Sample)
-        {
-            auto s = (const short*)source;
-            for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-                *d = FROM_INT16(s);
-        } else
-        if (sourceFormat == int24Sample)
-        {
-            auto s = (const int*)source;
-            for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-                *d = FROM_INT24(s);
-        } else {
-            wxASSERT(false); // source format unknown
-        }
-    } else
-    if (destFormat == int24Sample && sourceFormat == int16Sample)
+    if (ditherType == DitherType::shaped &&
+        SampleConvert::IsNarrowing(sourceFormat, destFormat))
     {
-        // Special case when promoting 16 bit to 24 bit
-        auto d = (int*)dest;
-        auto s = (const short*)source;
-        for (i = 0; i < len; i++, d += destStride, s += sourceStride)
-            *d = ((int)*s) << 8;
-    } else
+        Reset(); // reset dither filter for this NEW conversion
+        DITHER(ShapedDither, mState, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
+    }
+    else
     {
-        // We must do dithering
-        switch (ditherType)
-        {
-        case DitherType::none:
-            DITHER(NoDither, mState, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
-            break;
-        case DitherType::rectangle:
-            DITHER(RectangleDither, mState, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
-            break;
-        case DitherType::triangle:
-            Reset(); // reset dither filter for this NEW conversion
-            DITHER(TriangleDither, mState, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
-            break;
-        case DitherType::shaped:
-            Reset(); // reset dither filter for this NEW conversion
-            DITHER(ShapedDither, mState, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
-            break;
-        default:
-            wxASSERT(false); // unknown dither algorithm
-        }
+        if (ditherType == DitherType::triangle)
+            mNoise.previous = 0; // reset dither filter for this NEW conversion
+        SampleConvert::Convert(source, sourceFormat, sourceStride,
+            dest, destFormat, destStride, len, ditherType, mNoise);
     }
 }
 
 // Dither implementations
 
-// No dither, just return sample
-inline float NoDither(State &, float sample)
-{
-    return sample;
-}
-
-// Rectangle dithering, apply one-step noise
-inline float RectangleDither(State &, float sample)
-{
-    return sample - DITHER_NOISE();
-}
-
-// Triangle dither - high pass filtered
-inline float TriangleDither(State &state, float sample)
-{
-    float r = DITHER_NOISE();
-    float result = sample + r - state.mTriangleState;
-    state.mTriangleState = r;
-
-    return result;
-}
-
 // Shaped dither
 inline float ShapedDither(State &state, float sample)
 {
@@ -10,6 +10,7 @@
 #ifndef __AUDACITY_DITHER_H__
 #define __AUDACITY_DITHER_H__
 
+#include "SampleConvert.h"
 #include "SampleFormat.h"
 
 template< typename Enum > class EnumSetting;
@@ -28,6 +29,12 @@ public:
     static EnumSetting< DitherType > FastSetting;
     static EnumSetting< DitherType > BestSetting;
 
+    /// Error feedback history of shaped dither
+    struct State {
+        int mPhase;
+        float mBuffer[8];
+    };
+
     /// Default constructor
     Dither();
 
@@ -44,6 +51,13 @@ public:
                unsigned int len,
                unsigned int sourceStride = 1,
                unsigned int destStride = 1);
+
+private:
+    /// Noise for rectangle and triangle dither
+    SampleConvert::Noise mNoise;
+    /// Owned by each instance, so that threads with their own instances
+    /// don't share it
+    State mState;
 };
 
 #endif /* __AUDACITY_DITHER_H__ */
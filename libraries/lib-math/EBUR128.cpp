@@ -0,0 +1,466 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+EBUR128.cpp
+
+Max Maisel
+
+***********************************************************************/
+
+#include "EBUR128.h"
+#include "CpuFeatures.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(CPU_FEATURES_X86)
+#   include <emmintrin.h>
+#elif defined(CPU_FEATURES_ARM64)
+#   include <arm_neon.h>
+#endif
+
+namespace {
+
+// The kernels below repeat the operations of Biquad::ProcessOne in the
+// same order, including the rounding of each stage's output to float,
+// so that ProcessBuffers() gives the same results as the per-sample path.
+// Filter state lives in locals for the whole buffer and is written back
+// to the Biquads at the end.
+
+//! Filters one channel through the HSF and HPF stages and squares
+void WeightOne(Biquad *filter, const float *in, double *out, size_t len)
+{
+   auto &hsf = filter[0];
+   auto &hpf = filter[1];
+   const double hb0 = hsf.fNumerCoeffs[Biquad::B0],
+      hb1 = hsf.fNumerCoeffs[Biquad::B1], hb2 = hsf.fNumerCoeffs[Biquad::B2],
+      ha1 = hsf.fDenomCoeffs[Biquad::A1], ha2 = hsf.fDenomCoeffs[Biquad::A2];
+   const double pb0 = hpf.fNumerCoeffs[Biquad::B0],
+      pb1 = hpf.fNumerCoeffs[Biquad::B1], pb2 = hpf.fNumerCoeffs[Biquad::B2],
+      pa1 = hpf.fDenomCoeffs[Biquad::A1], pa2 = hpf.fDenomCoeffs[Biquad::A2];
+   double hx1 = hsf.fPrevIn, hx2 = hsf.fPrevPrevIn,
+      hy1 = hsf.fPrevOut, hy2 = hsf.fPrevPrevOut;
+   double px1 = hpf.fPrevIn, px2 = hpf.fPrevPrevIn,
+      py1 = hpf.fPrevOut, py2 = hpf.fPrevPrevOut;
+
+   for (size_t i = 0; i < len; ++i)
+   {
+      const float x = in[i];
+      const double hy =
+         double(x) * hb0 + hx1 * hb1 + hx2 * hb2 - hy1 * ha1 - hy2 * ha2;
+      hx2 = hx1; hx1 = x; hy2 = hy1; hy1 = hy;
+      const float h = hy;
+
+      const double py =
+         double(h) * pb0 + px1 * pb1 + px2 * pb2 - py1 * pa1 - py2 * pa2;
+      px2 = px1; px1 = h; py2 = py1; py1 = py;
+      const double value = float(py);
+      out[i] = value * value;
+   }
+
+   hsf.fPrevIn = hx1; hsf.fPrevPrevIn = hx2;
+   hsf.fPrevOut = hy1; hsf.fPrevPrevOut = hy2;
+   hpf.fPrevIn = px1; hpf.fPrevPrevIn = px2;
+   hpf.fPrevOut = py1; hpf.fPrevPrevOut = py2;
+}
+
+#if defined(CPU_FEATURES_X86)
+//! Like WeightOne, for two channels, one in each lane
+CPU_FEATURES_TARGET("sse2")
+void WeightPairSSE2(Biquad *filter0, Biquad *filter1,
+   const float *in0, const float *in1, double *out0, double *out1, size_t len)
+{
+   // Coefficients and state of both channels, channel 0 in the low lane
+   __m128d coeff[2][5], state[2][4];
+   for (size_t stage = 0; stage < 2; ++stage)
+   {
+      auto &f0 = filter0[stage];
+      auto &f1 = filter1[stage];
+      for (size_t ii = 0; ii < 3; ++ii)
+         coeff[stage][ii] =
+            _mm_set_pd(f1.fNumerCoeffs[ii], f0.fNumerCoeffs[ii]);
+      for (size_t ii = 0; ii < 2; ++ii)
+         coeff[stage][3 + ii] =
+            _mm_set_pd(f1.fDenomCoeffs[ii], f0.fDenomCoeffs[ii]);
+      state[stage][0] = _mm_set_pd(f1.fPrevIn, f0.fPrevIn);
+      state[stage][1] = _mm_set_pd(f1.fPrevPrevIn, f0.fPrevPrevIn);
+      state[stage][2] = _mm_set_pd(f1.fPrevOut, f0.fPrevOut);
+      state[stage][3] = _mm_set_pd(f1.fPrevPrevOut, f0.fPrevPrevOut);
+   }
+
+   for (size_t i = 0; i < len; ++i)
+   {
+      __m128d x = _mm_set_pd(in1[i], in0[i]);
+      for (size_t stage = 0; stage < 2; ++stage)
+      {
+         const auto c = coeff[stage];
+         const auto s = state[stage];
+         __m128d y = _mm_add_pd(_mm_mul_pd(x, c[0]), _mm_mul_pd(s[0], c[1]));
+         y = _mm_add_pd(y, _mm_mul_pd(s[1], c[2]));
+         y = _mm_sub_pd(y, _mm_mul_pd(s[2], c[3]));
+         y = _mm_sub_pd(y, _mm_mul_pd(s[3], c[4]));
+         s[1] = s[0]; s[0] = x; s[3] = s[2]; s[2] = y;
+         // Round to float, as ProcessOne returns
+         x = _mm_cvtps_pd(_mm_cvtpd_ps(y));
+      }
+      const __m128d power = _mm_mul_pd(x, x);
+      _mm_storel_pd(out0 + i, power);
+      _mm_storeh_pd(out1 + i, power);
+   }
+
+   for (size_t stage = 0; stage < 2; ++stage)
+   {
+      auto &f0 = filter0[stage];
+      auto &f1 = filter1[stage];
+      const auto s = state[stage];
+      _mm_storel_pd(&f0.fPrevIn, s[0]); _mm_storeh_pd(&f1.fPrevIn, s[0]);
+      _mm_storel_pd(&f0.fPrevPrevIn, s[1]);
+      _mm_storeh_pd(&f1.fPrevPrevIn, s[1]);
+      _mm_storel_pd(&f0.fPrevOut, s[2]); _mm_storeh_pd(&f1.fPrevOut, s[2]);
+      _mm_storel_pd(&f0.fPrevPrevOut, s[3]);
+      _mm_storeh_pd(&f1.fPrevPrevOut, s[3]);
+   }
+}
+#elif defined(CPU_FEATURES_ARM64)
+//! Like WeightOne, for two channels, one in each lane
+void WeightPairNEON(Biquad *filter0, Biquad *filter1,
+   const float *in0, const float *in1, double *out0, double *out1, size_t len)
+{
+   const auto pair = [](double lo, double hi) {
+      return vsetq_lane_f64(hi, vdupq_n_f64(lo), 1);
+   };
+
+   float64x2_t coeff[2][5], state[2][4];
+   for (size_t stage = 0; stage < 2; ++stage)
+   {
+      auto &f0 = filter0[stage];
+      auto &f1 = filter1[stage];
+      for (size_t ii = 0; ii < 3; ++ii)
+         coeff[stage][ii] = pair(f0.fNumerCoeffs[ii], f1.fNumerCoeffs[ii]);
+      for (size_t ii = 0; ii < 2; ++ii)
+         coeff[stage][3 + ii] =
+            pair(f0.fDenomCoeffs[ii], f1.fDenomCoeffs[ii]);
+      state[stage][0] = pair(f0.fPrevIn, f1.fPrevIn);
+      state[stage][1] = pair(f0.fPrevPrevIn, f1.fPrevPrevIn);
+      state[stage][2] = pair(f0.fPrevOut, f1.fPrevOut);
+      state[stage][3] = pair(f0.fPrevPrevOut, f1.fPrevPrevOut);
+   }
+
+   for (size_t i = 0; i < len; ++i)
+   {
+      float64x2_t x = pair(in0[i], in1[i]);
+      for (size_t stage = 0; stage < 2; ++stage)
+      {
+         const auto c = coeff[stage];
+         const auto s = state[stage];
+         float64x2_t y = vaddq_f64(vmulq_f64(x, c[0]), vmulq_f64(s[0], c[1]));
+         y = vaddq_f64(y, vmulq_f64(s[1], c[2]));
+         y = vsubq_f64(y, vmulq_f64(s[2], c[3]));
+         y = vsubq_f64(y, vmulq_f64(s[3], c[4]));
+         s[1] = s[0]; s[0] = x; s[3] = s[2]; s[2] = y;
+         // Round to float, as ProcessOne returns
+         x = vcvt_f64_f32(vcvt_f32_f64(y));
+      }
+      const float64x2_t power = vmulq_f64(x, x);
+      out0[i] = vgetq_lane_f64(power, 0);
+      out1[i] = vgetq_lane_f64(power, 1);
+   }
+
+   for (size_t stage = 0; stage < 2; ++stage)
+   {
+      auto &f0 = filter0[stage];
+      auto &f1 = filter1[stage];
+      const auto s = state[stage];
+      f0.fPrevIn = vgetq_lane_f64(s[0], 0);
+      f1.fPrevIn = vgetq_lane_f64(s[0], 1);
+      f0.fPrevPrevIn = vgetq_lane_f64(s[1], 0);
+      f1.fPrevPrevIn = vgetq_lane_f64(s[1], 1);
+      f0.fPrevOut = vgetq_lane_f64(s[2], 0);
+      f1.fPrevOut = vgetq_lane_f64(s[2], 1);
+      f0.fPrevPrevOut = vgetq_lane_f64(s[3], 0);
+      f1.fPrevPrevOut = vgetq_lane_f64(s[3], 1);
+   }
+}
+#endif
+
+//! Below this many samples per call, threads cost more than they save
+constexpr size_t MinParallelLength = 4096;
+
+}
+
+EBUR128::EBUR128(double rate, size_t channels)
+   : mChannelCount(channels)
+   , mRate(rate)
+{
+   mBlockSize = ceil(0.4 * mRate); // 400 ms blocks
+   mBlockOverlap = ceil(0.1 * mRate); // 100 ms overlap
+   mLoudnessHist.reinit(HIST_BIN_COUNT, false);
+   mBlockRingBuffer.reinit(mBlockSize);
+   mWeightingFilter.reinit(mChannelCount, false);
+   for(size_t channel = 0; channel < mChannelCount; ++channel)
+      mWeightingFilter[channel] = CalcWeightingFilter(mRate);
+}
+
+void EBUR128::Initialize()
+{
+   mSampleCount = 0;
+   mBlockRingPos = 0;
+   mBlockRingSize = 0;
+   memset(mLoudnessHist.get(), 0, HIST_BIN_COUNT*sizeof(long int));
+   for(size_t channel = 0; channel < mChannelCount; ++channel)
+   {
+      mWeightingFilter[channel][0].Reset();
+      mWeightingFilter[channel][1].Reset();
+   }
+}
+
+// fs: sample rate
+// returns array of two Biquads
+//
+// EBU R128 parameter sampling rate adaption after
+// Mansbridge, Stuart, Saoirse Finn, and Joshua D. Reiss.
+// "Implementation and Evaluation of Autonomous Multi-track Fader Control."
+// Paper presented at the 132nd Audio Engineering Society Convention,
+// Budapest, Hungary, 2012."
+ArrayOf<Biquad> EBUR128::CalcWeightingFilter(double fs)
+{
+   ArrayOf<Biquad> pBiquad(size_t(2), true);
+
+   //
+   // HSF pre filter
+   //
+   double db =    3.999843853973347;
+   double f0 = 1681.974450955533;
+   double Q  =    0.7071752369554196;
+   double K  = tan(M_PI * f0 / fs);
+
+   double Vh = pow(10.0, db / 20.0);
+   double Vb = pow(Vh, 0.4996667741545416);
+
+   double a0 = 1.0 + K / Q + K * K;
+
+   pBiquad[0].fNumerCoeffs[Biquad::B0] = (Vh + Vb * K / Q + K * K) / a0;
+   pBiquad[0].fNumerCoeffs[Biquad::B1] =       2.0 * (K * K -  Vh) / a0;
+   pBiquad[0].fNumerCoeffs[Biquad::B2] = (Vh - Vb * K / Q + K * K) / a0;
+
+   pBiquad[0].fDenomCoeffs[Biquad::A1] =   2.0 * (K * K - 1.0) / a0;
+   pBiquad[0].fDenomCoeffs[Biquad::A2] = (1.0 - K / Q + K * K) / a0;
+
+   //
+   // HPF weighting filter
+   //
+   f0 = 38.13547087602444;
+   Q  =  0.5003270373238773;
+   K  = tan(M_PI * f0 / fs);
+
+   pBiquad[1].fNumerCoeffs[Biquad::B0] =  1.0;
+   pBiquad[1].fNumerCoeffs[Biquad::B1] = -2.0;
+   pBiquad[1].fNumerCoeffs[Biquad::B2] =  1.0;
+
+   pBiquad[1].fDenomCoeffs[Biquad::A1] = 2.0 * (K * K - 1.0) / (1.0 + K / Q + K * K);
+   pBiquad[1].fDenomCoeffs[Biquad::A2] = (1.0 - K / Q + K * K) / (1.0 + K / Q + K * K);
+
+   return pBiquad;
+}
+
+void EBUR128::ProcessSampleFromChannel(float x_in, size_t channel)
+{
+   double value;
+   value = mWeightingFilter[channel][0].ProcessOne(x_in);
+   value = mWeightingFilter[channel][1].ProcessOne(value);
+   if(channel == 0)
+      mBlockRingBuffer[mBlockRingPos] = value * value;
+   else
+   {
+      // Add the power of additional channels to the power of first channel.
+      // As a result, stereo tracks appear about 3 LUFS louder, as specified.
+      mBlockRingBuffer[mBlockRingPos] += value * value;
+   }
+}
+
+void EBUR128::NextSample()
+{
+   ++mBlockRingPos;
+   ++mBlockRingSize;
+
+   if(mBlockRingPos % mBlockOverlap == 0)
+   {
+      // A new full block of samples was submitted.
+      if(mBlockRingSize >= mBlockSize)
+         AddBlockToHistogram(mBlockSize);
+   }
+   // Close the ring.
+   if(mBlockRingPos == mBlockSize)
+      mBlockRingPos = 0;
+   ++mSampleCount;
+}
+
+void EBUR128::ProcessBuffers(const float *const *channels, size_t len)
+{
+   if(len == 0 || mChannelCount == 0)
+      return;
+
+   if(mPowerCapacity < len)
+   {
+      mChannelPower.reinit(len * mChannelCount);
+      mPowerCapacity = len;
+   }
+
+   // Channels are filtered in pairs, and the pairs are independent
+   const size_t nPairs = (mChannelCount + 1) / 2;
+   const auto weightPair = [&](size_t iPair) {
+      const size_t first = 2 * iPair;
+      WeightChannels(channels, first,
+         std::min<size_t>(2, mChannelCount - first), len);
+   };
+   if(nPairs > 1 && len >= MinParallelLength)
+      WorkerPool::Get().ParallelFor(nPairs, weightPair);
+   else
+      for(size_t iPair = 0; iPair < nPairs; ++iPair)
+         weightPair(iPair);
+
+   // Add the power of additional channels to the power of first channel,
+   // in the same order as ProcessSampleFromChannel().
+   double *const power = mChannelPower.get();
+   for(size_t channel = 1; channel < mChannelCount; ++channel)
+   {
+      const double *const other = power + channel * mPowerCapacity;
+      for(size_t i = 0; i < len; ++i)
+         power[i] += other[i];
+   }
+
+   AddPowersToRing(power, len);
+}
+
+void EBUR128::WeightChannels(
+   const float *const *channels, size_t first, size_t count, size_t len)
+{
+   double *const out0 = mChannelPower.get() + first * mPowerCapacity;
+   if(count == 2)
+   {
+      double *const out1 = out0 + mPowerCapacity;
+#if defined(CPU_FEATURES_X86)
+      if(CpuFeatures::HasSSE2())
+      {
+         WeightPairSSE2(mWeightingFilter[first].get(),
+            mWeightingFilter[first + 1].get(),
+            channels[first], channels[first + 1], out0, out1, len);
+         return;
+      }
+#elif defined(CPU_FEATURES_ARM64)
+      WeightPairNEON(mWeightingFilter[first].get(),
+         mWeightingFilter[first + 1].get(),
+         channels[first], channels[first + 1], out0, out1, len);
+      return;
+#endif
+      WeightOne(mWeightingFilter[first + 1].get(),
+         channels[first + 1], out1, len);
+   }
+   WeightOne(mWeightingFilter[first].get(), channels[first], out0, len);
+}
+
+/// Copy squared samples into the ring buffer in runs that end where
+/// NextSample() would wrap the ring or complete a block.
+void EBUR128::AddPowersToRing(const double *power, size_t len)
+{
+   while(len > 0)
+   {
+      const size_t toOverlap = mBlockOverlap - mBlockRingPos % mBlockOverlap;
+      const size_t n = std::min({ len, toOverlap, mBlockSize - mBlockRingPos });
+      std::copy(power, power + n, &mBlockRingBuffer[mBlockRingPos]);
+      power += n;
+      len -= n;
+
+      mBlockRingPos += n;
+      mBlockRingSize += n;
+      mSampleCount += n;
+
+      if(mBlockRingPos % mBlockOverlap == 0)
+      {
+         // A new full block of samples was submitted.
+         if(mBlockRingSize >= mBlockSize)
+            AddBlockToHistogram(mBlockSize);
+      }
+      // Close the ring.
+      if(mBlockRingPos == mBlockSize)
+         mBlockRingPos = 0;
+   }
+}
+
+double EBUR128::IntegrativeLoudness()
+{
+   // EBU R128: z_i = mean square without root
+
+   // Calculate Gamma_R from histogram.
+   double sum_v;
+   long int sum_c;
+   HistogramSums(0, sum_v, sum_c);
+
+   // Handle incomplete block if no non-zero block was found.
+   if(sum_c == 0)
+   {
+      AddBlockToHistogram(mBlockRingSize);
+      HistogramSums(0, sum_v, sum_c);
+   }
+
+   // Histogram values are simplified log(x^2) immediate values
+   // without -0.691 + 10*(...) to safe computing power. This is
+   // possible because they will cancel out anyway.
+   // The -1 in the line below is the -10 LUFS from the EBU R128
+   // specification without the scaling factor of 10.
+   double Gamma_R = log10(sum_v/sum_c) - 1;
+   size_t idx_R = round((Gamma_R - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
+
+   // Apply Gamma_R threshold and calculate gated loudness (extent).
+   HistogramSums(idx_R+1, sum_v, sum_c);
+   if(sum_c == 0)
+      // Silence was processed.
+      return 0;
+   // LUFS is defined as -0.691 dB + 10*log10(sum(channels))
+   return 0.8529037031 * sum_v / sum_c;
+}
+
+void EBUR128::HistogramSums(size_t start_idx, double& sum_v, long int& sum_c)
+{
+    double val;
+    sum_v = 0;
+    sum_c = 0;
+    for(size_t i = start_idx; i < HIST_BIN_COUNT; ++i)
+    {
+       val = -GAMMA_A / double(HIST_BIN_COUNT) * (i+1) + GAMMA_A;
+       sum_v += pow(10, val) * mLoudnessHist[i];
+       sum_c += mLoudnessHist[i];
+    }
+}
+
+/// Process new full block. Incomplete blocks shall be discarded
+/// according to the EBU R128 specification there is usually no need
+/// to call this on the last block.
+/// However, allow to override the block size if the audio to be
+/// processed is shorter than one block.
+void EBUR128::AddBlockToHistogram(size_t validLen)
+{
+   // Reset mBlockRingSize to full state to avoid overflow.
+   // The actual value of mBlockRingSize does not matter
+   // since this is only used to detect if blocks are complete (>= mBlockSize).
+   mBlockRingSize = mBlockSize;
+
+   size_t idx;
+   double blockVal = 0;
+   for(size_t i = 0; i < validLen; ++i)
+      blockVal += mBlockRingBuffer[i];
+
+   // Histogram values are simplified log10() immediate values
+   // without -0.691 + 10*(...) to safe computing power. This is
+   // possible because these constant cancel out anyway during the
+   // following processing steps.
+   blockVal = log10(blockVal/double(validLen));
+   // log(blockVal) is within ]-inf, 1]
+   idx = round((blockVal - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
+
+   // idx is within ]-inf, HIST_BIN_COUNT-1], discard indices below 0
+   // as they are below the EBU R128 absolute threshold anyway.
+   if(idx < HIST_BIN_COUNT)
+      ++mLoudnessHist[idx];
+}
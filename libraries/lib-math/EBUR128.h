@@ -18,7 +18,7 @@ Max Maisel
 #include <cmath>
 
 /// \brief Implements EBU-R128 loudness measurement.
-class EBUR128
+class MATH_API EBUR128
 {
 public:
    EBUR128(double rate, size_t channels);
@@ -30,6 +30,12 @@ public:
    void Initialize();
    void ProcessSampleFromChannel(float x_in, size_t channel);
    void NextSample();
+   /// Same as calling ProcessSampleFromChannel() for every channel and
+   /// then NextSample(), for len samples, with the same results.
+   /// Filters whole buffers, pairs of channels at once in vector
+   /// registers, and more than two channels on several threads.
+   /// channels holds one pointer per channel to len samples each.
+   void ProcessBuffers(const float *const *channels, size_t len);
    double IntegrativeLoudness();
    inline double IntegrativeLoudnessToLUFS(double loudness)
       { return 10 * log10(loudness); }
@@ -37,6 +43,9 @@ public:
 private:
    void HistogramSums(size_t start_idx, double& sum_v, long int& sum_c);
    void AddBlockToHistogram(size_t validLen);
+   void WeightChannels(const float *const *channels, size_t first,
+                       size_t count, size_t len);
+   void AddPowersToRing(const double *power, size_t len);
 
    static const size_t HIST_BIN_COUNT = 65536;
    /// EBU R128 absolute threshold
@@ -56,6 +65,11 @@ private:
    /// CHANNEL = LEFT/RIGHT (0/1) and
    /// FILTER  = HSF/HPF    (0/1)
    ArrayOf<ArrayOf<Biquad>> mWeightingFilter;
+
+   /// Squared weighted samples of each channel for ProcessBuffers(),
+   /// mPowerCapacity samples per channel
+   Doubles mChannelPower;
+   size_t mPowerCapacity { 0 };
 };
 
 #endif
@@ -18,6 +18,8 @@
 *                   and BitReversed tables so they don't need to be reallocated
 *                   and recomputed on every call.
 *                 - Added Reorder* functions to undo the bit-reversal
+*              Sizes that are multiples of 32 now use the SIMD engine of
+*              PFFFT, with BitReversed describing its natural order output.
 *
 *  Copyright (C) 2009  Philip VanBaren
 *
@@ -38,11 +40,17 @@
 
 #include "RealFFTf.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
 #include <vector>
 #include <stdlib.h>
 #include <math.h>
 
-#include <wx/thread.h>
+#include "pffft.h"
 
 #ifndef M_PI
 #define	M_PI		3.14159265358979323846  /* pi */
@@ -52,10 +60,10 @@
 *  Initialize the Sine table and Twiddle pointers (bit-reversed pointers)
 *  for the FFT routine.
 */
-HFFT InitializeFFT(size_t fftlen)
+static std::unique_ptr<FFTParam> InitializeFFT(size_t fftlen)
 {
    int temp;
-   HFFT h{ safenew FFTParam };
+   auto h = std::make_unique<FFTParam>();
 
    /*
    *  FFT size is only half the number of data points
@@ -64,6 +72,21 @@ HFFT InitializeFFT(size_t fftlen)
    */
    h->Points = fftlen / 2;
 
+#ifndef EXPERIMENTAL_EQ_SSE_THREADED
+   // The vectorized engine needs a multiple of its minimum size; it produces
+   // bins in natural order, so the table of their positions is trivial
+   const size_t minSize = pffft_min_fft_size(PFFFT_REAL);
+   if (fftlen >= minSize && fftlen % minSize == 0) {
+      h->pSetup.reset(pffft_new_setup(fftlen, PFFFT_REAL));
+      if (h->pSetup) {
+         h->BitReversed.reinit(h->Points);
+         for(size_t i = 0; i < h->Points; i++)
+            h->BitReversed[i] = 2 * i;
+         return h;
+      }
+   }
+#endif
+
    h->SinTable.reinit(2*h->Points);
 
    h->BitReversed.reinit(h->Points);
@@ -93,51 +116,152 @@ HFFT InitializeFFT(size_t fftlen)
    return h;
 }
 
-enum : size_t { MAX_HFFT = 10 };
+namespace {
+//! Tables for every size ever requested, which are immutable once made
+/*!
+ They form a list that only grows at the head, so that lookups need no lock
+ and tables are computed once for each size, however many threads use them.
+ */
+class PlanRegistry {
+public:
+   PlanRegistry() = default;
+   PlanRegistry(const PlanRegistry&) = delete;
+   ~PlanRegistry()
+   {
+      auto pNode = mHead.load();
+      while (pNode)
+         delete std::exchange(pNode, pNode->next);
+   }
+
+   FFTParam *Get(size_t fftlen)
+   {
+      const auto points = fftlen / 2;
+      auto head = mHead.load(std::memory_order_acquire);
+      if (const auto pParam = Find(head, points)) {
+         mReused.fetch_add(1, std::memory_order_relaxed);
+         return pParam;
+      }
+
+      // Make new tables outside of any lock, then publish them, unless
+      // another thread did so first for the same size
+      auto pNode = std::make_unique<Node>(Node{ InitializeFFT(fftlen), head });
+      while (!mHead.compare_exchange_weak(pNode->next, pNode.get(),
+         std::memory_order_release, std::memory_order_acquire))
+         if (const auto pParam = Find(pNode->next, points)) {
+            mReused.fetch_add(1, std::memory_order_relaxed);
+            return pParam;
+         }
+      mCreated.fetch_add(1, std::memory_order_relaxed);
+      return pNode.release()->pParam.get();
+   }
+
+   FFTStatistics GetStatistics() const
+   {
+      return { mReused.load(std::memory_order_relaxed),
+         mCreated.load(std::memory_order_relaxed) };
+   }
 
-// Maintain a pool:
-static std::vector< std::unique_ptr<FFTParam> > hFFTArray(MAX_HFFT);
-wxCriticalSection getFFTMutex;
+private:
+   struct Node {
+      std::unique_ptr<FFTParam> pParam;
+      Node *next;
+   };
+
+   static FFTParam *Find(const Node *pNode, size_t points)
+   {
+      for (; pNode; pNode = pNode->next)
+         if (pNode->pParam->Points == points)
+            return pNode->pParam.get();
+      return nullptr;
+   }
+
+   std::atomic<Node*> mHead{ nullptr };
+   std::atomic<uint64_t> mReused{ 0 };
+   std::atomic<uint64_t> mCreated{ 0 };
+};
+
+PlanRegistry &GetRegistry()
+{
+   static PlanRegistry registry;
+   return registry;
+}
+}
 
 /* Get a handle to the FFT tables of the desired length */
 /* This version keeps common tables rather than allocating a NEW table every time */
 HFFT GetFFT(size_t fftlen)
 {
-   // To do:  smarter policy about when to retain in the pool and when to
-   // allocate a unique instance.
-
-   wxCriticalSectionLocker locker{ getFFTMutex };
-   
-   size_t h = 0;
-   auto n = fftlen/2;
-   auto size = hFFTArray.size();
-   for(;
-       (h < size) && hFFTArray[h] && (n != hFFTArray[h]->Points);
-       h++)
-      ;
-   if(h < size) {
-      if(hFFTArray[h] == NULL) {
-         hFFTArray[h].reset( InitializeFFT(fftlen).release() );
+   return HFFT{ GetRegistry().Get(fftlen) };
+}
+
+FFTStatistics GetFFTStatistics()
+{
+   return GetRegistry().GetStatistics();
+}
+
+void PffftSetupDeleter::operator() (PFFFT_Setup *p) const
+{
+   pffft_destroy_setup(p);
+}
+
+namespace {
+//! Memory aligned as the vectorized engine requires, kept for reuse by all
+//! transforms on one thread, because the setups are shared between threads
+class AlignedBuffer {
+public:
+   AlignedBuffer() = default;
+   AlignedBuffer(const AlignedBuffer&) = delete;
+   ~AlignedBuffer() { pffft_aligned_free(mpData); }
+
+   fft_type *Reserve(size_t size)
+   {
+      if (size > mSize) {
+         pffft_aligned_free(mpData);
+         mpData = nullptr, mSize = 0;
+         mpData = static_cast<fft_type*>(
+            pffft_aligned_malloc(size * sizeof(fft_type)));
+         if (!mpData)
+            throw std::bad_alloc{};
+         mSize = size;
       }
-      return HFFT{ hFFTArray[h].get() };
-   } else {
-      // All buffers used, so fall back to allocating a NEW set of tables
-      return InitializeFFT(fftlen);
+      return mpData;
    }
+
+private:
+   fft_type *mpData{};
+   size_t mSize{};
+};
+
+thread_local AlignedBuffer tWork, tCopy;
+
+void PffftTransform(
+   fft_type *buffer, const FFTParam *h, pffft_direction_t direction)
+{
+   const auto size = 2 * h->Points;
+   const auto work = tWork.Reserve(size);
+   // Callers' buffers are usually aligned enough already
+   auto data = buffer;
+   if (reinterpret_cast<uintptr_t>(buffer) % (4 * sizeof(fft_type)) != 0)
+      data = std::copy(buffer, buffer + size, tCopy.Reserve(size)) - size;
+
+   // Transform in place
+   pffft_transform_ordered(h->pSetup.get(), data, data, work, direction);
+
+   if (direction == PFFFT_BACKWARD) {
+      // PFFFT does not scale; match the scalar inverse
+      const auto scale = 1.0f / size;
+      std::transform(data, data + size, buffer,
+         [scale](fft_type x){ return x * scale; });
+   }
+   else if (data != buffer)
+      std::copy(data, data + size, buffer);
+}
 }
 
 /* Release a previously requested handle to the FFT tables */
-void FFTDeleter::operator() (FFTParam *hFFT) const
+void FFTDeleter::operator() (FFTParam *) const
 {
-   wxCriticalSectionLocker locker{ getFFTMutex };
-
-   auto it = hFFTArray.begin(), end = hFFTArray.end();
-   while (it != end && it->get() != hFFT)
-      ++it;
-   if ( it != end )
-      ;
-   else
-      delete hFFT;
+   // The registry keeps the tables for reuse
 }
 
 /*
@@ -160,6 +284,11 @@ void FFTDeleter::operator() (FFTParam *hFFT) const
 */
 void RealFFTf(fft_type *buffer, const FFTParam *h)
 {
+   if (h->pSetup) {
+      PffftTransform(buffer, h, PFFFT_FORWARD);
+      return;
+   }
+
    fft_type *A,*B;
    const fft_type *sptr;
    const fft_type *endptr1,*endptr2;
@@ -262,6 +391,11 @@ void RealFFTf(fft_type *buffer, const FFTParam *h)
 */
 void InverseRealFFTf(fft_type *buffer, const FFTParam *h)
 {
+   if (h->pSetup) {
+      PffftTransform(buffer, h, PFFFT_BACKWARD);
+      return;
+   }
+
    fft_type *A,*B;
    const fft_type *sptr;
    const fft_type *endptr1,*endptr2;
@@ -2,12 +2,23 @@
 #define __realfftf_h
 
 #include "MemoryX.h"
+#include <cstdint>
 
 using fft_type = float;
+
+struct PFFFT_Setup;
+struct MATH_API PffftSetupDeleter {
+   void operator () (PFFFT_Setup *p) const;
+};
+
 struct FFTParam {
    ArrayOf<int> BitReversed;
    ArrayOf<fft_type> SinTable;
    size_t Points;
+   //! If not null, the transforms use a vectorized engine, and BitReversed
+   //! maps each bin to natural order while SinTable is empty.  Either way,
+   //! callers find bin i at BitReversed[i].
+   std::unique_ptr<PFFFT_Setup, PffftSetupDeleter> pSetup;
 #ifdef EXPERIMENTAL_EQ_SSE_THREADED
    int pow2Bits;
 #endif
@@ -21,7 +32,19 @@ using HFFT = std::unique_ptr<
    FFTParam, FFTDeleter
 >;
 
+//! Get tables for transforms of the given length, which may be shared
+//! with other callers and threads
 MATH_API HFFT GetFFT(size_t);
+
+//! Counts of requests to GetFFT, which may be slightly stale when read
+struct FFTStatistics {
+   //! Requests satisfied by tables made earlier
+   uint64_t reused;
+   //! Tables made, once for each length
+   uint64_t created;
+};
+MATH_API FFTStatistics GetFFTStatistics();
+
 MATH_API void RealFFTf(fft_type *, const FFTParam *);
 MATH_API void InverseRealFFTf(fft_type *, const FFTParam *);
 MATH_API void ReorderToTime(const FFTParam *hFFT, const fft_type *buffer, fft_type *TimeOut);
@@ -0,0 +1,658 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SampleConvert.cpp
+
+  Split from Dither.cpp
+
+**********************************************************************/
+#include "SampleConvert.h"
+#include "CpuFeatures.h"
+#include "Dither.h"
+
+// Erik de Castro Lopo's header file that
+// makes sure that we have lrint and lrintf
+#include "float_cast.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(CPU_FEATURES_X86)
+#   include <emmintrin.h>
+#elif defined(CPU_FEATURES_ARM64)
+#   include <arm_neon.h>
+#endif
+
+using namespace SampleConvert;
+
+namespace {
+constexpr auto Lanes = Noise::Lanes;
+
+// Defines for sample conversion
+constexpr auto CONVERT_DIV16 = float(1<<15);
+constexpr auto CONVERT_DIV24 = float(1<<23);
+
+//! Scale from the 24 high bits of a generator's state to [0, 1)
+constexpr auto NOISE_SCALE = 1.0f / float(1<<24);
+
+//! Samples staged at once for strided conversions
+constexpr size_t ChunkSize = 256;
+
+inline uint32_t Advance(uint32_t x)
+{
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return x;
+}
+
+inline float ToNoise(uint32_t x)
+{
+   return static_cast<int32_t>(x >> 8) * NOISE_SCALE - 0.5f;
+}
+
+//! Range of an integer format, for the narrowing conversions
+template<typename Dst> struct Limits;
+template<> struct Limits<int16_t> {
+   static constexpr float scale = CONVERT_DIV16;
+   static constexpr float min = -32768.0f;
+   static constexpr float max = 32767.0f;
+};
+template<> struct Limits<int32_t> {
+   static constexpr float scale = CONVERT_DIV24;
+   static constexpr float min = -8388608.0f;
+   static constexpr float max = 8388607.0f;
+};
+
+/*
+ Scalar definitions, which the vector kernels reproduce exactly.
+
+ For float, we internally allow values greater than 1.0, which would blow
+ up the dithering to int values, so limit them first.  NaN becomes zero,
+ as in shaped dither.
+
+ Limiting to the integer range before rounding, rather than after, gives
+ the same result, because the limits are integers; and it lets the vector
+ kernels saturate in float.
+ */
+inline float LoadSample(float x)
+{
+   if (x != x)
+      return 0.0f;
+   return x > 1.0f ? 1.0f : x < -1.0f ? -1.0f : x;
+}
+
+inline float LoadSample(int32_t x)
+{
+   return x / CONVERT_DIV24;
+}
+
+template<typename Dst> inline Dst StoreSample(float x)
+{
+   x = std::clamp(x, Limits<Dst>::min, Limits<Dst>::max);
+   return static_cast<Dst>(lrintf(x));
+}
+
+inline float Dithered(float x, DitherType ditherType, Noise &noise)
+{
+   switch (ditherType) {
+   case DitherType::rectangle:
+      return x - noise.Next();
+   case DitherType::triangle: {
+      // High pass filtered
+      const auto r = noise.Next();
+      const auto result = x + r - noise.previous;
+      noise.previous = r;
+      return result;
+   }
+   default:
+      return x;
+   }
+}
+
+template<typename Src, typename Dst>
+inline Dst NarrowOne(Src x, DitherType ditherType, Noise &noise)
+{
+   return StoreSample<Dst>(
+      Dithered(LoadSample(x) * Limits<Dst>::scale, ditherType, noise));
+}
+
+inline bool IsDither(DitherType ditherType)
+{
+   return ditherType == DitherType::rectangle ||
+      ditherType == DitherType::triangle;
+}
+
+struct ScalarOps
+{
+   static void ToFloat(const int16_t *src, float *dst, size_t len)
+   {
+      for (size_t i = 0; i < len; ++i)
+         dst[i] = src[i] / CONVERT_DIV16;
+   }
+
+   static void ToFloat(const int32_t *src, float *dst, size_t len)
+   {
+      for (size_t i = 0; i < len; ++i)
+         dst[i] = src[i] / CONVERT_DIV24;
+   }
+
+   static void Widen(const int16_t *src, int32_t *dst, size_t len)
+   {
+      for (size_t i = 0; i < len; ++i)
+         dst[i] = int32_t(src[i]) * 256;
+   }
+
+   template<typename Src, typename Dst>
+   static void Narrow(const Src *src, Dst *dst, size_t len,
+      DitherType ditherType, Noise &noise)
+   {
+      for (size_t i = 0; i < len; ++i)
+         dst[i] = NarrowOne<Src, Dst>(src[i], ditherType, noise);
+   }
+};
+
+/*
+ The vector kernels take Lanes samples in each step, drawing one value of
+ noise from each generator, once the scalar code has brought the next
+ generator to draw from back to the first.
+ */
+
+#if defined(CPU_FEATURES_X86)
+struct SSE2Ops
+{
+   CPU_FEATURES_TARGET("sse2")
+   static void ToFloat(const int16_t *src, float *dst, size_t len)
+   {
+      const auto scale = _mm_set1_ps(1.0f / CONVERT_DIV16);
+      size_t i = 0;
+      for (; i + 8 <= len; i += 8) {
+         const auto x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+         const auto lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+         const auto hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+         // Multiplication by the reciprocal of a power of two is exact
+         _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+         _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+      }
+      ScalarOps::ToFloat(src + i, dst + i, len - i);
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static void ToFloat(const int32_t *src, float *dst, size_t len)
+   {
+      const auto scale = _mm_set1_ps(1.0f / CONVERT_DIV24);
+      size_t i = 0;
+      for (; i + 4 <= len; i += 4) {
+         const auto x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+         _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+      }
+      ScalarOps::ToFloat(src + i, dst + i, len - i);
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static void Widen(const int16_t *src, int32_t *dst, size_t len)
+   {
+      size_t i = 0;
+      for (; i + 8 <= len; i += 8) {
+         const auto x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+         const auto lo = _mm_slli_epi32(
+            _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), 8);
+         const auto hi = _mm_slli_epi32(
+            _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16), 8);
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), lo);
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), hi);
+      }
+      ScalarOps::Widen(src + i, dst + i, len - i);
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static __m128 Load(const float *src)
+   {
+      auto x = _mm_loadu_ps(src);
+      // NaN to zero
+      x = _mm_and_ps(x, _mm_cmpeq_ps(x, x));
+      return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static __m128 Load(const int32_t *src)
+   {
+      const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / CONVERT_DIV24));
+   }
+
+   template<typename Dst>
+   CPU_FEATURES_TARGET("sse2")
+   static __m128i Round(__m128 x)
+   {
+      x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(Limits<Dst>::min)),
+         _mm_set1_ps(Limits<Dst>::max));
+      // Rounds to nearest even, like lrintf
+      return _mm_cvtps_epi32(x);
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static void Store(int16_t *dst, __m128 x0, __m128 x1)
+   {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),
+         _mm_packs_epi32(Round<int16_t>(x0), Round<int16_t>(x1)));
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static void Store(int32_t *dst, __m128 x0, __m128 x1)
+   {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), Round<int32_t>(x0));
+      _mm_storeu_si128(
+         reinterpret_cast<__m128i*>(dst + 4), Round<int32_t>(x1));
+   }
+
+   CPU_FEATURES_TARGET("sse2")
+   static __m128 Draw(__m128i &state)
+   {
+      state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+      state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+      state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+      return _mm_sub_ps(
+         _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(state, 8)),
+            _mm_set1_ps(NOISE_SCALE)),
+         _mm_set1_ps(0.5f));
+   }
+
+   template<typename Src, typename Dst>
+   CPU_FEATURES_TARGET("sse2")
+   static void Narrow(const Src *src, Dst *dst, size_t len,
+      DitherType ditherType, Noise &noise)
+   {
+      static_assert(Lanes == 8);
+      size_t i = 0;
+      if (IsDither(ditherType))
+         for (; i < len && noise.lane != 0; ++i)
+            dst[i] = NarrowOne<Src, Dst>(src[i], ditherType, noise);
+
+      const auto scale = _mm_set1_ps(Limits<Dst>::scale);
+      auto state0 = _mm_loadu_si128(reinterpret_cast<__m128i*>(noise.state));
+      auto state1 =
+         _mm_loadu_si128(reinterpret_cast<__m128i*>(noise.state + 4));
+      auto previous = _mm_set1_ps(noise.previous);
+      for (; i + Lanes <= len; i += Lanes) {
+         auto x0 = _mm_mul_ps(Load(src + i), scale);
+         auto x1 = _mm_mul_ps(Load(src + i + 4), scale);
+         if (ditherType == DitherType::rectangle) {
+            x0 = _mm_sub_ps(x0, Draw(state0));
+            x1 = _mm_sub_ps(x1, Draw(state1));
+         }
+         else if (ditherType == DitherType::triangle) {
+            const auto r0 = Draw(state0);
+            const auto r1 = Draw(state1);
+            // Each sample subtracts the noise drawn for the one before
+            const auto p0 = _mm_move_ss(
+               _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(2, 1, 0, 0)), previous);
+            const auto p1 = _mm_move_ss(
+               _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(2, 1, 0, 0)),
+               _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 3, 3, 3)));
+            x0 = _mm_sub_ps(_mm_add_ps(x0, r0), p0);
+            x1 = _mm_sub_ps(_mm_add_ps(x1, r1), p1);
+            previous = _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 3, 3, 3));
+         }
+         Store(dst + i, x0, x1);
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(noise.state), state0);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(noise.state + 4), state1);
+      noise.previous = _mm_cvtss_f32(previous);
+
+      ScalarOps::Narrow(src + i, dst + i, len - i, ditherType, noise);
+   }
+};
+#endif
+
+#if defined(CPU_FEATURES_ARM64)
+struct NEONOps
+{
+   static void ToFloat(const int16_t *src, float *dst, size_t len)
+   {
+      const auto scale = vdupq_n_f32(1.0f / CONVERT_DIV16);
+      size_t i = 0;
+      for (; i + 8 <= len; i += 8) {
+         const auto x = vld1q_s16(src + i);
+         // Multiplication by the reciprocal of a power of two is exact
+         vst1q_f32(dst + i,
+            vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), scale));
+         vst1q_f32(dst + i + 4,
+            vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), scale));
+      }
+      ScalarOps::ToFloat(src + i, dst + i, len - i);
+   }
+
+   static void ToFloat(const int32_t *src, float *dst, size_t len)
+   {
+      const auto scale = vdupq_n_f32(1.0f / CONVERT_DIV24);
+      size_t i = 0;
+      for (; i + 4 <= len; i += 4)
+         vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+      ScalarOps::ToFloat(src + i, dst + i, len - i);
+   }
+
+   static void Widen(const int16_t *src, int32_t *dst, size_t len)
+   {
+      size_t i = 0;
+      for (; i + 8 <= len; i += 8) {
+         const auto x = vld1q_s16(src + i);
+         vst1q_s32(dst + i, vshlq_n_s32(vmovl_s16(vget_low_s16(x)), 8));
+         vst1q_s32(dst + i + 4, vshlq_n_s32(vmovl_s16(vget_high_s16(x)), 8));
+      }
+      ScalarOps::Widen(src + i, dst + i, len - i);
+   }
+
+   static float32x4_t Load(const float *src)
+   {
+      auto x = vld1q_f32(src);
+      // NaN to zero
+      x = vreinterpretq_f32_u32(
+         vandq_u32(vreinterpretq_u32_f32(x), vceqq_f32(x, x)));
+      return vminq_f32(vmaxq_f32(x, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f));
+   }
+
+   static float32x4_t Load(const int32_t *src)
+   {
+      return vmulq_f32(vcvtq_f32_s32(vld1q_s32(src)),
+         vdupq_n_f32(1.0f / CONVERT_DIV24));
+   }
+
+   template<typename Dst>
+   static int32x4_t Round(float32x4_t x)
+   {
+      x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(Limits<Dst>::min)),
+         vdupq_n_f32(Limits<Dst>::max));
+      // Rounds to nearest even, like lrintf
+      return vcvtnq_s32_f32(x);
+   }
+
+   static void Store(int16_t *dst, float32x4_t x0, float32x4_t x1)
+   {
+      vst1q_s16(dst, vcombine_s16(
+         vqmovn_s32(Round<int16_t>(x0)), vqmovn_s32(Round<int16_t>(x1))));
+   }
+
+   static void Store(int32_t *dst, float32x4_t x0, float32x4_t x1)
+   {
+      vst1q_s32(dst, Round<int32_t>(x0));
+      vst1q_s32(dst + 4, Round<int32_t>(x1));
+   }
+
+   static float32x4_t Draw(uint32x4_t &state)
+   {
+      state = veorq_u32(state, vshlq_n_u32(state, 13));
+      state = veorq_u32(state, vshrq_n_u32(state, 17));
+      state = veorq_u32(state, vshlq_n_u32(state, 5));
+      return vsubq_f32(
+         vmulq_f32(
+            vcvtq_f32_s32(vreinterpretq_s32_u32(vshrq_n_u32(state, 8))),
+            vdupq_n_f32(NOISE_SCALE)),
+         vdupq_n_f32(0.5f));
+   }
+
+   template<typename Src, typename Dst>
+   static void Narrow(const Src *src, Dst *dst, size_t len,
+      DitherType ditherType, Noise &noise)
+   {
+      static_assert(Lanes == 8);
+      size_t i = 0;
+      if (IsDither(ditherType))
+         for (; i < len && noise.lane != 0; ++i)
+            dst[i] = NarrowOne<Src, Dst>(src[i], ditherType, noise);
+
+      const auto scale = vdupq_n_f32(Limits<Dst>::scale);
+      auto state0 = vld1q_u32(noise.state);
+      auto state1 = vld1q_u32(noise.state + 4);
+      auto previous = vdupq_n_f32(noise.previous);
+      for (; i + Lanes <= len; i += Lanes) {
+         auto x0 = vmulq_f32(Load(src + i), scale);
+         auto x1 = vmulq_f32(Load(src + i + 4), scale);
+         if (ditherType == DitherType::rectangle) {
+            x0 = vsubq_f32(x0, Draw(state0));
+            x1 = vsubq_f32(x1, Draw(state1));
+         }
+         else if (ditherType == DitherType::triangle) {
+            const auto r0 = Draw(state0);
+            const auto r1 = Draw(state1);
+            // Each sample subtracts the noise drawn for the one before
+            x0 = vsubq_f32(vaddq_f32(x0, r0), vextq_f32(previous, r0, 3));
+            x1 = vsubq_f32(vaddq_f32(x1, r1), vextq_f32(r0, r1, 3));
+            previous = vdupq_laneq_f32(r1, 3);
+         }
+         Store(dst + i, x0, x1);
+      }
+      vst1q_u32(noise.state, state0);
+      vst1q_u32(noise.state + 4, state1);
+      noise.previous = vgetq_lane_f32(previous, 0);
+
+      ScalarOps::Narrow(src + i, dst + i, len - i, ditherType, noise);
+   }
+};
+#endif
+
+//! Conversion between different formats, of contiguous samples
+template<typename Ops>
+void ConvertContiguous(constSamplePtr src, sampleFormat srcFormat,
+   samplePtr dst, sampleFormat dstFormat, size_t len,
+   DitherType ditherType, Noise &noise)
+{
+   const auto int16Src = reinterpret_cast<const int16_t*>(src);
+   const auto int24Src = reinterpret_cast<const int32_t*>(src);
+   const auto floatSrc = reinterpret_cast<const float*>(src);
+
+   if (dstFormat == floatSample) {
+      const auto floatDst = reinterpret_cast<float*>(dst);
+      if (srcFormat == int16Sample)
+         Ops::ToFloat(int16Src, floatDst, len);
+      else
+         Ops::ToFloat(int24Src, floatDst, len);
+   }
+   else if (dstFormat == int24Sample) {
+      const auto int24Dst = reinterpret_cast<int32_t*>(dst);
+      if (srcFormat == int16Sample)
+         Ops::Widen(int16Src, int24Dst, len);
+      else
+         Ops::Narrow(floatSrc, int24Dst, len, ditherType, noise);
+   }
+   else {
+      const auto int16Dst = reinterpret_cast<int16_t*>(dst);
+      if (srcFormat == int24Sample)
+         Ops::Narrow(int24Src, int16Dst, len, ditherType, noise);
+      else
+         Ops::Narrow(floatSrc, int16Dst, len, ditherType, noise);
+   }
+}
+
+void ConvertContiguous(constSamplePtr src, sampleFormat srcFormat,
+   samplePtr dst, sampleFormat dstFormat, size_t len,
+   DitherType ditherType, Noise &noise, Kernel kernel)
+{
+   switch (kernel) {
+#if defined(CPU_FEATURES_X86)
+   case Kernel::SSE2:
+      ConvertContiguous<SSE2Ops>(
+         src, srcFormat, dst, dstFormat, len, ditherType, noise);
+      break;
+#endif
+#if defined(CPU_FEATURES_ARM64)
+   case Kernel::NEON:
+      ConvertContiguous<NEONOps>(
+         src, srcFormat, dst, dstFormat, len, ditherType, noise);
+      break;
+#endif
+   default:
+      ConvertContiguous<ScalarOps>(
+         src, srcFormat, dst, dstFormat, len, ditherType, noise);
+      break;
+   }
+}
+
+// The stride of interleaved stereo is a constant, so that the compiler can
+// vectorize it with shuffles
+template<typename T>
+void Gather(const T *src, size_t stride, T *dst, size_t len)
+{
+   if (stride == 2)
+      for (size_t i = 0; i < len; ++i)
+         dst[i] = src[2 * i];
+   else
+      for (size_t i = 0; i < len; ++i)
+         dst[i] = src[i * stride];
+}
+
+template<typename T>
+void Scatter(const T *src, T *dst, size_t stride, size_t len)
+{
+   if (stride == 2)
+      for (size_t i = 0; i < len; ++i)
+         dst[2 * i] = src[i];
+   else
+      for (size_t i = 0; i < len; ++i)
+         dst[i * stride] = src[i];
+}
+
+template<typename T>
+void StridedCopy(const T *src, size_t srcStride,
+   T *dst, size_t dstStride, size_t len)
+{
+   for (size_t i = 0; i < len; ++i, src += srcStride, dst += dstStride)
+      *dst = *src;
+}
+
+// Samples are copied as bit patterns of their sizes
+void Gather(constSamplePtr src, unsigned size, size_t stride,
+   void *dst, size_t len)
+{
+   if (size == 2)
+      Gather(reinterpret_cast<const uint16_t*>(src), stride,
+         static_cast<uint16_t*>(dst), len);
+   else
+      Gather(reinterpret_cast<const uint32_t*>(src), stride,
+         static_cast<uint32_t*>(dst), len);
+}
+
+void Scatter(const void *src, unsigned size, samplePtr dst, size_t stride,
+   size_t len)
+{
+   if (size == 2)
+      Scatter(static_cast<const uint16_t*>(src),
+         reinterpret_cast<uint16_t*>(dst), stride, len);
+   else
+      Scatter(static_cast<const uint32_t*>(src),
+         reinterpret_cast<uint32_t*>(dst), stride, len);
+}
+}
+
+Noise::Noise()
+{
+   Reset();
+}
+
+void Noise::Reset()
+{
+   // Distinct, nonzero seeds
+   for (size_t ii = 0; ii < Lanes; ++ii)
+      state[ii] = 0x9E3779B9u * (ii + 1);
+   lane = 0;
+   previous = 0;
+}
+
+float Noise::Next()
+{
+   auto &x = state[lane];
+   x = Advance(x);
+   lane = (lane + 1) % Lanes;
+   return ToNoise(x);
+}
+
+bool SampleConvert::IsAvailable(Kernel kernel)
+{
+   switch (kernel) {
+   case Kernel::Scalar:
+      return true;
+#if defined(CPU_FEATURES_X86)
+   case Kernel::SSE2:
+      return CpuFeatures::HasSSE2();
+#endif
+#if defined(CPU_FEATURES_ARM64)
+   case Kernel::NEON:
+      return CpuFeatures::HasNEON();
+#endif
+   default:
+      return false;
+   }
+}
+
+auto SampleConvert::BestKernel() -> Kernel
+{
+   static const auto result = []{
+      for (auto kernel : { Kernel::NEON, Kernel::SSE2 })
+         if (IsAvailable(kernel))
+            return kernel;
+      return Kernel::Scalar;
+   }();
+   return result;
+}
+
+void SampleConvert::Convert(
+   constSamplePtr src, sampleFormat srcFormat, size_t srcStride,
+   samplePtr dst, sampleFormat dstFormat, size_t dstStride,
+   size_t len, DitherType ditherType, Noise &noise, Kernel kernel)
+{
+   if (len == 0)
+      return;
+
+   const auto srcSize = SAMPLE_SIZE(srcFormat);
+   const auto dstSize = SAMPLE_SIZE(dstFormat);
+
+   if (srcFormat == dstFormat) {
+      if (srcStride == 1 && dstStride == 1)
+         memcpy(dst, src, len * srcSize);
+      else if (srcSize == 2)
+         StridedCopy(reinterpret_cast<const uint16_t*>(src), srcStride,
+            reinterpret_cast<uint16_t*>(dst), dstStride, len);
+      else
+         StridedCopy(reinterpret_cast<const uint32_t*>(src), srcStride,
+            reinterpret_cast<uint32_t*>(dst), dstStride, len);
+      return;
+   }
+
+   if (!IsAvailable(kernel))
+      kernel = Kernel::Scalar;
+   if (!IsNarrowing(srcFormat, dstFormat))
+      ditherType = DitherType::none;
+
+   if (srcStride == 1 && dstStride == 1) {
+      ConvertContiguous(
+         src, srcFormat, dst, dstFormat, len, ditherType, noise, kernel);
+      return;
+   }
+
+   // Stage strided samples through small buffers
+   alignas(16) uint32_t srcBuffer[ChunkSize];
+   alignas(16) uint32_t dstBuffer[ChunkSize];
+   for (size_t done = 0; done < len;) {
+      const auto count = std::min(ChunkSize, len - done);
+
+      auto chunkSrc = src + done * srcStride * srcSize;
+      if (srcStride != 1) {
+         Gather(chunkSrc, srcSize, srcStride, srcBuffer, count);
+         chunkSrc = reinterpret_cast<constSamplePtr>(srcBuffer);
+      }
+
+      const auto chunkDst = dst + done * dstStride * dstSize;
+      const auto out = dstStride == 1
+         ? chunkDst : reinterpret_cast<samplePtr>(dstBuffer);
+      ConvertContiguous(
+         chunkSrc, srcFormat, out, dstFormat, count, ditherType, noise, kernel);
+      if (dstStride != 1)
+         Scatter(dstBuffer, dstSize, chunkDst, dstStride, count);
+
+      done += count;
+   }
+}
@@ -0,0 +1,91 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SampleConvert.h
+  @brief Vectorized conversion of samples between formats, with strides,
+  and with rectangle or triangle dither
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_CONVERT__
+#define __AUDACITY_SAMPLE_CONVERT__
+
+#include "SampleFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SampleConvert {
+
+//! Implementations of Convert, which all give bit-identical results
+enum class Kernel {
+   Scalar,
+   SSE2,
+   NEON,
+};
+
+MATH_API bool IsAvailable(Kernel kernel);
+
+//! The fastest kernel that the processor supports
+MATH_API Kernel BestKernel();
+
+//! Uniform noise in [-0.5, 0.5) for rectangle and triangle dither
+/*!
+ Values come from Lanes independent xorshift generators in turn, so that
+ vector kernels can draw Lanes values at once, and still draw the same
+ values as the scalar kernel.
+ */
+struct MATH_API Noise
+{
+   static constexpr size_t Lanes = 8;
+
+   Noise();
+
+   //! Restart the sequence, and the filter of triangle dither
+   void Reset();
+
+   //! Draw the next value
+   float Next();
+
+   uint32_t state[Lanes];
+   //! Generator to draw from next
+   size_t lane;
+   //! The last value drawn for triangle dither, which subtracts it from
+   //! the next one
+   float previous;
+};
+
+//! Whether conversion from srcFormat to dstFormat loses precision, so that
+//! dither applies
+inline bool IsNarrowing(sampleFormat srcFormat, sampleFormat dstFormat)
+{
+   return (dstFormat == int16Sample && srcFormat != int16Sample) ||
+      (dstFormat == int24Sample && srcFormat == floatSample);
+}
+
+//! Convert len samples, reading every srcStride-th source sample and
+//! writing every dstStride-th destination sample
+/*!
+ Samples of the same format are copied unchanged.  Conversions to float,
+ and from int16 to int24, are exact.
+
+ Narrowing conversions limit float samples to [-1, 1], treating NaN as
+ zero, scale them, add noise for rectangle or triangle dither, round to
+ nearest even, and saturate, as Dither::Apply has always done.
+
+ Strided samples are gathered into, and scattered from, small contiguous
+ buffers, so any strides are served by the same vector kernels.
+
+ @pre `ditherType` is not shaped dither, which is inherently sequential
+ and stays with Dither
+ */
+MATH_API void Convert(
+   constSamplePtr src, sampleFormat srcFormat, size_t srcStride,
+   samplePtr dst, sampleFormat dstFormat, size_t dstStride,
+   size_t len, DitherType ditherType, Noise &noise,
+   Kernel kernel = BestKernel());
+
+}
+
+#endif
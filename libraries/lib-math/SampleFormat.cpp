@@ -46,7 +46,6 @@
 
 DitherType gLowQualityDither = DitherType::none;
 DitherType gHighQualityDither = DitherType::shaped;
-static Dither gDitherAlgorithm;
 
 void InitDitherers()
 {
@@ -112,7 +111,10 @@ void CopySamples(constSamplePtr src, sampleFormat srcFormat,
    unsigned int srcStride /* = 1 */,
    unsigned int dstStride /* = 1 */)
 {
-   gDitherAlgorithm.Apply(
+   // Dither keeps noise state between calls, and CopySamples is called from
+   // worker threads too, so each thread has its own
+   static thread_local Dither ditherAlgorithm;
+   ditherAlgorithm.Apply(
       ditherType,
       src, srcFormat, dst, dstFormat, len, srcStride, dstStride);
 }
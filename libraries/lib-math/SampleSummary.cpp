@@ -0,0 +1,324 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SampleSummary.cpp
+
+  Split from SqliteSampleBlock::CalcSummary
+
+**********************************************************************/
+#include "SampleSummary.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(CPU_FEATURES_X86)
+#   include <immintrin.h>
+#elif defined(CPU_FEATURES_ARM64)
+#   include <arm_neon.h>
+#endif
+
+namespace {
+using namespace SampleSummary;
+constexpr size_t fields = 3; /* min, max, sum of squares, later rms */
+
+//! Fill the triple for one frame of up to FrameSize samples
+//! @return the sum of the samples
+float SummarizeFrame(const float *samples, size_t count, float *summary)
+{
+   float min = samples[0];
+   float max = samples[0];
+   float sumsq = min * min;
+   float sum = min;
+
+   for (size_t j = 1; j < count; ++j)
+   {
+      float f1 = samples[j];
+      sumsq += f1 * f1;
+      sum += f1;
+
+      if (f1 < min)
+      {
+         min = f1;
+      }
+      else if (f1 > max)
+      {
+         max = f1;
+      }
+   }
+
+   summary[0] = min;
+   summary[1] = max;
+   summary[2] = sumsq;
+   return sum;
+}
+
+/*
+ The vector kernels transpose blocks of samples so that each lane follows
+ one frame, sample by sample.
+
+ min is only ever replaced by a smaller sample, and max by a larger, so
+ min <= max unless both are NaN; so the "else" above never matters, and
+ the updates are x < min ? x : min and x > max ? x : max, which leave the
+ old value for NaN samples or equal values such as -0 and +0, as the
+ x86 min and max instructions do when x is the first operand.
+ */
+
+#if defined(CPU_FEATURES_X86)
+CPU_FEATURES_TARGET("sse2")
+void SummarizeSSE2(const float *samples, size_t nFrames, float *summary,
+   double &total)
+{
+   constexpr size_t lanes = 4;
+   for (; nFrames >= lanes;
+        nFrames -= lanes, samples += lanes * FrameSize, summary += lanes * fields)
+   {
+      __m128 min, max, sumsq, sum;
+      for (size_t j = 0; j < FrameSize; j += lanes) {
+         __m128 r[lanes];
+         for (size_t ii = 0; ii < lanes; ++ii)
+            r[ii] = _mm_loadu_ps(samples + ii * FrameSize + j);
+         _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+
+         size_t ii = 0;
+         if (j == 0) {
+            min = max = sum = r[0];
+            sumsq = _mm_mul_ps(r[0], r[0]);
+            ++ii;
+         }
+         for (; ii < lanes; ++ii) {
+            min = _mm_min_ps(r[ii], min);
+            max = _mm_max_ps(r[ii], max);
+            sumsq = _mm_add_ps(sumsq, _mm_mul_ps(r[ii], r[ii]));
+            sum = _mm_add_ps(sum, r[ii]);
+         }
+      }
+
+      float mins[lanes], maxes[lanes], sums[lanes], frameSums[lanes];
+      _mm_storeu_ps(mins, min);
+      _mm_storeu_ps(maxes, max);
+      _mm_storeu_ps(sums, sumsq);
+      _mm_storeu_ps(frameSums, sum);
+      for (size_t ii = 0; ii < lanes; ++ii) {
+         summary[ii * fields] = mins[ii];
+         summary[ii * fields + 1] = maxes[ii];
+         summary[ii * fields + 2] = sums[ii];
+         total += frameSums[ii];
+      }
+   }
+
+   for (; nFrames > 0; --nFrames, samples += FrameSize, summary += fields)
+      total += SummarizeFrame(samples, FrameSize, summary);
+}
+
+CPU_FEATURES_TARGET("avx2")
+void SummarizeAVX2(const float *samples, size_t nFrames, float *summary,
+   double &total)
+{
+   constexpr size_t lanes = 8;
+   for (; nFrames >= lanes;
+        nFrames -= lanes, samples += lanes * FrameSize, summary += lanes * fields)
+   {
+      __m256 min, max, sumsq, sum;
+      for (size_t j = 0; j < FrameSize; j += lanes) {
+         __m256 r[lanes];
+         for (size_t ii = 0; ii < lanes; ++ii)
+            r[ii] = _mm256_loadu_ps(samples + ii * FrameSize + j);
+
+         // Transpose 8 x 8
+         const auto t0 = _mm256_unpacklo_ps(r[0], r[1]);
+         const auto t1 = _mm256_unpackhi_ps(r[0], r[1]);
+         const auto t2 = _mm256_unpacklo_ps(r[2], r[3]);
+         const auto t3 = _mm256_unpackhi_ps(r[2], r[3]);
+         const auto t4 = _mm256_unpacklo_ps(r[4], r[5]);
+         const auto t5 = _mm256_unpackhi_ps(r[4], r[5]);
+         const auto t6 = _mm256_unpacklo_ps(r[6], r[7]);
+         const auto t7 = _mm256_unpackhi_ps(r[6], r[7]);
+         const auto u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+         const auto u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+         const auto u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+         const auto u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+         const auto u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+         r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+         r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+         r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+         r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+         r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+         r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+         r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+         r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+
+         size_t ii = 0;
+         if (j == 0) {
+            min = max = sum = r[0];
+            sumsq = _mm256_mul_ps(r[0], r[0]);
+            ++ii;
+         }
+         for (; ii < lanes; ++ii) {
+            min = _mm256_min_ps(r[ii], min);
+            max = _mm256_max_ps(r[ii], max);
+            sumsq = _mm256_add_ps(sumsq, _mm256_mul_ps(r[ii], r[ii]));
+            sum = _mm256_add_ps(sum, r[ii]);
+         }
+      }
+
+      float mins[lanes], maxes[lanes], sums[lanes], frameSums[lanes];
+      _mm256_storeu_ps(mins, min);
+      _mm256_storeu_ps(maxes, max);
+      _mm256_storeu_ps(sums, sumsq);
+      _mm256_storeu_ps(frameSums, sum);
+      for (size_t ii = 0; ii < lanes; ++ii) {
+         summary[ii * fields] = mins[ii];
+         summary[ii * fields + 1] = maxes[ii];
+         summary[ii * fields + 2] = sums[ii];
+         total += frameSums[ii];
+      }
+   }
+
+   SummarizeSSE2(samples, nFrames, summary, total);
+}
+#endif
+
+#if defined(CPU_FEATURES_ARM64)
+void SummarizeNEON(const float *samples, size_t nFrames, float *summary,
+   double &total)
+{
+   constexpr size_t lanes = 4;
+   for (; nFrames >= lanes;
+        nFrames -= lanes, samples += lanes * FrameSize, summary += lanes * fields)
+   {
+      float32x4_t min, max, sumsq, sum;
+      for (size_t j = 0; j < FrameSize; j += lanes) {
+         const auto t01 = vtrnq_f32(vld1q_f32(samples + j),
+            vld1q_f32(samples + FrameSize + j));
+         const auto t23 = vtrnq_f32(vld1q_f32(samples + 2 * FrameSize + j),
+            vld1q_f32(samples + 3 * FrameSize + j));
+         const float32x4_t r[lanes] = {
+            vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])),
+            vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])),
+            vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])),
+            vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])),
+         };
+
+         size_t ii = 0;
+         if (j == 0) {
+            min = max = sum = r[0];
+            sumsq = vmulq_f32(r[0], r[0]);
+            ++ii;
+         }
+         for (; ii < lanes; ++ii) {
+            // vminq_f32 and vmaxq_f32 would propagate NaN, unlike the scalar
+            // comparisons, so select explicitly
+            min = vbslq_f32(vcltq_f32(r[ii], min), r[ii], min);
+            max = vbslq_f32(vcgtq_f32(r[ii], max), r[ii], max);
+            sumsq = vaddq_f32(sumsq, vmulq_f32(r[ii], r[ii]));
+            sum = vaddq_f32(sum, r[ii]);
+         }
+      }
+
+      float mins[lanes], maxes[lanes], sums[lanes], frameSums[lanes];
+      vst1q_f32(mins, min);
+      vst1q_f32(maxes, max);
+      vst1q_f32(sums, sumsq);
+      vst1q_f32(frameSums, sum);
+      for (size_t ii = 0; ii < lanes; ++ii) {
+         summary[ii * fields] = mins[ii];
+         summary[ii * fields + 1] = maxes[ii];
+         summary[ii * fields + 2] = sums[ii];
+         total += frameSums[ii];
+      }
+   }
+
+   for (; nFrames > 0; --nFrames, samples += FrameSize, summary += fields)
+      total += SummarizeFrame(samples, FrameSize, summary);
+}
+#endif
+
+void SummarizeScalar(const float *samples, size_t nFrames, float *summary,
+   double &total)
+{
+   for (; nFrames > 0; --nFrames, samples += FrameSize, summary += fields)
+      total += SummarizeFrame(samples, FrameSize, summary);
+}
+}
+
+bool SampleSummary::IsAvailable(Kernel kernel)
+{
+   switch (kernel) {
+   case Kernel::Scalar:
+      return true;
+#if defined(CPU_FEATURES_X86)
+   case Kernel::SSE2:
+      return CpuFeatures::HasSSE2();
+   case Kernel::AVX2:
+      return CpuFeatures::HasAVX2();
+#endif
+#if defined(CPU_FEATURES_ARM64)
+   case Kernel::NEON:
+      return CpuFeatures::HasNEON();
+#endif
+   default:
+      return false;
+   }
+}
+
+auto SampleSummary::BestKernel() -> Kernel
+{
+   static const auto result = []{
+      for (auto kernel : { Kernel::AVX2, Kernel::NEON, Kernel::SSE2 })
+         if (IsAvailable(kernel))
+            return kernel;
+      return Kernel::Scalar;
+   }();
+   return result;
+}
+
+auto SampleSummary::Summarize256(const float *samples, size_t count,
+   float *summary, Kernel kernel) -> Totals
+{
+   Totals totals{ 0.0, 0.0 };
+   if (count == 0)
+      return totals;
+
+   // Full frames
+   const auto nFrames = count / FrameSize;
+   switch (IsAvailable(kernel) ? kernel : Kernel::Scalar) {
+#if defined(CPU_FEATURES_X86)
+   case Kernel::SSE2:
+      SummarizeSSE2(samples, nFrames, summary, totals.sum);
+      break;
+   case Kernel::AVX2:
+      SummarizeAVX2(samples, nFrames, summary, totals.sum);
+      break;
+#endif
+#if defined(CPU_FEATURES_ARM64)
+   case Kernel::NEON:
+      SummarizeNEON(samples, nFrames, summary, totals.sum);
+      break;
+#endif
+   default:
+      SummarizeScalar(samples, nFrames, summary, totals.sum);
+      break;
+   }
+
+   // Partial frame
+   const auto sumLen = (count + FrameSize - 1) / FrameSize;
+   if (sumLen > nFrames)
+      totals.sum += SummarizeFrame(samples + nFrames * FrameSize,
+         count - nFrames * FrameSize, summary + nFrames * fields);
+
+   // Replace sums of squares with rms, in order, as the scalar code did
+   for (size_t i = 0; i < sumLen; ++i) {
+      const auto sumsq = summary[i * fields + 2];
+      totals.squares += sumsq;
+      const int jcount = std::min(FrameSize, count - i * FrameSize);
+      // The rms is correct, but this may be for less than 256 samples in
+      // last loop.
+      summary[i * fields + 2] = (float) std::sqrt(sumsq / jcount);
+   }
+   return totals;
+}
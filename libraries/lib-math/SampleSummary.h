@@ -0,0 +1,55 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SampleSummary.h
+  @brief Vectorized computation of the 256-sample summaries stored with
+  each sample block
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_SUMMARY__
+#define __AUDACITY_SAMPLE_SUMMARY__
+
+#include <cstddef>
+
+namespace SampleSummary {
+
+//! Implementations of Summarize256, which all give bit-identical results
+enum class Kernel {
+   Scalar,
+   SSE2,
+   AVX2,
+   NEON,
+};
+
+MATH_API bool IsAvailable(Kernel kernel);
+
+//! The fastest kernel that the processor supports
+MATH_API Kernel BestKernel();
+
+//! Number of samples in each frame of the summary
+constexpr size_t FrameSize = 256;
+
+//! Totals over all samples, each accumulated in float within each frame and
+//! in double across frames
+struct Totals {
+   double squares;
+   double sum;
+};
+
+//! Compute min, max, and rms of each frame of samples, the last of which may
+//! be partial
+/*!
+ Each kernel performs exactly the same floating point operations for each
+ frame as the scalar one, in the same order, only for several frames at
+ once, so that stored summaries never depend on the machine.
+
+ @param summary receives (count + 255) / 256 triples
+ */
+MATH_API Totals Summarize256(const float *samples, size_t count,
+   float *summary, Kernel kernel = BestKernel());
+
+}
+
+#endif
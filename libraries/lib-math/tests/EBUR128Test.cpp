@@ -0,0 +1,93 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  EBUR128Test.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "EBUR128.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr double rate = 48000.0;
+
+std::vector<std::vector<float>> MakeNoise(size_t nChannels, size_t count)
+{
+   std::mt19937 engine{ static_cast<unsigned>(nChannels * count) };
+   std::uniform_real_distribution<float> distribution{ -1.0f, 1.0f };
+   std::vector<std::vector<float>> channels(nChannels);
+   for (auto &channel : channels) {
+      channel.resize(count);
+      // Vary the level so that the gating histogram has several bins
+      for (size_t ii = 0; ii < count; ++ii)
+         channel[ii] = distribution(engine) * (1 + (ii / 30000) % 5) / 5;
+   }
+   return channels;
+}
+
+//! The loudness computed one sample at a time
+double PerSample(const std::vector<std::vector<float>> &channels)
+{
+   EBUR128 processor{ rate, channels.size() };
+   processor.Initialize();
+   for (size_t ii = 0, count = channels[0].size(); ii < count; ++ii) {
+      for (size_t channel = 0; channel < channels.size(); ++channel)
+         processor.ProcessSampleFromChannel(channels[channel][ii], channel);
+      processor.NextSample();
+   }
+   return processor.IntegrativeLoudness();
+}
+
+//! The loudness computed in buffers of the given length
+double Buffered(
+   const std::vector<std::vector<float>> &channels, size_t bufferLen)
+{
+   EBUR128 processor{ rate, channels.size() };
+   processor.Initialize();
+   std::vector<const float*> pointers(channels.size());
+   for (size_t ii = 0, count = channels[0].size(); ii < count;
+      ii += bufferLen
+   ) {
+      for (size_t channel = 0; channel < channels.size(); ++channel)
+         pointers[channel] = channels[channel].data() + ii;
+      processor.ProcessBuffers(
+         pointers.data(), std::min(bufferLen, count - ii));
+   }
+   return processor.IntegrativeLoudness();
+}
+}
+
+TEST_CASE("EBUR128 block processing agrees exactly with per-sample processing")
+{
+   // Five channels go through the worker pool
+   for (size_t nChannels : { 1, 2, 3, 5 }) {
+      // Not a whole number of 100 ms steps
+      const auto channels = MakeNoise(nChannels, 5 * 48000 + 1234);
+      const auto expected = PerSample(channels);
+      for (size_t bufferLen : { 1, 100, 4800, 65536, 1 << 20 })
+         REQUIRE(Buffered(channels, bufferLen) == expected);
+   }
+}
+
+TEST_CASE("EBUR128 measures a reference sine")
+{
+   // EBU Tech 3341, case 1: a stereo 1 kHz sine at -23 dBFS reads -23 LUFS
+   const auto amplitude = std::pow(10.0, -23.0 / 20.0);
+   std::vector<std::vector<float>> channels(2);
+   for (auto &channel : channels) {
+      channel.resize(20 * 48000);
+      for (size_t ii = 0; ii < channel.size(); ++ii)
+         channel[ii] = amplitude * std::sin(2 * M_PI * 1000 * ii / rate);
+   }
+   EBUR128 processor{ rate, 2 };
+   const auto loudness = PerSample(channels);
+   REQUIRE(std::abs(processor.IntegrativeLoudnessToLUFS(loudness) + 23.0)
+      <= 0.1);
+   REQUIRE(Buffered(channels, 4096) == loudness);
+}
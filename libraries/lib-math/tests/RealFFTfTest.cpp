@@ -0,0 +1,155 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  RealFFTfTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "RealFFTf.h"
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr double pi = 3.14159265358979323846;
+
+std::vector<fft_type> MakeSignal(size_t size)
+{
+   std::mt19937 engine{ static_cast<unsigned>(size) };
+   std::uniform_real_distribution<fft_type> distribution{ -1.0f, 1.0f };
+   std::vector<fft_type> signal(size);
+   for (auto &sample : signal)
+      sample = distribution(engine);
+   return signal;
+}
+
+//! Straightforward discrete Fourier transform, in double precision
+std::vector<std::complex<double>> ReferenceDFT(
+   const std::vector<fft_type> &signal)
+{
+   const auto size = signal.size();
+   std::vector<std::complex<double>> result(size / 2 + 1);
+   for (size_t k = 0; k < result.size(); ++k)
+      for (size_t n = 0; n < size; ++n)
+         result[k] += double(signal[n]) *
+            std::polar(1.0, -2 * pi * double((k * n) % size) / size);
+   return result;
+}
+
+//! The same tests at sizes for each of the engines
+const size_t sizes[] { 8, 16, 32, 64, 256, 1024, 4096 };
+}
+
+TEST_CASE("RealFFTf agrees with the definition of the DFT")
+{
+   for (auto size : sizes) {
+      const auto signal = MakeSignal(size);
+      const auto expected = ReferenceDFT(signal);
+      const auto tolerance = 1e-5 * size;
+
+      // Check buffers at offsets that are not vector aligned too
+      for (size_t offset : { 0, 1 }) {
+         std::vector<fft_type> storage(size + offset);
+         const auto buffer = storage.data() + offset;
+         std::copy(signal.begin(), signal.end(), buffer);
+
+         auto hFFT = GetFFT(size);
+         RealFFTf(buffer, hFFT.get());
+
+         // DC and Nyquist frequency share the first pair
+         REQUIRE(buffer[0] == Approx(expected[0].real()).margin(tolerance));
+         REQUIRE(buffer[1] ==
+            Approx(expected[size / 2].real()).margin(tolerance));
+         for (size_t k = 1; k < size / 2; ++k) {
+            const auto index = hFFT->BitReversed[k];
+            REQUIRE(buffer[index] ==
+               Approx(expected[k].real()).margin(tolerance));
+            REQUIRE(buffer[index + 1] ==
+               Approx(expected[k].imag()).margin(tolerance));
+         }
+      }
+   }
+}
+
+TEST_CASE("InverseRealFFTf undoes RealFFTf")
+{
+   for (auto size : sizes) {
+      const auto signal = MakeSignal(size);
+      for (size_t offset : { 0, 1 }) {
+         std::vector<fft_type> storage(size + offset);
+         const auto buffer = storage.data() + offset;
+         std::copy(signal.begin(), signal.end(), buffer);
+
+         auto hFFT = GetFFT(size);
+         RealFFTf(buffer, hFFT.get());
+
+         // The inverse wants its input in natural order
+         std::vector<fft_type> spectrum(size);
+         spectrum[0] = buffer[0];
+         spectrum[1] = buffer[1];
+         for (size_t k = 1; k < size / 2; ++k) {
+            spectrum[2 * k] = buffer[hFFT->BitReversed[k]];
+            spectrum[2 * k + 1] = buffer[hFFT->BitReversed[k] + 1];
+         }
+         std::copy(spectrum.begin(), spectrum.end(), buffer);
+         InverseRealFFTf(buffer, hFFT.get());
+
+         std::vector<fft_type> result(size);
+         ReorderToTime(hFFT.get(), buffer, result.data());
+         for (size_t n = 0; n < size; ++n)
+            REQUIRE(result[n] == Approx(signal[n]).margin(1e-5));
+      }
+   }
+}
+
+TEST_CASE("GetFFT makes tables once for each length")
+{
+   // A length that no other test uses
+   constexpr size_t size = 8192;
+   constexpr size_t nThreads = 8, nRequests = 100;
+   const auto before = GetFFTStatistics();
+
+   std::vector<const FFTParam*> params(nThreads * nRequests);
+   std::vector<std::thread> threads;
+   for (size_t ii = 0; ii < nThreads; ++ii)
+      threads.emplace_back([&params, ii]{
+         for (size_t jj = 0; jj < nRequests; ++jj)
+            params[ii * nRequests + jj] = GetFFT(size).get();
+      });
+   for (auto &thread : threads)
+      thread.join();
+
+   const auto after = GetFFTStatistics();
+   REQUIRE(after.created == before.created + 1);
+   REQUIRE(after.reused == before.reused + params.size() - 1);
+   for (auto pParam : params)
+      REQUIRE(pParam == params[0]);
+   REQUIRE(params[0]->Points == size / 2);
+}
+
+TEST_CASE("RealFFTf throughput", "[.][benchmark]")
+{
+   for (size_t size : { 256, 2048, 16384 }) {
+      const auto signal = MakeSignal(size);
+      std::vector<fft_type> buffer(size);
+      auto hFFT = GetFFT(size);
+      const size_t repetitions = (1 << 24) / size;
+
+      const auto start = std::chrono::steady_clock::now();
+      for (size_t ii = 0; ii < repetitions; ++ii) {
+         std::copy(signal.begin(), signal.end(), buffer.begin());
+         RealFFTf(buffer.data(), hFFT.get());
+      }
+      const std::chrono::duration<double> elapsed =
+         std::chrono::steady_clock::now() - start;
+      WARN("size " << size << ": "
+         << elapsed.count() * 1e6 / repetitions << " us per transform");
+   }
+}
@@ -0,0 +1,223 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleConvertTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "SampleConvert.h"
+#include "Dither.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace SampleConvert;
+
+namespace {
+constexpr Kernel kernels[] { Kernel::Scalar, Kernel::SSE2, Kernel::NEON };
+constexpr sampleFormat formats[] { int16Sample, int24Sample, floatSample };
+constexpr DitherType ditherTypes[] {
+   DitherType::none, DitherType::rectangle, DitherType::triangle
+};
+
+//! Bytes of count samples of the given format, with some out of range
+//! values, and NaN and infinities among floats
+std::vector<char> MakeSamples(sampleFormat format, size_t count)
+{
+   std::mt19937 engine{ static_cast<unsigned>(count) };
+   std::uniform_real_distribution<float> distribution{ -1.2f, 1.2f };
+   std::vector<char> bytes(count * SAMPLE_SIZE(format));
+   for (size_t ii = 0; ii < count; ++ii) {
+      const auto value = distribution(engine);
+      if (format == int16Sample)
+         reinterpret_cast<int16_t*>(bytes.data())[ii] =
+            static_cast<int16_t>(std::clamp(value, -1.0f, 1.0f) * 32767);
+      else if (format == int24Sample)
+         reinterpret_cast<int32_t*>(bytes.data())[ii] =
+            static_cast<int32_t>(std::clamp(value, -1.0f, 1.0f) * 8388607);
+      else
+         reinterpret_cast<float*>(bytes.data())[ii] = value;
+   }
+   if (format == floatSample && count > 100) {
+      const auto floats = reinterpret_cast<float*>(bytes.data());
+      floats[7] = std::numeric_limits<float>::quiet_NaN();
+      floats[20] = std::numeric_limits<float>::infinity();
+      floats[21] = -std::numeric_limits<float>::infinity();
+      floats[30] = -0.0f;
+      // Halfway between two int16 values
+      floats[40] = 100.5f / 32768;
+   }
+   return bytes;
+}
+}
+
+TEST_CASE("SampleConvert kernels agree bit for bit with the scalar kernel")
+{
+   for (auto srcFormat : formats)
+   for (auto dstFormat : formats)
+   for (auto ditherType : ditherTypes)
+   for (size_t srcStride : { 1, 2, 3 })
+   for (size_t dstStride : { 1, 2, 5 })
+   for (size_t count : { 1, 7, 8, 9, 300, 1001 }) {
+      const auto src = MakeSamples(srcFormat, count * srcStride);
+      const auto dstBytes = count * dstStride * SAMPLE_SIZE(dstFormat);
+
+      // Convert twice with the same noise, the second time starting at
+      // another of its generators
+      std::vector<char> expected(2 * dstBytes);
+      Noise expectedNoise;
+      for (size_t pass = 0; pass < 2; ++pass)
+         Convert(src.data(), srcFormat, srcStride,
+            expected.data() + pass * dstBytes, dstFormat, dstStride,
+            count, ditherType, expectedNoise, Kernel::Scalar);
+
+      for (auto kernel : kernels) {
+         if (!IsAvailable(kernel))
+            continue;
+         std::vector<char> actual(2 * dstBytes);
+         Noise noise;
+         for (size_t pass = 0; pass < 2; ++pass)
+            Convert(src.data(), srcFormat, srcStride,
+               actual.data() + pass * dstBytes, dstFormat, dstStride,
+               count, ditherType, noise, kernel);
+         REQUIRE(std::memcmp(
+            actual.data(), expected.data(), actual.size()) == 0);
+         REQUIRE(noise.lane == expectedNoise.lane);
+         REQUIRE(noise.previous == expectedNoise.previous);
+      }
+   }
+}
+
+TEST_CASE("SampleConvert converts exactly without dither")
+{
+   const int16_t shorts[] { -32768, -1, 0, 1, 32767 };
+   float floats[5];
+   int32_t ints[5];
+   int16_t roundTrip[5];
+   Noise noise;
+
+   Convert(reinterpret_cast<constSamplePtr>(shorts), int16Sample, 1,
+      reinterpret_cast<samplePtr>(floats), floatSample, 1,
+      5, DitherType::none, noise);
+   REQUIRE(floats[0] == -1.0f);
+   REQUIRE(floats[2] == 0.0f);
+   REQUIRE(floats[4] == 32767.0f / 32768);
+
+   Convert(reinterpret_cast<constSamplePtr>(floats), floatSample, 1,
+      reinterpret_cast<samplePtr>(roundTrip), int16Sample, 1,
+      5, DitherType::none, noise);
+   REQUIRE(std::memcmp(roundTrip, shorts, sizeof shorts) == 0);
+
+   Convert(reinterpret_cast<constSamplePtr>(shorts), int16Sample, 1,
+      reinterpret_cast<samplePtr>(ints), int24Sample, 1,
+      5, DitherType::none, noise);
+   REQUIRE(ints[0] == -32768 * 256);
+   REQUIRE(ints[4] == 32767 * 256);
+
+   const float extremes[] {
+      1.5f, -1.5f, std::numeric_limits<float>::quiet_NaN(), 1.0f, -1.0f
+   };
+   Convert(reinterpret_cast<constSamplePtr>(extremes), floatSample, 1,
+      reinterpret_cast<samplePtr>(roundTrip), int16Sample, 1,
+      5, DitherType::none, noise);
+   REQUIRE(roundTrip[0] == 32767);
+   REQUIRE(roundTrip[1] == -32768);
+   REQUIRE(roundTrip[2] == 0);
+   REQUIRE(roundTrip[3] == 32767);
+   REQUIRE(roundTrip[4] == -32768);
+}
+
+TEST_CASE("SampleConvert interleaves and deinterleaves")
+{
+   const float interleaved[] { 0.5f, -0.5f, 0.25f, -0.25f };
+   int16_t left[2], right[2];
+   Noise noise;
+   Convert(reinterpret_cast<constSamplePtr>(interleaved), floatSample, 2,
+      reinterpret_cast<samplePtr>(left), int16Sample, 1,
+      2, DitherType::none, noise);
+   Convert(reinterpret_cast<constSamplePtr>(interleaved + 1), floatSample, 2,
+      reinterpret_cast<samplePtr>(right), int16Sample, 1,
+      2, DitherType::none, noise);
+   REQUIRE(left[0] == 16384);
+   REQUIRE(left[1] == 8192);
+   REQUIRE(right[0] == -16384);
+   REQUIRE(right[1] == -8192);
+
+   float result[4];
+   Convert(reinterpret_cast<constSamplePtr>(left), int16Sample, 1,
+      reinterpret_cast<samplePtr>(result), floatSample, 2,
+      2, DitherType::none, noise);
+   Convert(reinterpret_cast<constSamplePtr>(right), int16Sample, 1,
+      reinterpret_cast<samplePtr>(result + 1), floatSample, 2,
+      2, DitherType::none, noise);
+   REQUIRE(std::memcmp(result, interleaved, sizeof result) == 0);
+}
+
+TEST_CASE("SampleConvert noise is uniform in [-0.5, 0.5)")
+{
+   Noise noise;
+   double sum = 0;
+   constexpr size_t count = 100000;
+   for (size_t ii = 0; ii < count; ++ii) {
+      const auto value = noise.Next();
+      REQUIRE(value >= -0.5f);
+      REQUIRE(value < 0.5f);
+      sum += value;
+   }
+   REQUIRE(std::abs(sum / count) < 0.01);
+}
+
+TEST_CASE("SampleConvert throughput", "[.][benchmark]")
+{
+   // Conversions of one second of 44.1 kHz stereo audio, many times
+   constexpr size_t count = 2 * 44100, repetitions = 1000;
+   const auto floats = MakeSamples(floatSample, count);
+   const auto shorts = MakeSamples(int16Sample, count);
+   std::vector<char> dst(count * sizeof(float));
+
+   struct Case {
+      const char *name;
+      const std::vector<char> &src;
+      sampleFormat srcFormat, dstFormat;
+      size_t stride;
+      DitherType ditherType;
+   } cases[] {
+      { "int16 to float", shorts, int16Sample, floatSample, 1,
+         DitherType::none },
+      { "float to int16", floats, floatSample, int16Sample, 1,
+         DitherType::none },
+      { "float to int16, triangle dither", floats, floatSample, int16Sample,
+         1, DitherType::triangle },
+      { "float to int24, rectangle dither", floats, floatSample, int24Sample,
+         1, DitherType::rectangle },
+      { "deinterleave int16 to float", shorts, int16Sample, floatSample, 2,
+         DitherType::none },
+   };
+
+   for (auto &oneCase : cases) {
+      for (auto kernel : kernels) {
+         if (!IsAvailable(kernel))
+            continue;
+         Noise noise;
+         const auto len = count / oneCase.stride;
+         const auto start = std::chrono::steady_clock::now();
+         for (size_t ii = 0; ii < repetitions; ++ii)
+            Convert(oneCase.src.data(), oneCase.srcFormat, oneCase.stride,
+               dst.data(), oneCase.dstFormat, 1,
+               len, oneCase.ditherType, noise, kernel);
+         const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+         WARN(oneCase.name << ", kernel " << static_cast<int>(kernel) << ": "
+            << len * repetitions / elapsed.count() / 1e6
+            << " million samples per second");
+      }
+   }
+}
@@ -0,0 +1,123 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleSummaryTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "SampleSummary.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace SampleSummary;
+
+namespace {
+constexpr Kernel kernels[] {
+   Kernel::Scalar, Kernel::SSE2, Kernel::AVX2, Kernel::NEON
+};
+
+std::vector<float> MakeSamples(size_t count)
+{
+   std::mt19937 engine{ static_cast<unsigned>(count) };
+   std::uniform_real_distribution<float> distribution{ -1.0f, 1.0f };
+   std::vector<float> samples(count);
+   for (auto &sample : samples)
+      sample = distribution(engine);
+   return samples;
+}
+}
+
+TEST_CASE("SampleSummary kernels agree bit for bit with the scalar kernel")
+{
+   for (size_t count : { 1, 255, 256, 257, 1000, 2048, 3000, 65536, 262144 })
+   {
+      auto samples = MakeSamples(count);
+      if (count > 1000) {
+         // Values that distinguish the choices of min and max instructions
+         samples[3] = std::numeric_limits<float>::quiet_NaN();
+         samples[600] = -0.0f;
+         samples[601] = 0.0f;
+         samples[count / 2] = std::numeric_limits<float>::infinity();
+         samples[count - 1] = std::numeric_limits<float>::quiet_NaN();
+      }
+
+      const auto nFrames = (count + FrameSize - 1) / FrameSize;
+      std::vector<float> expected(3 * nFrames);
+      const auto expectedTotal =
+         Summarize256(samples.data(), count, expected.data(), Kernel::Scalar);
+
+      for (auto kernel : kernels) {
+         if (!IsAvailable(kernel))
+            continue;
+         std::vector<float> actual(3 * nFrames);
+         const auto total =
+            Summarize256(samples.data(), count, actual.data(), kernel);
+         REQUIRE(std::memcmp(&total.squares, &expectedTotal.squares,
+            sizeof(double)) == 0);
+         REQUIRE(std::memcmp(&total.sum, &expectedTotal.sum,
+            sizeof(double)) == 0);
+         REQUIRE(std::memcmp(actual.data(), expected.data(),
+            actual.size() * sizeof(float)) == 0);
+      }
+   }
+}
+
+TEST_CASE("SampleSummary computes min, max, rms, and sum")
+{
+   const float samples[] { 0.5f, -1.0f, 0.25f, 1.0f };
+   float summary[3];
+   const auto total = Summarize256(samples, 4, summary);
+   REQUIRE(summary[0] == -1.0f);
+   REQUIRE(summary[1] == 1.0f);
+   REQUIRE(summary[2] == Approx(std::sqrt(2.3125 / 4)));
+   REQUIRE(total.squares == Approx(2.3125));
+   REQUIRE(total.sum == Approx(0.75));
+}
+
+TEST_CASE("SampleSummary sums samples across frames")
+{
+   // Small integers, which float adds exactly
+   std::vector<float> samples(1000);
+   for (size_t ii = 0; ii < samples.size(); ++ii)
+      samples[ii] = float(int(ii % 7) - 3);
+   const auto expected = std::accumulate(samples.begin(), samples.end(), 0.0);
+   std::vector<float> summary(3 * 4);
+   for (auto kernel : kernels) {
+      if (!IsAvailable(kernel))
+         continue;
+      REQUIRE(Summarize256(samples.data(), samples.size(), summary.data(),
+         kernel).sum == expected);
+   }
+}
+
+TEST_CASE("SampleSummary throughput", "[.][benchmark]")
+{
+   // Summaries of one second of 44.1 kHz audio, many times
+   constexpr size_t count = 44100, repetitions = 2000;
+   const auto samples = MakeSamples(count);
+   std::vector<float> summary(3 * ((count + FrameSize - 1) / FrameSize));
+
+   for (auto kernel : kernels) {
+      if (!IsAvailable(kernel))
+         continue;
+      const auto start = std::chrono::steady_clock::now();
+      double total = 0;
+      for (size_t ii = 0; ii < repetitions; ++ii)
+         total +=
+            Summarize256(samples.data(), count, summary.data(), kernel).squares;
+      const std::chrono::duration<double> elapsed =
+         std::chrono::steady_clock::now() - start;
+      WARN("kernel " << static_cast<int>(kernel) << ": "
+         << count * repetitions / elapsed.count() / 1e6
+         << " million samples per second (" << total << ")");
+   }
+}
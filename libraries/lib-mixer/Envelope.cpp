@@ -934,128 +934,197 @@ double Envelope::GetInterpolationStartValueAtPoint( int iPoint ) const
       return log10(v);
 }
 
-void Envelope::GetValues( double *buffer, int bufferLen,
+bool Envelope::GetValues( double *buffer, int bufferLen,
                           double t0, double tstep ) const
 {
    // Convert t0 from absolute to clip-relative time
    t0 -= mOffset;
-   GetValuesRelative( buffer, bufferLen, t0, tstep);
+   return GetValuesRelative( buffer, bufferLen, t0, tstep);
 }
 
-void Envelope::GetValuesRelative
+bool Envelope::GetValuesRelative
    (double *buffer, int bufferLen, double t0, double tstep, bool leftLimit)
    const
 {
    // JC: If bufferLen ==0 we have probably just allocated a zero sized buffer.
    // wxASSERT( bufferLen > 0 );
 
-   const auto epsilon = tstep / 2;
-   int len = mEnv.size();
-
-   double t = t0;
-   double increment = 0;
-   if ( len > 1 && t <= mEnv[0].GetT() && mEnv[0].GetT() == mEnv[1].GetT() )
-      increment = leftLimit ? -epsilon : epsilon;
-
-   double tprev, vprev, tnext = 0, vnext, vstep = 0;
-
-   for (int b = 0; b < bufferLen; b++) {
-
-      // Get easiest cases out the way first...
-      // IF empty envelope THEN default value
-      if (len <= 0) {
-         buffer[b] = mDefaultValue;
-         t += tstep;
-         continue;
-      }
+   SegmentCursor cursor{ *this, t0, tstep, leftLimit };
+   bool constant = true;
+   for (size_t b = 0, len = std::max(0, bufferLen); b < len;) {
+      const auto segment = cursor.Next(len - b);
+      segment.Fill(buffer + b);
+      constant = constant && segment.IsConstant() && buffer[b] == buffer[0];
+      b += segment.len;
+   }
+   return constant;
+}
 
-      auto tplus = t + increment;
+Envelope::SegmentCursor Envelope::Segments(double t0, double tstep) const
+{
+   return { *this, t0 - mOffset, tstep, false };
+}
 
-      // IF before envelope THEN first value
-      if ( leftLimit ? tplus <= mEnv[0].GetT() : tplus < mEnv[0].GetT() ) {
-         buffer[b] = mEnv[0].GetVal();
-         t += tstep;
-         continue;
-      }
-      // IF after envelope THEN last value
-      if ( leftLimit
-            ? tplus > mEnv[len - 1].GetT() : tplus >= mEnv[len - 1].GetT() ) {
-         buffer[b] = mEnv[len - 1].GetVal();
-         t += tstep;
-         continue;
+void Envelope::Segment::Fill(double *buffer) const
+{
+   size_t ii = 0;
+   if (IsConstant())
+      std::fill(buffer, buffer + len, value);
+   else if (!exponential) {
+      // Multiply exact indices, rather than accumulate roundoff, in four
+      // independent lanes that the compiler may put in one vector
+      double index[4] { 0, 1, 2, 3 };
+      for (; ii + 4 <= len; ii += 4)
+         for (size_t lane = 0; lane < 4; ++lane) {
+            buffer[ii + lane] = value + index[lane] * step;
+            index[lane] += 4;
+         }
+      for (; ii < len; ++ii)
+         buffer[ii] = value + ii * step;
+   }
+   else {
+      double power = value;
+      for (; ii < std::min<size_t>(len, 4); ++ii) {
+         buffer[ii] = power;
+         power *= step;
       }
+      // Then four independent lanes of products
+      const auto step4 = step * step * step * step;
+      for (; ii < len; ++ii)
+         buffer[ii] = buffer[ii - 4] * step4;
+   }
+}
 
-      // be careful to get the correct limit even in case epsilon == 0
-      if ( b == 0 ||
-           ( leftLimit ? tplus > tnext : tplus >= tnext ) ) {
-
-         // We're beyond our tnext, so find the next one.
-         // Don't just increment lo or hi because we might
-         // be zoomed far out and that could be a large number of
-         // points to move over.  That's why we binary search.
-
-         int lo,hi;
-         if ( leftLimit )
-            BinarySearchForTime_LeftLimit( lo, hi, tplus );
-         else
-            BinarySearchForTime( lo, hi, tplus );
-
-         // mEnv[0] is before tplus because of eliminations above, therefore lo >= 0
-         // mEnv[len - 1] is after tplus, therefore hi <= len - 1
-         wxASSERT( lo >= 0 && hi <= len - 1 );
-
-         tprev = mEnv[lo].GetT();
-         tnext = mEnv[hi].GetT();
-
-         if ( hi + 1 < len && tnext == mEnv[ hi + 1 ].GetT() )
-            // There is a discontinuity after this point-to-point interval.
-            // Usually will stop evaluating in this interval when time is slightly
-            // before tNext, then use the right limit.
-            // This is the right intent
-            // in case small roundoff errors cause a sample time to be a little
-            // before the envelope point time.
-            // Less commonly we want a left limit, so we continue evaluating in
-            // this interval until shortly after the discontinuity.
-            increment = leftLimit ? -epsilon : epsilon;
-         else
-            increment = 0;
-
-         vprev = GetInterpolationStartValueAtPoint( lo );
-         vnext = GetInterpolationStartValueAtPoint( hi );
+Envelope::SegmentCursor::SegmentCursor(
+   const Envelope &envelope, double t0, double tstep, bool leftLimit)
+   : mEnvelope{ envelope }
+   , mT0{ t0 }
+   , mTStep{ tstep }
+   , mEpsilon{ tstep / 2 }
+   , mLeftLimit{ leftLimit }
+{
+   const auto &env = envelope.mEnv;
+   if ( env.size() > 1 && t0 <= env[0].GetT() &&
+        env[0].GetT() == env[1].GetT() )
+      mIncrement = leftLimit ? -mEpsilon : mEpsilon;
+}
 
-         // Interpolate, either linear or log depending on mDB.
-         double dt = (tnext - tprev);
-         double to = t - tprev;
-         double v;
-         if (dt > 0.0)
-         {
-            v = (vprev * (dt - to) + vnext * to) / dt;
-            vstep = (vnext - vprev) * tstep / dt;
-         }
-         else
-         {
-            v = vnext;
-            vstep = 0.0;
-         }
+size_t Envelope::SegmentCursor::CountBefore(
+   size_t maxLen, double bound, bool inclusive) const
+{
+   if (!(mTStep > 0))
+      // All times are equal, or (not expected) decreasing
+      return mTStep == 0 ? maxLen : std::min<size_t>(maxLen, 1);
+   const auto before = [&](size_t count) {
+      // Whether the count-th time from mIndex is before the bound
+      const auto t = Time(mIndex + count) + mIncrement;
+      return inclusive ? t <= bound : t < bound;
+   };
+   // Estimate by division, then correct the estimate for roundoff
+   const auto estimate = ceil( (bound - mIncrement - Time(mIndex)) / mTStep );
+   size_t count = !(estimate >= 1) ? 1
+      : estimate >= maxLen ? maxLen
+      : static_cast<size_t>(estimate);
+   while (count < maxLen && before(count))
+      ++count;
+   while (count > 1 && !before(count - 1))
+      --count;
+   return count;
+}
 
-         // An adjustment if logarithmic scale.
-         if( mDB )
-         {
-            v = pow(10.0, v);
-            vstep = pow( 10.0, vstep );
-         }
+Envelope::Segment Envelope::SegmentCursor::Next(size_t maxLen)
+{
+   const auto &env = mEnvelope.mEnv;
+   const int len = env.size();
+   const auto constant = [&](size_t count, double value) {
+      mIndex += count;
+      return Segment{ count, value, 0.0, false };
+   };
 
-         buffer[b] = v;
-      } else {
-         if (mDB){
-            buffer[b] = buffer[b - 1] * vstep;
-         }else{
-            buffer[b] = buffer[b - 1] + vstep;
-         }
-      }
+   // Get easiest cases out the way first...
+   // IF empty envelope THEN default value
+   if (maxLen == 0 || len <= 0)
+      return constant(maxLen, mEnvelope.mDefaultValue);
+
+   const auto t = Time(mIndex);
+   const auto tplus = t + mIncrement;
+
+   // IF before envelope THEN first value
+   const auto tfirst = env[0].GetT();
+   if ( mLeftLimit ? tplus <= tfirst : tplus < tfirst )
+      return constant(
+         CountBefore(maxLen, tfirst, mLeftLimit), env[0].GetVal());
+
+   // IF after envelope THEN last value, for the rest of the times
+   const auto tlast = env[len - 1].GetT();
+   if ( mLeftLimit ? tplus > tlast : tplus >= tlast )
+      return constant(
+         mTStep < 0 ? std::min<size_t>(maxLen, 1) : maxLen,
+         env[len - 1].GetVal());
+
+   // Find the interval of the time.  The envelope's search guesses first
+   // at the interval of its previous search, so a cursor that moves forward
+   // finds it quickly.
+   int lo, hi;
+   if ( mLeftLimit )
+      mEnvelope.BinarySearchForTime_LeftLimit( lo, hi, tplus );
+   else
+      mEnvelope.BinarySearchForTime( lo, hi, tplus );
+
+   // mEnv[0] is before tplus because of eliminations above, therefore lo >= 0
+   // mEnv[len - 1] is after tplus, therefore hi <= len - 1
+   wxASSERT( lo >= 0 && hi <= len - 1 );
+
+   const auto tprev = env[lo].GetT();
+   const auto tnext = env[hi].GetT();
+
+   if ( hi + 1 < len && tnext == env[ hi + 1 ].GetT() )
+      // There is a discontinuity after this point-to-point interval.
+      // Usually will stop evaluating in this interval when time is slightly
+      // before tNext, then use the right limit.
+      // This is the right intent
+      // in case small roundoff errors cause a sample time to be a little
+      // before the envelope point time.
+      // Less commonly we want a left limit, so we continue evaluating in
+      // this interval until shortly after the discontinuity.
+      mIncrement = mLeftLimit ? -mEpsilon : mEpsilon;
+   else
+      mIncrement = 0;
+
+   // The first time is in the interval, and so are the following ones, up to
+   // the next point
+   const auto count = CountBefore(maxLen, tnext, mLeftLimit);
+
+   const auto vprev = mEnvelope.GetInterpolationStartValueAtPoint( lo );
+   const auto vnext = mEnvelope.GetInterpolationStartValueAtPoint( hi );
+   if ( vprev == vnext )
+      // A level interval needs no interpolation
+      return constant( count, env[hi].GetVal() );
+
+   // Interpolate, either linear or log depending on mDB.
+   double dt = (tnext - tprev);
+   double to = t - tprev;
+   double v, vstep;
+   if (dt > 0.0)
+   {
+      v = (vprev * (dt - to) + vnext * to) / dt;
+      vstep = (vnext - vprev) * mTStep / dt;
+   }
+   else
+   {
+      v = vnext;
+      vstep = 0.0;
+   }
 
-      t += tstep;
+   // An adjustment if logarithmic scale.
+   if( mEnvelope.mDB )
+   {
+      v = pow(10.0, v);
+      vstep = pow( 10.0, vstep );
    }
+
+   mIndex += count;
+   return { count, v, vstep, mEnvelope.mDB };
 }
 
 // relative time
@@ -136,8 +136,57 @@ public:
    /** \brief Get many envelope points at once.
     *
     * This is much faster than calling GetValue() multiple times if you need
-    * more than one value in a row. */
-   void GetValues(double *buffer, int len, double t0, double tstep) const;
+    * more than one value in a row.
+    * @return whether all of the values are equal, so that the caller may
+    * apply them as one gain, or skip a unit gain */
+   bool GetValues(double *buffer, int len, double t0, double tstep) const;
+
+   //! A run of values at equally spaced times, given by one linear or
+   //! exponential formula
+   struct MIXER_API Segment {
+      //! How many values
+      size_t len;
+      //! The first value
+      double value;
+      //! Difference of successive values, or their ratio if exponential
+      double step;
+      bool exponential;
+
+      bool IsConstant() const { return step == (exponential ? 1.0 : 0.0); }
+      //! Write len values to buffer
+      void Fill(double *buffer) const;
+   };
+
+   //! Visits the segments of an envelope at times t0, t0 + tstep, ... in
+   //! order, so that successive buffers are evaluated without per-sample
+   //! searches or branches
+   class MIXER_API SegmentCursor {
+   public:
+      //! @return a segment of at most maxLen values, and advance past it
+      Segment Next(size_t maxLen);
+
+   private:
+      friend Envelope;
+      // relative time
+      SegmentCursor(
+         const Envelope &envelope, double t0, double tstep, bool leftLimit);
+
+      double Time(size_t index) const { return mT0 + index * mTStep; }
+      //! How many times, from mIndex and at least one, plus mIncrement are
+      //! before bound, or not after it if inclusive
+      size_t CountBefore(size_t maxLen, double bound, bool inclusive) const;
+
+      const Envelope &mEnvelope;
+      const double mT0;
+      const double mTStep;
+      const double mEpsilon;
+      const bool mLeftLimit;
+      size_t mIndex{ 0 };
+      double mIncrement{ 0 };
+   };
+
+   //! Cursor for the values that GetValues(buffer, len, t0, tstep) writes
+   SegmentCursor Segments(double t0, double tstep) const;
 
    // Guarantee an envelope point at the end of the domain.
    void Cap( double sampleDur );
@@ -150,7 +199,7 @@ private:
       ( size_t startAt, bool rightward, bool testNeighbors = true );
 
    double GetValueRelative(double t, bool leftLimit = false) const;
-   void GetValuesRelative
+   bool GetValuesRelative
       (double *buffer, int len, double t0, double tstep, bool leftLimit = false)
       const;
    // relative time
@@ -63,6 +63,21 @@ double ComputeWarpFactor(const Envelope &env, double t0, double t1)
    return env.AverageOfInverse(t0, t1);
 }
 
+//! Multiply samples by envelope values, or by one gain if all the values are
+//! equal, or not at all if that gain is unit
+void ApplyEnvelope(
+   float *buffer, const double *values, size_t len, bool constant)
+{
+   if (!constant)
+      for (size_t i = 0; i < len; ++i)
+         buffer[i] *= values[i];
+   else if (len > 0 && values[0] != 1.0) {
+      const auto gain = values[0];
+      for (size_t i = 0; i < len; ++i)
+         buffer[i] *= gain;
+   }
+}
+
 }
 
 size_t MixerSource::MixVariableRates(
@@ -133,14 +148,12 @@ size_t MixerSource::MixVariableRates(
                    fillZero, mMayThrow))
                for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
                   memset(dst[i], 0, sizeof(float) * getLen);
-            mpLeader->GetEnvelopeValues(
+            const auto constant = mpLeader->GetEnvelopeValues(
                mEnvValues.data(), getLen, (pos).as_double() / sequenceRate,
                backwards);
-            for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
-               const auto queue = mSampleQueue[iChannel].data();
-               for (decltype(getLen) i = 0; i < getLen; i++)
-                  queue[(queueLen) + i] *= mEnvValues[i];
-            }
+            for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+               ApplyEnvelope(mSampleQueue[iChannel].data() + queueLen,
+                  mEnvValues.data(), getLen, constant);
 
             if (backwards)
                pos -= getLen;
@@ -254,13 +267,12 @@ size_t MixerSource::MixSameRate(unsigned nChannels, const size_t maxOut,
       for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
          memset(floatBuffers[iChannel], 0, sizeof(float) * slen);
 
-   mpLeader->GetEnvelopeValues(mEnvValues.data(), slen, t, backwards);
+   const auto constant =
+      mpLeader->GetEnvelopeValues(mEnvValues.data(), slen, t, backwards);
 
-   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel) {
-      const auto pFloat = floatBuffers[iChannel];
-      for (size_t i = 0; i < slen; i++)
-         pFloat[i] *= mEnvValues[i]; // Track gain control will go here?
-   }
+   // Track gain control will go here?
+   for (size_t iChannel = 0; iChannel < nChannels; ++iChannel)
+      ApplyEnvelope(floatBuffers[iChannel], mEnvValues.data(), slen, constant);
 
    if (backwards)
       pos -= slen;
@@ -135,8 +135,10 @@ public:
    /*!
     @param backwards if true, fetch values in reverse order, from `t0` to
        `t0 - bufferLen / rate`
+    @return whether all of the values are equal, so that the caller may apply
+       them as one gain, or skip a unit gain
     */
-   virtual void GetEnvelopeValues(
+   virtual bool GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0, bool backwards) const = 0;
 
 private:
@@ -0,0 +1,121 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  EnvelopeTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "Envelope.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+// Times are multiples of 1/8, so that they are exact in binary, and sample
+// times land on control points whatever the offset
+constexpr double tstep = 0.125;
+
+std::unique_ptr<Envelope> MakeEnvelope(bool exponential,
+   const std::vector<std::pair<double, double>> &points, double offset = 0)
+{
+   auto pEnvelope = std::make_unique<Envelope>(exponential, 0.01, 10.0, 1.0);
+   pEnvelope->SetTrackLen(10.0);
+   // Relative times, in order, maybe repeated for a discontinuity
+   for (const auto &[t, value] : points)
+      pEnvelope->Insert(t, value);
+   pEnvelope->SetOffset(offset);
+   return pEnvelope;
+}
+
+//! Compare one call of GetValues() with GetValue() for each time
+void CompareValues(
+   const Envelope &envelope, double t0, size_t len, double step = tstep)
+{
+   std::vector<double> values(len);
+   const auto constant = envelope.GetValues(values.data(), len, t0, step);
+   for (size_t ii = 0; ii < len; ++ii) {
+      const auto t = t0 + ii * step;
+      INFO("t = " << t);
+      REQUIRE(values[ii] ==
+         Approx(envelope.GetValue(t, step)).epsilon(1e-12).margin(1e-12));
+   }
+   if (constant)
+      REQUIRE(std::all_of(values.begin(), values.end(),
+         [&](double value){ return value == values[0]; }));
+}
+}
+
+TEST_CASE("Envelope::GetValues gives the default of an empty envelope")
+{
+   const auto pEnvelope = MakeEnvelope(false, {});
+   std::vector<double> values(100);
+   REQUIRE(pEnvelope->GetValues(values.data(), values.size(), -3, tstep));
+   REQUIRE(std::all_of(values.begin(), values.end(),
+      [](double value){ return value == 1.0; }));
+   CompareValues(*pEnvelope, -3, 100);
+}
+
+TEST_CASE("Envelope::GetValues agrees with GetValue across control points")
+{
+   const std::vector<std::pair<double, double>> points {
+      { 1.0, 0.5 }, { 2.0, 2.0 }, { 3.0, 1.0 }, { 3.5, 1.0 }, { 5.0, 4.0 }
+   };
+   for (bool exponential : { false, true }) {
+      INFO("exponential " << exponential);
+      const auto pEnvelope = MakeEnvelope(exponential, points);
+      // From negative times, before the first point, to after the last
+      CompareValues(*pEnvelope, -1.0, 64);
+      // Starting exactly at control points
+      for (const auto &point : points)
+         CompareValues(*pEnvelope, point.first, 20);
+      // Steps that do not land on the points
+      CompareValues(*pEnvelope, 0.3, 700, 0.01);
+      // Steps longer than the intervals between points
+      CompareValues(*pEnvelope, -0.5, 5, 1.5);
+      // One value at a time
+      for (size_t ii = 0; ii < 56; ++ii)
+         CompareValues(*pEnvelope, -0.5 + ii * tstep, 1);
+   }
+}
+
+TEST_CASE("Envelope::GetValues agrees with GetValue at discontinuities")
+{
+   // Two points at the same time make a jump; another one starts the
+   // envelope with a jump
+   const auto pEnvelope = MakeEnvelope(false, {
+      { 0.0, 0.5 }, { 0.0, 2.0 }, { 1.0, 1.0 }, { 2.0, 1.0 }, { 2.0, 3.0 },
+      { 4.0, 0.25 }
+   });
+   CompareValues(*pEnvelope, -1.0, 48);
+   CompareValues(*pEnvelope, 0.0, 40);
+   CompareValues(*pEnvelope, 2.0, 10);
+   // Finer steps, still exact in binary, so that no time falls just short
+   // of a jump by rounding
+   CompareValues(*pEnvelope, -0.0625, 600, 1.0 / 128);
+
+   // The value exactly at a jump is its right limit
+   REQUIRE(pEnvelope->GetValue(2.0, tstep) == 3.0);
+   REQUIRE(pEnvelope->GetValue(0.0, tstep) == 2.0);
+}
+
+TEST_CASE("Envelope::GetValues agrees with GetValue with offsets")
+{
+   const std::vector<std::pair<double, double>> points {
+      { 0.0, 1.0 }, { 1.0, 3.0 }, { 1.0, 0.5 }, { 2.5, 2.0 }
+   };
+   for (double offset : { 0.5, -0.75, 3.0 })
+      for (bool exponential : { false, true }) {
+         INFO("offset " << offset << " exponential " << exponential);
+         const auto pEnvelope = MakeEnvelope(exponential, points, offset);
+         CompareValues(*pEnvelope, offset - 1.0, 48);
+         CompareValues(*pEnvelope, offset + 1.0, 16);
+         CompareValues(*pEnvelope, -2.0, 80);
+         // Absolute times of the points
+         REQUIRE(pEnvelope->GetValue(offset, tstep) == 1.0);
+         REQUIRE(pEnvelope->GetValue(offset + 2.5, tstep) == 2.0);
+      }
+}
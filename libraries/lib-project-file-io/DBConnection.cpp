@@ -13,6 +13,11 @@ Paul Licameli -- split from ProjectFileIO.cpp
 
 #include "sqlite3.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
 #include <wx/string.h>
 
 #include "AudacityLogger.h"
@@ -29,10 +34,20 @@ Paul Licameli -- split from ProjectFileIO.cpp
 #define xstr(a) str(a)
 #define str(a) #a
 
+// Incremental auto-vacuum lets a file give back the pages of deleted sample
+// blocks without being rewritten.  Like the page size, it can change only
+// while the file is new, or with a VACUUM.
 static const char* PageSizeConfig =
    "PRAGMA <schema>.page_size = " xstr(AUDACITY_PROJECT_PAGE_SIZE) ";"
+   "PRAGMA <schema>.auto_vacuum = INCREMENTAL;"
    "VACUUM;";
 
+// Memory mapping of the project file for reads; the size is appended
+static const char *MmapConfig =
+   "PRAGMA <schema>.mmap_size = ";
+
+IntSetting ProjectMemoryMapSize{ L"/FileFormats/ProjectMemoryMapSize", 256 };
+
 // Configuration to provide "safe" connections
 static const char* SafeConfig =
    "PRAGMA <schema>.busy_timeout = 5000;"
@@ -71,6 +86,210 @@ DBConnection::~DBConnection()
    }
 }
 
+void DBConnection::EnqueueWrite(std::function<void()> write)
+{
+   {
+      std::unique_lock<std::mutex> lock{ mWriteMutex };
+      // Make the producer wait for the disk, if it is far ahead; but the
+      // writer itself may queue more, and must not wait for itself
+      // The writer, or a thread that paused it, must not wait for itself
+      const auto id = std::this_thread::get_id();
+      if (id != mWriterThread.get_id() &&
+          !(mWriterPauses > 0 && id == mPausingThread))
+         mWriteFinished.wait(lock, [this]{
+            return mWrites.size() < MaxQueuedWrites; });
+      if (mWriteError)
+         std::rethrow_exception(std::exchange(mWriteError, nullptr));
+      if (!mWriterThread.joinable()) {
+         mWriteStop = false;
+         mWriterThread = std::thread([this]{ WriterThread(); });
+      }
+      mWrites.push_back(std::move(write));
+      ++mWritesQueued;
+   }
+   mWriteCondition.notify_one();
+}
+
+void DBConnection::FlushWrites()
+{
+   std::unique_lock<std::mutex> lock{ mWriteMutex };
+   // Updates queued during this thread's own pause would never run
+   if (mWriterPauses > 0 && std::this_thread::get_id() == mPausingThread)
+      return;
+   const auto queued = mWritesQueued;
+   mWriteFinished.wait(lock, [&]{ return mWritesDone >= queued; });
+}
+
+DBConnection::WriterPause::WriterPause(DBConnection &connection)
+   : mConnection{ connection }
+   , mPauseLock{ connection.mPauseMutex }
+{
+   {
+      std::unique_lock<std::mutex> lock{ connection.mWriteMutex };
+      // Having the pause mutex, this thread made any pause already in effect
+      if (connection.mWriterPauses == 0) {
+         const auto queued = connection.mWritesQueued;
+         connection.mWriteFinished.wait(lock, [&]{
+            return connection.mWritesDone >= queued; });
+      }
+      ++connection.mWriterPauses;
+      connection.mPausingThread = std::this_thread::get_id();
+   }
+   // Wait for the release of a savepoint that the writer opened for updates
+   // queued after the flush, and keep transaction scopes of other threads
+   // from starting
+   mSavepointLock = std::unique_lock{ connection.mSavepointMutex };
+}
+
+DBConnection::WriterPause::~WriterPause()
+{
+   mSavepointLock.unlock();
+   {
+      std::lock_guard<std::mutex> lock{ mConnection.mWriteMutex };
+      if (--mConnection.mWriterPauses == 0)
+         mConnection.mPausingThread = {};
+   }
+   mConnection.mWriteCondition.notify_one();
+   mConnection.mWriteFinished.notify_all();
+}
+
+std::exception_ptr DBConnection::TakeWriteError()
+{
+   FlushWrites();
+   std::lock_guard<std::mutex> lock{ mWriteMutex };
+   return std::exchange(mWriteError, nullptr);
+}
+
+void DBConnection::StopWriter()
+{
+   {
+      std::lock_guard<std::mutex> lock{ mWriteMutex };
+      mWriteStop = true;
+   }
+   mWriteCondition.notify_one();
+   if (mWriterThread.joinable())
+      mWriterThread.join();
+}
+
+void DBConnection::WriterThread()
+{
+   std::vector<std::function<void()>> writes;
+   std::unique_lock<std::mutex> lock{ mWriteMutex };
+   while (true) {
+      mWriteCondition.wait(lock, [this]{
+         return mWriteStop || (!mWrites.empty() && mWriterPauses == 0); });
+      // Run everything queued before stopping
+      if (mWrites.empty())
+         return;
+      writes.swap(mWrites);
+      lock.unlock();
+
+      std::exception_ptr pError;
+      {
+         std::lock_guard<std::recursive_mutex> savepointLock{ mSavepointMutex };
+         // If another thread has a transaction open, this nests in it
+         const bool grouped = writes.size() > 1 &&
+            sqlite3_exec(mDB, "SAVEPOINT BlockWriter;",
+               nullptr, nullptr, nullptr) == SQLITE_OK;
+         for (auto &write : writes) {
+            try {
+               write();
+            }
+            catch (...) {
+               if (!pError)
+                  pError = std::current_exception();
+            }
+         }
+         if (grouped &&
+             sqlite3_exec(mDB, "RELEASE BlockWriter;",
+               nullptr, nullptr, nullptr) != SQLITE_OK)
+            wxLogMessage("Failed to release writer savepoint on %s\n"
+                         "\tError: %s",
+                         sqlite3_db_filename(mDB, nullptr),
+                         sqlite3_errmsg(mDB));
+      }
+
+      const auto count = writes.size();
+      writes.clear();
+      lock.lock();
+      if (pError && !mWriteError)
+         mWriteError = pError;
+      mWritesDone += count;
+      mWriteFinished.notify_all();
+   }
+}
+
+// Value of the first column of the first row of a query, or -1
+static int64_t GetPragma(sqlite3 *db, const char *sql)
+{
+   int64_t result = -1;
+   sqlite3_exec(db, sql,
+      [](void *data, int cols, char **vals, char **) {
+         if (cols > 0 && vals[0])
+            *static_cast<int64_t*>(data) = std::strtoll(vals[0], nullptr, 10);
+         return 1;
+      }, &result, nullptr);
+   return result;
+}
+
+bool DBConnection::CanReleaseFreePages()
+{
+   // 2 is INCREMENTAL
+   return GetPragma(mDB, "PRAGMA main.auto_vacuum;") == 2;
+}
+
+int64_t DBConnection::FreePageCount()
+{
+   return GetPragma(mDB, "PRAGMA main.freelist_count;");
+}
+
+bool DBConnection::ReleaseFreePages(std::chrono::steady_clock::duration budget)
+{
+   using namespace std::chrono;
+   const auto start = steady_clock::now();
+
+   while (FreePageCount() > 0)
+   {
+      // Move few pages at a time, so that the budget is not overrun by much
+      const int rc = sqlite3_exec(mDB, "PRAGMA main.incremental_vacuum(16);",
+         nullptr, nullptr, nullptr);
+      if (rc != SQLITE_OK)
+      {
+         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+         ADD_EXCEPTION_CONTEXT("sqlite3.context", "DBConnection::ReleaseFreePages");
+
+         wxLogMessage("Failed to release free pages of %s\n"
+                      "\tError: %s\n",
+                      sqlite3_db_filename(mDB, nullptr),
+                      sqlite3_errmsg(mDB));
+         return false;
+      }
+
+      if (steady_clock::now() - start >= budget)
+         break;
+   }
+
+   return FreePageCount() == 0;
+}
+
+void DBConnection::ReleaseFreePagesLater()
+{
+   // Not worth queueing for a few pages
+   constexpr int64_t MinFreePages = 16;
+
+   if (mReleasePending || !CanReleaseFreePages() ||
+       FreePageCount() < MinFreePages)
+      return;
+
+   mReleasePending = true;
+   EnqueueWrite([this]{
+      mReleasePending = false;
+      // What remains waits for another call
+      using namespace std::chrono_literals;
+      ReleaseFreePages(50ms);
+   });
+}
+
 void DBConnection::SetBypass( bool bypass )
 {
    mBypass = bypass;
@@ -202,6 +421,9 @@ int DBConnection::OpenStepByStep(const FilePath fileName)
       return rc;
    }
 
+   // Not fatal:  reads work the same, only slower, without the mapping
+   MmapMode();
+
    rc = sqlite3_open(name, &mCheckpointDB);
    if (rc != SQLITE_OK)
    {
@@ -241,6 +463,9 @@ bool DBConnection::Close()
       return true;
    }
 
+   // Finish queued updates before anything else
+   StopWriter();
+
    // Uninstall our checkpoint hook so that no additional checkpoints
    // are sent our way.  (Though this shouldn't really happen.)
    sqlite3_wal_hook(mDB, nullptr, nullptr);
@@ -362,6 +587,14 @@ int DBConnection::FastMode(const char *schema /* = "main" */)
    return ModeConfig(mDB, schema, FastConfig);
 }
 
+int DBConnection::MmapMode(const char *schema /* = "main" */)
+{
+   const auto megabytes = std::max(0, ProjectMemoryMapSize.Read());
+   const auto config = MmapConfig +
+      std::to_string(static_cast<sqlite3_int64>(megabytes) << 20) + ";";
+   return ModeConfig(mDB, schema, config.c_str());
+}
+
 int DBConnection::SetPageSize(const char* schema)
 {
    // First of all - let's check if the database is empty.
@@ -597,6 +830,8 @@ struct DBConnectionTransactionScopeImpl final : TransactionScopeImpl {
    bool TransactionStart(const wxString &name) override;
    bool TransactionCommit(const wxString &name) override;
    bool TransactionRollback(const wxString &name) override;
+   //! Release the savepoint, without waiting for queued writes
+   bool Release(const wxString &name);
 
    DBConnection &mConnection;
 };
@@ -615,8 +850,13 @@ DBConnectionTransactionScopeImpl::~DBConnectionTransactionScopeImpl() = default;
 
 bool DBConnectionTransactionScopeImpl::TransactionStart(const wxString &name)
 {
+   // Block insertions queued earlier belong to no transaction; don't let the
+   // writer run them inside this one, where a rollback would lose them
+   mConnection.FlushWrites();
+
    char *errmsg = nullptr;
 
+   std::unique_lock<std::recursive_mutex> lock{ mConnection.mSavepointMutex };
    int rc = sqlite3_exec(mConnection.DB(),
                          wxT("SAVEPOINT ") + name + wxT(";"),
                          nullptr,
@@ -638,9 +878,26 @@ bool DBConnectionTransactionScopeImpl::TransactionStart(const wxString &name)
 }
 
 bool DBConnectionTransactionScopeImpl::TransactionCommit(const wxString &name)
+{
+   // Include all queued block insertions in the transaction, and fail if any
+   // of them did
+   if (mConnection.TakeWriteError())
+   {
+      mConnection.SetDBError(
+         XO("Failed to write sample blocks before releasing savepoint:\n\n%s")
+            .Format(name)
+      );
+      return false;
+   }
+
+   return Release(name);
+}
+
+bool DBConnectionTransactionScopeImpl::Release(const wxString &name)
 {
    char *errmsg = nullptr;
 
+   std::unique_lock<std::recursive_mutex> lock{ mConnection.mSavepointMutex };
    int rc = sqlite3_exec(mConnection.DB(),
                          wxT("RELEASE ") + name + wxT(";"),
                          nullptr,
@@ -663,8 +920,13 @@ bool DBConnectionTransactionScopeImpl::TransactionCommit(const wxString &name)
 
 bool DBConnectionTransactionScopeImpl::TransactionRollback(const wxString &name)
 {
+   // Queued block insertions belong to the transaction too; their failures
+   // don't matter once they are rolled back
+   (void) mConnection.TakeWriteError();
+
    char *errmsg = nullptr;
 
+   std::unique_lock<std::recursive_mutex> lock{ mConnection.mSavepointMutex };
    int rc = sqlite3_exec(mConnection.DB(),
                          wxT("ROLLBACK TO ") + name + wxT(";"),
                          nullptr,
@@ -683,12 +945,13 @@ bool DBConnectionTransactionScopeImpl::TransactionRollback(const wxString &name)
 
    if (rc != SQLITE_OK)
       return false;
+   lock.unlock();
 
    // Rollback AND REMOVE the transaction
    // -- must do both; rolling back a savepoint only rewinds it
    // without removing it, unlike the ROLLBACK command
 
-   return TransactionCommit(name);
+   return Release(name);
 }
 
 ConnectionPtr::~ConnectionPtr()
@@ -13,21 +13,29 @@ Paul Licameli -- split from ProjectFileIO.h
 #define __AUDACITY_DB_CONNECTION__
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <exception>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "ClientData.h"
 #include "Identifier.h"
+#include "Prefs.h"
 
 struct sqlite3;
 struct sqlite3_stmt;
 class wxString;
 class AudacityProject;
 
+//! Megabytes of each project file that connections may memory-map for
+//! reading; 0 disables memory mapping
+extern PROJECT_FILE_IO_API IntSetting ProjectMemoryMapSize;
+
 struct DBConnectionErrors
 {
    TranslatableString mLastError;
@@ -62,6 +70,9 @@ public:
    int SafeMode(const char *schema = "main");
    int FastMode(const char* schema = "main");
    int SetPageSize(const char* schema = "main");
+   //! Apply ProjectMemoryMapSize, so that reads are served from mapped pages
+   //! rather than copied through the page cache
+   int MmapMode(const char* schema = "main");
 
    bool Assign(sqlite3 *handle);
    sqlite3 *Detach();
@@ -73,9 +84,8 @@ public:
 
    enum StatementID
    {
-      GetSamples,
-      GetSummary256,
-      GetSummary64k,
+      GetSamplesRange,
+      PrefetchSamples,
       LoadSampleBlock,
       InsertSampleBlock,
       DeleteSampleBlock,
@@ -87,6 +97,69 @@ public:
    void SetBypass( bool bypass );
    bool ShouldBypass();
 
+   //! Queue a database update, to be run on this connection's writer thread
+   /*!
+    All updates that are queued when the writer wakes are run in one
+    savepoint, so that they append to the WAL together.  The thread that
+    queues them need not wait for the disk, unless MaxQueuedWrites are
+    already waiting.
+
+    @throw the exception that escaped an earlier update, if any, so that its
+    producer learns of the failure (such as a full disk) at the next update
+    */
+   void EnqueueWrite(std::function<void()> write);
+
+   //! Wait until all updates queued so far have run
+   void FlushWrites();
+
+   //! While it exists, the writer starts no updates, and other threads
+   //! start no transaction scopes
+   /*!
+    Statements that begin or end transactions directly, or attach databases,
+    would otherwise nest in the writer's savepoint, or have queued updates
+    nest in their transactions.  Updates queued before the pause run first.
+    Those queued during it wait, but the pausing thread does not wait for
+    them in FlushWrites() or EnqueueWrite().
+    */
+   class WriterPause final
+   {
+   public:
+      explicit WriterPause(DBConnection &connection);
+      WriterPause(const WriterPause&) = delete;
+      WriterPause &operator=(const WriterPause&) = delete;
+      ~WriterPause();
+
+   private:
+      DBConnection &mConnection;
+      std::unique_lock<std::recursive_mutex> mPauseLock;
+      std::unique_lock<std::recursive_mutex> mSavepointLock;
+   };
+
+   //! FlushWrites(), then take the exception that escaped any update since
+   //! the last report, so that a commit point can fail
+   std::exception_ptr TakeWriteError();
+
+   //! Whether the file uses incremental auto-vacuum, so that
+   //! ReleaseFreePages() can shrink it in place
+   bool CanReleaseFreePages();
+
+   //! Number of pages of the file that hold nothing
+   int64_t FreePageCount();
+
+   //! Move pages from the end of the file into free pages, and truncate the
+   //! file, until none are free or the time budget is spent
+   /*!
+    @return whether no free pages remain
+    @pre CanReleaseFreePages()
+    */
+   bool ReleaseFreePages(std::chrono::steady_clock::duration budget =
+      std::chrono::steady_clock::duration::max());
+
+   //! If enough pages are free, queue a ReleaseFreePages() with a small
+   //! budget on the writer thread, so that the file shrinks a little at a
+   //! time while the user works
+   void ReleaseFreePagesLater();
+
    //! Just set stored errors
    void SetError(
       const TranslatableString &msg,
@@ -100,12 +173,18 @@ public:
       int errorCode = -1);
 
 private:
+   friend struct DBConnectionTransactionScopeImpl;
+
    int OpenStepByStep(const FilePath fileName);
    int ModeConfig(sqlite3 *db, const char *schema, const char *config);
 
    void CheckpointThread(sqlite3 *db, const FilePath &fileName);
    static int CheckpointHook(void *data, sqlite3 *db, const char *schema, int pages);
 
+   void WriterThread();
+   //! Stop the writer after it has run all queued updates
+   void StopWriter();
+
 private:
    std::weak_ptr<AudacityProject> mpProject;
    sqlite3 *mDB;
@@ -118,6 +197,36 @@ private:
    std::atomic_bool mCheckpointPending{ false };
    std::atomic_bool mCheckpointActive{ false };
 
+   //! Bound on the updates waiting for the writer, each of which may hold a
+   //! block's samples
+   static constexpr size_t MaxQueuedWrites = 64;
+
+   //! Guards the members below it, not the database
+   std::mutex mWriteMutex;
+   std::condition_variable mWriteCondition;
+   std::condition_variable mWriteFinished;
+   std::thread mWriterThread;
+   std::vector<std::function<void()>> mWrites;
+   //! Counts of updates queued and completed, for FlushWrites
+   size_t mWritesQueued{ 0 };
+   size_t mWritesDone{ 0 };
+   std::exception_ptr mWriteError;
+   bool mWriteStop{ false };
+   //! Count of nested WriterPause objects, all of one thread
+   size_t mWriterPauses{ 0 };
+   std::thread::id mPausingThread;
+
+   //! Whether a ReleaseFreePages() is queued and not yet started
+   std::atomic_bool mReleasePending{ false };
+
+   //! Held by the writer while its savepoint is open, and by transaction
+   //! scopes while they change the savepoint stack, so neither releases the
+   //! other's savepoint; and by a WriterPause, during which its thread may
+   //! still use transaction scopes
+   std::recursive_mutex mSavepointMutex;
+   //! Serializes pauses of the writer
+   std::recursive_mutex mPauseMutex;
+
    std::mutex mStatementMutex;
    using StatementIndex = std::pair<enum StatementID, std::thread::id>;
    std::map<StatementIndex, sqlite3_stmt *> mStatements;
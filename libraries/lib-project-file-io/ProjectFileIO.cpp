@@ -14,6 +14,9 @@ Paul Licameli split from AudacityProject.cpp
 #include <sqlite3.h>
 #include <optional>
 #include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 #include <wx/crt.h>
 #include <wx/log.h>
@@ -40,7 +43,6 @@ Paul Licameli split from AudacityProject.cpp
 
 #include "ProjectFormatExtensionsRegistry.h"
 
-#include "BufferedStreamReader.h"
 #include "FromChars.h"
 
 // Don't change this unless the file format changes
@@ -88,6 +90,85 @@ static const int ProjectFileID = PACK('A', 'U', 'D', 'Y');
 // A search for "SQL sampleblocks" will find all SQL related 
 // to sampleblocks.
 
+// autosavedelta holds sections of the autosave document that changed since
+// it was written, so that autosave need not rewrite the whole document.
+// Rows are never updated, and all are deleted with the autosave document.
+// While there are any, user_version requires AutoSaveDeltaFormatVersion, so
+// that earlier versions, which would recover only the autosave document and
+// then delete the blocks that only the deltas use, refuse the file.
+// base is the checksum of the autosave doc that the row extends; rows with
+// another checksum are ignored.
+// dict is the dictionary of fieldnames, as in autosave.  It only grows, so
+// that the dict of the last row serves for all sections.
+// layout lists the pieces that make up the whole document, each as three
+// little-endian 8 byte numbers: the id of the row whose doc holds the piece,
+// or 0 for the autosave doc; the offset; and the length.  Only the layout of
+// the last row matters.
+// doc is the bytes of the sections that changed.
+#define AUTOSAVEDELTA_SCHEMA \
+   "CREATE TABLE IF NOT EXISTS <schema>.autosavedelta" \
+   "(" \
+   "  id                   INTEGER PRIMARY KEY," \
+   "  base                 INTEGER," \
+   "  dict                 BLOB," \
+   "  layout               BLOB," \
+   "  doc                  BLOB" \
+   ");"
+
+// The earliest version that recovers from autosavedelta
+static const ProjectFormatVersion AutoSaveDeltaFormatVersion = { 3, 4, 0, 0 };
+
+// The estimate of space used by a row of sampleblocks, as
+// ProjectFileIO::GetDiskUsage() reports it
+#define BLOCK_SPACE_USAGE(row) \
+   "(length(" row "blockid) + length(" row "sampleformat) + " \
+   "length(" row "summin) + length(" row "summax) + length(" row "sumrms) + " \
+   "length(" row "summary256) + length(" row "summary64k) + " \
+   "length(" row "samples))"
+
+// blockusage has one row, with id 1, holding the number of rows of
+// sampleblocks and the sum of their space usage estimates.  Triggers keep
+// it up to date as rows are inserted and deleted, so that totals need not
+// scan the whole table.
+#define BLOCKUSAGE_SCHEMA \
+   "CREATE TABLE IF NOT EXISTS <schema>.blockusage" \
+   "(" \
+   "  id                   INTEGER PRIMARY KEY," \
+   "  blocks               INTEGER," \
+   "  bytes                INTEGER" \
+   ");" \
+   "INSERT OR IGNORE INTO <schema>.blockusage(id, blocks, bytes)" \
+   "  SELECT 1, count(*), coalesce(sum(" BLOCK_SPACE_USAGE("") "), 0)" \
+   "  FROM <schema>.sampleblocks;" \
+   "CREATE TRIGGER IF NOT EXISTS <schema>.blockusage_insert" \
+   "  AFTER INSERT ON sampleblocks" \
+   "  BEGIN" \
+   "    UPDATE blockusage SET blocks = blocks + 1," \
+   "      bytes = bytes + coalesce(" BLOCK_SPACE_USAGE("NEW.") ", 0)" \
+   "      WHERE id = 1;" \
+   "  END;" \
+   "CREATE TRIGGER IF NOT EXISTS <schema>.blockusage_delete" \
+   "  AFTER DELETE ON sampleblocks" \
+   "  BEGIN" \
+   "    UPDATE blockusage SET blocks = blocks - 1," \
+   "      bytes = bytes - coalesce(" BLOCK_SPACE_USAGE("OLD.") ", 0)" \
+   "      WHERE id = 1;" \
+   "  END;"
+
+// Install the tables that project files written by earlier versions may lack.
+//
+// This is a persistent migration of the schema, which CheckVersion() applies,
+// without asking, to every such file that is opened, even if it is then
+// closed unchanged.  It adds the autosavedelta and blockusage tables and the
+// two triggers on sampleblocks, and fills blockusage with one scan of all of
+// sampleblocks, which takes time in proportion to the number of blocks, once
+// per file.  The format version is not raised, so earlier versions still
+// open the file.  They ignore the tables, and the triggers keep blockusage
+// correct as those versions add and delete blocks.
+static const char *ProjectFileUpgradeSchema =
+   AUTOSAVEDELTA_SCHEMA
+   BLOCKUSAGE_SCHEMA;
+
 static const char *ProjectFileSchema =
    // These are persistent and not connection based
    //
@@ -95,6 +176,9 @@ static const char *ProjectFileSchema =
    // settings.
    "PRAGMA <schema>.application_id = %d;"
    "PRAGMA <schema>.user_version = %u;"
+   // Effective only before the first table is created, as in the
+   // destination of CopyTo(); see also PageSizeConfig in DBConnection
+   "PRAGMA <schema>.auto_vacuum = INCREMENTAL;"
    ""
    // project is a binary representation of an XML file.
    // it's in binary for speed.
@@ -159,7 +243,13 @@ static const char *ProjectFileSchema =
    "  summary256           BLOB,"
    "  summary64k           BLOB,"
    "  samples              BLOB"
-   ");";
+   ");"
+   ""
+   // CREATE SQL autosavedelta
+   AUTOSAVEDELTA_SCHEMA
+   ""
+   // CREATE SQL blockusage
+   BLOCKUSAGE_SCHEMA;
 
 // This singleton handles initialization/shutdown of the SQLite library.
 // It is needed because our local SQLite is built with SQLITE_OMIT_AUTOINIT
@@ -321,6 +411,21 @@ public:
       return rc;
    }
 
+   // Position for the next Read or Write
+   bool Seek(int64_t offset) noexcept
+   {
+      if (offset < 0 || offset > static_cast<int64_t>(mBlobSize))
+         return false;
+
+      mOffset = static_cast<int>(offset);
+      return true;
+   }
+
+   int64_t GetSize() const noexcept
+   {
+      return mBlobSize;
+   }
+
    bool IsEof() const noexcept
    {
       return mOffset == mBlobSize;
@@ -335,88 +440,280 @@ private:
    bool mIsReadOnly { false };
 };
 
-class BufferedProjectBlobStream : public BufferedStreamReader
+namespace {
+// Bytes of the doc column of a row of autosavedelta, or of autosave if row
+// is 0
+struct AutoSavePiece
+{
+   int64_t row { 0 };
+   int64_t offset { 0 };
+   int64_t length { 0 };
+
+   bool operator ==(const AutoSavePiece &other) const
+   {
+      return row == other.row && offset == other.offset &&
+         length == other.length;
+   }
+};
+
+void WriteLayoutNumber(MemoryStream &stream, int64_t value)
+{
+   unsigned char bytes[8];
+   auto bits = static_cast<uint64_t>(value);
+   for (auto &byte : bytes)
+   {
+      byte = static_cast<unsigned char>(bits & 0xff);
+      bits >>= 8;
+   }
+   stream.AppendData(bytes, sizeof(bytes));
+}
+
+// 64 bit FNV-1a hash, which identifies the autosave doc that rows of
+// autosavedelta extend.  Unlike std::hash, it is the same on all platforms.
+class DocChecksum
 {
 public:
-   static constexpr std::array<const char*, 2> Columns = { "dict", "doc" };
+   void Update(const void *data, size_t size)
+   {
+      const auto bytes = static_cast<const unsigned char *>(data);
+      for (size_t ii = 0; ii < size; ++ii)
+         mValue = (mValue ^ bytes[ii]) * 0x100000001b3ull;
+   }
 
-   BufferedProjectBlobStream(
-      sqlite3* db, const char* schema, const char* table,
-      int64_t rowID)
-       // Despite we use 64k pages in SQLite - it is impossible to guarantee
-       // that read is satisfied from a single page.
-       // Reading 64k proved to be slower, (64k - 8) gives no measurable difference
-       // to reading 32k.
-       // Reading 4k is slower than reading 32k.
-       : BufferedStreamReader(32 * 1024) 
-       , mDB(db)
-       , mSchema(schema)
-       , mTable(table)
-       , mRowID(rowID)
+   int64_t Get() const
    {
+      return static_cast<int64_t>(mValue);
    }
 
 private:
-   bool OpenBlob(size_t index)
+   uint64_t mValue { 0xcbf29ce484222325ull };
+};
+
+int64_t ReadLayoutNumber(const unsigned char *bytes)
+{
+   uint64_t bits = 0;
+   for (int ii = 8; ii--;)
+      bits = (bits << 8) | bytes[ii];
+   return static_cast<int64_t>(bits);
+}
+
+// Read the layout of a row of autosavedelta
+std::optional<std::vector<AutoSavePiece>>
+ReadAutoSaveLayout(sqlite3 *db, int64_t rowID)
+{
+   auto blobStream =
+      SQLiteBlobStream::Open(db, "main", "autosavedelta", "layout", rowID, true);
+   if (!blobStream || blobStream->GetSize() % 24 != 0)
+      return {};
+
+   std::vector<unsigned char> bytes(blobStream->GetSize());
+   int size = bytes.size();
+   if (size > 0 &&
+       (SQLITE_OK != blobStream->Read(bytes.data(), size) ||
+        size != static_cast<int>(bytes.size())))
+      return {};
+
+   std::vector<AutoSavePiece> pieces;
+   for (size_t ii = 0; ii < bytes.size(); ii += 24)
+      pieces.push_back({ ReadLayoutNumber(&bytes[ii]),
+         ReadLayoutNumber(&bytes[ii + 8]), ReadLayoutNumber(&bytes[ii + 16]) });
+   return pieces;
+}
+
+// Checksum of the autosave doc
+std::optional<int64_t> ReadAutoSaveChecksum(sqlite3 *db, int64_t rowID)
+{
+   auto blobStream =
+      SQLiteBlobStream::Open(db, "main", "autosave", "doc", rowID, true);
+   if (!blobStream)
+      return {};
+
+   DocChecksum checksum;
+   std::vector<unsigned char> buffer(64 * 1024);
+   while (!blobStream->IsEof())
+   {
+      int size = buffer.size();
+      if (SQLITE_OK != blobStream->Read(buffer.data(), size))
+         return {};
+      checksum.Update(buffer.data(), size);
+   }
+   return checksum.Get();
+}
+
+// Read length bytes of a blob, from offset, into buffer
+bool ReadBlob(
+   SQLiteBlobStream &blobStream, int64_t offset, int64_t length, char *buffer)
+{
+   if (length == 0)
+      return true;
+   if (!blobStream.Seek(offset))
+      return false;
+   int size = static_cast<int>(length);
+   return SQLITE_OK == blobStream.Read(buffer, size) && size == length;
+}
+
+// The dict and doc of a row of the project or autosave table, read into one
+// buffer, which ProjectSerializer decodes in place
+std::optional<std::vector<char>> ReadProjectDocument(
+   sqlite3 *db, const char *table, int64_t rowID)
+{
+   auto dict = SQLiteBlobStream::Open(db, "main", table, "dict", rowID, true);
+   auto doc = SQLiteBlobStream::Open(db, "main", table, "doc", rowID, true);
+   if (!dict || !doc)
+      return {};
+
+   const auto dictSize = dict->GetSize();
+   std::vector<char> bytes(dictSize + doc->GetSize());
+   if (!ReadBlob(*dict, 0, dictSize, bytes.data()) ||
+       !ReadBlob(*doc, 0, doc->GetSize(), bytes.data() + dictSize))
+      return {};
+   return bytes;
+}
+
+// The dict of a row of autosavedelta, then the pieces of the document that
+// its layout lists, read into one buffer
+std::optional<std::vector<char>> ReadAutoSaveDocument(sqlite3 *db,
+   int64_t deltaRowID, int64_t autosaveRowID,
+   const std::vector<AutoSavePiece> &pieces)
+{
+   auto dict = SQLiteBlobStream::Open(
+      db, "main", "autosavedelta", "dict", deltaRowID, true);
+   if (!dict)
+      return {};
+
+   // Open the doc of each row once, and check all pieces before sizing the
+   // buffer
+   std::unordered_map<int64_t, SQLiteBlobStream> docs;
+   int64_t size = dict->GetSize();
+   for (const auto &piece : pieces)
    {
-      if (index >= Columns.size())
+      auto iter = docs.find(piece.row);
+      if (iter == docs.end())
       {
-         mBlobStream.reset();
-         return false;
+         auto doc = piece.row == 0
+            ? SQLiteBlobStream::Open(
+               db, "main", "autosave", "doc", autosaveRowID, true)
+            : SQLiteBlobStream::Open(
+               db, "main", "autosavedelta", "doc", piece.row, true);
+         if (!doc)
+            return {};
+         iter = docs.emplace(piece.row, std::move(*doc)).first;
       }
+      if (piece.offset < 0 || piece.length < 0 ||
+          piece.length > iter->second.GetSize() - piece.offset)
+         return {};
+      size += piece.length;
+   }
 
-      mBlobStream = SQLiteBlobStream::Open(
-         mDB, mSchema, mTable, Columns[index], mRowID, true);
-
-      return mBlobStream.has_value();
+   std::vector<char> bytes(size);
+   auto buffer = bytes.data();
+   if (!ReadBlob(*dict, 0, dict->GetSize(), buffer))
+      return {};
+   buffer += dict->GetSize();
+   for (const auto &piece : pieces)
+   {
+      if (!ReadBlob(docs.at(piece.row), piece.offset, piece.length, buffer))
+         return {};
+      buffer += piece.length;
    }
+   return bytes;
+}
+}
 
-   std::optional<SQLiteBlobStream> mBlobStream;
-   size_t mNextBlobIndex { 0 };
+// What the autosave and autosavedelta tables hold, so that AutoSave() can
+// find the sections of a new document that are already stored
+struct ProjectFileIO::AutoSaveState
+{
+   struct Section
+   {
+      size_t start;
+      size_t length;
+      AutoSavePiece piece;
+   };
+
+   // Copy the document and divide it at its section boundaries
+   explicit AutoSaveState(const ProjectSerializer &autosave)
+   {
+      const auto &data = autosave.GetData();
+      doc.assign(static_cast<const char *>(data.GetData()), data.GetSize());
 
-   sqlite3* mDB;
-   const char* mSchema;
-   const char* mTable;
-   const int64_t mRowID;
+      size_t start = 0;
+      const auto divide = [&](size_t end) {
+         if (end > start)
+            sections.push_back({ start, end - start });
+         start = end;
+      };
+      for (auto boundary : autosave.GetSectionBoundaries())
+         divide(boundary);
+      divide(doc.size());
+   }
 
-protected:
-   bool HasMoreData() const override
+   std::string_view Bytes(const Section &section) const
    {
-      return mBlobStream.has_value() || mNextBlobIndex < Columns.size();
+      return std::string_view{ doc }.substr(section.start, section.length);
    }
 
-   size_t ReadData(void* buffer, size_t maxBytes) override
+   // A section with the given bytes, if there is one
+   const Section *Find(std::string_view bytes) const
    {
-      if (!mBlobStream || mBlobStream->IsEof())
+      auto range = byHash.equal_range(std::hash<std::string_view>{}(bytes));
+      for (auto iter = range.first; iter != range.second; ++iter)
       {
-         if (!OpenBlob(mNextBlobIndex++))
-            return {};
+         const auto &section = sections[iter->second];
+         if (Bytes(section) == bytes)
+            return &section;
       }
+      return nullptr;
+   }
 
-      // Do not allow reading more then 2GB at a time (O_o)
-      maxBytes = std::min<size_t>(maxBytes, std::numeric_limits<int>::max());
-      auto bytesRead = static_cast<int>(maxBytes);
+   // Make sections findable, once their pieces are known
+   void Index()
+   {
+      byHash.clear();
+      for (size_t ii = 0; ii < sections.size(); ++ii)
+         byHash.emplace(
+            std::hash<std::string_view>{}(Bytes(sections[ii])), ii);
+   }
 
-      if (SQLITE_OK != mBlobStream->Read(buffer, bytesRead))
+   // The pieces of the whole document, merging adjacent ones
+   MemoryStream Layout() const
+   {
+      std::vector<AutoSavePiece> pieces;
+      for (const auto &section : sections)
       {
-         // Reading has failed, close the stream and do not allow opening
-         // the next one
-         mBlobStream = {};
-         mNextBlobIndex = Columns.size();
-
-         return 0;
+         const auto &piece = section.piece;
+         if (!pieces.empty() && pieces.back().row == piece.row &&
+             pieces.back().offset + pieces.back().length == piece.offset)
+            pieces.back().length += piece.length;
+         else
+            pieces.push_back(piece);
       }
-      else if (bytesRead == 0)
+
+      MemoryStream layout;
+      for (const auto &piece : pieces)
       {
-         mBlobStream = {};
+         WriteLayoutNumber(layout, piece.row);
+         WriteLayoutNumber(layout, piece.offset);
+         WriteLayoutNumber(layout, piece.length);
       }
-
-      return static_cast<size_t>(bytesRead);
-   }
+      return layout;
+   }
+
+   // Copy of the last document written
+   std::string doc;
+   std::vector<Section> sections;
+   // Positions in sections, by hash of their bytes
+   std::unordered_multimap<size_t, size_t> byHash;
+
+   // Id of the last row of autosavedelta, or 0 if it is empty
+   int64_t lastRow { 0 };
+   // Checksum of the autosave doc
+   int64_t baseChecksum { 0 };
+   // Sizes of the autosave doc, and of all of autosavedelta
+   size_t baseSize { 0 };
+   size_t deltaSize { 0 };
 };
 
-constexpr std::array<const char*, 2> BufferedProjectBlobStream::Columns;
-
 bool ProjectFileIO::InitializeSQL()
 {
    static SQLiteIniter sqliteIniter;
@@ -514,7 +811,11 @@ wxString ProjectFileIO::GenerateDoc()
 
 sqlite3 *ProjectFileIO::DB()
 {
-   return GetConnection().DB();
+   auto &connection = GetConnection();
+   // Statements of this class may examine the whole sampleblocks table, so
+   // let them see all blocks created so far
+   connection.FlushWrites();
+   return connection.DB();
 }
 
 /*!
@@ -574,6 +875,10 @@ bool ProjectFileIO::OpenConnection(FilePath fileName /* = {}  */)
 
    mTemporary = isTemp;
 
+   // The next autosave does not know what the tables of this connection
+   // hold, and writes the whole document
+   mpAutoSaveState.reset();
+
    SetFileName(fileName);
 
    return true;
@@ -590,6 +895,7 @@ bool ProjectFileIO::CloseConnection()
       return false;
    }
    curConn.reset();
+   mpAutoSaveState.reset();
 
    SetFileName({});
 
@@ -606,6 +912,7 @@ void ProjectFileIO::SaveConnection()
    mPrevConn = std::move(CurrConn());
    mPrevFileName = mFileName;
    mPrevTemporary = mTemporary;
+   mpAutoSaveState.reset();
 
    SetFileName({});
 }
@@ -660,6 +967,7 @@ void ProjectFileIO::RestoreConnection()
    }
 
    curConn = std::move(mPrevConn);
+   mpAutoSaveState.reset();
    SetFileName(mPrevFileName);
    mTemporary = mPrevTemporary;
 
@@ -672,6 +980,7 @@ void ProjectFileIO::UseConnection(Connection &&conn, const FilePath &filePath)
    wxASSERT(!curConn);
 
    curConn = std::move(conn);
+   mpAutoSaveState.reset();
    SetFileName(filePath);
 }
 
@@ -822,7 +1131,35 @@ bool ProjectFileIO::CheckVersion()
       );
       return false;
    }
-   
+
+   // Project files written by earlier versions may lack some tables.  Add
+   // them, and count the existing sample blocks only this once, in one
+   // transaction.  See ProjectFileUpgradeSchema.
+   if (!GetValue(
+      "SELECT Count(*) FROM sqlite_master WHERE type='table'"
+      "   AND name IN ('autosavedelta', 'blockusage');", result))
+   {
+      return false;
+   }
+
+   if (wxStrtol<char **>(result, nullptr, 10) < 2)
+   {
+      wxString sql{ ProjectFileUpgradeSchema };
+      sql.Replace("<schema>", "main");
+      sql = wxT("SAVEPOINT Upgrade;") + sql + wxT("RELEASE Upgrade;");
+      DBConnection::WriterPause pause{ GetConnection() };
+      rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+      if (rc != SQLITE_OK)
+      {
+         sqlite3_exec(db, "ROLLBACK TO Upgrade; RELEASE Upgrade;",
+            nullptr, nullptr, nullptr);
+         SetDBError(
+            XO("Unable to initialize the project file")
+         );
+         return false;
+      }
+   }
+
    return true;
 }
 
@@ -983,6 +1320,9 @@ bool ProjectFileIO::CopyTo(const FilePath &destpath,
    WriteXML(doc, false, tracks.empty() ? nullptr : tracks[0]);
 
    auto db = DB();
+   // Keep the writer's savepoints and queued updates out of the attachment
+   // and the transaction below, until the cleanup is done
+   DBConnection::WriterPause pause{ *pConn };
    Connection destConn = nullptr;
    bool success = false;
    int rc = SQLITE_OK;
@@ -1212,7 +1552,8 @@ bool ProjectFileIO::ShouldCompact(const std::vector<const TrackList *> &tracks)
             );
    }
 
-   // Get the number of blocks and total length from the project file.
+   // Get the number of blocks and total length from the project file, as
+   // maintained by triggers
    unsigned long long total = GetTotalUsage();
    unsigned long long blockcount = 0;
    
@@ -1223,7 +1564,8 @@ bool ProjectFileIO::ShouldCompact(const std::vector<const TrackList *> &tracks)
       return 0;
    };
 
-   if (!Query("SELECT Count(*) FROM sampleblocks;", cb) || blockcount == 0)
+   if (!Query("SELECT blocks FROM blockusage WHERE id = 1;", cb) ||
+       blockcount == 0)
    {
       // Shouldn't compact since we don't have the full picture
       return false;
@@ -1458,10 +1800,24 @@ void ProjectFileIO::Compact(
             (void) AutoSaveDelete();
          }
 
+         // Still give back the pages that are free, which is cheap when the
+         // file allows it
+         if (!IsTemporary() && GetConnection().CanReleaseFreePages())
+         {
+            TransactionScope transaction(mProject, "Compact");
+            if (GetConnection().ReleaseFreePages())
+               transaction.Commit();
+         }
+
          return;
       }
    }
 
+   // Files created since incremental auto-vacuum was introduced need no copy;
+   // older ones are copied once, and the copy allows it from then on
+   if (GetConnection().CanReleaseFreePages() && CompactInPlace(tracks))
+      return;
+
    wxString origName = mFileName;
    wxString backName = origName + "_compact_back";
    wxString tempName = origName + "_compact_temp";
@@ -1561,6 +1917,57 @@ void ProjectFileIO::Compact(
    return;
 }
 
+bool ProjectFileIO::CompactInPlace(
+   const std::vector<const TrackList *> &tracks)
+{
+   // Create the project doc, as CopyTo() would
+   ProjectSerializer doc;
+   WriteXMLHeader(doc);
+   WriteXML(doc, false, tracks.empty() ? nullptr : tracks[0]);
+
+   SampleBlockIDSet blockids;
+   for (auto trackList : tracks)
+      if (trackList)
+         InspectBlocks( *trackList, {}, &blockids );
+
+   {
+      TransactionScope transaction(mProject, "Compact");
+
+      // Only prune sample blocks if we have a tracklist
+      if (!tracks.empty() && !DeleteBlocks(blockids, true))
+         return false;
+
+      // Temporary projects do not have a "project" doc, so the doc replaces
+      // the autosave, as in CopyTo(); otherwise the autosave is dropped
+      const auto noResult = [](auto...) { return 0; };
+      if (!Query("DELETE FROM main.autosavedelta;", noResult) ||
+          (!IsTemporary() && !Query("DELETE FROM main.autosave;", noResult)) ||
+          !WriteDoc(IsTemporary() ? "autosave" : "project", doc))
+         return false;
+
+      // Move pages from the end of the file into the pages of the deleted
+      // blocks and documents
+      if (!GetConnection().ReleaseFreePages() || !transaction.Commit())
+         return false;
+   }
+
+   // The next autosave must write the whole document
+   mpAutoSaveState.reset();
+   if (!IsTemporary())
+      mModified = false;
+
+   // The file shrinks when the write-ahead log is next checkpointed; do it
+   // now, so that the caller sees the new size.  The checkpoint thread will
+   // retry if readers prevent it.
+   sqlite3_wal_checkpoint_v2(
+      DB(), "main", SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr);
+
+   // Remember that we compacted
+   mWasCompacted = true;
+
+   return true;
+}
+
 bool ProjectFileIO::WasCompacted()
 {
    return mWasCompacted;
@@ -1804,12 +2211,34 @@ bool ProjectFileIO::AutoSave(bool recording)
    WriteXMLHeader(autosave);
    WriteXML(autosave, recording);
 
-   if (WriteDoc("autosave", autosave))
+   // Delta autosaves seldom let the number of rows, or the space taken by
+   // superseded sections, grow beyond these bounds before the next whole
+   // document replaces them
+   constexpr int64_t MaxDeltas = 100;
+
+   auto pState = std::make_unique<AutoSaveState>(autosave);
+   const auto &pPrevious = mpAutoSaveState;
+   const bool success =
+      (!pPrevious || pPrevious->lastRow >= MaxDeltas ||
+         pPrevious->deltaSize > pPrevious->baseSize)
+      ? WriteAutoSaveBase(autosave, *pState)
+      : WriteAutoSaveDelta(autosave, *pPrevious, *pState);
+
+   if (success)
    {
+      pState->Index();
+      mpAutoSaveState = std::move(pState);
       mModified = true;
+      // Pages of blocks of discarded undo states are given back a few at a
+      // time, but not while recording, when the writer is busy enough
+      if (!recording)
+         GetConnection().ReleaseFreePagesLater();
       return true;
    }
 
+   // The tables may hold anything now, so write the whole document next time
+   mpAutoSaveState.reset();
+
    return false;
 }
 
@@ -1822,7 +2251,10 @@ bool ProjectFileIO::AutoSaveDelete(sqlite3 *db /* = nullptr */)
       db = DB();
    }
 
-   rc = sqlite3_exec(db, "DELETE FROM autosave;", nullptr, nullptr, nullptr);
+   mpAutoSaveState.reset();
+
+   rc = sqlite3_exec(db, "DELETE FROM autosave; DELETE FROM autosavedelta;",
+      nullptr, nullptr, nullptr);
    if (rc != SQLITE_OK)
    {
       ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
@@ -1834,11 +2266,156 @@ bool ProjectFileIO::AutoSaveDelete(sqlite3 *db /* = nullptr */)
       return false;
    }
 
+   // Without deltas, earlier versions may open the file again
+   if (db == DB() && !WriteRequiredVersion())
+      return false;
+
    mModified = false;
 
    return true;
 }
 
+bool ProjectFileIO::WriteAutoSaveBase(
+   const ProjectSerializer &autosave, AutoSaveState &state)
+{
+   TransactionScope transaction(mProject, "AutoSave");
+
+   // Remove the deltas first, so that WriteDoc() no longer requires the
+   // version that reads them
+   if (!Query("DELETE FROM main.autosavedelta;", [](auto...) { return 0; }))
+      return false;
+
+   if (!WriteDoc("autosave", autosave))
+      return false;
+
+   if (!transaction.Commit())
+      return false;
+
+   DocChecksum checksum;
+   checksum.Update(state.doc.data(), state.doc.size());
+   state.baseChecksum = checksum.Get();
+
+   for (auto &section : state.sections)
+      section.piece = { 0, static_cast<int64_t>(section.start),
+         static_cast<int64_t>(section.length) };
+   state.baseSize = state.doc.size();
+
+   return true;
+}
+
+bool ProjectFileIO::WriteAutoSaveDelta(const ProjectSerializer &autosave,
+   const AutoSaveState &previous, AutoSaveState &state)
+{
+   state.lastRow = previous.lastRow;
+   state.baseChecksum = previous.baseChecksum;
+   state.baseSize = previous.baseSize;
+   state.deltaSize = previous.deltaSize;
+
+   const auto row = previous.lastRow + 1;
+   MemoryStream data;
+   bool changed = state.sections.size() != previous.sections.size();
+   for (size_t ii = 0; ii < state.sections.size(); ++ii)
+   {
+      auto &section = state.sections[ii];
+      const auto bytes = state.Bytes(section);
+      if (const auto pFound = previous.Find(bytes))
+         section.piece = pFound->piece;
+      else
+      {
+         section.piece = { row, static_cast<int64_t>(data.GetSize()),
+            static_cast<int64_t>(section.length) };
+         data.AppendData(bytes.data(), bytes.size());
+      }
+      changed = changed || !(section.piece == previous.sections[ii].piece);
+   }
+
+   // Nothing to write if all sections are in the same places as before
+   if (!changed)
+      return true;
+
+   const MemoryStream& dict = autosave.GetDict();
+   const MemoryStream layout = state.Layout();
+
+   auto db = DB();
+
+   TransactionScope transaction(mProject, "AutoSave");
+
+   // SQL autosavedelta
+   static const char *sql =
+      "INSERT INTO main.autosavedelta(id, base, dict, layout, doc)"
+      "       VALUES(?1, ?2, ?3, ?4, ?5);";
+
+   sqlite3_stmt *stmt = nullptr;
+   auto cleanup = finally([&]
+   {
+      if (stmt)
+      {
+         sqlite3_finalize(stmt);
+      }
+   });
+
+   int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+   if (rc != SQLITE_OK)
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.query", sql);
+      ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteAutoSaveDelta::prepare");
+
+      SetDBError(
+         XO("Unable to prepare project file command:\n\n%s").Format(sql)
+      );
+      return false;
+   }
+
+   if (
+      sqlite3_bind_int64(stmt, 1, row) ||
+      sqlite3_bind_int64(stmt, 2, state.baseChecksum) ||
+      sqlite3_bind_zeroblob(stmt, 3, dict.GetSize()) ||
+      sqlite3_bind_zeroblob(stmt, 4, layout.GetSize()) ||
+      sqlite3_bind_zeroblob(stmt, 5, data.GetSize()))
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.query", sql);
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteAutoSaveDelta::bind");
+
+      SetDBError(XO("Unable to bind to blob"));
+      return false;
+   }
+
+   rc = sqlite3_step(stmt);
+   if (rc != SQLITE_DONE)
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.query", sql);
+      ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteAutoSaveDelta::step");
+
+      SetDBError(
+         XO("Failed to update the project file.\nThe following command failed:\n\n%s")
+            .Format(sql));
+      return false;
+   }
+
+   // Finalize the statement before committing the transaction
+   sqlite3_finalize(stmt);
+   stmt = nullptr;
+
+   // The id is the rowid
+   if (!WriteStream(db, "main", "autosavedelta", "dict", row, dict) ||
+       !WriteStream(db, "main", "autosavedelta", "layout", row, layout) ||
+       !WriteStream(db, "main", "autosavedelta", "doc", row, data))
+      return false;
+
+   if (!WriteRequiredVersion())
+      return false;
+
+   if (!transaction.Commit())
+      return false;
+
+   state.lastRow = row;
+   state.deltaSize += dict.GetSize() + layout.GetSize() + data.GetSize();
+
+   return true;
+}
+
 bool ProjectFileIO::WriteDoc(const char *table,
                              const ProjectSerializer &autosave,
                              const char *schema /* = "main" */)
@@ -1936,59 +2513,76 @@ bool ProjectFileIO::WriteDoc(const char *table,
       return false;
    }
 
-   const auto writeStream = [db, schema, table, rowID, this](const char* column, const MemoryStream& stream) {
+   if (!WriteStream(db, schema, table, "dict", rowID, dict))
+      return false;
+
+   if (!WriteStream(db, schema, table, "doc", rowID, data))
+      return false;
 
-      auto blobStream =
-         SQLiteBlobStream::Open(db, schema, table, column, rowID, false);
+   if (!WriteRequiredVersion())
+      return false;
 
-      if (!blobStream)
-      {
-         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(sqlite3_errcode(db)));
-         ADD_EXCEPTION_CONTEXT("sqlite3.col", column);
-         ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteDoc::openBlobStream");
+   return transaction.Commit();
+}
 
-         SetDBError(XO("Unable to bind to blob"));
-         return false;
-      }
+bool ProjectFileIO::WriteStream(sqlite3 *db, const char *schema,
+   const char *table, const char *column, int64_t rowID,
+   const MemoryStream &stream)
+{
+   auto blobStream =
+      SQLiteBlobStream::Open(db, schema, table, column, rowID, false);
 
-      for (auto chunk : stream)
-      {
-         if (SQLITE_OK != blobStream->Write(chunk.first, chunk.second))
-         {
-            ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(sqlite3_errcode(db)));
-            ADD_EXCEPTION_CONTEXT("sqlite3.col", column);
-            ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteDoc::writeBlobStream");
-            // The user visible message is not changed, so there is no need for new strings
-            SetDBError(XO("Unable to bind to blob"));
-            return false;
-         }
-      }
+   if (!blobStream)
+   {
+      ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(sqlite3_errcode(db)));
+      ADD_EXCEPTION_CONTEXT("sqlite3.col", column);
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteStream::openBlobStream");
 
-      if (blobStream->Close() != SQLITE_OK)
+      SetDBError(XO("Unable to bind to blob"));
+      return false;
+   }
+
+   for (auto chunk : stream)
+   {
+      if (SQLITE_OK != blobStream->Write(chunk.first, chunk.second))
       {
-         ADD_EXCEPTION_CONTEXT(
-            "sqlite3.rc", std::to_string(sqlite3_errcode(db)));
+         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(sqlite3_errcode(db)));
          ADD_EXCEPTION_CONTEXT("sqlite3.col", column);
-         ADD_EXCEPTION_CONTEXT(
-            "sqlite3.context", "ProjectGileIO::WriteDoc::writeBlobStream");
-         // The user visible message is not changed, so there is no need for new
-         // strings
+         ADD_EXCEPTION_CONTEXT("sqlite3.context", "ProjectGileIO::WriteStream::writeBlobStream");
+         // The user visible message is not changed, so there is no need for new strings
          SetDBError(XO("Unable to bind to blob"));
          return false;
       }
+   }
 
-      return true;
-   };
-
-   if (!writeStream("dict", dict))
+   if (blobStream->Close() != SQLITE_OK)
+   {
+      ADD_EXCEPTION_CONTEXT(
+         "sqlite3.rc", std::to_string(sqlite3_errcode(db)));
+      ADD_EXCEPTION_CONTEXT("sqlite3.col", column);
+      ADD_EXCEPTION_CONTEXT(
+         "sqlite3.context", "ProjectGileIO::WriteStream::writeBlobStream");
+      // The user visible message is not changed, so there is no need for new
+      // strings
+      SetDBError(XO("Unable to bind to blob"));
       return false;
+   }
 
-   if (!writeStream("doc", data))
-      return false;
+   return true;
+}
 
-   const auto requiredVersion =
+bool ProjectFileIO::WriteRequiredVersion()
+{
+   auto requiredVersion =
       ProjectFormatExtensionsRegistry::Get().GetRequiredVersion(mProject);
 
+   // Earlier versions must not open the file while there are deltas of the
+   // autosave document
+   int64_t deltaRowId = 0;
+   if (requiredVersion < AutoSaveDeltaFormatVersion &&
+       GetValue("SELECT id FROM main.autosavedelta LIMIT 1;", deltaRowId, true))
+      requiredVersion = AutoSaveDeltaFormatVersion;
+
    const wxString setVersionSql =
       wxString::Format("PRAGMA user_version = %u", requiredVersion.GetPacked());
 
@@ -1997,11 +2591,13 @@ bool ProjectFileIO::WriteDoc(const char *table,
       // DV: Very unlikely case.
       // Since we need to improve the error messages in the future, let's use
       // the generic message for now, so no new strings are needed
-      reportError(setVersionSql);
+      SetDBError(
+         XO("Failed to update the project file.\nThe following command failed:\n\n%s")
+            .Format(setVersionSql));
       return false;
    }
 
-   return transaction.Commit();
+   return true;
 }
 
 ProjectFileIO::
@@ -2078,11 +2674,41 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
       return {};
    else
    {
+      // Blocks made while decoding may fetch their metadata together
+      const auto pBlockFactory =
+         WaveTrackFactory::Get( mProject ).GetSampleBlockFactory();
+      pBlockFactory->BeginLoading();
+      auto endLoading = finally([&]{ pBlockFactory->EndLoading(); });
+
       // Load 'er up
-      BufferedProjectBlobStream stream(
-         DB(), "main", useAutosave ? "autosave" : "project", rowId);
+      // Deltas of another autosave document than the one stored, which
+      // perhaps an earlier version wrote, are ignored
+      int64_t deltaRowId = -1;
+      std::optional<int64_t> checksum;
+      if (useAutosave)
+         checksum = ReadAutoSaveChecksum(DB(), rowId);
+      char deltaSql[128];
+      if (checksum)
+         sqlite3_snprintf(sizeof(deltaSql), deltaSql,
+            "SELECT id FROM main.autosavedelta WHERE base = %lld"
+            " ORDER BY id DESC LIMIT 1;",
+            static_cast<sqlite3_int64>(*checksum));
+      std::optional<std::vector<char>> bytes;
+      if (checksum && GetValue(deltaSql, deltaRowId, true))
+      {
+         // Replay the autosave document with the sections that changed after
+         // it was written
+         auto pieces = ReadAutoSaveLayout(DB(), deltaRowId);
+         if (pieces)
+            bytes = ReadAutoSaveDocument(DB(), deltaRowId, rowId, *pieces);
+      }
+      else
+         bytes = ReadProjectDocument(
+            DB(), useAutosave ? "autosave" : "project", rowId);
 
-      success = ProjectSerializer::Decode(stream, this);
+      // The blobs are read once, into the buffer that is decoded
+      success = bytes &&
+         ProjectSerializer::Decode(bytes->data(), bytes->size(), this);
 
       if (!success)
       {
@@ -2094,9 +2720,7 @@ auto ProjectFileIO::LoadProject(const FilePath &fileName, bool ignoreAutosave)
 
       // Check for orphans blocks...sets mRecovered if any were deleted
       
-      auto blockids = WaveTrackFactory::Get( mProject )
-         .GetSampleBlockFactory()
-            ->GetActiveBlockIDs();
+      auto blockids = pBlockFactory->GetActiveBlockIDs();
       if (blockids.size() > 0)
       {
          success = DeleteBlocks(blockids, true);
@@ -2590,25 +3214,22 @@ int64_t ProjectFileIO::GetDiskUsage(DBConnection &conn, SampleBlockID blockid /*
 
    if (blockid == 0)
    {
+      // Count the blocks still queued for the writer, as DB() does.  (A
+      // single block's ID is known only after its row is written.)
+      conn.FlushWrites();
+
+      // The total is maintained by triggers, rather than summed over all
+      // blocks
       static const char* statement =
-R"(SELECT 
-	sum(length(blockid) + length(sampleformat) + 
-	length(summin) + length(summax) + length(sumrms) + 
-	length(summary256) + length(summary64k) +
-	length(samples))
-FROM sampleblocks;)";
+         "SELECT bytes FROM blockusage WHERE id = 1;";
 
       stmt = conn.Prepare(DBConnection::GetAllSampleBlocksSize, statement);
    }
    else
    {
       static const char* statement =
-R"(SELECT 
-	length(blockid) + length(sampleformat) + 
-	length(summin) + length(summax) + length(sumrms) + 
-	length(summary256) + length(summary64k) +
-	length(samples)
-FROM sampleblocks WHERE blockid = ?1;)";
+         "SELECT " BLOCK_SPACE_USAGE("")
+         "  FROM sampleblocks WHERE blockid = ?1;";
 
       stmt = conn.Prepare(DBConnection::GetSampleBlockSize, statement);
    }
@@ -30,6 +30,7 @@ struct sqlite3_value;
 class AudacityProject;
 class DBConnection;
 struct DBConnectionErrors;
+class MemoryStream;
 class ProjectSerializer;
 class SqliteSampleBlock;
 class TrackList;
@@ -272,6 +273,24 @@ private:
    // Write project or autosave XML (binary) documents
    bool WriteDoc(const char *table, const ProjectSerializer &autosave, const char *schema = "main");
 
+   struct AutoSaveState;
+
+   // Write the whole autosave document, and remove any deltas
+   bool WriteAutoSaveBase(
+      const ProjectSerializer &autosave, AutoSaveState &state);
+
+   // Write the sections of the autosave document that changed since the
+   // previous state, and the layout of the whole document
+   bool WriteAutoSaveDelta(const ProjectSerializer &autosave,
+      const AutoSaveState &previous, AutoSaveState &state);
+
+   // Write a stream into a blob, already of the right size
+   bool WriteStream(sqlite3 *db, const char *schema, const char *table,
+      const char *column, int64_t rowID, const MemoryStream &stream);
+
+   // Record the project format version that the documents require
+   bool WriteRequiredVersion();
+
    // Application defined function to verify blockid exists is in set of blockids
    static void InSet(sqlite3_context *context, int argc, sqlite3_value **argv);
 
@@ -298,6 +317,12 @@ private:
 
    bool ShouldCompact(const std::vector<const TrackList *> &tracks);
 
+   //! Delete unused blocks and release free pages, without copying the file
+   /*!
+    @pre GetConnection().CanReleaseFreePages()
+    */
+   bool CompactInPlace(const std::vector<const TrackList *> &tracks);
+
    // Gets values from SQLite B-tree structures
    static unsigned int get2(const unsigned char *ptr);
    static unsigned int get4(const unsigned char *ptr);
@@ -334,6 +359,9 @@ private:
    Connection mPrevConn;
    FilePath mPrevFileName;
    bool mPrevTemporary;
+
+   // What the autosave tables of the current connection hold, if known
+   std::unique_ptr<AutoSaveState> mpAutoSaveState;
 };
 
 //! Makes a temporary project that doesn't display on the screen
@@ -17,7 +17,11 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <mutex>
+#include <stdexcept>
+#include <type_traits>
 #include <wx/ustring.h>
 #include <codecvt>
 #include <locale>
@@ -36,8 +40,7 @@
 // It is not intended that the user view or modify the file.
 //
 // It IS intended that very little work be done during auto save, so numbers
-// and strings are written in their native format.  They will be converted
-// during recovery.
+// are written in their native format.
 //
 // The file has 3 main sections:
 //
@@ -45,6 +48,12 @@
 //    name dictionary   dictionary of all names used in the document
 //    data fields       the "encoded" XML document
 //
+// The character size is the version of the encoding of strings.  Documents
+// are now written in UTF-8, which every version of Audacity that reads this
+// format can decode, and which the decoder can pass to the tag handlers
+// without conversion or copying.  Older documents have the native size of
+// wxStringCharType, and their strings are converted while decoding.
+//
 // If a subtree is added, it will be preceded with FT_Push to tell the decoder
 // to preserve the active dictionary.  The decoder will then restore the
 // dictionary when an FT_Pop is encountered.  Nesting is unlimited.
@@ -52,8 +61,6 @@
 // To save space, each name (attribute or element) encountered is stored in
 // the name dictionary and replaced with the assigned 2-byte identifier.
 //
-// All strings are in native unicode format, 2-byte or 4-byte.
-//
 // All name "lengths" are 2-byte signed, so are limited to 32767 bytes long.
 // All string/data "lengths" are 4-byte signed.
 
@@ -128,6 +135,9 @@ bool IsLittleEndian()
 // static_assert( IsLittleEndian || (std::endian::native == std::endian::big),
 //    "Oh no!  I'm mixed-endian!" );
 
+// The character size of strings in documents written now
+constexpr char UTF8CharSize = 1;
+
 // Functions that can read and write native integer types to a canonicalized
 // little-endian file format.  (We don't bother to do the same for floating
 // point numbers.)
@@ -147,19 +157,55 @@ template <typename Number> void WriteBigEndian(MemoryStream& out, Number value)
    out.AppendData(&value, sizeof(value));
 }
 
+struct Error{}; // exception type for short-range try/catch
+
+//! Reads a document in contiguous memory, which may be mapped, in place
+class DocumentReader final
+{
+public:
+   DocumentReader(const void *data, size_t size) noexcept
+      : mCurrent{ static_cast<const char*>(data) }
+      , mEnd{ mCurrent + size }
+   {
+   }
+
+   bool Eof() const noexcept { return mCurrent == mEnd; }
+
+   //! @return pointer to the next count bytes, which remain valid as long as
+   //! the memory does
+   /*! @throw Error if fewer remain */
+   const char *Take(size_t count)
+   {
+      if (static_cast<size_t>(mEnd - mCurrent) < count)
+         throw Error{};
+      const auto result = mCurrent;
+      mCurrent += count;
+      return result;
+   }
+
+   //! Read a value of native byte order, which may be unaligned
+   template<typename Value> Value ReadValue()
+   {
+      Value result;
+      memcpy(&result, Take(sizeof(result)), sizeof(result));
+      return result;
+   }
+
+private:
+   const char *mCurrent;
+   const char *const mEnd;
+};
+
 // Read little-endian file format to native little-endian
-template <typename Number> Number ReadLittleEndian(BufferedStreamReader& in)
+template <typename Number> Number ReadLittleEndian(DocumentReader& in)
 {
-   Number result;
-   in.ReadValue(result);
-   return result;
+   return in.ReadValue<Number>();
 }
 
 // Read little-endian file format to native big-endian
-template <typename Number> Number ReadBigEndian(BufferedStreamReader& in)
+template <typename Number> Number ReadBigEndian(DocumentReader& in)
 {
-   Number result;
-   in.ReadValue(result);
+   auto result = in.ReadValue<Number>();
    auto begin = static_cast<unsigned char*>(static_cast<void*>(&result));
    std::reverse(begin, begin + sizeof(result));
    return result;
@@ -199,6 +245,42 @@ using Digits = Int; // Instead, just an unsigned char?
 static const auto WriteDigits = WriteInt;
 static const auto ReadDigits = ReadInt;
 
+// Write the length in bytes, then the UTF-8 encoding, of a string.  The
+// length is limited to the maximum of the signed type of its width.
+template <typename LengthType>
+void WriteUTF8(MemoryStream& out, const wxString& value,
+   void (*writeLength)(MemoryStream&, LengthType))
+{
+   constexpr size_t maxLength =
+      std::numeric_limits<std::make_signed_t<LengthType>>::max();
+   const auto begin = value.wx_str();
+   const auto end = begin + value.length();
+   const bool isAscii = std::all_of(begin, end,
+      [](wxStringCharType c)
+      { return static_cast<std::make_unsigned_t<wxStringCharType>>(c) < 0x80; });
+
+   if (!isAscii)
+   {
+      const auto utf8 = value.utf8_str();
+      wxASSERT(utf8.length() <= maxLength);
+      writeLength(out, static_cast<LengthType>(utf8.length()));
+      out.AppendData(utf8.data(), utf8.length());
+      return;
+   }
+
+   // Narrow the characters a chunk at a time, without allocation
+   wxASSERT(value.length() <= maxLength);
+   writeLength(out, static_cast<LengthType>(value.length()));
+   char chunk[256];
+   for (auto first = begin; first != end;)
+   {
+      const auto count = std::min<size_t>(end - first, sizeof(chunk));
+      std::copy(first, first + count, chunk);
+      out.AppendData(chunk, count);
+      first += count;
+   }
+}
+
 class XMLTagHandlerAdapter final
 {
 public:
@@ -227,6 +309,17 @@ public:
       mHandlers.pop_back();
    }
 
+   //! value must remain valid until the next start tag is emitted
+   void WriteAttr(const std::string_view& name, std::string_view value)
+   {
+      assert(mInTag);
+
+      if (!mInTag)
+         return;
+
+      mAttributes.emplace_back(name, XMLAttributeValueView(value));
+   }
+
    void WriteAttr(const std::string_view& name, std::string value)
    {
       assert(mInTag);
@@ -247,16 +340,22 @@ public:
       mAttributes.emplace_back(name, XMLAttributeValueView(value));
    }
 
-   void WriteData(std::string value)
+   void WriteData(std::string_view value)
    {
       if (mInTag)
          EmitStartTag();
 
       if (XMLTagHandler* const handler = mHandlers.back())
-         handler->HandleXMLContent(CacheString(std::move(value)));
+         handler->HandleXMLContent(value);
+   }
+
+   void WriteData(std::string value)
+   {
+      // Not cached; emitting a pending start tag would clear the cache
+      WriteData(std::string_view{ value });
    }
 
-   void WriteRaw(std::string)
+   void WriteRaw(std::string_view)
    {
       // This method is intentionally left empty.
       // The only data that is serialized by FT_Raw
@@ -337,8 +436,12 @@ std::string FastStringConvert(const void* bytes, int bytesCount)
 
    assert(bytesCount % charSize == 0);
 
-   const auto begin = static_cast<const BaseCharType*>(bytes);
-   const auto end = begin + bytesCount / charSize;
+   // The characters may be unaligned in the document
+   std::basic_string<BaseCharType> aligned(bytesCount / charSize, 0);
+   memcpy(aligned.data(), bytes, aligned.size() * charSize);
+
+   const auto begin = aligned.data();
+   const auto end = begin + aligned.size();
 
    const bool isAscii = std::all_of(
       begin, end,
@@ -348,8 +451,19 @@ std::string FastStringConvert(const void* bytes, int bytesCount)
    if (isAscii)
       return std::string(begin, end);
    
-   return std::wstring_convert<std::codecvt_utf8<BaseCharType>, BaseCharType>()
-      .to_bytes(begin, end);
+   // UTF-16 may have surrogate pairs, which codecvt_utf8 rejects
+   using Facet = std::conditional_t<std::is_same_v<BaseCharType, char16_t>,
+      std::codecvt_utf8_utf16<BaseCharType>,
+      std::codecvt_utf8<BaseCharType>>;
+   try
+   {
+      return std::wstring_convert<Facet, BaseCharType>().to_bytes(begin, end);
+   }
+   catch (const std::range_error&)
+   {
+      // Invalid characters
+      throw Error{};
+   }
 }
 } // namespace
 
@@ -359,9 +473,9 @@ ProjectSerializer::ProjectSerializer(size_t allocSize)
    std::call_once(flag, []{
       // Just once per run, store header information in the unique static
       // dictionary that will be written into each project that is saved.
-      // Store the size of "wxStringCharType" so we can convert during recovery
-      // in case the file is used on a system with a different character size.
-      char size = sizeof(wxStringCharType);
+      // Store the size of characters, so that documents of older versions,
+      // which stored the size of "wxStringCharType", can be converted
+      char size = UTF8CharSize;
       mDict.AppendByte(FT_CharSize);
       mDict.AppendData(&size, 1);
    });
@@ -375,6 +489,9 @@ ProjectSerializer::~ProjectSerializer()
 
 void ProjectSerializer::StartTag(const wxString & name)
 {
+   if (++mDepth <= SectionDepth)
+      mSectionBoundaries.push_back(mBuffer.GetSize());
+
    mBuffer.AppendByte(FT_StartTag);
    WriteName(name);
 }
@@ -383,6 +500,9 @@ void ProjectSerializer::EndTag(const wxString & name)
 {
    mBuffer.AppendByte(FT_EndTag);
    WriteName(name);
+
+   if (mDepth-- <= SectionDepth)
+      mSectionBoundaries.push_back(mBuffer.GetSize());
 }
 
 void ProjectSerializer::WriteAttr(const wxString & name, const wxChar *value)
@@ -395,9 +515,7 @@ void ProjectSerializer::WriteAttr(const wxString & name, const wxString & value)
    mBuffer.AppendByte(FT_String);
    WriteName(name);
 
-   const Length len = value.length() * sizeof(wxStringCharType);
-   WriteLength( mBuffer, len );
-   mBuffer.AppendData(value.wx_str(), len);
+   WriteUTF8( mBuffer, value, WriteLength );
 }
 
 void ProjectSerializer::WriteAttr(const wxString & name, int value)
@@ -462,22 +580,18 @@ void ProjectSerializer::WriteData(const wxString & value)
 {
    mBuffer.AppendByte(FT_Data);
 
-   Length len = value.length() * sizeof(wxStringCharType);
-   WriteLength( mBuffer, len );
-   mBuffer.AppendData(value.wx_str(), len);
+   WriteUTF8( mBuffer, value, WriteLength );
 }
 
 void ProjectSerializer::Write(const wxString & value)
 {
    mBuffer.AppendByte(FT_Raw);
-   Length len = value.length() * sizeof(wxStringCharType);
-   WriteLength( mBuffer, len );
-   mBuffer.AppendData(value.wx_str(), len);
+
+   WriteUTF8( mBuffer, value, WriteLength );
 }
 
 void ProjectSerializer::WriteName(const wxString & name)
 {
-   wxASSERT(name.length() * sizeof(wxStringCharType) <= SHRT_MAX);
    UShort id;
 
    auto nameiter = mNames.find(name);
@@ -489,15 +603,12 @@ void ProjectSerializer::WriteName(const wxString & name)
    {
       // mNames is static.  This appends each name to static mDict only once
       // in each run.
-      UShort len = name.length() * sizeof(wxStringCharType);
-
       id = mNames.size();
       mNames[name] = id;
 
       mDict.AppendByte(FT_Name);
       WriteUShort( mDict, id );
-      WriteUShort( mDict, len );
-      mDict.AppendData(name.wx_str(), len);
+      WriteUTF8( mDict, name, WriteUShort );
 
       mDictChanged = true;
    }
@@ -525,62 +636,87 @@ bool ProjectSerializer::DictChanged() const
    return mDictChanged;
 }
 
-// See ProjectFileIO::LoadProject() for explanation of the blockids arg
+const std::vector<size_t> &ProjectSerializer::GetSectionBoundaries() const
+{
+   return mSectionBoundaries;
+}
+
 bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
+{
+   // The decoder needs the document in one piece, so this copies it.  When
+   // the size is known, read into one buffer and decode that instead.
+   std::vector<char> bytes;
+   constexpr size_t ChunkSize = 64 * 1024;
+   size_t size = 0;
+   while (!in.Eof())
+   {
+      bytes.resize(size + ChunkSize);
+      const auto count = in.Read(bytes.data() + size, ChunkSize);
+      if (count == 0)
+         break;
+      size += count;
+   }
+
+   return Decode(bytes.data(), size, handler);
+}
+
+bool ProjectSerializer::Decode(
+   const void* data, size_t size, XMLTagHandler* handler)
 {
    if (handler == nullptr)
       return false;
 
    XMLTagHandlerAdapter adapter(handler);
-
-   std::vector<char> bytes;
-   IdMap mIds;
-   std::vector<IdMap> mIdStack;
+   DocumentReader in(data, size);
+
+   // Names, indexed by id; views of the document, or of mConverted for
+   // documents not in UTF-8
+   using Ids = std::vector<std::string_view>;
+   Ids mIds;
+   std::vector<Ids> mIdStack;
+   std::deque<std::string> mConverted;
    char mCharSize = 0;
 
-   mIds.clear();
-
-   struct Error{}; // exception type for short-range try/catch
    auto Lookup = [&mIds]( UShort id ) -> std::string_view
    {
-      auto iter = mIds.find( id );
-      if (iter == mIds.end())
+      if (id >= mIds.size() || mIds[id].data() == nullptr)
       {
          throw Error{};
       }
 
-      return iter->second;
+      return mIds[id];
    };
 
    int64_t stringsCount = 0;
    int64_t stringsLength = 0;
 
-   auto ReadString = [&mCharSize, &in, &bytes, &stringsCount, &stringsLength](int len) -> std::string
+   // Call emit with a std::string_view of the document if it is in UTF-8,
+   // else with a converted std::string
+   auto ReadString = [&mCharSize, &in, &stringsCount, &stringsLength](
+      int len, auto emit)
    {
-      bytes.reserve( len );
-      auto data = bytes.data();
-      in.Read( data, len );
+      if (len < 0)
+         throw Error{};
+      const auto bytes = in.Take( len );
 
       stringsCount++;
       stringsLength += len;
-      
+
       switch (mCharSize)
       {
-         case 1:
-            return std::string(bytes.data(), len);
+         case UTF8CharSize:
+            return emit(std::string_view(bytes, len));
 
          case 2:
-            return FastStringConvert<char16_t>(bytes.data(), len);
+            return emit(FastStringConvert<char16_t>(bytes, len));
 
          case 4:
-            return FastStringConvert<char32_t>(bytes.data(), len);
+            return emit(FastStringConvert<char32_t>(bytes, len));
 
          default:
-            wxASSERT_MSG(false, wxT("Characters size not 1, 2, or 4"));
-         break;
+            // The document is from an unknown future version, or corrupt
+            throw Error{};
       }
-
-      return {};
    };
 
    try
@@ -589,7 +725,7 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
       {
          UShort id;
 
-         switch (in.GetC())
+         switch (in.ReadValue<unsigned char>())
          {
             case FT_Push:
             {
@@ -600,6 +736,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Pop:
             {
+               if (mIdStack.empty())
+                  throw Error{};
                mIds = mIdStack.back();
                mIdStack.pop_back();
             }
@@ -609,7 +747,16 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
             {
                id = ReadUShort( in );
                auto len = ReadUShort( in );
-               mIds[id] = ReadString(len);
+               if (id >= mIds.size())
+                  mIds.resize(id + 1);
+               ReadString(len, [&](auto &&name)
+               {
+                  using Name = std::decay_t<decltype(name)>;
+                  if constexpr (std::is_same_v<Name, std::string_view>)
+                     mIds[id] = name;
+                  else
+                     mIds[id] = mConverted.emplace_back(std::move(name));
+               });
             }
             break;
 
@@ -633,17 +780,19 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
             {
                id = ReadUShort( in );
                int len = ReadLength( in );
-               
-               adapter.WriteAttr(Lookup(id), ReadString(len));
+               const auto name = Lookup(id);
+
+               ReadString(len, [&](auto &&value)
+               {
+                  adapter.WriteAttr(name, std::move(value));
+               });
             }
             break;
 
             case FT_Float:
             {
-               float val;
-
                id = ReadUShort( in );
-               in.Read(&val, sizeof(val));
+               auto val = in.ReadValue<float>();
                /* int dig = */ReadDigits(in);
 
                adapter.WriteAttr(Lookup(id), val);
@@ -652,10 +801,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Double:
             {
-               double val;
-
                id = ReadUShort( in );
-               in.Read(&val, sizeof(val));
+               auto val = in.ReadValue<double>();
                /*int dig = */ReadDigits(in);
 
                adapter.WriteAttr(Lookup(id), val);
@@ -673,10 +820,8 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
 
             case FT_Bool:
             {
-               unsigned char val;
-
                id = ReadUShort( in );
-               in.Read(&val, 1);
+               auto val = in.ReadValue<unsigned char>();
 
                adapter.WriteAttr(Lookup(id), val);
             }
@@ -711,20 +856,26 @@ bool ProjectSerializer::Decode(BufferedStreamReader& in, XMLTagHandler* handler)
             case FT_Data:
             {
                int len = ReadLength( in );
-               adapter.WriteData(ReadString(len));
+               ReadString(len, [&](auto &&value)
+               {
+                  adapter.WriteData(std::move(value));
+               });
             }
             break;
 
             case FT_Raw:
             {
                int len = ReadLength( in );
-               adapter.WriteRaw(ReadString(len));
+               ReadString(len, [&](auto &&value)
+               {
+                  adapter.WriteRaw(value);
+               });
             }
             break;
 
             case FT_CharSize:
             {
-               in.Read(&mCharSize, 1);
+               mCharSize = in.ReadValue<char>();
             }
             break;
 
@@ -18,6 +18,7 @@
 
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 #include "Identifier.h"
 
@@ -30,7 +31,6 @@ class BufferedStreamReader;
 ///
 
 using NameMap = std::unordered_map<wxString, unsigned short>;
-using IdMap = std::unordered_map<unsigned short, std::string>;
 
 // This class's overrides do NOT throw AudacityException.
 class PROJECT_FILE_IO_API ProjectSerializer final : public XMLWriter
@@ -65,14 +65,42 @@ public:
    bool IsEmpty() const;
    bool DictChanged() const;
 
-   // Returns empty string if decoding fails
+   //! Depth, counting the root element as 1, of the deepest elements whose
+   //! beginnings and ends are section boundaries
+   static constexpr int SectionDepth = 3;
+
+   //! Offsets into GetData(), in increasing order, at which elements no
+   //! deeper than SectionDepth begin or end
+   /*!
+    With a project document, the sections between boundaries are the
+    project's own attributes, each attachment and track, and each clip of a
+    track, so that a delta autosave can compare them separately
+    */
+   const std::vector<size_t> &GetSectionBoundaries() const;
+
+   //! Decode a dictionary and document from a stream
+   /*!
+    The stream is copied into one buffer first; prefer the other overload
+    when the whole document can be read into memory directly
+    @return whether decoding succeeded
+    */
    static bool Decode(BufferedStreamReader& in, XMLTagHandler* handler);
 
+   //! Decode a dictionary and document in contiguous memory, such as a
+   //! mapping of a file, without copying it
+   /*!
+    Strings of documents in UTF-8 reach the handler as views of the memory,
+    which must remain valid until this returns
+    @return whether decoding succeeded
+    */
+   static bool Decode(const void* data, size_t size, XMLTagHandler* handler);
+
 private:
    void WriteName(const wxString& name);
 
 private:
    MemoryStream mBuffer;
+   std::vector<size_t> mSectionBoundaries;
    bool mDictChanged;
 
    static NameMap mNames;
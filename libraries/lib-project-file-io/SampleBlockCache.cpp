@@ -0,0 +1,119 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SampleBlockCache.cpp
+
+**********************************************************************/
+#include "SampleBlockCache.h"
+
+IntSetting SampleBlockCacheSize{ L"/FileFormats/SampleBlockCacheSize", 256 };
+
+SampleBlockCache::SampleBlockCache(size_t budget)
+   : mShardBudget{ budget / NShards }
+{
+}
+
+auto SampleBlockCache::GetShard(SampleBlockID id) -> Shard &
+{
+   return mShards[std::hash<SampleBlockID>{}(id) % NShards];
+}
+
+auto SampleBlockCache::GetShard(SampleBlockID id) const -> const Shard &
+{
+   return mShards[std::hash<SampleBlockID>{}(id) % NShards];
+}
+
+BlockSampleView SampleBlockCache::Find(SampleBlockID id, Kind kind)
+{
+   if (!IsEnabled())
+      return {};
+   auto &shard = GetShard(id);
+   std::lock_guard<std::mutex> lock{ shard.mutex };
+   const auto iter = shard.index.find({ id, kind });
+   if (iter == shard.index.end()) {
+      mMisses.fetch_add(1, std::memory_order_relaxed);
+      return {};
+   }
+   mHits.fetch_add(1, std::memory_order_relaxed);
+   shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+   return iter->second->data;
+}
+
+bool SampleBlockCache::Contains(SampleBlockID id, Kind kind) const
+{
+   if (!IsEnabled())
+      return false;
+   auto &shard = GetShard(id);
+   std::lock_guard<std::mutex> lock{ shard.mutex };
+   return shard.index.count({ id, kind }) > 0;
+}
+
+void SampleBlockCache::Insert(
+   SampleBlockID id, Kind kind, BlockSampleView data)
+{
+   if (!data)
+      return;
+   const auto bytes = data->size() * sizeof(float);
+   if (bytes > mShardBudget)
+      return;
+
+   // Destroy evicted data after releasing the lock
+   std::list<Entry> evicted;
+
+   auto &shard = GetShard(id);
+   {
+      std::lock_guard<std::mutex> lock{ shard.mutex };
+      const Key key{ id, kind };
+      if (const auto iter = shard.index.find(key);
+          iter != shard.index.end()) {
+         shard.bytes -= iter->second->bytes;
+         evicted.splice(evicted.end(), shard.entries, iter->second);
+         shard.index.erase(iter);
+      }
+
+      while (!shard.entries.empty() && shard.bytes + bytes > mShardBudget) {
+         auto &last = shard.entries.back();
+         shard.bytes -= last.bytes;
+         shard.index.erase(last.key);
+         evicted.splice(evicted.end(), shard.entries, std::prev(shard.entries.end()));
+         mEvictions.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      shard.entries.push_front({ key, std::move(data), bytes });
+      shard.index.emplace(key, shard.entries.begin());
+      shard.bytes += bytes;
+   }
+}
+
+void SampleBlockCache::Erase(SampleBlockID id)
+{
+   if (!IsEnabled())
+      return;
+   std::list<Entry> erased;
+   auto &shard = GetShard(id);
+   std::lock_guard<std::mutex> lock{ shard.mutex };
+   for (auto kind : { Kind::Samples, Kind::Summary256, Kind::Summary64k }) {
+      if (const auto iter = shard.index.find({ id, kind });
+          iter != shard.index.end()) {
+         shard.bytes -= iter->second->bytes;
+         erased.splice(erased.end(), shard.entries, iter->second);
+         shard.index.erase(iter);
+      }
+   }
+}
+
+auto SampleBlockCache::GetStatistics() const -> Statistics
+{
+   size_t bytes = 0;
+   for (auto &shard : mShards) {
+      std::lock_guard<std::mutex> lock{ shard.mutex };
+      bytes += shard.bytes;
+   }
+   return {
+      mHits.load(std::memory_order_relaxed),
+      mMisses.load(std::memory_order_relaxed),
+      mEvictions.load(std::memory_order_relaxed),
+      bytes
+   };
+}
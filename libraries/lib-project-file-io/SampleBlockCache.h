@@ -0,0 +1,122 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SampleBlockCache.h
+  @brief Bounded cache of decoded sample block data, shared by all readers
+  of one project
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_BLOCK_CACHE__
+#define __AUDACITY_SAMPLE_BLOCK_CACHE__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "AudioSegmentSampleView.h"
+#include "Prefs.h"
+
+using SampleBlockID = long long;
+
+//! Megabytes of decoded samples and summaries that each project may cache
+//! in memory; 0 disables the cache
+extern PROJECT_FILE_IO_API IntSetting SampleBlockCacheSize;
+
+//! Least-recently-used cache of float data of committed sample blocks,
+//! keyed by block id, with a bound on total bytes
+/*!
+ Rows of the sampleblocks table are immutable and ids are never reused, so
+ entries need no invalidation, only eviction when the blocks are destroyed.
+
+ The cache is divided into shards, each with its own lock and an equal part
+ of the budget, so that concurrent readers of different blocks seldom
+ contend.  All kinds of data for one block are in the same shard.
+
+ Evicting an entry releases only the cache's reference; views handed out
+ earlier remain valid.
+ */
+class SampleBlockCache final
+{
+public:
+   enum class Kind : unsigned char {
+      Samples,
+      Summary256,
+      Summary64k,
+   };
+
+   //! Totals since construction, which may be slightly stale when read
+   struct Statistics {
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t evictions;
+      size_t bytes;
+   };
+
+   //! @param budget total bytes of cached floats; 0 disables the cache
+   explicit SampleBlockCache(size_t budget);
+   SampleBlockCache(const SampleBlockCache&) = delete;
+   SampleBlockCache &operator=(const SampleBlockCache&) = delete;
+
+   bool IsEnabled() const { return mShardBudget > 0; }
+
+   //! Look up data and mark it most recently used, counting a hit or miss
+   /*! @return null if absent */
+   BlockSampleView Find(SampleBlockID id, Kind kind);
+
+   //! Like Find, but not counted and not changing the recency
+   bool Contains(SampleBlockID id, Kind kind) const;
+
+   //! Insert or replace data, evicting least recently used entries of the
+   //! shard to stay within budget
+   /*! Data larger than a shard's budget are not cached */
+   void Insert(SampleBlockID id, Kind kind, BlockSampleView data);
+
+   //! Remove all kinds of data for the block
+   void Erase(SampleBlockID id);
+
+   Statistics GetStatistics() const;
+
+private:
+   using Key = std::pair<SampleBlockID, Kind>;
+   struct KeyHash {
+      size_t operator () (const Key &key) const
+      {
+         return std::hash<SampleBlockID>{}(key.first) * 3 +
+            static_cast<size_t>(key.second);
+      }
+   };
+   struct Entry {
+      Key key;
+      BlockSampleView data;
+      size_t bytes;
+   };
+
+   struct Shard {
+      mutable std::mutex mutex;
+      //! Most recently used at the front
+      std::list<Entry> entries;
+      std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+      size_t bytes{ 0 };
+   };
+
+   static constexpr size_t NShards = 16;
+   Shard &GetShard(SampleBlockID id);
+   const Shard &GetShard(SampleBlockID id) const;
+
+   std::array<Shard, NShards> mShards;
+   const size_t mShardBudget;
+
+   std::atomic<uint64_t> mHits{ 0 };
+   std::atomic<uint64_t> mMisses{ 0 };
+   std::atomic<uint64_t> mEvictions{ 0 };
+};
+
+#endif
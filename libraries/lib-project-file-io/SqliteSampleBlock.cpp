@@ -14,7 +14,9 @@ Paul Licameli -- split from SampleBlock.cpp and SampleBlock.h
 #include "BasicUI.h"
 #include "DBConnection.h"
 #include "ProjectFileIO.h"
+#include "SampleBlockCache.h"
 #include "SampleFormat.h"
+#include "SampleSummary.h"
 #include "AudioSegmentSampleView.h"
 #include "XMLTagHandler.h"
 
@@ -25,10 +27,29 @@ Paul Licameli -- split from SampleBlock.cpp and SampleBlock.h
 #include "SentryHelper.h"
 #include <wx/log.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <future>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 class SqliteSampleBlockFactory;
 
+// Columns of a row of sampleblocks that describe the block without its
+// contents.  The last is the same estimate of space usage that
+// ProjectFileIO::GetDiskUsage() computes, which costs little more here.
+#define SAMPLE_BLOCK_METADATA \
+   "sampleformat, summin, summax, sumrms," \
+   "       length(samples)," \
+   "       length(blockid) + length(sampleformat) +" \
+   "       length(summin) + length(summax) + length(sumrms) +" \
+   "       length(summary256) + length(summary64k) +" \
+   "       length(samples)"
+
 ///\brief Implementation of @ref SampleBlock using Sqlite database
 class SqliteSampleBlock final : public SampleBlock
 {
@@ -36,8 +57,10 @@ public:
    BlockSampleView GetFloatSampleView() override;
 
 private:
-   std::weak_ptr<std::vector<float>> mCache;
-   std::mutex mCacheMutex;
+   //! Still reachable after eviction from the factory's cache, while
+   //! any view is in use
+   std::weak_ptr<std::vector<float>> mSampleView;
+   std::mutex mSampleViewMutex;
 
 public:
    explicit SqliteSampleBlock(
@@ -61,6 +84,11 @@ public:
                        sampleFormat destformat,
                        size_t sampleoffset,
                        size_t numsamples) override;
+   //! Like DoGetSamples, but bypassing the cache
+   size_t ReadSamples(samplePtr dest,
+                      sampleFormat destformat,
+                      size_t sampleoffset,
+                      size_t numsamples);
    sampleFormat GetSampleFormat() const;
    size_t GetSampleCount() const override;
 
@@ -76,20 +104,56 @@ public:
    /// Gets extreme values for the entire block
    MinMaxRMS DoGetMinMaxRMS() const override;
 
+   using SampleBlock::DoGetSum;
+   /// Gets the sum of all samples, reading them only on the first call
+   double DoGetSum() override;
+
    size_t GetSpaceUsage() const override;
    void SaveXML(XMLWriter &xmlFile) override;
 
 private:
-   bool IsSilent() const { return mBlockID <= 0; }
+   bool IsSilent() const
+   {
+      return !mPending.load(std::memory_order_acquire) && mBlockID <= 0;
+   }
+   //! Wait for the writer thread to assign mBlockID, if it has not yet
+   /*! @throw the exception from a failed insertion */
+   void WaitCommitted() const;
+
+   //! The fields of SAMPLE_BLOCK_METADATA
+   struct Metadata {
+      sampleFormat format;
+      double sumMin;
+      double sumMax;
+      double sumRms;
+      size_t sampleBytes;
+      int64_t spaceUsage;
+   };
+   //! Read SAMPLE_BLOCK_METADATA from a statement, starting at a column
+   static Metadata ReadMetadata(sqlite3_stmt *stmt, int column);
+   void SetMetadata(SampleBlockID sbid, const Metadata &metadata);
+
    void Load(SampleBlockID sbid);
    bool GetSummary(float *dest,
                    size_t frameoffset,
                    size_t numframes,
-                   DBConnection::StatementID id,
-                   const char *sql);
+                   const char *column,
+                   SampleBlockCache::Kind kind,
+                   size_t totalframes);
+   SampleBlockCache *Cache() const;
+   //! Read a range of the given column of this block's row, padding with
+   //! zeroes
    size_t GetBlob(void *dest,
                   sampleFormat destformat,
-                  sqlite3_stmt *stmt,
+                  const char *column,
+                  sampleFormat srcformat,
+                  size_t srcoffset,
+                  size_t srcbytes);
+   //! Copy from a blob already in memory, padding with zeroes
+   static size_t CopyBlob(void *dest,
+                  sampleFormat destformat,
+                  const void *blob,
+                  size_t blobbytes,
                   sampleFormat srcformat,
                   size_t srcoffset,
                   size_t srcbytes);
@@ -101,6 +165,23 @@ private:
    Sizes SetSizes( size_t numsamples, sampleFormat srcformat );
    void CalcSummary(Sizes sizes);
 
+   //! Contents of a row to insert, owned by the queued insertion
+   struct PendingRow {
+      sampleFormat format;
+      double sumMin;
+      double sumMax;
+      double sumRms;
+      ArrayOf<char> summary256;
+      size_t summary256Bytes;
+      ArrayOf<char> summary64k;
+      size_t summary64kBytes;
+      ArrayOf<char> samples;
+      size_t sampleBytes;
+      std::promise<SampleBlockID> id;
+   };
+   //! Called on the connection's writer thread
+   static SampleBlockID InsertRow(DBConnection &conn, const PendingRow &row);
+
 private:
    //! This must never be called for silent blocks
    /*! @post return value is not null */
@@ -116,7 +197,12 @@ private:
    bool mValid{ false };
    bool mLocked = false;
 
-   SampleBlockID mBlockID{ 0 };
+   //! Assigned by Load(), or else when the queued insertion completes
+   mutable SampleBlockID mBlockID{ 0 };
+   //! Whether the insertion of the row is queued and mBlockID not yet known
+   mutable std::atomic<bool> mPending{ false };
+   mutable std::shared_future<SampleBlockID> mPendingID;
+   mutable std::mutex mPendingMutex;
 
    ArrayOf<char> mSamples;
    size_t mSampleBytes;
@@ -129,6 +215,16 @@ private:
    double mSumMax;
    double mSumRms;
 
+   //! Sum of all samples, for the mean; not stored in the database, so
+   //! computed with the summaries of a new block, or on demand
+   std::atomic<double> mSum{ 0.0 };
+   std::atomic<bool> mSumKnown{ false };
+
+   //! Estimate of the space that the row takes, as
+   //! ProjectFileIO::GetDiskUsage() computes it, or -1 until known; rows are
+   //! immutable, so it is queried at most once
+   mutable std::atomic<int64_t> mSpaceUsage{ -1 };
+
 #if defined(WORDS_BIGENDIAN)
 #error All sample block data is little endian...big endian not yet supported
 #endif
@@ -164,7 +260,38 @@ public:
       sampleFormat srcformat,
       const AttributesList &attrs) override;
 
+   bool DoGetSamples(const BlockReads &reads, sampleFormat destformat)
+      override;
+
+   void Prefetch(const SampleBlockPtr &pBlock) override;
+
+   void BeginLoading() override;
+   void EndLoading() override;
+
 private:
+   using MetadataMap =
+      std::unordered_map<SampleBlockID, SqliteSampleBlock::Metadata>;
+   //! Metadata of all blocks, fetched in one statement on a read-only
+   //! connection of its own to the file
+   static MetadataMap LoadAllMetadata(const std::string &fileName);
+   //! Wait for the fetch that BeginLoading() started, if any
+   /*! @return null if there was none, or the block is not found */
+   const SqliteSampleBlock::Metadata *FindMetadata(SampleBlockID sbid);
+
+   //! Fetch the samples of committed blocks with consecutive ids, in one
+   //! statement
+   /*! @pre `first < last`, all point to SqliteSampleBlock, and ids increase
+    by one */
+   bool GetSamplesRange(BlockReads::const_iterator first,
+      BlockReads::const_iterator last, sampleFormat destformat);
+
+   //! Move mNewBlocks into mAllBlocks, waiting for their insertions
+   void RegisterNewBlocks();
+
+   void PrefetchLoop();
+   //! Read the samples of a committed block into the cache
+   void PrefetchSamples(SampleBlockID sbid);
+
    void OnBeginPurge(size_t begin, size_t end);
    void OnEndPurge();
 
@@ -182,11 +309,34 @@ private:
    using AllBlocksMap =
       std::map< SampleBlockID, std::weak_ptr< SqliteSampleBlock > >;
    AllBlocksMap mAllBlocks;
+
+   //! Created blocks not yet in mAllBlocks, because their ids may still be
+   //! unknown
+   std::vector<std::weak_ptr<SqliteSampleBlock>> mNewBlocks;
+   std::mutex mNewBlocksMutex;
+
+   //! Between BeginLoading() and the first block needing it
+   std::future<MetadataMap> mPendingMetadata;
+   //! Between then and EndLoading()
+   MetadataMap mMetadata;
+
+   SampleBlockCache mCache;
+
+   //! Ids of blocks to prefetch; zero marks a free slot
+   /*! Prefetch() fills slots without locking or allocating, because the
+    audio thread calls it, and the prefetch thread needs no block object,
+    whose last reference it might otherwise release */
+   std::array<std::atomic<SampleBlockID>, 32> mPrefetchRequests;
+   std::mutex mPrefetchMutex;
+   std::condition_variable mPrefetchAvailable;
+   bool mStopPrefetching{ false };
+   std::thread mPrefetchThread;
 };
 
 SqliteSampleBlockFactory::SqliteSampleBlockFactory( AudacityProject &project )
    : mProject{ project }
    , mppConnection{ ConnectionPtr::Get(project).shared_from_this() }
+   , mCache{ static_cast<size_t>(std::max(0, SampleBlockCacheSize.Read())) << 20 }
 {
    mUndoSubscription = UndoManager::Get(project)
       .Subscribe([this](UndoRedoMessage message){
@@ -199,22 +349,73 @@ SqliteSampleBlockFactory::SqliteSampleBlockFactory( AudacityProject &project )
             return;
          }
       });
+
+   for (auto &request : mPrefetchRequests)
+      request.store(0);
+   if (mCache.IsEnabled())
+      mPrefetchThread = std::thread{ [this]{ PrefetchLoop(); } };
 }
 
-SqliteSampleBlockFactory::~SqliteSampleBlockFactory() = default;
+SqliteSampleBlockFactory::~SqliteSampleBlockFactory()
+{
+   if (mPrefetchThread.joinable()) {
+      // Pending requests are abandoned
+      {
+         std::lock_guard<std::mutex> lock{ mPrefetchMutex };
+         mStopPrefetching = true;
+      }
+      mPrefetchAvailable.notify_one();
+      mPrefetchThread.join();
+   }
+
+   if (mCache.IsEnabled()) {
+      const auto stats = mCache.GetStatistics();
+      wxLogDebug(wxT("Sample block cache: %llu hits, %llu misses, %llu evictions"),
+         static_cast<unsigned long long>(stats.hits),
+         static_cast<unsigned long long>(stats.misses),
+         static_cast<unsigned long long>(stats.evictions));
+   }
+}
 
 SampleBlockPtr SqliteSampleBlockFactory::DoCreate(
    constSamplePtr src, size_t numsamples, sampleFormat srcformat )
 {
    auto sb = std::make_shared<SqliteSampleBlock>(shared_from_this());
    sb->SetSamples(src, numsamples, srcformat);
-   // block id has now been assigned
-   mAllBlocks[ sb->GetBlockID() ] = sb;
+   // The block id is assigned later, when the writer thread inserts the
+   // row; don't wait for it here, which may be the recording thread
+   {
+      std::lock_guard<std::mutex> lock{ mNewBlocksMutex };
+      mNewBlocks.push_back(sb);
+   }
    return sb;
 }
 
+void SqliteSampleBlockFactory::RegisterNewBlocks()
+{
+   std::vector<std::weak_ptr<SqliteSampleBlock>> blocks;
+   {
+      std::lock_guard<std::mutex> lock{ mNewBlocksMutex };
+      blocks.swap(mNewBlocks);
+   }
+   for (auto &wBlock : blocks) {
+      if (auto pBlock = wBlock.lock()) {
+         SampleBlockID id;
+         try {
+            id = pBlock->GetBlockID();
+         }
+         catch (...) {
+            // No row was inserted, and the producer of the block was told
+            continue;
+         }
+         mAllBlocks[id] = pBlock;
+      }
+   }
+}
+
 auto SqliteSampleBlockFactory::GetActiveBlockIDs() -> SampleBlockIDs
 {
+   RegisterNewBlocks();
    SampleBlockIDs result;
    for (auto end = mAllBlocks.end(), it = mAllBlocks.begin(); it != end;) {
       if (it->second.expired())
@@ -251,6 +452,9 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreateFromXML(
 {
    std::shared_ptr<SampleBlock> sb;
 
+   // The document may mention blocks created since the last call
+   RegisterNewBlocks();
+
    int found = 0;
 
    // loop through attrs, which is a null-terminated list of attribute-value pairs
@@ -280,9 +484,12 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreateFromXML(
                wb = ssb;
                sb = ssb;
                ssb->mSampleFormat = srcformat;
-               // This may throw database errors
-               // It initializes the rest of the fields
-               ssb->Load((SampleBlockID) nValue);
+               if (auto pMetadata = FindMetadata(nValue))
+                  ssb->SetMetadata(nValue, *pMetadata);
+               else
+                  // This may throw database errors
+                  // It initializes the rest of the fields
+                  ssb->Load((SampleBlockID) nValue);
             }
          }
          found++;
@@ -298,29 +505,344 @@ SampleBlockPtr SqliteSampleBlockFactory::DoCreateFromXML(
    return sb;
 }
 
+void SqliteSampleBlockFactory::BeginLoading()
+{
+   // Opening a project makes a block for each of its rows.  Fetch all the
+   // rows' metadata in one scan, instead of one lookup per block, while the
+   // document is decoded.  Steps of statements on the project's connection
+   // would take turns with those of the decoder and the writer thread, so
+   // the scan opens another.
+   if (mPendingMetadata.valid() || !mppConnection->mpConnection)
+      return;
+   const auto fileName =
+      sqlite3_db_filename(mppConnection->mpConnection->DB(), "main");
+   // An in-memory or temporary database has no name
+   if (!fileName || !*fileName)
+      return;
+   mPendingMetadata = std::async(std::launch::async,
+      [fileName = std::string{ fileName }]{
+         return LoadAllMetadata(fileName);
+      });
+}
+
+void SqliteSampleBlockFactory::EndLoading()
+{
+   // Don't leave the fetch running; and rows may change from now on
+   if (mPendingMetadata.valid())
+      mPendingMetadata.wait();
+   mPendingMetadata = {};
+   MetadataMap{}.swap(mMetadata);
+}
+
+auto SqliteSampleBlockFactory::FindMetadata(SampleBlockID sbid)
+   -> const SqliteSampleBlock::Metadata *
+{
+   if (mPendingMetadata.valid())
+      mMetadata = mPendingMetadata.get();
+   const auto iter = mMetadata.find(sbid);
+   return iter == mMetadata.end() ? nullptr : &iter->second;
+}
+
+auto SqliteSampleBlockFactory::LoadAllMetadata(const std::string &fileName)
+   -> MetadataMap
+{
+   MetadataMap result;
+
+   // Not a cached statement; it runs once, on a thread and a connection of
+   // its own
+   sqlite3 *db = nullptr;
+   sqlite3_stmt *stmt = nullptr;
+   auto cleanup = finally([&]{
+      sqlite3_finalize(stmt);
+      sqlite3_close(db);
+   });
+   if (sqlite3_open_v2(fileName.c_str(), &db,
+         SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK ||
+       sqlite3_busy_timeout(db, 5000) != SQLITE_OK ||
+       sqlite3_prepare_v2(db,
+         "SELECT blockid, " SAMPLE_BLOCK_METADATA " FROM sampleblocks;",
+         -1, &stmt, nullptr) != SQLITE_OK)
+      // Blocks will be loaded singly, and errors reported then
+      return {};
+
+   int rc;
+   while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+      result.emplace(sqlite3_column_int64(stmt, 0),
+         SqliteSampleBlock::ReadMetadata(stmt, 1));
+
+   if (rc != SQLITE_DONE)
+   {
+      wxLogDebug(wxT("SqliteSampleBlockFactory::LoadAllMetadata - SQLITE error %s"),
+         sqlite3_errmsg(db));
+      return {};
+   }
+
+   return result;
+}
+
+//! Copy part of a view, padding with zeroes beyond its end
+static void CopyFromView(const std::vector<float> &view,
+   size_t offset, size_t count, float *dest)
+{
+   const auto available =
+      offset < view.size() ? std::min(count, view.size() - offset) : 0;
+   std::copy_n(view.data() + offset, available, dest);
+   std::fill_n(dest + available, count - available, 0.0f);
+}
+
+bool SqliteSampleBlockFactory::DoGetSamples(
+   const BlockReads &reads, sampleFormat destformat)
+{
+   // Committed blocks written in succession have consecutive ids, so a
+   // sequence that was recorded, imported or processed usually consists of
+   // long runs of them.  Fetch each run with one statement.
+   // Blocks already in the cache are read singly, from the cache.
+   const bool cached = destformat == floatSample && mCache.IsEnabled();
+   const auto committed = [this, cached](const BlockRead &read)
+      -> const SqliteSampleBlock * {
+      auto pBlock = dynamic_cast<const SqliteSampleBlock*>(read.pBlock);
+      if (pBlock && pBlock->mpFactory.get() == this && !pBlock->IsSilent() &&
+          !(cached && mCache.Contains(
+             pBlock->GetBlockID(), SampleBlockCache::Kind::Samples)))
+         return pBlock;
+      return nullptr;
+   };
+
+   bool result = true;
+   for (auto first = reads.begin(), end = reads.end(); first != end;) {
+      auto last = first + 1;
+      if (auto pBlock = committed(*first)) {
+         for (auto id = pBlock->GetBlockID(); last != end; ++last) {
+            const auto pNext = committed(*last);
+            if (!pNext || pNext->GetBlockID() != ++id)
+               break;
+         }
+      }
+      if (last - first > 1) {
+         if (!GetSamplesRange(first, last, destformat))
+            result = false;
+      }
+      else if (first->pBlock->GetSamples(first->dest, destformat,
+         first->sampleoffset, first->numsamples) != first->numsamples)
+         result = false;
+      first = last;
+   }
+   return result;
+}
+
+bool SqliteSampleBlockFactory::GetSamplesRange(
+   BlockReads::const_iterator first, BlockReads::const_iterator last,
+   sampleFormat destformat)
+{
+   const auto &front = static_cast<SqliteSampleBlock&>(*first->pBlock);
+   const auto &back = static_cast<SqliteSampleBlock&>(*(last - 1)->pBlock);
+   auto conn = front.Conn();
+   auto db = conn->DB();
+
+   // Other fields, such as the sample format, are needed to interpret blobs
+   for (auto iter = first; iter != last; ++iter) {
+      auto &block = static_cast<SqliteSampleBlock&>(*iter->pBlock);
+      if (!block.mValid)
+         block.Load(block.mBlockID);
+   }
+
+   // Prepare and cache statement...automatically finalized at DB close
+   sqlite3_stmt *stmt = conn->Prepare(DBConnection::GetSamplesRange,
+      "SELECT blockid, samples FROM sampleblocks"
+      "  WHERE blockid BETWEEN ?1 AND ?2 ORDER BY blockid;");
+
+   // Clear statement bindings and rewind statement, even if throwing
+   auto cleanup = finally([&]{
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   });
+
+   // Bind statement parameters
+   // Might return SQLITE_MISUSE which means it's our mistake that we violated
+   // preconditions; should return SQL_OK which is 0
+   if (sqlite3_bind_int64(stmt, 1, front.GetBlockID()) ||
+       sqlite3_bind_int64(stmt, 2, back.GetBlockID()))
+   {
+      ADD_EXCEPTION_CONTEXT(
+         "sqlite3.rc", std::to_string(sqlite3_errcode(db)));
+      ADD_EXCEPTION_CONTEXT("sqlite3.context",
+         "SqliteSampleBlockFactory::GetSamplesRange::bind");
+
+      wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
+   }
+
+   // Whether to decode whole rows into the cache, and copy out of that
+   const bool cached = destformat == floatSample && mCache.IsEnabled();
+
+   bool result = true;
+   for (auto iter = first; iter != last; ++iter) {
+      auto &block = static_cast<SqliteSampleBlock&>(*iter->pBlock);
+
+      // Execute the statement for the next row, which must be present
+      auto rc = sqlite3_step(stmt);
+      if (rc != SQLITE_ROW ||
+          sqlite3_column_int64(stmt, 0) != block.GetBlockID())
+      {
+         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+         ADD_EXCEPTION_CONTEXT("sqlite3.context",
+            "SqliteSampleBlockFactory::GetSamplesRange::step");
+
+         wxLogDebug(wxT("SqliteSampleBlockFactory::GetSamplesRange - SQLITE error %s"),
+            sqlite3_errmsg(db));
+
+         // Just showing the user a simple message, not the library error too
+         // which isn't internationalized
+         conn->ThrowException( false );
+      }
+
+      // Retrieve returned data
+      if (cached) {
+         const auto view =
+            std::make_shared<std::vector<float>>(block.mSampleCount);
+         SqliteSampleBlock::CopyBlob(view->data(),
+            floatSample,
+            sqlite3_column_blob(stmt, 1),
+            (size_t) sqlite3_column_bytes(stmt, 1),
+            block.mSampleFormat,
+            0,
+            block.mSampleCount * SAMPLE_SIZE(block.mSampleFormat));
+         CopyFromView(*view, iter->sampleoffset, iter->numsamples,
+            reinterpret_cast<float*>(iter->dest));
+         mCache.Insert(block.GetBlockID(), SampleBlockCache::Kind::Samples, view);
+         continue;
+      }
+      const auto sampleSize = SAMPLE_SIZE(block.mSampleFormat);
+      const auto copied = SqliteSampleBlock::CopyBlob(iter->dest,
+         destformat,
+         sqlite3_column_blob(stmt, 1),
+         (size_t) sqlite3_column_bytes(stmt, 1),
+         block.mSampleFormat,
+         iter->sampleoffset * sampleSize,
+         iter->numsamples * sampleSize) / sampleSize;
+      if (copied != iter->numsamples)
+         result = false;
+   }
+
+   return result;
+}
+
+void SqliteSampleBlockFactory::Prefetch(const SampleBlockPtr &pBlock)
+{
+   if (!mPrefetchThread.joinable())
+      return;
+   const auto pSqliteBlock = dynamic_cast<SqliteSampleBlock*>(pBlock.get());
+   if (!pSqliteBlock || pSqliteBlock->mpFactory.get() != this ||
+       // Don't wait for a new block to be written
+       pSqliteBlock->mPending.load(std::memory_order_acquire) ||
+       pSqliteBlock->IsSilent())
+      return;
+
+   const auto sbid = pSqliteBlock->mBlockID;
+   const auto end = mPrefetchRequests.end();
+   if (std::any_of(mPrefetchRequests.begin(), end,
+      [sbid](const auto &request){ return request.load() == sbid; }))
+      return;
+   for (auto &request : mPrefetchRequests) {
+      SampleBlockID expected = 0;
+      if (request.compare_exchange_strong(expected, sbid)) {
+         // Without the mutex, the prefetch thread may miss this, but it
+         // also polls
+         mPrefetchAvailable.notify_one();
+         return;
+      }
+   }
+   // All slots are taken:  it's only a hint
+}
+
+void SqliteSampleBlockFactory::PrefetchLoop()
+{
+   std::unique_lock<std::mutex> lock{ mPrefetchMutex };
+   while (!mStopPrefetching) {
+      bool found = false;
+      for (auto &request : mPrefetchRequests) {
+         if (const auto sbid = request.exchange(0)) {
+            found = true;
+            lock.unlock();
+            try {
+               PrefetchSamples(sbid);
+            }
+            catch (...) {
+               // Errors are reported later, if the samples are really read
+            }
+            lock.lock();
+            if (mStopPrefetching)
+               return;
+         }
+      }
+      if (!found)
+         mPrefetchAvailable.wait_for(lock, std::chrono::milliseconds{ 50 });
+   }
+}
+
+void SqliteSampleBlockFactory::PrefetchSamples(SampleBlockID sbid)
+{
+   if (mCache.Contains(sbid, SampleBlockCache::Kind::Samples))
+      return;
+
+   const auto &pConnection = mppConnection->mpConnection;
+   if (!pConnection)
+      return;
+
+   // Prepare and cache statement...automatically finalized at DB close
+   sqlite3_stmt *stmt = pConnection->Prepare(DBConnection::PrefetchSamples,
+      "SELECT sampleformat, samples FROM sampleblocks WHERE blockid = ?1;");
+   if (!stmt)
+      return;
+
+   // Clear statement bindings and rewind statement
+   auto cleanup = finally([&]{
+      sqlite3_clear_bindings(stmt);
+      sqlite3_reset(stmt);
+   });
+
+   // The row may be gone, if the block was deleted after the request
+   if (sqlite3_bind_int64(stmt, 1, sbid) != SQLITE_OK ||
+       sqlite3_step(stmt) != SQLITE_ROW)
+      return;
+
+   const auto srcformat = static_cast<sampleFormat>(
+      sqlite3_column_int(stmt, 0));
+   const auto srcbytes = static_cast<size_t>(sqlite3_column_bytes(stmt, 1));
+   const auto view = std::make_shared<std::vector<float>>(
+      srcbytes / SAMPLE_SIZE(srcformat));
+   SqliteSampleBlock::CopyBlob(view->data(), floatSample,
+      sqlite3_column_blob(stmt, 1), srcbytes, srcformat, 0, srcbytes);
+   mCache.Insert(sbid, SampleBlockCache::Kind::Samples, view);
+}
+
 BlockSampleView SqliteSampleBlock::GetFloatSampleView()
 {
    assert(mSampleCount > 0);
 
+   const auto pCache = Cache();
+   if (pCache)
+      if (auto view = pCache->Find(GetBlockID(), SampleBlockCache::Kind::Samples))
+         return view;
+
    // Double-checked locking.
    // `weak_ptr::lock()` guarantees atomicity, which is important to make this
    // work without races.
-   auto cache = mCache.lock();
-   if (cache)
-      return cache;
-   std::lock_guard<std::mutex> lock(mCacheMutex);
-   cache = mCache.lock();
-   if (cache)
-      return cache;
-
-   const auto newCache =
-      std::make_shared<std::vector<float>>(mSampleCount);
-   const auto cachedSize = DoGetSamples(
-      reinterpret_cast<samplePtr>(newCache->data()), floatSample, 0,
-      mSampleCount);
-   assert(cachedSize == mSampleCount);
-   mCache = newCache;
-   return newCache;
+   auto view = mSampleView.lock();
+   if (!view) {
+      std::lock_guard<std::mutex> lock(mSampleViewMutex);
+      view = mSampleView.lock();
+      if (!view) {
+         view = std::make_shared<std::vector<float>>(mSampleCount);
+         const auto cachedSize = ReadSamples(
+            reinterpret_cast<samplePtr>(view->data()), floatSample, 0,
+            mSampleCount);
+         assert(cachedSize == mSampleCount);
+         mSampleView = view;
+      }
+   }
+   if (pCache)
+      pCache->Insert(GetBlockID(), SampleBlockCache::Kind::Samples, view);
+   return view;
 }
 
 SqliteSampleBlock::SqliteSampleBlock(
@@ -350,6 +872,17 @@ SqliteSampleBlock::~SqliteSampleBlock()
       return;
    }
 
+   try {
+      WaitCommitted();
+   }
+   catch (...) {
+      // No row was inserted, and the producer of the block was told
+      return;
+   }
+
+   // The id is never reused, so the data could not be found again
+   mpFactory->mCache.Erase(mBlockID);
+
    // See ProjectFileIO::Bypass() for a description of mIO.mBypass
    GuardedCall( [this]{
       if (!mLocked && !Conn()->ShouldBypass())
@@ -387,8 +920,16 @@ void SqliteSampleBlock::CloseLock() noexcept
    mLocked = true;
 }
 
+SampleBlockCache *SqliteSampleBlock::Cache() const
+{
+   if (IsSilent() || !mpFactory->mCache.IsEnabled())
+      return nullptr;
+   return &mpFactory->mCache;
+}
+
 SampleBlockID SqliteSampleBlock::GetBlockID() const
 {
+   WaitCommitted();
    return mBlockID;
 }
 
@@ -406,6 +947,22 @@ size_t SqliteSampleBlock::DoGetSamples(samplePtr dest,
                                      sampleFormat destformat,
                                      size_t sampleoffset,
                                      size_t numsamples)
+{
+   if (destformat == floatSample && Cache()) {
+      // Read the whole block into the cache, so that later reads of any part
+      // of it are served from memory
+      CopyFromView(*GetFloatSampleView(), sampleoffset, numsamples,
+         reinterpret_cast<float*>(dest));
+      return numsamples;
+   }
+
+   return ReadSamples(dest, destformat, sampleoffset, numsamples);
+}
+
+size_t SqliteSampleBlock::ReadSamples(samplePtr dest,
+                                      sampleFormat destformat,
+                                      size_t sampleoffset,
+                                      size_t numsamples)
 {
    if (IsSilent()) {
       auto size = SAMPLE_SIZE(destformat);
@@ -413,13 +970,9 @@ size_t SqliteSampleBlock::DoGetSamples(samplePtr dest,
       return numsamples;
    }
 
-   // Prepare and cache statement...automatically finalized at DB close
-   sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::GetSamples,
-      "SELECT samples FROM sampleblocks WHERE blockid = ?1;");
-
    return GetBlob(dest,
                   destformat,
-                  stmt,
+                  "samples",
                   mSampleFormat,
                   sampleoffset * SAMPLE_SIZE(mSampleFormat),
                   numsamples * SAMPLE_SIZE(mSampleFormat)) / SAMPLE_SIZE(mSampleFormat);
@@ -442,36 +995,54 @@ bool SqliteSampleBlock::GetSummary256(float *dest,
                                       size_t frameoffset,
                                       size_t numframes)
 {
-   return GetSummary(dest, frameoffset, numframes, DBConnection::GetSummary256,
-      "SELECT summary256 FROM sampleblocks WHERE blockid = ?1;");
+   const auto frames64k = (mSampleCount + 65535) / 65536;
+   return GetSummary(dest, frameoffset, numframes, "summary256",
+      SampleBlockCache::Kind::Summary256, frames64k * 256);
 }
 
 bool SqliteSampleBlock::GetSummary64k(float *dest,
                                       size_t frameoffset,
                                       size_t numframes)
 {
-   return GetSummary(dest, frameoffset, numframes, DBConnection::GetSummary64k,
-      "SELECT summary64k FROM sampleblocks WHERE blockid = ?1;");
+   const auto frames64k = (mSampleCount + 65535) / 65536;
+   return GetSummary(dest, frameoffset, numframes, "summary64k",
+      SampleBlockCache::Kind::Summary64k, frames64k);
 }
 
 bool SqliteSampleBlock::GetSummary(float *dest,
                                    size_t frameoffset,
                                    size_t numframes,
-                                   DBConnection::StatementID id,
-                                   const char *sql)
+                                   const char *column,
+                                   SampleBlockCache::Kind kind,
+                                   size_t totalframes)
 {
    // Non-throwing, it returns true for success
    bool silent = IsSilent();
    if (!silent) {
       // Not a silent block
       try {
-         // Prepare and cache statement...automatically finalized at DB close
-         auto stmt = Conn()->Prepare(id, sql);
+         if (const auto pCache = Cache()) {
+            auto summary = pCache->Find(GetBlockID(), kind);
+            if (!summary) {
+               summary = std::make_shared<std::vector<float>>(
+                  totalframes * fields);
+               GetBlob(summary->data(),
+                       floatSample,
+                       column,
+                       floatSample,
+                       0,
+                       summary->size() * SAMPLE_SIZE(floatSample));
+               pCache->Insert(GetBlockID(), kind, summary);
+            }
+            CopyFromView(*summary,
+               frameoffset * fields, numframes * fields, dest);
+            return true;
+         }
          // Note GetBlob returns a size_t, not a bool
          // REVIEW: An error in GetBlob() will throw an exception.
          GetBlob(dest,
                      floatSample,
-                     stmt,
+                     column,
                      floatSample,
                      frameoffset * fields * SAMPLE_SIZE(floatSample),
                      numframes * fields * SAMPLE_SIZE(floatSample));
@@ -557,17 +1128,50 @@ MinMaxRMS SqliteSampleBlock::DoGetMinMaxRMS() const
    return { (float) mSumMin, (float) mSumMax, (float) mSumRms };
 }
 
+double SqliteSampleBlock::DoGetSum()
+{
+   if (IsSilent())
+      return 0.0;
+
+   if (mSumKnown.load(std::memory_order_acquire))
+      return mSum.load(std::memory_order_relaxed);
+
+   if (!mValid)
+   {
+      Load(mBlockID);
+   }
+
+   // Sum as CalcSummary() does, so that the result does not depend on
+   // whether the block was made in this session; racing threads compute
+   // the same value
+   SampleBuffer buffer(mSampleCount, floatSample);
+   DoGetSamples(buffer.ptr(), floatSample, 0, mSampleCount);
+   Floats summary256(3 * ((mSampleCount + 255) / 256));
+   const auto sum = SampleSummary::Summarize256(
+      reinterpret_cast<const float *>(buffer.ptr()), mSampleCount,
+      summary256.get()).sum;
+   mSum.store(sum, std::memory_order_relaxed);
+   mSumKnown.store(true, std::memory_order_release);
+   return sum;
+}
+
 size_t SqliteSampleBlock::GetSpaceUsage() const
 {
    if (IsSilent())
       return 0;
-   else
-      return ProjectFileIO::GetDiskUsage(*Conn(), mBlockID);
+
+   auto spaceUsage = mSpaceUsage.load(std::memory_order_relaxed);
+   if (spaceUsage < 0)
+   {
+      spaceUsage = ProjectFileIO::GetDiskUsage(*Conn(), GetBlockID());
+      mSpaceUsage.store(spaceUsage, std::memory_order_relaxed);
+   }
+   return spaceUsage;
 }
 
 size_t SqliteSampleBlock::GetBlob(void *dest,
                                   sampleFormat destformat,
-                                  sqlite3_stmt *stmt,
+                                  const char *column,
                                   sampleFormat srcformat,
                                   size_t srcoffset,
                                   size_t srcbytes)
@@ -581,34 +1185,26 @@ size_t SqliteSampleBlock::GetBlob(void *dest,
       Load(mBlockID);
    }
 
-   int rc;
-   size_t minbytes = 0;
-
-   // Bind statement parameters
-   // Might return SQLITE_MISUSE which means it's our mistake that we violated
-   // preconditions; should return SQL_OK which is 0
-   if (sqlite3_bind_int64(stmt, 1, mBlockID))
-   {
-      ADD_EXCEPTION_CONTEXT(
-         "sqlite3.rc", std::to_string(sqlite3_errcode(Conn()->DB())));
-      ADD_EXCEPTION_CONTEXT("sqlite3.context", "SqliteSampleBlock::GetBlob::bind");
-
-      wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
-   }
+   // Incremental blob I/O reads only the requested byte range, straight from
+   // the database pages (memory-mapped, if DBConnection enabled that) into
+   // the destination, instead of materializing the whole column value in a
+   // statement result first.  The handle is not cached, because an open blob
+   // handle holds a read transaction and would block checkpoints.
+   sqlite3_blob *blob = nullptr;
+   auto cleanup = finally([&]{
+      // Harmless when blob is null
+      sqlite3_blob_close(blob);
+   });
 
-   // Execute the statement
-   rc = sqlite3_step(stmt);
-   if (rc != SQLITE_ROW)
+   int rc = sqlite3_blob_open(
+      db, "main", "sampleblocks", column, GetBlockID(), 0, &blob);
+   if (rc != SQLITE_OK)
    {
       ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
-      ADD_EXCEPTION_CONTEXT("sqlite3.context", "SqliteSampleBlock::GetBlob::step");
+      ADD_EXCEPTION_CONTEXT("sqlite3.context", "SqliteSampleBlock::GetBlob::open");
 
       wxLogDebug(wxT("SqliteSampleBlock::GetBlob - SQLITE error %s"), sqlite3_errmsg(db));
 
-      // Clear statement bindings and rewind statement
-      sqlite3_clear_bindings(stmt);
-      sqlite3_reset(stmt);
-
       // Just showing the user a simple message, not the library error too
       // which isn't internationalized
       // Actually this can lead to 'Could not read from file' error message
@@ -621,18 +1217,50 @@ size_t SqliteSampleBlock::GetBlob(void *dest,
       Conn()->ThrowException( false );
    }
 
-   // Retrieve returned data
-   samplePtr src = (samplePtr) sqlite3_column_blob(stmt, 0);
-   size_t blobbytes = (size_t) sqlite3_column_bytes(stmt, 0);
-
+   const size_t blobbytes = sqlite3_blob_bytes(blob);
    srcoffset = std::min(srcoffset, blobbytes);
-   minbytes = std::min(srcbytes, blobbytes - srcoffset);
+   const auto minbytes = std::min(srcbytes, blobbytes - srcoffset);
+
+   const auto read = [&](void *buffer) {
+      if (minbytes > 0 &&
+          (rc = sqlite3_blob_read(blob, buffer, minbytes, srcoffset)) != SQLITE_OK)
+      {
+         ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
+         ADD_EXCEPTION_CONTEXT("sqlite3.context", "SqliteSampleBlock::GetBlob::read");
+
+         wxLogDebug(wxT("SqliteSampleBlock::GetBlob - SQLITE error %s"), sqlite3_errmsg(db));
 
-   if (srcoffset != 0)
+         Conn()->ThrowException( false );
+      }
+   };
+
+   if (destformat == srcformat)
    {
-      srcoffset += 0;
+      // No conversion:  read directly into the destination
+      read(dest);
+      if (srcbytes - minbytes)
+         memset(static_cast<samplePtr>(dest) + minbytes, 0, srcbytes - minbytes);
+      return srcbytes;
    }
 
+   SampleBuffer buffer(minbytes / SAMPLE_SIZE(srcformat), srcformat);
+   read(buffer.ptr());
+   return CopyBlob(dest,
+      destformat, buffer.ptr(), minbytes, srcformat, 0, srcbytes);
+}
+
+size_t SqliteSampleBlock::CopyBlob(void *dest,
+                                   sampleFormat destformat,
+                                   const void *blob,
+                                   size_t blobbytes,
+                                   sampleFormat srcformat,
+                                   size_t srcoffset,
+                                   size_t srcbytes)
+{
+   auto src = static_cast<constSamplePtr>(blob);
+   srcoffset = std::min(srcoffset, blobbytes);
+   const auto minbytes = std::min(srcbytes, blobbytes - srcoffset);
+
    /*
     Will dithering happen in CopySamples?  Answering this as of 3.0.3 by
     examining all uses.
@@ -682,10 +1310,6 @@ size_t SqliteSampleBlock::GetBlob(void *dest,
       memset(dest, 0, srcbytes - minbytes);
    }
 
-   // Clear statement bindings and rewind statement
-   sqlite3_clear_bindings(stmt);
-   sqlite3_reset(stmt);
-
    return srcbytes;
 }
 
@@ -705,8 +1329,7 @@ void SqliteSampleBlock::Load(SampleBlockID sbid)
 
    // Prepare and cache statement...automatically finalized at DB close
    sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::LoadSampleBlock,
-      "SELECT sampleformat, summin, summax, sumrms,"
-      "       length(samples)"
+      "SELECT " SAMPLE_BLOCK_METADATA
       "  FROM sampleblocks WHERE blockid = ?1;");
 
    // Bind statement parameters
@@ -742,31 +1365,108 @@ void SqliteSampleBlock::Load(SampleBlockID sbid)
    }
 
    // Retrieve returned data
-   mBlockID = sbid;
-   mSampleFormat = (sampleFormat) sqlite3_column_int(stmt, 0);
-   mSumMin = sqlite3_column_double(stmt, 1);
-   mSumMax = sqlite3_column_double(stmt, 2);
-   mSumRms = sqlite3_column_double(stmt, 3);
-   mSampleBytes = sqlite3_column_int(stmt, 4);
-   mSampleCount = mSampleBytes / SAMPLE_SIZE(mSampleFormat);
+   const auto metadata = ReadMetadata(stmt, 0);
 
    // Clear statement bindings and rewind statement
    sqlite3_clear_bindings(stmt);
    sqlite3_reset(stmt);
 
+   SetMetadata(sbid, metadata);
+}
+
+auto SqliteSampleBlock::ReadMetadata(sqlite3_stmt *stmt, int column)
+   -> Metadata
+{
+   return {
+      (sampleFormat) sqlite3_column_int(stmt, column),
+      sqlite3_column_double(stmt, column + 1),
+      sqlite3_column_double(stmt, column + 2),
+      sqlite3_column_double(stmt, column + 3),
+      static_cast<size_t>(sqlite3_column_int(stmt, column + 4)),
+      sqlite3_column_int64(stmt, column + 5),
+   };
+}
+
+void SqliteSampleBlock::SetMetadata(
+   SampleBlockID sbid, const Metadata &metadata)
+{
+   mBlockID = sbid;
+   mSampleFormat = metadata.format;
+   mSumMin = metadata.sumMin;
+   mSumMax = metadata.sumMax;
+   mSumRms = metadata.sumRms;
+   mSampleBytes = metadata.sampleBytes;
+   mSampleCount = mSampleBytes / SAMPLE_SIZE(mSampleFormat);
+   mSpaceUsage.store(metadata.spaceUsage, std::memory_order_relaxed);
+
    mValid = true;
 }
 
 void SqliteSampleBlock::Commit(Sizes sizes)
 {
-   const auto mSummary256Bytes = sizes.first;
-   const auto mSummary64kBytes = sizes.second;
+   auto conn = Conn();
+
+   // The row takes ownership of the local arrays
+   auto pRow = std::make_shared<PendingRow>();
+   pRow->format = mSampleFormat;
+   pRow->sumMin = mSumMin;
+   pRow->sumMax = mSumMax;
+   pRow->sumRms = mSumRms;
+   pRow->summary256 = std::move(mSummary256);
+   pRow->summary256Bytes = sizes.first;
+   pRow->summary64k = std::move(mSummary64k);
+   pRow->summary64kBytes = sizes.second;
+   pRow->samples = std::move(mSamples);
+   pRow->sampleBytes = mSampleBytes;
+   auto id = pRow->id.get_future().share();
+
+   // This may throw the error of an earlier insertion
+   conn->EnqueueWrite([conn, pRow]{
+      try {
+         pRow->id.set_value(InsertRow(*conn, *pRow));
+      }
+      catch (...) {
+         pRow->id.set_exception(std::current_exception());
+         throw;
+      }
+   });
 
-   auto db = DB();
+   {
+      std::lock_guard<std::mutex> lock(mSampleViewMutex);
+      mSampleView.reset();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mPendingMutex);
+      mPendingID = std::move(id);
+      mPending.store(true, std::memory_order_release);
+   }
+
+   // The other fields are all known already
+   mValid = true;
+}
+
+void SqliteSampleBlock::WaitCommitted() const
+{
+   if (!mPending.load(std::memory_order_acquire))
+      return;
+   std::lock_guard<std::mutex> lock(mPendingMutex);
+   if (!mPending.load(std::memory_order_relaxed))
+      return;
+   // Rethrows the error of a failed insertion
+   mBlockID = mPendingID.get();
+   mPendingID = {};
+   mPending.store(false, std::memory_order_release);
+}
+
+SampleBlockID SqliteSampleBlock::InsertRow(
+   DBConnection &conn, const PendingRow &row)
+{
+   auto db = conn.DB();
    int rc;
 
    // Prepare and cache statement...automatically finalized at DB close
-   sqlite3_stmt *stmt = Conn()->Prepare(DBConnection::InsertSampleBlock,
+   sqlite3_stmt *stmt = conn.Prepare(DBConnection::InsertSampleBlock,
       "INSERT INTO sampleblocks (sampleformat, summin, summax, sumrms,"
       "                          summary256, summary64k, samples)"
       "                         VALUES(?1,?2,?3,?4,?5,?6,?7);");
@@ -774,27 +1474,34 @@ void SqliteSampleBlock::Commit(Sizes sizes)
    // Bind statement parameters
    // Might return SQLITE_MISUSE which means it's our mistake that we violated
    // preconditions; should return SQL_OK which is 0
-   if (sqlite3_bind_int(stmt, 1, static_cast<int>(mSampleFormat)) ||
-       sqlite3_bind_double(stmt, 2, mSumMin) ||
-       sqlite3_bind_double(stmt, 3, mSumMax) ||
-       sqlite3_bind_double(stmt, 4, mSumRms) ||
-       sqlite3_bind_blob(stmt, 5, mSummary256.get(), mSummary256Bytes, SQLITE_STATIC) ||
-       sqlite3_bind_blob(stmt, 6, mSummary64k.get(), mSummary64kBytes, SQLITE_STATIC) ||
-       sqlite3_bind_blob(stmt, 7, mSamples.get(), mSampleBytes, SQLITE_STATIC))
+   if (sqlite3_bind_int(stmt, 1, static_cast<int>(row.format)) ||
+       sqlite3_bind_double(stmt, 2, row.sumMin) ||
+       sqlite3_bind_double(stmt, 3, row.sumMax) ||
+       sqlite3_bind_double(stmt, 4, row.sumRms) ||
+       sqlite3_bind_blob(stmt, 5, row.summary256.get(), row.summary256Bytes, SQLITE_STATIC) ||
+       sqlite3_bind_blob(stmt, 6, row.summary64k.get(), row.summary64kBytes, SQLITE_STATIC) ||
+       sqlite3_bind_blob(stmt, 7, row.samples.get(), row.sampleBytes, SQLITE_STATIC))
    {
 
       ADD_EXCEPTION_CONTEXT(
-         "sqlite3.rc", std::to_string(sqlite3_errcode(Conn()->DB())));
+         "sqlite3.rc", std::to_string(sqlite3_errcode(db)));
       ADD_EXCEPTION_CONTEXT("sqlite3.context", "SqliteSampleBlock::Commit::bind");
 
 
       wxASSERT_MSG(false, wxT("Binding failed...bug!!!"));
    }
 
+   // Other threads may insert into other tables on this connection; hold
+   // its mutex so that the rowid fetched below is this statement's
+   auto mutex = sqlite3_db_mutex(db);
+   sqlite3_mutex_enter(mutex);
+
    // Execute the statement
    rc = sqlite3_step(stmt);
    if (rc != SQLITE_DONE)
    {
+      sqlite3_mutex_leave(mutex);
+
       ADD_EXCEPTION_CONTEXT("sqlite3.rc", std::to_string(rc));
       ADD_EXCEPTION_CONTEXT("sqlite3.context", "SqliteSampleBlock::Commit::step");
 
@@ -806,26 +1513,18 @@ void SqliteSampleBlock::Commit(Sizes sizes)
 
       // Just showing the user a simple message, not the library error too
       // which isn't internationalized
-      Conn()->ThrowException( true );
+      conn.ThrowException( true );
    }
 
    // Retrieve returned data
-   mBlockID = sqlite3_last_insert_rowid(db);
-
-   // Reset local arrays
-   mSamples.reset();
-   mSummary256.reset();
-   mSummary64k.reset();
-   {
-      std::lock_guard<std::mutex> lock(mCacheMutex);
-      mCache.reset();
-   }
+   const SampleBlockID result = sqlite3_last_insert_rowid(db);
+   sqlite3_mutex_leave(mutex);
 
    // Clear statement bindings and rewind statement
    sqlite3_clear_bindings(stmt);
    sqlite3_reset(stmt);
 
-   mValid = true;
+   return result;
 }
 
 void SqliteSampleBlock::Delete()
@@ -842,7 +1541,7 @@ void SqliteSampleBlock::Delete()
    // Bind statement parameters
    // Might return SQLITE_MISUSE which means it's our mistake that we violated
    // preconditions; should return SQL_OK which is 0
-   if (sqlite3_bind_int64(stmt, 1, mBlockID))
+   if (sqlite3_bind_int64(stmt, 1, GetBlockID()))
    {
       ADD_EXCEPTION_CONTEXT(
          "sqlite3.rc", std::to_string(sqlite3_errcode(Conn()->DB())));
@@ -876,7 +1575,18 @@ void SqliteSampleBlock::Delete()
 
 void SqliteSampleBlock::SaveXML(XMLWriter &xmlFile)
 {
-   xmlFile.WriteAttr(wxT("blockid"), mBlockID);
+   SampleBlockID id;
+   try {
+      id = GetBlockID();
+   }
+   catch (...) {
+      // The failed insertion was reported to the producer, or at the commit
+      // of a transaction; don't fail serialization too, but save what the
+      // database really has for this block:  nothing, so silence
+      wxLogMessage("Saving unwritten sample block as silence");
+      id = -static_cast<SampleBlockID>(mSampleCount);
+   }
+   xmlFile.WriteAttr(wxT("blockid"), id);
 }
 
 auto SqliteSampleBlock::SetSizes(
@@ -925,48 +1635,16 @@ void SqliteSampleBlock::CalcSummary(Sizes sizes)
    float min;
    float max;
    float sumsq;
-   double totalSquares = 0.0;
    double fraction = 0.0;
 
-   // Recalc 256 summaries
+   // Recalc 256 summaries, with a vectorized kernel
    int sumLen = (mSampleCount + 255) / 256;
    int summaries = 256;
 
-   for (int i = 0; i < sumLen; ++i)
-   {
-      min = samples[i * 256];
-      max = samples[i * 256];
-      sumsq = min * min;
-
-      int jcount = 256;
-      if (jcount > mSampleCount - i * 256)
-      {
-         jcount = mSampleCount - i * 256;
-         fraction = 1.0 - (jcount / 256.0);
-      }
-
-      for (int j = 1; j < jcount; ++j)
-      {
-         float f1 = samples[i * 256 + j];
-         sumsq += f1 * f1;
-
-         if (f1 < min)
-         {
-            min = f1;
-         }
-         else if (f1 > max)
-         {
-            max = f1;
-         }
-      }
-
-      totalSquares += sumsq;
-
-      summary256[i * fields] = min;
-      summary256[i * fields + 1] = max;
-      // The rms is correct, but this may be for less than 256 samples in last loop.
-      summary256[i * fields + 2] = (float) sqrt(sumsq / jcount);
-   }
+   const auto totals =
+      SampleSummary::Summarize256(samples, mSampleCount, summary256);
+   if (const auto remainder = mSampleCount % 256)
+      fraction = 1.0 - (remainder / 256.0);
 
    for (int i = sumLen, frames256 = mSummary256Bytes / bytesPerFrame;
         i < frames256; ++i)
@@ -980,7 +1658,9 @@ void SqliteSampleBlock::CalcSummary(Sizes sizes)
    }
 
    // Calculate now while we can do it accurately
-   mSumRms = sqrt(totalSquares / mSampleCount);
+   mSumRms = sqrt(totals.squares / mSampleCount);
+   mSum.store(totals.sum, std::memory_order_relaxed);
+   mSumKnown.store(true, std::memory_order_release);
 
    // Recalc 64K summaries
    sumLen = (mSampleCount + 65535) / 65536;
@@ -0,0 +1,185 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectFileIOTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "MemoryX.h"
+#include "Project.h"
+#include "ProjectFileIO.h"
+#include "ProjectFormatVersion.h"
+#include "TestProject.h"
+#include "Track.h"
+#include "WaveTrack.h"
+
+#include <algorithm>
+#include <sqlite3.h>
+
+namespace {
+//! Names and samples of the wave tracks of a project
+using Summary = std::vector<std::pair<wxString, std::vector<float>>>;
+
+Summary Summarize(AudacityProject &project)
+{
+   Summary result;
+   for (auto pTrack : TrackList::Get(project).Any<const WaveTrack>()) {
+      const auto len =
+         pTrack->TimeToLongSamples(pTrack->GetEndTime()).as_size_t();
+      std::vector<float> samples(len);
+      samplePtr buffers[]{ reinterpret_cast<samplePtr>(samples.data()) };
+      pTrack->Get(0, 1, buffers, floatSample, 0, len, false);
+      result.emplace_back(pTrack->GetName(), std::move(samples));
+   }
+   return result;
+}
+
+WaveTrack &AddTrack(AudacityProject &project, const wxString &name)
+{
+   const auto pTrack = WaveTrack::New(project);
+   pTrack->SetName(name);
+   return *pTrack;
+}
+
+void Append(WaveTrack &track, size_t len, float value)
+{
+   const std::vector<float> samples(len, value);
+   track.Append(reinterpret_cast<constSamplePtr>(samples.data()),
+      floatSample, len);
+   track.Flush();
+}
+
+//! Run a statement through a connection of its own, and return the integer
+//! in the first column of the first row, if any
+int64_t QueryFile(const FilePath &fileName, const char *sql)
+{
+   sqlite3 *db = nullptr;
+   auto cleanup = finally([&]{ sqlite3_close(db); });
+   REQUIRE(SQLITE_OK == sqlite3_open(fileName.ToUTF8(), &db));
+   sqlite3_busy_timeout(db, 5000);
+
+   sqlite3_stmt *stmt = nullptr;
+   REQUIRE(SQLITE_OK == sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr));
+   const auto rc = sqlite3_step(stmt);
+   const int64_t result =
+      rc == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+   sqlite3_finalize(stmt);
+   REQUIRE((rc == SQLITE_ROW || rc == SQLITE_DONE));
+   return result;
+}
+
+int64_t CountDeltas(const FilePath &fileName)
+{
+   return QueryFile(fileName, "SELECT count(*) FROM autosavedelta;");
+}
+
+//! Whether versions that do not recover deltas refuse the file
+bool RequiresDeltaVersion(const FilePath &fileName)
+{
+   const auto version = ProjectFormatVersion::FromPacked(
+      static_cast<uint32_t>(QueryFile(fileName, "PRAGMA user_version;")));
+   return !(version < ProjectFormatVersion{ 3, 4, 0, 0 });
+}
+
+//! What another process recovers from the file
+Summary Recover(const FilePath &fileName)
+{
+   TestProject project{ {} };
+   auto result = project.projectFileIO.LoadProject(fileName, false);
+   REQUIRE(result);
+   result->Commit();
+   REQUIRE(project.projectFileIO.IsRecovered());
+   return Summarize(*project.pProject);
+}
+}
+
+TEST_CASE("ProjectFileIO recovers the autosave document and its deltas")
+{
+   TestFile file;
+   const auto &fileName = file.fileName;
+   TestProject project{ fileName };
+   auto &projectFileIO = project.projectFileIO;
+   REQUIRE(projectFileIO.OpenProject());
+
+   auto &track1 = AddTrack(*project.pProject, "One");
+   Append(track1, 1000, 0.25f);
+   auto &track2 = AddTrack(*project.pProject, "Two");
+   Append(track2, 2000, 0.5f);
+
+   // The first autosave writes the whole document
+   REQUIRE(projectFileIO.AutoSave());
+   REQUIRE(CountDeltas(fileName) == 0);
+   REQUIRE(!RequiresDeltaVersion(fileName));
+   const auto base = Summarize(*project.pProject);
+   REQUIRE(Recover(fileName) == base);
+
+   // Later ones write the changed sections.  These changes keep all blocks
+   // of the base document.
+   track2.SetName("Deux");
+   REQUIRE(projectFileIO.AutoSave());
+   Append(AddTrack(*project.pProject, "Three"), 300, 0.75f);
+   REQUIRE(projectFileIO.AutoSave());
+   REQUIRE(CountDeltas(fileName) == 2);
+   REQUIRE(RequiresDeltaVersion(fileName));
+   const auto expected = Summarize(*project.pProject);
+   REQUIRE(expected != base);
+   REQUIRE(Recover(fileName) == expected);
+
+   SECTION("Deltas of another autosave document are ignored")
+   {
+      QueryFile(fileName, "UPDATE autosavedelta SET base = base + 1;");
+      REQUIRE(Recover(fileName) == base);
+   }
+
+   SECTION("Deltas follow edits of samples and removal of tracks")
+   {
+      Append(track1, 500, -0.25f);
+      REQUIRE(projectFileIO.AutoSave());
+      // Removing a track leaves a document with fewer sections
+      TrackList::Get(*project.pProject).Remove(track2);
+      REQUIRE(projectFileIO.AutoSave());
+      REQUIRE(CountDeltas(fileName) == 4);
+      REQUIRE(Recover(fileName) == Summarize(*project.pProject));
+   }
+
+   SECTION("Deleting the autosave information restores the version")
+   {
+      REQUIRE(projectFileIO.AutoSaveDelete());
+      REQUIRE(CountDeltas(fileName) == 0);
+      REQUIRE(!RequiresDeltaVersion(fileName));
+   }
+}
+
+TEST_CASE("ProjectFileIO consolidates autosave deltas")
+{
+   TestFile file;
+   const auto &fileName = file.fileName;
+   TestProject project{ fileName };
+   auto &projectFileIO = project.projectFileIO;
+   REQUIRE(projectFileIO.OpenProject());
+
+   auto &track = AddTrack(*project.pProject, "Track");
+   Append(track, 1000, 0.5f);
+   AddTrack(*project.pProject, "Other");
+
+   int64_t maxDeltas = 0;
+   bool consolidated = false;
+   for (int ii = 0; ii < 150; ++ii) {
+      track.SetName(wxString::Format("Track %d", ii));
+      REQUIRE(projectFileIO.AutoSave());
+      const auto deltas = CountDeltas(fileName);
+      REQUIRE(deltas <= 100);
+      // A whole document replaces the deltas from time to time
+      consolidated = consolidated || (maxDeltas > 0 && deltas == 0);
+      maxDeltas = std::max(maxDeltas, deltas);
+      REQUIRE(RequiresDeltaVersion(fileName) == (deltas > 0));
+      if (ii % 10 == 0)
+         REQUIRE(Recover(fileName) == Summarize(*project.pProject));
+   }
+   REQUIRE(maxDeltas > 0);
+   REQUIRE(consolidated);
+   REQUIRE(Recover(fileName) == Summarize(*project.pProject));
+}
@@ -0,0 +1,282 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectSerializerTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "BufferedStreamReader.h"
+#include "ProjectSerializer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+//! Tags, attributes and content that the decoder passes to the handlers
+struct Recorder final : XMLTagHandler
+{
+   bool HandleXMLTag(
+      const std::string_view& tag, const AttributesList& attrs) override
+   {
+      events.push_back("<" + std::string(tag));
+      for (const auto &[name, value] : attrs)
+         events.push_back(std::string(name) + "=" + value.ToString());
+      return true;
+   }
+
+   void HandleXMLEndTag(const std::string_view& tag) override
+   {
+      events.push_back("/" + std::string(tag));
+   }
+
+   void HandleXMLContent(const std::string_view& content) override
+   {
+      events.push_back("[" + std::string(content) + "]");
+   }
+
+   XMLTagHandler *HandleXMLChild(const std::string_view&) override
+   {
+      return this;
+   }
+
+   std::vector<std::string> events;
+};
+
+//! Reads bytes in small pieces, as from a blob
+struct VectorReader final : BufferedStreamReader
+{
+   explicit VectorReader(const std::vector<char> &bytes)
+      : BufferedStreamReader(16), bytes{ bytes }
+   {
+   }
+
+   bool HasMoreData() const override
+   {
+      return position < bytes.size();
+   }
+
+   size_t ReadData(void* buffer, size_t maxBytes) override
+   {
+      maxBytes = std::min(maxBytes, bytes.size() - position);
+      memcpy(buffer, bytes.data() + position, maxBytes);
+      position += maxBytes;
+      return maxBytes;
+   }
+
+   const std::vector<char> &bytes;
+   size_t position { 0 };
+};
+
+std::vector<std::string> Decode(const std::vector<char> &bytes)
+{
+   Recorder recorder;
+   REQUIRE(ProjectSerializer::Decode(bytes.data(), bytes.size(), &recorder));
+   return recorder.events;
+}
+
+//! The dictionary, then the document, as a project file stores them
+std::vector<char> GetBytes(const ProjectSerializer &serializer)
+{
+   std::vector<char> result;
+   for (auto pStream : { &serializer.GetDict(), &serializer.GetData() }) {
+      const auto data = static_cast<const char*>(pStream->GetData());
+      result.insert(result.end(), data, data + pStream->GetSize());
+   }
+   return result;
+}
+
+//! Writes documents as versions before 3.4 did, with strings of 2- or 4-byte
+//! characters
+class LegacyDocument
+{
+public:
+   // Field types of the format
+   enum : unsigned char {
+      FT_CharSize = 0, FT_StartTag = 1, FT_EndTag = 2, FT_String = 3,
+      FT_Int = 4, FT_Data = 11, FT_Name = 15
+   };
+
+   explicit LegacyDocument(unsigned char charSize)
+      : mCharSize{ charSize }
+   {
+      Byte(FT_CharSize);
+      Byte(charSize);
+   }
+
+   void Name(uint16_t id, const std::u32string &name)
+   {
+      Byte(FT_Name);
+      Little(id);
+      const auto chars = Chars(name);
+      Little(static_cast<uint16_t>(chars.size()));
+      Append(chars);
+   }
+
+   void StartTag(uint16_t id) { Byte(FT_StartTag); Little(id); }
+   void EndTag(uint16_t id) { Byte(FT_EndTag); Little(id); }
+
+   void String(uint16_t id, const std::u32string &value)
+   {
+      Byte(FT_String);
+      Little(id);
+      const auto chars = Chars(value);
+      Little(static_cast<int32_t>(chars.size()));
+      Append(chars);
+   }
+
+   void Int(uint16_t id, int32_t value)
+   {
+      Byte(FT_Int);
+      Little(id);
+      Little(value);
+   }
+
+   void Data(const std::u32string &value)
+   {
+      Byte(FT_Data);
+      const auto chars = Chars(value);
+      Little(static_cast<int32_t>(chars.size()));
+      Append(chars);
+   }
+
+   const std::vector<char> &GetBytes() const { return mBytes; }
+
+private:
+   void Byte(unsigned char byte) { mBytes.push_back(byte); }
+
+   void Append(const std::vector<char> &bytes)
+   {
+      mBytes.insert(mBytes.end(), bytes.begin(), bytes.end());
+   }
+
+   template<typename Number> void Little(Number value)
+   {
+      Append(LittleBytes(static_cast<uint32_t>(value), sizeof(value)));
+   }
+
+   static std::vector<char> LittleBytes(uint32_t value, size_t size)
+   {
+      std::vector<char> result;
+      for (size_t ii = 0; ii < size; ++ii, value >>= 8)
+         result.push_back(static_cast<char>(value & 0xff));
+      return result;
+   }
+
+   //! Little-endian UTF-16 or UTF-32
+   std::vector<char> Chars(const std::u32string &string) const
+   {
+      std::vector<char> result;
+      auto append = [&](uint32_t unit) {
+         const auto bytes = LittleBytes(unit, mCharSize);
+         result.insert(result.end(), bytes.begin(), bytes.end());
+      };
+      for (const auto c : string) {
+         if (mCharSize == 2 && c >= 0x10000) {
+            append(0xd800 + ((c - 0x10000) >> 10));
+            append(0xdc00 + ((c - 0x10000) & 0x3ff));
+         }
+         else
+            append(c);
+      }
+      return result;
+   }
+
+   const unsigned char mCharSize;
+   std::vector<char> mBytes;
+};
+}
+
+TEST_CASE("ProjectSerializer round-trips non-ASCII names and values")
+{
+   const std::string longAscii(1000, 'x');
+   std::wstring longName;
+   for (int ii = 0; ii < 1000; ++ii)
+      longName += L"\u00e9";
+
+   ProjectSerializer serializer;
+   serializer.Write(wxT("<?xml version=\"1.0\"?>\n"));
+   serializer.StartTag(wxT("project"));
+   serializer.WriteAttr(L"n\u00e4me", wxString{ L"\u266a \U0001F3B5" });
+   serializer.WriteAttr(wxT("ascii"), wxString{ longAscii });
+   serializer.WriteAttr(wxT("rate"), 44100);
+   serializer.StartTag(L"\u30e9\u30d9\u30eb");
+   serializer.WriteAttr(wxString{ longName }, wxString{ L"\u00fcber" });
+   serializer.WriteData(L"content \u00e9");
+   serializer.EndTag(L"\u30e9\u30d9\u30eb");
+   serializer.EndTag(wxT("project"));
+
+   std::string longNameUTF8;
+   for (int ii = 0; ii < 1000; ++ii)
+      longNameUTF8 += u8"\u00e9";
+   const std::vector<std::string> expected{
+      "<project",
+      u8"n\u00e4me=\u266a \U0001F3B5",
+      "ascii=" + longAscii,
+      "rate=44100",
+      u8"<\u30e9\u30d9\u30eb",
+      longNameUTF8 + u8"=\u00fcber",
+      u8"[content \u00e9]",
+      u8"/\u30e9\u30d9\u30eb",
+      "/project",
+   };
+
+   const auto bytes = GetBytes(serializer);
+   REQUIRE(Decode(bytes) == expected);
+
+   // The stream overload decodes the same
+   VectorReader reader{ bytes };
+   Recorder recorder;
+   REQUIRE(ProjectSerializer::Decode(reader, &recorder));
+   REQUIRE(recorder.events == expected);
+}
+
+TEST_CASE("ProjectSerializer decodes documents of earlier versions")
+{
+   // Earlier versions wrote wxString's native characters, which are 2 bytes
+   // on Windows and 4 elsewhere
+   const unsigned char charSize = GENERATE(2, 4);
+   INFO("character size " << int(charSize));
+
+   LegacyDocument document{ charSize };
+   document.Name(0, U"project");
+   document.Name(1, U"n\u00e4me");
+   document.Name(2, U"rate");
+   document.Name(3, U"\u30e9\u30d9\u30eb");
+   document.StartTag(0);
+   // Needs a surrogate pair in UTF-16
+   document.String(1, U"\u266a \U0001F3B5");
+   document.String(2, U"ascii");
+   document.Int(2, 44100);
+   document.StartTag(3);
+   document.Data(U"content \u00e9");
+   document.EndTag(3);
+   document.EndTag(0);
+
+   const std::vector<std::string> expected{
+      "<project",
+      u8"n\u00e4me=\u266a \U0001F3B5",
+      "rate=ascii",
+      "rate=44100",
+      u8"<\u30e9\u30d9\u30eb",
+      u8"[content \u00e9]",
+      u8"/\u30e9\u30d9\u30eb",
+      "/project",
+   };
+   REQUIRE(Decode(document.GetBytes()) == expected);
+
+   SECTION("A truncated document fails")
+   {
+      auto bytes = document.GetBytes();
+      // Cut into the characters of the content
+      bytes.resize(bytes.size() - 8);
+      Recorder recorder;
+      REQUIRE(!ProjectSerializer::Decode(
+         bytes.data(), bytes.size(), &recorder));
+   }
+}
@@ -0,0 +1,108 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SqliteSampleBlockTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "ProjectFileIO.h"
+#include "SampleBlock.h"
+#include "TestProject.h"
+#include "WaveTrack.h"
+#include "XMLTagHandler.h"
+
+#include <algorithm>
+
+namespace {
+struct BlockContents
+{
+   SampleBlockID id;
+   std::vector<float> samples;
+};
+
+//! Blocks of differing lengths and samples, locked, so that their rows stay
+//! in the file when they are destroyed
+std::vector<BlockContents> MakeBlocks(
+   SampleBlockFactory &factory, size_t count, float offset)
+{
+   std::vector<BlockContents> result;
+   for (size_t ii = 0; ii < count; ++ii) {
+      std::vector<float> samples(100 + 37 * ii);
+      for (size_t jj = 0; jj < samples.size(); ++jj)
+         samples[jj] = offset + 0.001f * ((ii + jj) % 97) - 0.05f;
+      const auto pBlock = factory.Create(
+         reinterpret_cast<constSamplePtr>(samples.data()), samples.size(),
+         floatSample);
+      // Waits for the insertion of the row
+      const auto id = pBlock->GetBlockID();
+      pBlock->CloseLock();
+      result.push_back({ id, std::move(samples) });
+   }
+   return result;
+}
+
+//! Make a block from its id, as the document of a project does, and compare
+//! it with what was written
+void CheckBlock(SampleBlockFactory &factory, const BlockContents &contents)
+{
+   INFO("block " << contents.id);
+   const AttributesList attrs{
+      { "blockid", XMLAttributeValueView{ contents.id } } };
+   const auto pBlock = factory.CreateFromXML(floatSample, attrs);
+   REQUIRE(pBlock->GetBlockID() == contents.id);
+
+   const auto &samples = contents.samples;
+   REQUIRE(pBlock->GetSampleCount() == samples.size());
+   std::vector<float> read(samples.size());
+   pBlock->GetSamples(reinterpret_cast<samplePtr>(read.data()), floatSample,
+      0, read.size());
+   REQUIRE(read == samples);
+
+   const auto [pMin, pMax] =
+      std::minmax_element(samples.begin(), samples.end());
+   const auto minMaxRMS = pBlock->GetMinMaxRMS();
+   REQUIRE(minMaxRMS.min == *pMin);
+   REQUIRE(minMaxRMS.max == *pMax);
+   pBlock->CloseLock();
+}
+}
+
+TEST_CASE("SqliteSampleBlockFactory loads prefetched and missing blocks")
+{
+   TestFile file;
+   TestProject project{ file.fileName };
+   REQUIRE(project.projectFileIO.OpenProject());
+   const auto &pFactory =
+      WaveTrackFactory::Get(*project.pProject).GetSampleBlockFactory();
+
+   const auto before = MakeBlocks(*pFactory, 20, 0.25f);
+   pFactory->BeginLoading();
+
+   // The first block waits for the scan of the metadata of all blocks
+   CheckBlock(*pFactory, before[0]);
+
+   // Blocks written after the scan are missing from it, and load singly.
+   // Interleave them with blocks that it found.
+   const auto after = MakeBlocks(*pFactory, 10, -0.5f);
+   for (size_t ii = 0; ii < after.size(); ++ii) {
+      CheckBlock(*pFactory, after[ii]);
+      CheckBlock(*pFactory, before[2 * ii + 1]);
+      if (2 * ii + 2 < before.size())
+         CheckBlock(*pFactory, before[2 * ii + 2]);
+   }
+
+   // Silent blocks have no rows
+   const AttributesList attrs{
+      { "blockid", XMLAttributeValueView{ SampleBlockID{ -50 } } } };
+   const auto pSilent = pFactory->CreateFromXML(floatSample, attrs);
+   REQUIRE(pSilent->GetSampleCount() == 50);
+
+   pFactory->EndLoading();
+
+   // Loading after EndLoading() reads rows singly
+   CheckBlock(*pFactory, before.back());
+   CheckBlock(*pFactory, after.back());
+}
@@ -0,0 +1,47 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  TestProject.cpp
+
+**********************************************************************/
+#include "TestProject.h"
+
+#include <catch2/catch.hpp>
+
+#include "Project.h"
+#include "ProjectFileIO.h"
+#include "Track.h"
+#include "WaveTrack.h"
+
+#include <wx/filename.h>
+
+// An empty file, in which SQLite makes a new database
+TestFile::TestFile()
+   : fileName{ wxFileName::CreateTempFileName("ProjectFileIO") }
+{
+   REQUIRE(ProjectFileIO::InitializeSQL());
+   REQUIRE(!fileName.empty());
+}
+
+TestFile::~TestFile()
+{
+   ProjectFileIO::RemoveProject(fileName);
+}
+
+TestProject::TestProject(const FilePath &fileName)
+   : pProject{ AudacityProject::Create() }
+   , projectFileIO{ ProjectFileIO::Get(*pProject) }
+{
+   projectFileIO.SetFileName(fileName);
+}
+
+TestProject::~TestProject()
+{
+   auto &tracks = TrackList::Get(*pProject);
+   for (auto pTrack : tracks.Leaders<WaveTrack>())
+      pTrack->CloseLock();
+   tracks.Clear();
+   projectFileIO.CloseProject();
+}
@@ -0,0 +1,39 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  TestProject.h
+
+**********************************************************************/
+#pragma once
+
+#include "Identifier.h"
+
+#include <memory>
+
+class AudacityProject;
+class ProjectFileIO;
+
+//! An empty file for a project, in the system's temporary directory, which
+//! is removed with this
+struct TestFile
+{
+   TestFile();
+   ~TestFile();
+
+   const FilePath fileName;
+};
+
+//! A project, whose file is not temporary, so that closing it keeps the file
+struct TestProject
+{
+   //! Does not open the file
+   explicit TestProject(const FilePath &fileName);
+   //! Locks the tracks, as when the application closes a project, so that
+   //! destroying them does not delete their blocks, then closes the file
+   ~TestProject();
+
+   const std::shared_ptr<AudacityProject> pProject;
+   ProjectFileIO &projectFileIO;
+};
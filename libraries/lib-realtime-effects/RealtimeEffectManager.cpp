@@ -90,7 +90,7 @@ void RealtimeEffectManager::Finalize() noexcept
    SetSuspended(true);
 
    // Assume it is now safe to clean up
-   mLatency = std::chrono::microseconds(0);
+   mLatency.store(std::chrono::microseconds(0), std::memory_order_relaxed);
 
    VisitAll([](RealtimeEffectState &state, bool){ state.Finalize(); });
 
@@ -121,7 +121,7 @@ void RealtimeEffectManager::ProcessStart(bool suspended)
 size_t RealtimeEffectManager::Process(bool suspended,
    const WideSampleSequence &sequence,
    float *const *buffers, float *const *scratch, float *const dummy,
-   unsigned nBuffers, size_t numSamples)
+   unsigned nBuffers, size_t numSamples, Lists lists)
 {
    // Can be suspended because of the audio stream being paused or because
    // effects have been suspended, so allow the samples to pass as-is.
@@ -150,16 +150,20 @@ size_t RealtimeEffectManager::Process(bool suspended,
    // Tracks how many processors were called
    size_t called = 0;
    size_t discardable = 0;
-   VisitGroup(sequence,
-      [&](RealtimeEffectState &state, bool)
-      {
-         discardable +=
-            state.Process(sequence, nBuffers, ibuf, obuf, dummy, numSamples);
-         for (auto i = 0; i < nBuffers; ++i)
-            std::swap(ibuf[i], obuf[i]);
-         called++;
-      }
-   );
+   const auto visitor = [&](RealtimeEffectState &state, bool)
+   {
+      discardable +=
+         state.Process(sequence, nBuffers, ibuf, obuf, dummy, numSamples);
+      for (auto i = 0; i < nBuffers; ++i)
+         std::swap(ibuf[i], obuf[i]);
+      called++;
+   };
+   // Paralleling VisitGroup
+   const auto bits = static_cast<unsigned char>(lists);
+   if (bits & static_cast<unsigned char>(Lists::Master))
+      RealtimeEffectList::Get(mProject).Visit(visitor);
+   if (bits & static_cast<unsigned char>(Lists::Sequence))
+      RealtimeEffectList::Get(sequence).Visit(visitor);
 
    // Once we're done, we might wind up with the last effect storing its results
    // in the temporary buffers.  If that's the case, we need to copy it over to
@@ -171,7 +175,9 @@ size_t RealtimeEffectManager::Process(bool suspended,
 
    // Remember the latency
    auto end = std::chrono::steady_clock::now();
-   mLatency = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+   mLatency.store(
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start),
+      std::memory_order_relaxed);
 
    //
    // This is wrong...needs to handle tails
@@ -342,6 +348,6 @@ std::optional<size_t> RealtimeEffectManager::FindState(
 #if 0
 auto RealtimeEffectManager::GetLatency() const -> Latency
 {
-   return mLatency; // should this be atomic?
+   return mLatency.load(std::memory_order_relaxed);
 }
 #endif
@@ -52,6 +52,17 @@ class REALTIME_EFFECTS_API RealtimeEffectManager final :
 public:
    using Latency = std::chrono::microseconds;
 
+   //! Selects which lists of states are applied by one call to Process
+   /*! The per-project list is applied before the list of the sequence */
+   enum class Lists : unsigned char {
+      //! Per-project states, shared by all sequences, so that processing of
+      //! distinct sequences must be serialized
+      Master = 1,
+      //! States of the sequence only, independent of all other sequences
+      Sequence = 2,
+      All = Master | Sequence,
+   };
+
    RealtimeEffectManager(AudacityProject &project);
    ~RealtimeEffectManager();
 
@@ -155,7 +166,7 @@ private:
    size_t Process(bool suspended,
       const WideSampleSequence &sequence,
       float *const *buffers, float *const *scratch, float *dummy,
-      unsigned nBuffers, size_t numSamples);
+      unsigned nBuffers, size_t numSamples, Lists lists);
    void ProcessEnd(bool suspended) noexcept;
 
    RealtimeEffectManager(const RealtimeEffectManager&) = delete;
@@ -202,7 +213,8 @@ private:
    }
 
    AudacityProject &mProject;
-   Latency mLatency{ 0 };
+   //! Written by whichever thread processed last
+   std::atomic<Latency> mLatency{ Latency{ 0 } };
 
    std::atomic<bool> mSuspended{ true };
 
@@ -282,18 +294,24 @@ public:
    }
 
    //! @return how many samples to discard for latency
+   /*!
+    May be called concurrently from several threads, for distinct sequences,
+    each with its own scratch buffers, if lists is Lists::Sequence; other
+    calls must be serialized.
+    */
    size_t Process(const WideSampleSequence &sequence,
       float *const *buffers,
       float *const *scratch,
       float *dummy,
       unsigned nBuffers, //!< how many buffers; equal number of scratches
-      size_t numSamples //!< length of each buffer
+      size_t numSamples, //!< length of each buffer
+      RealtimeEffectManager::Lists lists = RealtimeEffectManager::Lists::All
    )
    {
       if (auto pProject = mwProject.lock())
          return RealtimeEffectManager::Get(*pProject)
             .Process(mSuspended, sequence, buffers, scratch, dummy,
-               nBuffers, numSamples);
+               nBuffers, numSamples, lists);
       else
          return 0; // consider them trivially processed
    }
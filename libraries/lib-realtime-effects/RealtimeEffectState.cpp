@@ -548,7 +548,10 @@ size_t RealtimeEffectState::Process(
    const auto clientIn = stackAllocate(const float *, numAudioIn);
    const auto clientOut = stackAllocate(float *, numAudioOut);
    size_t len = 0;
-   const auto &pair = mGroups[&sequence];
+   // Not operator[], which is not safe for concurrent use
+   const auto iter = mGroups.find(&sequence);
+   assert(iter != mGroups.end());
+   const auto &pair = iter->second;
    auto processor = pair.first;
    // Outer loop over processors
    AllocateChannelsToProcessors(chans, numAudioIn, numAudioOut,
@@ -77,6 +77,8 @@ public:
    bool ProcessStart(bool running);
    //! Worker thread processes part of a batch of samples
    /*!
+    Calls for distinct sequences may be concurrent only if this state belongs
+    to the list of one sequence; a per-project state must be serialized.
     @return how many leading samples are discardable for latency
     */
    size_t Process(const WideSampleSequence &sequence,
@@ -138,10 +138,10 @@ bool StretchingSequence::HasTrivialEnvelope() const
    return mSequence.HasTrivialEnvelope();
 }
 
-void StretchingSequence::GetEnvelopeValues(
+bool StretchingSequence::GetEnvelopeValues(
    double* buffer, size_t bufferLen, double t0, bool backwards) const
 {
-   mSequence.GetEnvelopeValues(buffer, bufferLen, t0, backwards);
+   return mSequence.GetEnvelopeValues(buffer, bufferLen, t0, backwards);
 }
 
 AudioGraph::ChannelType StretchingSequence::GetChannelType() const
@@ -44,7 +44,7 @@ public:
    double GetRate() const override;
    sampleFormat WidestEffectiveFormat() const override;
    bool HasTrivialEnvelope() const override;
-   void GetEnvelopeValues(
+   bool GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0,
       bool backwards) const override;
    bool Get(
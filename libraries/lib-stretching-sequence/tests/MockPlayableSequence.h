@@ -66,10 +66,11 @@ public:
       return true;
    }
 
-   void GetEnvelopeValues(
+   bool GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0,
       bool backwards) const override
    {
+      return false;
    }
 
    // AudioGraph::Channel
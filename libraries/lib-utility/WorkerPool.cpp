@@ -0,0 +1,171 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file WorkerPool.cpp
+
+**********************************************************************/
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+size_t WorkerPool::DefaultWorkerCount()
+{
+   return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+WorkerPool &WorkerPool::Get()
+{
+   static WorkerPool pool;
+   return pool;
+}
+
+WorkerPool::WorkerPool(size_t nWorkers)
+{
+   mThreads.reserve(nWorkers);
+   for (size_t ii = 0; ii < nWorkers; ++ii)
+      mThreads.emplace_back([this]{ WorkerLoop(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mStop = true;
+   }
+   mWorkAvailable.notify_all();
+   for (auto &thread : mThreads)
+      thread.join();
+}
+
+void WorkerPool::Batch::Run() noexcept
+{
+   while (true) {
+      const auto ii = next.fetch_add(1, std::memory_order_relaxed);
+      if (ii >= count)
+         break;
+      try {
+         body(ii);
+      }
+      catch (...) {
+         {
+            std::lock_guard<std::mutex> lock{ exceptionMutex };
+            if (!pException)
+               pException = std::current_exception();
+         }
+         // Abandon the iterations not yet claimed
+         next.store(count, std::memory_order_relaxed);
+      }
+   }
+}
+
+void WorkerPool::ParallelFor(size_t count, Body body)
+{
+   if (count == 0)
+      return;
+   if (count == 1 || mThreads.empty()) {
+      for (size_t ii = 0; ii < count; ++ii)
+         body(ii);
+      return;
+   }
+
+   // The batch lives on this stack frame; workers may only reach it through
+   // a slot, and this function does not return until they have left it
+   Batch batch{ count, body };
+
+   // If all slots are taken by concurrent or nested loops, this caller does
+   // all of the work
+   Slot *pSlot = nullptr;
+   for (auto &slot : mSlots) {
+      bool expected = false;
+      if (slot.busy.compare_exchange_strong(expected, true)) {
+         pSlot = &slot;
+         break;
+      }
+   }
+
+   if (pSlot) {
+      pSlot->pBatch.store(&batch);
+      pSlot->open.store(true);
+      // Without the mutex, a worker about to sleep may miss this; then the
+      // caller does more of the work, but is never blocked
+      mWorkAvailable.notify_all();
+   }
+
+   batch.Run();
+
+   if (pSlot) {
+      pSlot->open.store(false);
+      pSlot->pBatch.store(nullptr);
+      // Workers that loaded the pointer are finishing at most one iteration
+      // each; spin a while before yielding
+      for (size_t spins = 0; pSlot->users.load() != 0; ++spins)
+         if (spins >= 1000)
+            std::this_thread::yield();
+      pSlot->busy.store(false);
+   }
+
+   if (batch.pException)
+      std::rethrow_exception(batch.pException);
+}
+
+void WorkerPool::Enqueue(Task task)
+{
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mTasks.push_back(std::move(task));
+   }
+   mWorkAvailable.notify_one();
+}
+
+bool WorkerPool::AnyOpenBatch() const
+{
+   return std::any_of(mSlots.begin(), mSlots.end(),
+      [](const Slot &slot){ return slot.open.load(); });
+}
+
+bool WorkerPool::HelpBatches()
+{
+   bool helped = false;
+   for (auto &slot : mSlots) {
+      if (!slot.open.load())
+         continue;
+      // Announce use before loading the pointer, so that the caller, which
+      // clears the pointer before waiting for users, can't miss this one
+      slot.users.fetch_add(1);
+      if (const auto pBatch = slot.pBatch.load()) {
+         pBatch->Run();
+         // The caller can't release the slot while this is a user, so the
+         // flag is not another batch's
+         slot.open.store(false);
+         helped = true;
+      }
+      slot.users.fetch_sub(1);
+   }
+   return helped;
+}
+
+void WorkerPool::WorkerLoop()
+{
+   while (true) {
+      if (HelpBatches())
+         continue;
+
+      std::unique_lock<std::mutex> lock{ mMutex };
+      mWorkAvailable.wait(lock, [this]{
+         return mStop || AnyOpenBatch() || !mTasks.empty(); });
+      if (mStop)
+         return;
+      if (AnyOpenBatch())
+         continue;
+
+      auto task = std::move(mTasks.front());
+      mTasks.pop_front();
+      lock.unlock();
+      try {
+         task();
+      }
+      catch (...) {
+      }
+   }
+}
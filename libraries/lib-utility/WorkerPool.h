@@ -0,0 +1,150 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file WorkerPool.h
+  @brief A fixed set of worker threads for data-parallel loops and
+  background tasks
+
+**********************************************************************/
+
+#ifndef __AUDACITY_WORKER_POOL__
+#define __AUDACITY_WORKER_POOL__
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//! A fixed set of threads that execute loops in parallel with the caller,
+//! and also queued tasks
+/*!
+ ParallelFor() does not allocate memory, does not transfer ownership of
+ anything to the pool, and never waits on a lock that a worker may hold, so
+ it is suitable for use in the audio thread.  It publishes its loop in one of
+ a few slots, which workers poll with atomic operations; the calling thread
+ participates in the loop, so that nested or concurrent calls cannot
+ deadlock, and the loop completes even if all workers are busy or asleep.
+ At the end it spins, then yields, until workers finish the iterations they
+ claimed.
+
+ Unclaimed loop iterations are preferred by the workers over queued tasks.
+ Realtime work should use a pool of its own, to which no tasks are queued,
+ so that its loops are not delayed by long tasks.
+ */
+class UTILITY_API WorkerPool final
+{
+public:
+   using Task = std::function<void()>;
+
+   //! Non-owning reference to a callable taking an index
+   /*!
+    Unlike std::function, construction never allocates.  The callable must
+    outlive the Body, as a temporary argument of ParallelFor does.
+    */
+   class Body final
+   {
+   public:
+      template<typename Function, typename = std::enable_if_t<
+         !std::is_same_v<std::decay_t<Function>, Body>>>
+      Body(Function &&function) noexcept
+         : mpFunction{ const_cast<void*>(
+            static_cast<const void*>(std::addressof(function))) }
+         , mCall{ [](void *pFunction, size_t ii) {
+            (*static_cast<std::remove_reference_t<Function>*>(pFunction))(ii);
+         } }
+      {
+      }
+
+      void operator()(size_t ii) const { mCall(mpFunction, ii); }
+
+   private:
+      void *mpFunction;
+      void (*mCall)(void *, size_t);
+   };
+
+   //! Number of workers to use by default:  one less than the number of
+   //! hardware threads, leaving one for the caller
+   static size_t DefaultWorkerCount();
+
+   //! Process-wide pool, created on first use
+   static WorkerPool &Get();
+
+   explicit WorkerPool(size_t nWorkers = DefaultWorkerCount());
+   WorkerPool(const WorkerPool&) = delete;
+   WorkerPool &operator=(const WorkerPool&) = delete;
+   //! Discards tasks not yet started, and joins the threads
+   ~WorkerPool();
+
+   //! Count of worker threads, not including callers of ParallelFor
+   size_t GetWorkerCount() const { return mThreads.size(); }
+
+   //! Call body(i) for every i in [0, count) and return when all are done
+   /*!
+    The order of calls and the threads making them are unspecified, but
+    indices are claimed in increasing order.
+    If any call throws, remaining unstarted iterations are skipped, and the
+    first exception is rethrown to the caller after all others complete.
+    */
+   void ParallelFor(size_t count, Body body);
+
+   //! Queue a task to be executed by some worker at a later time
+   /*! Exceptions escaping task are swallowed */
+   void Enqueue(Task task);
+
+private:
+   struct Batch {
+      Batch(size_t count, Body body)
+         : count{ count }, body{ body } {}
+
+      //! Claim and execute iterations until none are left
+      void Run() noexcept;
+
+      const size_t count;
+      const Body body;
+      std::atomic<size_t> next{ 0 };
+      std::exception_ptr pException;
+      std::mutex exceptionMutex;
+   };
+
+   //! Where a caller of ParallelFor publishes its batch
+   struct Slot {
+      //! Claimed by a caller, until no worker can reach its batch
+      std::atomic<bool> busy{ false };
+      //! Whether the batch may have unclaimed iterations
+      std::atomic<bool> open{ false };
+      //! Lives in the caller's stack
+      std::atomic<Batch*> pBatch{ nullptr };
+      //! Workers that may have loaded pBatch
+      std::atomic<size_t> users{ 0 };
+   };
+
+   //! Concurrent or nested loops beyond this many run in their callers only
+   static constexpr size_t MaxBatches = 8;
+
+   void WorkerLoop();
+   //! Run iterations of open batches
+   /*! @return whether there were any */
+   bool HelpBatches();
+   bool AnyOpenBatch() const;
+
+   std::array<Slot, MaxBatches> mSlots;
+   std::vector<std::thread> mThreads;
+
+   //! Guards mTasks and mStop, and lets idle workers sleep; never taken by
+   //! ParallelFor
+   std::mutex mMutex;
+   std::condition_variable mWorkAvailable;
+   std::deque<Task> mTasks;
+   bool mStop{ false };
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WorkerPoolTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "WorkerPool.h"
+
+#include <future>
+#include <numeric>
+#include <stdexcept>
+
+TEST_CASE("WorkerPool::ParallelFor visits each index once")
+{
+   for (size_t nWorkers : { 0, 1, 3 }) {
+      WorkerPool pool{ nWorkers };
+      std::vector<std::atomic<int>> visits(1000);
+      pool.ParallelFor(visits.size(), [&](size_t ii){ ++visits[ii]; });
+      for (auto &count : visits)
+         REQUIRE(count == 1);
+   }
+}
+
+TEST_CASE("WorkerPool::ParallelFor nests without deadlock")
+{
+   WorkerPool pool{ 2 };
+   std::atomic<size_t> total{ 0 };
+   pool.ParallelFor(8, [&](size_t){
+      pool.ParallelFor(8, [&](size_t ii){ total += ii; });
+   });
+   REQUIRE(total == 8 * 28);
+}
+
+TEST_CASE("WorkerPool::ParallelFor rethrows")
+{
+   WorkerPool pool{ 2 };
+   std::atomic<int> count{ 0 };
+   REQUIRE_THROWS_AS(pool.ParallelFor(100, [&](size_t ii){
+      ++count;
+      if (ii == 10)
+         throw std::runtime_error{ "" };
+   }), std::runtime_error);
+   REQUIRE(count > 0);
+   REQUIRE(count <= 100);
+}
+
+TEST_CASE("WorkerPool::Enqueue")
+{
+   WorkerPool pool{ 2 };
+   std::promise<int> promise;
+   auto future = promise.get_future();
+   pool.Enqueue([&]{ promise.set_value(42); });
+   REQUIRE(future.get() == 42);
+}
+
+TEST_CASE("WorkerPool::ParallelFor completes while workers are busy")
+{
+   WorkerPool pool{ 1 };
+   std::promise<void> release;
+   auto released = release.get_future().share();
+   pool.Enqueue([released]{ released.wait(); });
+   // The only worker is blocked, so the caller must do all of the work
+   std::atomic<size_t> total{ 0 };
+   pool.ParallelFor(100, [&](size_t ii){ total += ii; });
+   REQUIRE(total == 4950);
+   release.set_value();
+}
+
+TEST_CASE("WorkerPool::ParallelFor from many threads")
+{
+   // More concurrent callers than there are slots for publishing batches
+   WorkerPool pool{ 3 };
+   std::vector<std::thread> callers;
+   std::vector<size_t> totals(20);
+   for (size_t jj = 0; jj < totals.size(); ++jj)
+      callers.emplace_back([&, jj]{
+         for (int rep = 0; rep < 50; ++rep) {
+            std::atomic<size_t> total{ 0 };
+            pool.ParallelFor(100, [&](size_t ii){ total += ii; });
+            totals[jj] += total;
+         }
+      });
+   for (auto &caller : callers)
+      caller.join();
+   for (auto total : totals)
+      REQUIRE(total == 50 * 4950);
+}
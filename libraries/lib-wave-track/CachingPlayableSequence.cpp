@@ -93,10 +93,10 @@ bool CachingPlayableSequence::HasTrivialEnvelope() const
    return mWaveTrack.HasTrivialEnvelope();
 }
 
-void CachingPlayableSequence::GetEnvelopeValues(
+bool CachingPlayableSequence::GetEnvelopeValues(
    double* buffer, size_t bufferLen, double t0, bool backwards) const
 {
-   mWaveTrack.GetEnvelopeValues(buffer, bufferLen, t0, backwards);
+   return mWaveTrack.GetEnvelopeValues(buffer, bufferLen, t0, backwards);
 }
 
 AudioGraph::ChannelType CachingPlayableSequence::GetChannelType() const
@@ -56,6 +56,46 @@ SampleBlockPtr SampleBlockFactory::CreateFromXML(
    return result;
 }
 
+bool SampleBlockFactory::GetSamples(const BlockReads &reads,
+   sampleFormat destformat, bool mayThrow)
+{
+   try { return DoGetSamples(reads, destformat); }
+   catch( ... ) {
+      if( mayThrow )
+         throw;
+      // Retry one at a time, so that only failed reads are zeroed
+      bool result = true;
+      for (auto &read : reads)
+         if (read.pBlock->GetSamples(read.dest, destformat,
+            read.sampleoffset, read.numsamples, false) != read.numsamples)
+            result = false;
+      return result;
+   }
+}
+
+bool SampleBlockFactory::DoGetSamples(
+   const BlockReads &reads, sampleFormat destformat)
+{
+   bool result = true;
+   for (auto &read : reads)
+      if (read.pBlock->GetSamples(read.dest, destformat,
+         read.sampleoffset, read.numsamples) != read.numsamples)
+         result = false;
+   return result;
+}
+
+void SampleBlockFactory::Prefetch(const SampleBlockPtr &)
+{
+}
+
+void SampleBlockFactory::BeginLoading()
+{
+}
+
+void SampleBlockFactory::EndLoading()
+{
+}
+
 SampleBlock::~SampleBlock() = default;
 
 size_t SampleBlock::GetSamples(samplePtr dest,
@@ -93,3 +133,40 @@ size_t SampleBlock::GetSamples(samplePtr dest,
    }
 }
 
+double SampleBlock::GetSum(size_t start, size_t len, bool mayThrow)
+{
+   try{ return DoGetSum(start, len); }
+   catch( ... ) {
+      if( mayThrow )
+         throw;
+      return 0.0;
+   }
+}
+
+double SampleBlock::GetSum(bool mayThrow)
+{
+   try{ return DoGetSum(); }
+   catch( ... ) {
+      if( mayThrow )
+         throw;
+      return 0.0;
+   }
+}
+
+double SampleBlock::DoGetSum(size_t start, size_t len)
+{
+   SampleBuffer blockData(len, floatSample);
+   const auto samples = reinterpret_cast<const float *>(blockData.ptr());
+   const auto copied =
+      DoGetSamples(blockData.ptr(), floatSample, start, len);
+
+   double sum = 0.0;
+   for (size_t i = 0; i < copied; ++i)
+      sum += samples[i];
+   return sum;
+}
+
+double SampleBlock::DoGetSum()
+{
+   return DoGetSum(0, GetSampleCount());
+}
@@ -16,6 +16,7 @@ SampleBlock.h
 #include <functional>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
 #include "Observer.h"
 #include "XMLTagHandler.h"
@@ -85,6 +86,14 @@ public:
    // That may be appropriate when only attempting to display samples, not edit.
    MinMaxRMS GetMinMaxRMS(bool mayThrow = true) const;
 
+   /// Gets the sum of the samples in the specified region, for the mean
+   // If !mayThrow and there is an error, ignores it and returns zero.
+   double GetSum(size_t start, size_t len, bool mayThrow = true);
+
+   /// Gets the sum of all samples of the block, for the mean
+   // If !mayThrow and there is an error, ignores it and returns zero.
+   double GetSum(bool mayThrow = true);
+
    virtual size_t GetSpaceUsage() const = 0;
 
    virtual void SaveXML(XMLWriter &xmlFile) = 0;
@@ -98,6 +107,13 @@ protected:
    virtual MinMaxRMS DoGetMinMaxRMS(size_t start, size_t len) = 0;
 
    virtual MinMaxRMS DoGetMinMaxRMS() const = 0;
+
+   //! Default implementation reads the samples as floats and adds them
+   virtual double DoGetSum(size_t start, size_t len);
+
+   //! Default implementation calls DoGetSum(0, GetSampleCount()); the
+   //! override may remember the result, as the samples never change
+   virtual double DoGetSum();
 };
 
 // Makes a useful function object
@@ -145,6 +161,41 @@ public:
    /*! @return ids of all sample blocks created by this factory and still extant */
    virtual SampleBlockIDs GetActiveBlockIDs() = 0;
 
+   //! Describes a read of part of one block into a caller's buffer
+   struct BlockRead {
+      SampleBlock *pBlock; //!< not null
+      samplePtr dest;
+      size_t sampleoffset;
+      size_t numsamples;
+   };
+   using BlockReads = std::vector<BlockRead>;
+
+   //! Like SampleBlock::GetSamples for each of the reads, but the override
+   //! may fetch many blocks in each round trip to storage
+   /*!
+    If !mayThrow and there is an error, retries the reads one at a time,
+    so that only the failed ones are filled with zeroes.
+    @return whether all reads completed
+    */
+   bool GetSamples(const BlockReads &reads,
+      sampleFormat destformat, bool mayThrow = true);
+
+   //! Hint that the block's samples will soon be fetched as floats, as
+   //! during playback or a sequential scan
+   /*! The override may begin loading them in the background into a cache.
+    Default does nothing */
+   virtual void Prefetch(const SampleBlockPtr &pBlock);
+
+   //! Hint that CreateFromXML will be called for many blocks, as when a
+   //! project opens, until EndLoading()
+   /*! The override may begin fetching what it needs of all blocks at once,
+    in the background.  Default does nothing */
+   virtual void BeginLoading();
+
+   //! End what BeginLoading() began
+   /*! Default does nothing */
+   virtual void EndLoading();
+
 protected:
    // The override should throw more informative exceptions on error than the
    // default InconsistencyException thrown by Create
@@ -163,6 +214,10 @@ protected:
    virtual SampleBlockPtr DoCreateFromXML(
       sampleFormat srcformat,
       const AttributesList &attrs) = 0;
+
+   //! Default implementation reads the blocks one at a time
+   /*! @return whether all reads completed */
+   virtual bool DoGetSamples(const BlockReads &reads, sampleFormat destformat);
 };
 
 #endif
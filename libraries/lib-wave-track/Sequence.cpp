@@ -256,15 +256,12 @@ std::pair<float, float> Sequence::GetMinMax(
 
    // First calculate the min/max of the blocks in the middle of this region;
    // this is very fast because we have the min/max of every entire block
-   // already in memory.
+   // already in memory, combined in a pyramid.
 
-   for (unsigned b = block0 + 1; b < block1; ++b) {
-      auto results = mBlock[b].sb->GetMinMaxRMS(mayThrow);
-
-      if (results.min < min)
-         min = results.min;
-      if (results.max > max)
-         max = results.max;
+   if (block1 > block0 + 1) {
+      auto results = SummarizeBlocks(block0 + 1, block1, mayThrow);
+      min = results.min;
+      max = results.max;
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -332,16 +329,11 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
 
    // First calculate the rms of the blocks in the middle of this region;
    // this is very fast because we have the rms of every entire block
-   // already in memory.
-   for (unsigned b = block0 + 1; b < block1; b++) {
-      const SeqBlock &theBlock = mBlock[b];
-      const auto &sb = theBlock.sb;
-      auto results = sb->GetMinMaxRMS(mayThrow);
-
-      const auto fileLen = sb->GetSampleCount();
-      const auto blockRMS = results.RMS;
-      sumsq += blockRMS * blockRMS * fileLen;
-      length += fileLen;
+   // already in memory, combined in a pyramid.
+   if (block1 > block0 + 1) {
+      auto results = SummarizeBlocks(block0 + 1, block1, mayThrow);
+      sumsq += results.sumsq;
+      length += results.count;
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -384,6 +376,41 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
    return sqrt(sumsq / length.as_double() );
 }
 
+double Sequence::GetSum(sampleCount start, sampleCount len, bool mayThrow) const
+{
+   if (len == 0 || mBlock.size() == 0)
+      return 0.0;
+
+   double sum = 0.0;
+
+   const auto block0 = FindBlock(start);
+   const auto block1 = FindBlock(start + len - 1);
+   for (auto b = block0; b <= block1; ++b) {
+      const SeqBlock &theBlock = mBlock[b];
+      const auto &sb = theBlock.sb;
+      const auto count = sb->GetSampleCount();
+      // The part of the region that lies within theBlock
+      const auto s0 = ( std::max(start, theBlock.start) - theBlock.start )
+         .as_size_t();
+      const auto s1 = ( std::min(start + len, theBlock.start + count)
+         - theBlock.start ).as_size_t();
+      if (s0 == 0 && s1 == count)
+         sum += sb->GetSum(mayThrow);
+      else
+         sum += sb->GetSum(s0, s1 - s0, mayThrow);
+   }
+
+   return sum;
+}
+
+SummaryPyramid::Summary
+Sequence::SummarizeBlocks(size_t b0, size_t b1, bool mayThrow) const
+{
+   std::lock_guard lock{ mPyramidMutex };
+   mPyramid.Update(mBlock, mBlocksVersion, mayThrow);
+   return mPyramid.Query(b0, b1);
+}
+
 // Must pass in the correct factory for the result.  If it's not the same
 // as in this, then block contents must be copied.
 std::unique_ptr<Sequence> Sequence::Copy( const SampleBlockFactoryPtr &pFactory,
@@ -594,6 +621,7 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
          buffer.ptr(),
          largerBlockLen.as_size_t(),
          format);
+      ++mBlocksVersion;
 
       // Don't make a duplicate array.  We can still give Strong-guarantee
       // if we modify only one block in place.
@@ -849,6 +877,7 @@ bool Sequence::HandleXMLTag(const std::string_view& tag, const AttributesList &a
       }
 
       mBlock.push_back(wb);
+      ++mBlocksVersion;
 
       return true;
    }
@@ -1131,6 +1160,9 @@ Sequence::GetFloatSampleView(sampleCount start, size_t length) const
       blockViews.push_back(block.sb->GetFloatSampleView());
       cursor = block.start + block.sb->GetSampleCount();
    }
+   // Playback will likely want the next block soon
+   if (cursor < mNumSamples)
+      mpFactory->Prefetch(mBlock[FindBlock(cursor)].sb);
    return { std::move(blockViews), sequenceOffset, length };
 }
 
@@ -1155,7 +1187,25 @@ bool Sequence::Get(samplePtr buffer, sampleFormat format,
 bool Sequence::Get(int b, samplePtr buffer, sampleFormat format,
    sampleCount start, size_t len, bool mayThrow) const
 {
-   bool result = true;
+   // Sequential readers will likely want the next block soon
+   const auto prefetch = [&](int next) {
+      if (format == floatSample && next < static_cast<int>(mBlock.size()))
+         mpFactory->Prefetch(mBlock[next].sb);
+   };
+
+   {
+      // Most reads, as in playback, lie within one block; don't allocate
+      const SeqBlock &block = mBlock[b];
+      const auto bstart = (start - block.start).as_size_t();
+      if (len <= block.sb->GetSampleCount() - bstart) {
+         prefetch(b + 1);
+         return Read(buffer, format, block, bstart, len, mayThrow);
+      }
+   }
+
+   // Gather the reads of all touched blocks, so that the factory may fetch
+   // them together
+   SampleBlockFactory::BlockReads reads;
    while (len) {
       const SeqBlock &block = mBlock[b];
       // start is in block
@@ -1163,15 +1213,22 @@ bool Sequence::Get(int b, samplePtr buffer, sampleFormat format,
       // bstart is not more than block length
       const auto blen = std::min(len, block.sb->GetSampleCount() - bstart);
 
-      if (! Read(buffer, format, block, bstart, blen, mayThrow) )
-         result = false;
+      reads.push_back({ block.sb.get(), buffer, bstart, blen });
 
       len -= blen;
       buffer += (blen * SAMPLE_SIZE(format));
       b++;
       start += blen;
    }
-   return result;
+
+   prefetch(b);
+
+   // Either throws, or if !mayThrow, tells whether all were really read
+   if (!mpFactory->GetSamples(reads, format, mayThrow)) {
+      wxLogWarning(wxT("Failed to read some of %zu blocks."), reads.size());
+      return false;
+   }
+   return true;
 }
 
 // Pass nullptr to set silence
@@ -1599,6 +1656,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
            ( pos + len ).as_size_t(), newLen - pos, true);
 
       b.sb = factory.Create(scratch.ptr(), newLen, format);
+      ++mBlocksVersion;
 
       // Don't make a duplicate array.  We can still give Strong-guarantee
       // if we modify only one block in place.
@@ -1786,6 +1844,7 @@ void Sequence::CommitChangesIfConsistent
    // use No-fail-guarantee
 
    mBlock.swap(newBlock);
+   ++mBlocksVersion;
    mNumSamples = numSamples;
 }
 
@@ -1799,6 +1858,9 @@ void Sequence::AppendBlocksIfConsistent
    if (additionalBlocks.empty())
       return;
 
+   // Even if the change is undone below
+   ++mBlocksVersion;
+
    bool tmpValid = false;
    SeqBlock tmp;
 
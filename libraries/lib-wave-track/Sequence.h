@@ -14,12 +14,14 @@
 
 #include <vector>
 #include <functional>
+#include <mutex>
 
 #include "SampleFormat.h"
 #include "XMLTagHandler.h"
 
 #include "SampleCount.h"
 #include "AudioSegmentSampleView.h"
+#include "SummaryPyramid.h"
 
 class SampleBlock;
 class SampleBlockFactory;
@@ -193,6 +195,16 @@ class WAVE_TRACK_API Sequence final : public XMLTagHandler{
    std::pair<float, float> GetMinMax(
       sampleCount start, sampleCount len, bool mayThrow) const;
    float GetRMS(sampleCount start, sampleCount len, bool mayThrow) const;
+   //! Sum of the samples, for the mean; whole blocks use their own sums,
+   //! which are read only once in the life of each block
+   double GetSum(sampleCount start, sampleCount len, bool mayThrow) const;
+
+   //! Combined whole-block summaries of the blocks with indices in [b0, b1)
+   /*! Costs time logarithmic in the number of blocks, after the first call
+      following an edit, which updates a pyramid of summaries in proportion
+      to the changed blocks */
+   SummaryPyramid::Summary
+   SummarizeBlocks(size_t b0, size_t b1, bool mayThrow) const;
 
    //
    // Getting block size and alignment information
@@ -208,7 +220,8 @@ class WAVE_TRACK_API Sequence final : public XMLTagHandler{
    // you're doing!
    //
 
-   BlockArray &GetBlockArray() { return mBlock; }
+   //! The caller may change the blocks, so this counts as an edit
+   BlockArray &GetBlockArray() { ++mBlocksVersion; return mBlock; }
    const BlockArray &GetBlockArray() const { return mBlock; }
 
    size_t GetAppendBufferLen() const { return mAppendBufferLen; }
@@ -243,6 +256,13 @@ class WAVE_TRACK_API Sequence final : public XMLTagHandler{
 
    bool          mErrorOpening{ false };
 
+   //! Changes with every edit of mBlock, so that mPyramid need not compare
+   //! the blocks when there was none
+   size_t        mBlocksVersion{ 0 };
+
+   mutable std::mutex mPyramidMutex;
+   mutable SummaryPyramid mPyramid;
+
    //
    // Private methods
    //
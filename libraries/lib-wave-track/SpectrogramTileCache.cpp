@@ -0,0 +1,133 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SpectrogramTileCache.cpp
+
+**********************************************************************/
+#include "SpectrogramTileCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+IntSetting SpectrogramTileCacheSize{ L"/Spectrum/TileCacheSize", 64 };
+
+bool SpectrogramTileCache::Key::operator == (const Key &other) const
+{
+   return algorithm == other.algorithm
+      && windowType == other.windowType
+      && windowSize == other.windowSize
+      && zeroPaddingFactor == other.zeroPaddingFactor
+      && frequencyGain == other.frequencyGain
+      && rate == other.rate;
+}
+
+bool SpectrogramTileCache::TileKey::operator == (const TileKey &other) const
+{
+   return pBlock == other.pBlock
+      && key == other.key
+      && hop == other.hop
+      && tile == other.tile;
+}
+
+size_t SpectrogramTileCache::TileKeyHash::operator () (
+   const TileKey &key) const
+{
+   size_t result = std::hash<const SampleBlock*>{}(key.pBlock);
+   const auto combine = [&](size_t value){
+      result ^= value + 0x9e3779b9 + (result << 6) + (result >> 2);
+   };
+   combine(key.tile);
+   combine(key.hop);
+   combine(key.key.windowSize * key.key.zeroPaddingFactor);
+   combine(std::hash<double>{}(key.key.rate));
+   combine(static_cast<size_t>(key.key.algorithm));
+   combine(static_cast<size_t>(key.key.windowType));
+   combine(static_cast<size_t>(key.key.frequencyGain));
+   return result;
+}
+
+SpectrogramTileCache &SpectrogramTileCache::Get()
+{
+   static SpectrogramTileCache instance{
+      static_cast<size_t>(std::max(0, SpectrogramTileCacheSize.Read())) << 20
+   };
+   return instance;
+}
+
+SpectrogramTileCache::SpectrogramTileCache(size_t budget)
+   : mBudget{ budget }
+{
+}
+
+auto SpectrogramTileCache::FindTile(
+   const std::shared_ptr<SampleBlock> &pBlock, const TileKey &key)
+   -> TileList::iterator
+{
+   const auto iter = mIndex.find(key);
+   if (iter == mIndex.end())
+      return mTiles.end();
+   const auto iTile = iter->second;
+   if (iTile->wBlock.lock() != pBlock) {
+      // The block was destroyed, and another was made at the same address
+      Erase(iTile);
+      return mTiles.end();
+   }
+   mTiles.splice(mTiles.begin(), mTiles, iTile);
+   return iTile;
+}
+
+void SpectrogramTileCache::Erase(TileList::iterator iter)
+{
+   mBytes -= iter->bytes;
+   mIndex.erase(iter->key);
+   mTiles.erase(iter);
+}
+
+bool SpectrogramTileCache::Find(const std::shared_ptr<SampleBlock> &pBlock,
+   const Key &key, size_t hop, size_t frame, float *out, size_t nBins)
+{
+   if (!IsEnabled() || !pBlock)
+      return false;
+   std::lock_guard<std::mutex> lock{ mMutex };
+   const auto iTile =
+      FindTile(pBlock, { pBlock.get(), key, hop, frame / TileFrames });
+   if (iTile == mTiles.end())
+      return false;
+   const auto &column = iTile->columns[frame % TileFrames];
+   if (column.size() != nBins)
+      return false;
+   std::copy(column.begin(), column.end(), out);
+   return true;
+}
+
+void SpectrogramTileCache::Insert(const std::shared_ptr<SampleBlock> &pBlock,
+   const Key &key, size_t hop, size_t frame, const float *column, size_t nBins)
+{
+   if (!IsEnabled() || !pBlock)
+      return;
+   const auto bytes = nBins * sizeof(float);
+   if (bytes > mBudget)
+      return;
+
+   std::lock_guard<std::mutex> lock{ mMutex };
+   const TileKey tileKey{ pBlock.get(), key, hop, frame / TileFrames };
+   auto iTile = FindTile(pBlock, tileKey);
+   if (iTile == mTiles.end()) {
+      mTiles.push_front({ tileKey, pBlock });
+      iTile = mTiles.begin();
+      mIndex.emplace(tileKey, iTile);
+   }
+
+   auto &dest = iTile->columns[frame % TileFrames];
+   mBytes -= dest.size() * sizeof(float);
+   iTile->bytes -= dest.size() * sizeof(float);
+   dest.assign(column, column + nBins);
+   mBytes += bytes;
+   iTile->bytes += bytes;
+
+   // Evict from the back, but never the tile just used
+   while (mBytes > mBudget && std::prev(mTiles.end()) != iTile)
+      Erase(std::prev(mTiles.end()));
+}
@@ -0,0 +1,123 @@
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SpectrogramTileCache.h
+  @brief Bounded cache of spectrogram columns computed within sample blocks,
+  shared by all clips and zoom levels
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPECTROGRAM_TILE_CACHE__
+#define __AUDACITY_SPECTROGRAM_TILE_CACHE__
+
+#include <array>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Prefs.h"
+
+class SampleBlock;
+
+//! Megabytes of spectrogram columns to keep in memory; 0 disables the cache
+extern WAVE_TRACK_API IntSetting SpectrogramTileCacheSize;
+
+//! Least-recently-used cache of spectrogram columns, keyed by sample block
+/*!
+ A column is identified by the block containing its whole window of samples,
+ the analysis settings, and the position of the window's center, which is
+ snapped to a grid of multiples of a power of two samples from the start of
+ the block.  Such a column depends only on the contents of the block, which
+ never change, so entries remain correct when the block moves within its
+ sequence, or is shared with another track, or when the view scrolls or zooms;
+ and an edit leaves the columns of untouched blocks usable.
+
+ Columns are grouped in tiles of consecutive grid positions, which are the
+ unit of eviction.  Entries for destroyed blocks are never found again, and
+ are evicted in time.
+
+ All member functions may be called from any thread.
+ */
+class WAVE_TRACK_API SpectrogramTileCache final
+{
+public:
+   //! Settings that affect the values of columns
+   struct WAVE_TRACK_API Key {
+      int algorithm;
+      int windowType;
+      size_t windowSize;
+      size_t zeroPaddingFactor;
+      int frequencyGain;
+      double rate;
+
+      bool operator == (const Key &other) const;
+   };
+
+   //! Number of grid positions in a tile
+   static constexpr size_t TileFrames = 64;
+
+   //! Process-wide cache, created on first use with the budget from
+   //! preferences
+   static SpectrogramTileCache &Get();
+
+   //! @param budget total bytes of cached columns; 0 disables the cache
+   explicit SpectrogramTileCache(size_t budget);
+   SpectrogramTileCache(const SpectrogramTileCache&) = delete;
+   SpectrogramTileCache &operator=(const SpectrogramTileCache&) = delete;
+
+   bool IsEnabled() const { return mBudget > 0; }
+
+   //! Copy a column into out, if present, and mark its tile most recently used
+   /*!
+    @param hop spacing of the grid, in samples
+    @param frame index of the center in the grid
+    @param nBins count of values in the column
+    */
+   bool Find(const std::shared_ptr<SampleBlock> &pBlock, const Key &key,
+      size_t hop, size_t frame, float *out, size_t nBins);
+
+   //! Store a copy of a column, evicting least recently used tiles to stay
+   //! within budget
+   void Insert(const std::shared_ptr<SampleBlock> &pBlock, const Key &key,
+      size_t hop, size_t frame, const float *column, size_t nBins);
+
+private:
+   struct TileKey {
+      const SampleBlock *pBlock;
+      Key key;
+      size_t hop;
+      size_t tile;
+
+      bool operator == (const TileKey &other) const;
+   };
+   struct TileKeyHash {
+      size_t operator () (const TileKey &key) const;
+   };
+   struct Tile {
+      TileKey key;
+      //! Detects reuse of the address of a destroyed block
+      std::weak_ptr<SampleBlock> wBlock;
+      std::array<std::vector<float>, TileFrames> columns;
+      size_t bytes{ 0 };
+   };
+   using TileList = std::list<Tile>;
+
+   //! @pre mutex is held
+   TileList::iterator FindTile(
+      const std::shared_ptr<SampleBlock> &pBlock, const TileKey &key);
+   //! @pre mutex is held
+   void Erase(TileList::iterator iter);
+
+   std::mutex mMutex;
+   //! Most recently used at the front
+   TileList mTiles;
+   std::unordered_map<TileKey, TileList::iterator, TileKeyHash> mIndex;
+   size_t mBytes{ 0 };
+   const size_t mBudget;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SummaryPyramid.cpp
+
+**********************************************************************/
+#include "SummaryPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "SampleBlock.h"
+#include "Sequence.h"
+
+void SummaryPyramid::Summary::Combine(const Summary &other)
+{
+   min = std::min(min, other.min);
+   max = std::max(max, other.max);
+   sumsq += other.sumsq;
+   count += other.count;
+}
+
+float SummaryPyramid::Summary::RMS() const
+{
+   return count > 0 ? std::sqrt(sumsq / count.as_double()) : 0.0f;
+}
+
+namespace {
+bool SameBlock(const std::weak_ptr<const SampleBlock> &summarized,
+   const std::shared_ptr<SampleBlock> &block)
+{
+   return !summarized.owner_before(block) && !block.owner_before(summarized);
+}
+
+SummaryPyramid::Summary SummarizeBlock(const SampleBlock &block, bool mayThrow)
+{
+   const auto results = block.GetMinMaxRMS(mayThrow);
+   const auto count = block.GetSampleCount();
+   return { results.min, results.max,
+      double(results.RMS) * results.RMS * count, count };
+}
+}
+
+void SummaryPyramid::Update(
+   const BlockArray &blocks, size_t version, bool mayThrow)
+{
+   if (mVersion == version)
+      return;
+
+   const auto nOld = mBlocks.size(), nNew = blocks.size();
+
+   // Find the unchanged prefix and suffix of blocks
+   const auto nCommon = std::min(nOld, nNew);
+   size_t prefix = 0;
+   while (prefix < nCommon && SameBlock(mBlocks[prefix], blocks[prefix].sb))
+      ++prefix;
+   size_t suffix = 0;
+   while (suffix < nCommon - prefix &&
+      SameBlock(mBlocks[nOld - 1 - suffix], blocks[nNew - 1 - suffix].sb))
+      ++suffix;
+   if (nOld == nNew && prefix == nNew) {
+      mVersion = version;
+      return;
+   }
+
+   // Summarize the replacements first, which may throw
+   const auto end = nNew - suffix;
+   std::vector<Summary> changed;
+   changed.reserve(end - prefix);
+   for (auto b = prefix; b < end; ++b)
+      changed.push_back(SummarizeBlock(*blocks[b].sb, mayThrow));
+
+   try {
+      if (mLevels.empty())
+         mLevels.emplace_back();
+      auto &leaves = mLevels[0];
+      leaves.erase(leaves.begin() + prefix, leaves.begin() + (nOld - suffix));
+      leaves.insert(leaves.begin() + prefix, changed.begin(), changed.end());
+      mBlocks.erase(
+         mBlocks.begin() + prefix, mBlocks.begin() + (nOld - suffix));
+      mBlocks.insert(mBlocks.begin() + prefix, end - prefix, {});
+      for (auto b = prefix; b < end; ++b)
+         mBlocks[b] = blocks[b].sb;
+
+      // Recompute ancestors of changed leaves; if the count changed, then
+      // grouping of all later leaves changed too
+      auto first = prefix, last = (nOld == nNew) ? end : nNew;
+      size_t level = 1;
+      for (; mLevels[level - 1].size() > 1; ++level) {
+         if (level == mLevels.size())
+            mLevels.emplace_back();
+         const auto &children = mLevels[level - 1];
+         auto &parents = mLevels[level];
+         const auto nParents = (children.size() + Fanout - 1) / Fanout;
+         parents.resize(nParents);
+         first /= Fanout;
+         last = (nOld == nNew)
+            ? (last + Fanout - 1) / Fanout
+            : nParents;
+         for (auto ii = first; ii < last; ++ii) {
+            Summary summary;
+            const auto childEnd =
+               std::min(children.size(), (ii + 1) * Fanout);
+            for (auto jj = ii * Fanout; jj < childEnd; ++jj)
+               summary.Combine(children[jj]);
+            parents[ii] = summary;
+         }
+      }
+      mLevels.resize(level);
+      mVersion = version;
+   }
+   catch (...) {
+      // Start over next time
+      mBlocks.clear();
+      mLevels.clear();
+      mVersion.reset();
+      throw;
+   }
+}
+
+auto SummaryPyramid::Query(size_t b0, size_t b1) const -> Summary
+{
+   Summary result;
+   b1 = std::min(b1, mBlocks.size());
+   for (size_t level = 0; b0 < b1; ++level) {
+      const auto &summaries = mLevels[level];
+      if (level + 1 == mLevels.size()) {
+         while (b0 < b1)
+            result.Combine(summaries[b0++]);
+         break;
+      }
+      // Take the unaligned ends at this level, then go up
+      while (b0 < b1 && b0 % Fanout)
+         result.Combine(summaries[b0++]);
+      while (b1 > b0 && b1 % Fanout)
+         result.Combine(summaries[--b1]);
+      b0 /= Fanout;
+      b1 /= Fanout;
+   }
+   return result;
+}
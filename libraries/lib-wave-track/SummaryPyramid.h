@@ -0,0 +1,76 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file SummaryPyramid.h
+  @brief Multi-level min, max, and rms of the blocks of a Sequence
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SUMMARY_PYRAMID__
+#define __AUDACITY_SUMMARY_PYRAMID__
+
+#include <float.h>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "SampleCount.h"
+
+class BlockArray;
+class SampleBlock;
+
+//! Tree of summaries over runs of whole sample blocks, each level combining
+//! groups of Fanout from the level below
+/*!
+ The lowest level holds the whole-block min, max, and rms that every sample
+ block already keeps in memory and in the project, so building or extending
+ the pyramid needs no reading of samples.
+
+ Update() does nothing unless the owner's version of the blocks changed.
+ Otherwise it compares blocks to those summarized before, by identity, and
+ recomputes only the changed lowest level entries and their ancestors, so
+ that edits cost little more than the edited blocks.
+
+ Not thread-safe; Sequence serializes access.
+ */
+class WAVE_TRACK_API SummaryPyramid final
+{
+public:
+   static constexpr size_t Fanout = 4;
+
+   struct WAVE_TRACK_API Summary {
+      float min = FLT_MAX;
+      float max = -FLT_MAX;
+      double sumsq = 0.0;
+      sampleCount count = 0;
+
+      void Combine(const Summary &other);
+      float RMS() const;
+   };
+
+   //! Bring the pyramid up to date with the blocks
+   /*!
+    @param version must change whenever the blocks may have changed; while it
+    equals that of the last Update, the blocks are not examined
+    @excsafety{Weak} -- the pyramid is emptied, to be rebuilt by the next
+    call
+    */
+   void Update(const BlockArray &blocks, size_t version, bool mayThrow);
+
+   //! Combine summaries of blocks with indices in [b0, b1) as of the last
+   //! Update, visiting O(Fanout * log(b1 - b0)) entries
+   Summary Query(size_t b0, size_t b1) const;
+
+   size_t NLevels() const { return mLevels.size(); }
+
+private:
+   //! Blocks summarized at the lowest level, not keeping them alive;
+   //! weak pointers compare safely even after the blocks are destroyed
+   std::vector<std::weak_ptr<const SampleBlock>> mBlocks;
+   std::vector<std::vector<Summary>> mLevels;
+   //! Version of the blocks as of the last Update, if any succeeded
+   std::optional<size_t> mVersion;
+};
+
+#endif
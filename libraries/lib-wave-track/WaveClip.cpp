@@ -225,9 +225,21 @@ constSamplePtr WaveClip::GetAppendBuffer(size_t ii) const
 
 void WaveClip::MarkChanged() // NOFAIL-GUARANTEE
 {
+   // Sample counts may have changed, and so the play end time
+   const auto length = GetNumSamples() + GetAppendBufferLen();
+   if (length != mMarkedLength) {
+      mMarkedLength = length;
+      RegionChanged();
+   }
    Caches::ForEach( std::mem_fn( &WaveClipListener::MarkChanged ) );
 }
 
+void WaveClip::RegionChanged() noexcept
+{
+   if (mpRegionVersion)
+      ++*mpRegionVersion;
+}
+
 std::pair<float, float> WaveClip::GetMinMax(size_t ii,
    double t0, double t1, bool mayThrow) const
 {
@@ -270,6 +282,26 @@ float WaveClip::GetRMS(size_t ii, double t0, double t1, bool mayThrow) const
    return mSequences[ii]->GetRMS(s0, s1-s0, mayThrow);
 }
 
+double WaveClip::GetSum(size_t ii, double t0, double t1, bool mayThrow) const
+{
+   assert(ii < GetWidth());
+   t0 = std::max(t0, GetPlayStartTime());
+   t1 = std::min(t1, GetPlayEndTime());
+   if (t0 > t1) {
+      if (mayThrow)
+         THROW_INCONSISTENCY_EXCEPTION;
+      return 0.0;
+   }
+
+   if (t0 == t1)
+      return 0.0;
+
+   auto s0 = TimeToSequenceSamples(t0);
+   auto s1 = TimeToSequenceSamples(t1);
+
+   return mSequences[ii]->GetSum(s0, s1 - s0, mayThrow);
+}
+
 void WaveClip::ConvertToSampleFormat(sampleFormat format,
    const std::function<void(size_t)> & progressReport)
 {
@@ -306,7 +338,9 @@ std::shared_ptr<SampleBlock> WaveClip::AppendNewBlock(
    // This is a special use function for legacy files only and this assertion
    // does not need to be relaxed
    assert(GetWidth() == 1);
-   return mSequences[0]->AppendNewBlock( buffer, format, len );
+   auto result = mSequences[0]->AppendNewBlock( buffer, format, len );
+   RegionChanged();
+   return result;
 }
 
 /*! @excsafety{Strong} */
@@ -316,6 +350,7 @@ void WaveClip::AppendSharedBlock(const std::shared_ptr<SampleBlock> &pBlock)
    // does not need to be relaxed
    assert(GetWidth() == 1);
    mSequences[0]->AppendSharedBlock( pBlock );
+   RegionChanged();
 }
 
 bool WaveClip::Append(constSamplePtr buffers[], sampleFormat format,
@@ -418,6 +453,7 @@ void WaveClip::HandleXMLEndTag(const std::string_view& tag)
    // by the constructor which remains empty.
    mSequences.erase(mSequences.begin());
    mSequences.shrink_to_fit();
+   RegionChanged();
    if (tag == "waveclip")
       UpdateEnvelopeTrackLen();
    // A proof of this assertion assumes that nothing has happened since
@@ -994,6 +1030,7 @@ void WaveClip::Resample(int rate, BasicUI::ProgressDialog *progress)
       // Use No-fail-guarantee in these steps
       mSequences = move(newSequences);
       mRate = rate;
+      RegionChanged();
       Flush();
       Caches::ForEach( std::mem_fn( &WaveClipListener::Invalidate ) );
    }
@@ -1089,6 +1126,7 @@ sampleCount WaveClip::GetPlaySamplesCount() const
 void WaveClip::SetTrimLeft(double trim)
 {
     mTrimLeft = std::max(.0, trim);
+    RegionChanged();
 }
 
 double WaveClip::GetTrimLeft() const noexcept
@@ -1099,6 +1137,7 @@ double WaveClip::GetTrimLeft() const noexcept
 void WaveClip::SetTrimRight(double trim)
 {
     mTrimRight = std::max(.0, trim);
+    RegionChanged();
 }
 
 double WaveClip::GetTrimRight() const noexcept
@@ -1109,21 +1148,25 @@ double WaveClip::GetTrimRight() const noexcept
 void WaveClip::TrimLeft(double deltaTime)
 {
     mTrimLeft += deltaTime;
+    RegionChanged();
 }
 
 void WaveClip::TrimRight(double deltaTime)
 {
     mTrimRight += deltaTime;
+    RegionChanged();
 }
 
 void WaveClip::TrimLeftTo(double to)
 {
     mTrimLeft = std::clamp(to, GetSequenceStartTime(), GetPlayEndTime()) - GetSequenceStartTime();
+    RegionChanged();
 }
 
 void WaveClip::TrimRightTo(double to)
 {
     mTrimRight = GetSequenceEndTime() - std::clamp(to, GetPlayStartTime(), GetSequenceEndTime());
+    RegionChanged();
 }
 
 double WaveClip::GetSequenceStartTime() const noexcept
@@ -1136,6 +1179,7 @@ void WaveClip::SetSequenceStartTime(double startTime)
 {
     mSequenceOffset = startTime;
     mEnvelope->SetOffset(startTime);
+    RegionChanged();
 }
 
 double WaveClip::GetSequenceEndTime() const
@@ -1265,5 +1309,6 @@ WaveClip::Transaction::~Transaction()
       clip.mSequences.swap(sequences);
       clip.mTrimLeft = mTrimLeft;
       clip.mTrimRight = mTrimRight;
+      clip.RegionChanged();
    }
 }
@@ -23,6 +23,7 @@
 
 #include <wx/longlong.h>
 
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <optional>
@@ -301,6 +302,15 @@ public:
    /*! @excsafety{No-fail} */
    void MarkChanged();
 
+   //! Counter shared by the clips of one track, and advanced whenever the
+   //! play region of any of them may change
+   using RegionVersion = std::shared_ptr<std::atomic<size_t>>;
+
+   //! WaveTrack gives its counter to each clip it holds, and resets it when
+   //! it releases the clip
+   void SetRegionVersion(RegionVersion pVersion) noexcept
+   { mpRegionVersion = std::move(pVersion); }
+
    /** Getting high-level data for one channel for screen display and clipping
     * calculations and Contrast */
    /*!
@@ -313,6 +323,11 @@ public:
     @copydoc GetMinMax
     */
    float GetRMS(size_t ii, double t0, double t1, bool mayThrow) const;
+   /*!
+    @copydoc GetMinMax
+    @return the sum of the samples between t0 and t1, within the play region
+    */
+   double GetSum(size_t ii, double t0, double t1, bool mayThrow) const;
 
    /** Whenever you do an operation to the sequence that will change the number
     * of samples (that is, the length of the clip), you will want to call this
@@ -503,7 +518,13 @@ private:
    bool mIsPlaceholder { false };
 
 private:
+   //! Advance the counter of the owning track, if any
+   void RegionChanged() noexcept;
+
    wxString mName;
+   RegionVersion mpRegionVersion;
+   //! Samples and append buffer length at the last MarkChanged()
+   sampleCount mMarkedLength{ 0 };
 };
 
 #endif
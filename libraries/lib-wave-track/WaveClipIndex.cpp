@@ -0,0 +1,66 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file WaveClipIndex.cpp
+
+**********************************************************************/
+#include "WaveClipIndex.h"
+
+#include <algorithm>
+
+#include "WaveClip.h"
+
+WaveClipIndex::WaveClipIndex(const WaveClipHolders &clips, size_t version)
+   : mVersion{ version }
+{
+   mEntries.reserve(clips.size());
+   size_t position = 0;
+   for (const auto &pClip : clips) {
+      const auto start = pClip->GetPlayStartTime();
+      const auto end = pClip->GetPlayEndTime();
+      const auto startSample = pClip->GetPlayStartSample();
+      const auto endSample = pClip->GetPlayEndSample();
+      mEntries.push_back({ pClip.get(), position++,
+         start, end, startSample, endSample, end, endSample });
+   }
+   // Stable, so that clips with equal start times keep their order
+   std::stable_sort(mEntries.begin(), mEntries.end(),
+      [](const Entry &a, const Entry &b){ return a.start < b.start; });
+
+   for (size_t ii = 0, size = mEntries.size(); ii < size; ++ii) {
+      auto &entry = mEntries[ii];
+      // Regions must also not be reversed, for the starts to be in order
+      mDisjoint = mDisjoint && entry.end >= entry.start;
+      mDisjointSamples = mDisjointSamples &&
+         entry.endSample >= entry.startSample;
+      if (ii == 0)
+         continue;
+      auto &previous = mEntries[ii - 1];
+      mDisjoint = mDisjoint && entry.start >= previous.maxEnd;
+      // Sample positions are rounded from times, but are in the same order
+      // unless clips have differing rates
+      mDisjointSamples = mDisjointSamples &&
+         entry.startSample >= previous.maxEndSample;
+      entry.maxEnd = std::max(entry.maxEnd, previous.maxEnd);
+      entry.maxEndSample = std::max(entry.maxEndSample, previous.maxEndSample);
+   }
+
+   mByPosition.resize(mEntries.size());
+   for (size_t ii = 0, size = mEntries.size(); ii < size; ++ii)
+      mByPosition[mEntries[ii].position] = ii;
+}
+
+size_t WaveClipIndex::FindLast(double t) const
+{
+   // Entries from the first starting after t are excluded
+   const auto ii = std::upper_bound(mEntries.begin(), mEntries.end(), t,
+      [](double t, const Entry &entry){ return t < entry.start; })
+         - mEntries.begin();
+   // Walk back to the last entry whose end is not before t, while some entry
+   // may still have such an end
+   for (auto jj = ii; jj > 0 && mEntries[jj - 1].maxEnd >= t; --jj)
+      if (mEntries[jj - 1].end >= t)
+         return jj - 1;
+   return mEntries.size();
+}
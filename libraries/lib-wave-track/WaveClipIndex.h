@@ -0,0 +1,134 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  @file WaveClipIndex.h
+  @brief Clips of a WaveTrack sorted by play region, for queries by time or
+  sample in logarithmic time
+
+**********************************************************************/
+
+#ifndef __AUDACITY_WAVE_CLIP_INDEX__
+#define __AUDACITY_WAVE_CLIP_INDEX__
+
+#include <memory>
+#include <vector>
+
+#include "SampleCount.h"
+
+class WaveClip;
+using WaveClipHolder = std::shared_ptr<WaveClip>;
+using WaveClipHolders = std::vector<WaveClipHolder>;
+
+//! Snapshot of the play regions of an array of clips, sorted by start time
+/*!
+ Each entry also records the greatest end of it and all entries before it,
+ so that a query finds the last entry starting before a bound by binary
+ search, then walks back only over entries that reach past the other bound.
+
+ The index does not observe the clips.  WaveTrack gives each of its clips a
+ shared version counter, which the clips advance whenever their play regions
+ may change, and which the track advances whenever it adds or removes clips.
+ The track rebuilds the index when the counter no longer matches
+ GetVersion().
+ */
+class WAVE_TRACK_API WaveClipIndex final
+{
+public:
+   struct Entry {
+      WaveClip *pClip;
+      //! Position in the array from which the index was built
+      size_t position;
+      double start, end;
+      sampleCount startSample, endSample;
+      //! Greatest end of this and all previous entries
+      double maxEnd;
+      sampleCount maxEndSample;
+   };
+
+   WaveClipIndex(const WaveClipHolders &clips, size_t version);
+
+   size_t GetVersion() const { return mVersion; }
+
+   //! Entries sorted by start time
+   const std::vector<Entry> &GetEntries() const { return mEntries; }
+
+   //! Position in GetEntries() of the last entry with start <= t <= end, or
+   //! GetEntries().size() if there is none
+   size_t FindLast(double t) const;
+
+   //! Call visit(WaveClip&) for each clip whose play region meets (t0, t1)
+   /*!
+    Clips are visited in order of start time when their regions are
+    disjoint, and otherwise in the order of the array from which the index
+    was built, so that of overlapping clips the same one prevails as before
+    there was an index
+    */
+   template<typename Visit>
+   void VisitOverlapping(double t0, double t1, const Visit &visit) const
+   {
+      Visit_(t0, t1, &Entry::start, &Entry::end, &Entry::maxEnd,
+         mDisjoint, visit);
+   }
+
+   //! Call visit(WaveClip&) for each clip whose play region meets the
+   //! samples [s0, s1), in the order described above
+   template<typename Visit>
+   void VisitOverlapping(sampleCount s0, sampleCount s1, const Visit &visit)
+      const
+   {
+      Visit_(s0, s1, &Entry::startSample, &Entry::endSample,
+         &Entry::maxEndSample, mDisjointSamples, visit);
+   }
+
+private:
+   template<typename T, typename Visit>
+   void Visit_(T t0, T t1, T Entry::*start, T Entry::*end, T Entry::*maxEnd,
+      bool disjoint, const Visit &visit) const
+   {
+      if (!disjoint) {
+         for (auto index : mByPosition) {
+            auto &entry = mEntries[index];
+            if (entry.*end > t0 && entry.*start < t1)
+               visit(*entry.pClip);
+         }
+         return;
+      }
+      // Entries from the first starting at or after t1 are excluded
+      auto ii = LowerBound(t1, start);
+      // Walk back while some entry may end after t0
+      auto first = ii;
+      while (first > 0 && mEntries[first - 1].*maxEnd > t0)
+         --first;
+      for (; first < ii; ++first) {
+         auto &entry = mEntries[first];
+         if (entry.*end > t0 && entry.*start < t1)
+            visit(*entry.pClip);
+      }
+   }
+
+   //! Position of the first entry whose start is not before t
+   template<typename T> size_t LowerBound(T t, T Entry::*start) const
+   {
+      size_t lo = 0, hi = mEntries.size();
+      while (lo < hi) {
+         const auto mid = (lo + hi) / 2;
+         if (mEntries[mid].*start < t)
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      return lo;
+   }
+
+   std::vector<Entry> mEntries;
+   //! Positions in mEntries, in the order of the array from which the index
+   //! was built
+   std::vector<size_t> mByPosition;
+   size_t mVersion;
+   //! Whether no play regions overlap, in time, or in samples
+   bool mDisjoint{ true };
+   bool mDisjointSamples{ true };
+};
+
+#endif
@@ -30,6 +30,7 @@ from the project that will own the track.
 
 #include "WideClip.h"
 #include "WaveClip.h"
+#include "WaveClipIndex.h"
 
 #include <wx/defs.h>
 #include <wx/debug.h>
@@ -1172,11 +1173,8 @@ std::shared_ptr<WaveClip> WaveTrack::RemoveAndReturnClip(WaveClip* clip)
 {
    // Be clear about who owns the clip!!
    auto it = FindClip(mClips, clip);
-   if (it != mClips.end()) {
-      auto result = std::move(*it); // Array stops owning the clip, before we shrink it
-      mClips.erase(it);
-      return result;
-   }
+   if (it != mClips.end())
+      return EraseClip(it);
    else
       return {};
 }
@@ -1328,7 +1326,7 @@ void WaveTrack::HandleClear(double t0, double t1,
    {
       auto myIt = FindClip(mClips, clip);
       if (myIt != mClips.end())
-         mClips.erase(myIt); // deletes the clip!
+         EraseClip(myIt); // deletes the clip!
       else
          wxASSERT(false);
    }
@@ -1577,7 +1575,31 @@ void WaveTrack::InsertClip(WaveClipHolder clip)
    const auto& tempo = GetProjectTempo();
    if (tempo.has_value())
       clip->OnProjectTempoChange(std::nullopt, *tempo);
+   clip->SetRegionVersion(mpClipsVersion);
    mClips.push_back(std::move(clip));
+   ++*mpClipsVersion;
+}
+
+WaveClipHolder WaveTrack::EraseClip(WaveClipHolders::iterator it)
+{
+   auto result = std::move(*it); // Array stops owning the clip, before we shrink it
+   mClips.erase(it);
+   result->SetRegionVersion({});
+   ++*mpClipsVersion;
+   return result;
+}
+
+std::shared_ptr<const WaveClipIndex> WaveTrack::GetClipIndex() const
+{
+   // Read the version before the clips, so that changes made while building
+   // cause another rebuild next time
+   const size_t version = *mpClipsVersion;
+   auto pIndex = std::atomic_load(&mpClipIndex);
+   if (!pIndex || pIndex->GetVersion() != version) {
+      pIndex = std::make_shared<const WaveClipIndex>(mClips, version);
+      std::atomic_store(&mpClipIndex, pIndex);
+   }
+   return pIndex;
 }
 
 /*! @excsafety{Weak} */
@@ -1801,7 +1823,7 @@ void WaveTrack::Join(double t0, double t1)
       t = newClip->GetPlayEndTime();
 
       auto it = FindClip(mClips, clip);
-      mClips.erase(it); // deletes the clip
+      EraseClip(it); // deletes the clip
    }
 }
 
@@ -2203,6 +2225,35 @@ float WaveTrack::GetRMS(double t0, double t1, bool mayThrow) const
    return length > 0 ? sqrt(sumsq / length.as_double()) : 0.0;
 }
 
+double WaveTrack::GetMean(double t0, double t1, bool mayThrow) const
+{
+   if (t0 > t1) {
+      if (mayThrow)
+         THROW_INCONSISTENCY_EXCEPTION;
+      return 0.0;
+   }
+
+   if (t0 == t1)
+      return 0.0;
+
+   double sum = 0.0;
+   sampleCount length = 0;
+
+   for (const auto &clip: mClips)
+   {
+      if (t1 >= clip->GetPlayStartTime() && t0 <= clip->GetPlayEndTime())
+      {
+         auto clipStart = clip->TimeToSequenceSamples(std::max(t0, clip->GetPlayStartTime()));
+         auto clipEnd = clip->TimeToSequenceSamples(std::min(t1, clip->GetPlayEndTime()));
+
+         // TODO wide wave tracks -- choose correct channel
+         sum += clip->GetSum(0, t0, t1, mayThrow);
+         length += (clipEnd - clipStart);
+      }
+   }
+   return length > 0 ? sum / length.as_double() : 0.0;
+}
+
 bool WaveTrack::Get(
    size_t iChannel, size_t nBuffers, samplePtr buffers[], sampleFormat format,
    sampleCount start, size_t len, bool backwards, fillFormat fill,
@@ -2245,14 +2296,11 @@ bool WaveTrack::GetOne(
    bool doClear = true;
    bool result = true;
    sampleCount samplesCopied = 0;
-   for (const auto &clip: mClips)
-   {
-      if (start >= clip->GetPlayStartSample() && start+len <= clip->GetPlayEndSample())
-      {
+   const auto pIndex = GetClipIndex();
+   pIndex->VisitOverlapping(start, start + len, [&](const WaveClip &clip) {
+      if (start >= clip.GetPlayStartSample() && start+len <= clip.GetPlayEndSample())
          doClear = false;
-         break;
-      }
-   }
+   });
    if (doClear)
    {
       // Usually we fill in empty space with zero
@@ -2272,17 +2320,16 @@ bool WaveTrack::GetOne(
       }
    }
 
-   // Iterate the clips.  They are not necessarily sorted by time.
-   for (const auto &clip: mClips)
-   {
-      auto clipStart = clip->GetPlayStartSample();
-      auto clipEnd = clip->GetPlayEndSample();
+   // Visit the clips that overlap the samples.
+   pIndex->VisitOverlapping(start, start + len, [&](const WaveClip &clip) {
+      auto clipStart = clip.GetPlayStartSample();
+      auto clipEnd = clip.GetPlayEndSample();
 
       if (clipEnd > start && clipStart < start+len)
       {
          // Clip sample region and Get/Put sample region overlap
          auto samplesToCopy =
-            std::min( start+len - clipStart, clip->GetPlaySamplesCount() );
+            std::min( start+len - clipStart, clip.GetPlaySamplesCount() );
          auto startDelta = clipStart - start;
          decltype(startDelta) inclipDelta = 0;
          if (startDelta < 0)
@@ -2302,7 +2349,7 @@ bool WaveTrack::GetOne(
             // samplesToCopy is positive and not more than len
          }
 
-         if (!clip->GetSamples(0,
+         if (!clip.GetSamples(0,
                (samplePtr)(((char*)buffer) +
                            startDelta.as_size_t() *
                            SAMPLE_SIZE(format)),
@@ -2311,7 +2358,7 @@ bool WaveTrack::GetOne(
          else
             samplesCopied += samplesToCopy;
       }
-   }
+   });
    if( pNumWithinClips )
       *pNumWithinClips = samplesCopied;
    if (result == true && backwards)
@@ -2396,16 +2443,15 @@ ChannelSampleView WaveTrack::GetOneSampleView(
 void WaveTrack::Set(constSamplePtr buffer, sampleFormat format,
    sampleCount start, size_t len, sampleFormat effectiveFormat)
 {
-   for (const auto &clip: mClips)
-   {
-      auto clipStart = clip->GetPlayStartSample();
-      auto clipEnd = clip->GetPlayEndSample();
+   GetClipIndex()->VisitOverlapping(start, start + len, [&](WaveClip &clip) {
+      auto clipStart = clip.GetPlayStartSample();
+      auto clipEnd = clip.GetPlayEndSample();
 
       if (clipEnd > start && clipStart < start+len)
       {
          // Clip sample region and Get/Put sample region overlap
          auto samplesToCopy =
-            std::min( start+len - clipStart, clip->GetPlaySamplesCount() );
+            std::min( start+len - clipStart, clip.GetPlaySamplesCount() );
          auto startDelta = clipStart - start;
          decltype(startDelta) inclipDelta = 0;
          if (startDelta < 0)
@@ -2425,12 +2471,12 @@ void WaveTrack::Set(constSamplePtr buffer, sampleFormat format,
             // samplesToCopy is positive and not more than len
          }
 
-         clip->SetSamples(0,
+         clip.SetSamples(0,
             buffer + startDelta.as_size_t() * SAMPLE_SIZE(format),
             format, inclipDelta, samplesToCopy.as_size_t(), effectiveFormat );
-         clip->MarkChanged();
+         clip.MarkChanged();
       }
-   }
+   });
 }
 
 sampleFormat WaveTrack::WidestEffectiveFormat() const
@@ -2458,7 +2504,7 @@ bool WaveTrack::HasTrivialEnvelope() const
       [](const auto &pClip){ return pClip->GetEnvelope()->IsTrivial(); });
 }
 
-void WaveTrack::GetEnvelopeValues(
+bool WaveTrack::GetEnvelopeValues(
    double* buffer, size_t bufferLen, double t0, bool backwards) const
 {
    if (backwards)
@@ -2482,11 +2528,16 @@ void WaveTrack::GetEnvelopeValues(
    const auto rate = GetRate();
    auto tstep = 1.0 / rate;
    double endTime = t0 + tstep * bufferLen;
-   for (const auto &clip: mClips)
-   {
+   // Values are all equal if each clip's are, and those of a clip that does
+   // not fill the buffer are unit, like the gaps between clips
+   bool constant = true;
+   bool consistent = true;
+   GetClipIndex()->VisitOverlapping(startTime, endTime, [&](WaveClip &clip) {
+      if (!consistent)
+         return;
       // IF clip intersects startTime..endTime THEN...
-      auto dClipStartTime = clip->GetPlayStartTime();
-      auto dClipEndTime = clip->GetPlayEndTime();
+      auto dClipStartTime = clip.GetPlayStartTime();
+      auto dClipEndTime = clip.GetPlayEndTime();
       if ((dClipStartTime < endTime) && (dClipEndTime > startTime))
       {
          auto rbuf = buffer;
@@ -2507,14 +2558,16 @@ void WaveTrack::GetEnvelopeValues(
 
          if (rt0 + rlen*tstep > dClipEndTime)
          {
-            auto nClipLen = clip->GetPlayEndSample() - clip->GetPlayStartSample();
+            auto nClipLen = clip.GetPlayEndSample() - clip.GetPlayStartSample();
 
-            if (nClipLen <= 0) // Testing for bug 641, this problem is consistently '== 0', but doesn't hurt to check <.
+            if (nClipLen <= 0) { // Testing for bug 641, this problem is consistently '== 0', but doesn't hurt to check <.
+               consistent = false;
                return;
+            }
 
             // This check prevents problem cited in http://bugzilla.audacityteam.org/show_bug.cgi?id=528#c11,
             // Gale's cross_fade_out project, which was already corrupted by bug 528.
-            // This conditional prevents the previous write past the buffer end, in clip->GetEnvelope() call.
+            // This conditional prevents the previous write past the buffer end, in clip.GetEnvelope() call.
             // Never increase rlen here.
             // PRL bug 827:  rewrote it again
             rlen = limitSampleBufferSize( rlen, nClipLen );
@@ -2522,34 +2575,41 @@ void WaveTrack::GetEnvelopeValues(
          }
          // Samples are obtained for the purpose of rendering a wave track,
          // so quantize time
-         clip->GetEnvelope()->GetValues(rbuf, rlen, rt0, tstep);
+         const auto clipConstant =
+            clip.GetEnvelope()->GetValues(rbuf, rlen, rt0, tstep);
+         constant = constant && clipConstant &&
+            (rlen == 0 || rlen == bufferLen || rbuf[0] == 1.0);
       }
-   }
-   if (backwards)
+   });
+   if (!consistent)
+      return false;
+   if (backwards && !constant)
       std::reverse(buffer, buffer + bufferLen);
+   return constant;
 }
 
 // When the time is both the end of a clip and the start of the next clip, the
 // latter clip is returned.
 WaveClip* WaveTrack::GetClipAtTime(double time)
 {
-
-   const auto clips = SortedClipArray();
-   auto p = std::find_if(clips.rbegin(), clips.rend(), [&] (WaveClip* const& clip) {
-      return time >= clip->GetPlayStartTime() && time <= clip->GetPlayEndTime(); });
+   const auto pIndex = GetClipIndex();
+   const auto &entries = pIndex->GetEntries();
+   auto ii = pIndex->FindLast(time);
+   if (ii == entries.size())
+      return nullptr;
 
    // When two clips are immediately next to each other, the GetPlayEndTime() of the first clip
    // and the GetPlayStartTime() of the second clip may not be exactly equal due to rounding errors.
    // If "time" is the end time of the first of two such clips, and the end time is slightly
    // less than the start time of the second clip, then the first rather than the
    // second clip is found by the above code. So correct this.
-   if (p != clips.rend() && p != clips.rbegin() &&
-      time == (*p)->GetPlayEndTime() &&
-      (*p)->SharesBoundaryWithNextClip(*(p-1))) {
-      p--;
+   if (ii + 1 < entries.size() &&
+      time == entries[ii].end &&
+      entries[ii].pClip->SharesBoundaryWithNextClip(entries[ii + 1].pClip)) {
+      ++ii;
    }
 
-   return p != clips.rend() ? *p : nullptr;
+   return entries[ii].pClip;
 }
 
 Envelope* WaveTrack::GetEnvelopeAtTime(double time)
@@ -2838,7 +2898,7 @@ void WaveTrack::MergeClips(int clipidx1, int clipidx2)
    // use No-fail-guarantee for the rest
    // Delete second clip
    auto it = FindClip(mClips, clip2);
-   mClips.erase(it);
+   EraseClip(it);
 }
 
 /*! @excsafety{Weak} -- Partial completion may leave clips at differing sample rates!
@@ -2853,27 +2913,26 @@ void WaveTrack::Resample(int rate, BasicUI::ProgressDialog *progress)
 }
 
 namespace {
-   template < typename Cont1, typename Cont2 >
-   Cont1 FillSortedClipArray(const Cont2& mClips)
+   template < typename Cont >
+   Cont FillSortedClipArray(const WaveClipIndex &index)
    {
-      Cont1 clips;
-      for (const auto &clip : mClips)
-         clips.push_back(clip.get());
-      std::sort(clips.begin(), clips.end(),
-         [](const WaveClip *a, const WaveClip *b)
-      { return a->GetPlayStartTime() < b->GetPlayStartTime(); });
+      Cont clips;
+      const auto &entries = index.GetEntries();
+      clips.reserve(entries.size());
+      for (const auto &entry : entries)
+         clips.push_back(entry.pClip);
       return clips;
    }
 }
 
 WaveClipPointers WaveTrack::SortedClipArray()
 {
-   return FillSortedClipArray<WaveClipPointers>(mClips);
+   return FillSortedClipArray<WaveClipPointers>(*GetClipIndex());
 }
 
 WaveClipConstPointers WaveTrack::SortedClipArray() const
 {
-   return FillSortedClipArray<WaveClipConstPointers>(mClips);
+   return FillSortedClipArray<WaveClipConstPointers>(*GetClipIndex());
 }
 
 auto WaveTrack::AllClipsIterator::operator ++ () -> AllClipsIterator &
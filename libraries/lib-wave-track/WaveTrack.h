@@ -16,6 +16,7 @@
 #include "SampleFormat.h"
 #include "SampleTrack.h"
 
+#include <atomic>
 #include <vector>
 #include <functional>
 #include <wx/thread.h>
@@ -31,6 +32,7 @@ class TimeWarper;
 class ClipInterface;
 class Sequence;
 class WaveClip;
+class WaveClipIndex;
 class AudioSegmentSampleView;
 
 //! Clips are held by shared_ptr, not for sharing, but to allow weak_ptr
@@ -300,7 +302,7 @@ private:
 
    bool HasTrivialEnvelope() const override;
 
-   void GetEnvelopeValues(
+   bool GetEnvelopeValues(
       double* buffer, size_t bufferLen, double t0,
       bool backwards) const override;
 
@@ -319,6 +321,15 @@ private:
     */
    float GetRMS(double t0, double t1, bool mayThrow = true) const;
 
+   // Get the mean, or DC offset, from the unique channel
+   /*!
+    Whole sample blocks contribute their remembered sums; only the samples
+    of partly covered blocks, and of blocks not yet summed, are read
+    @pre `t0 <= t1`
+    TODO wide wave tracks -- require a channel number
+    */
+   double GetMean(double t0, double t1, bool mayThrow = true) const;
+
    //
    // MM: We now have more than one sequence and envelope per track, so
    // instead of GetEnvelope() we have the following function which gives the
@@ -365,6 +376,8 @@ private:
    //! Get access to the (visible) clips in the tracks, in unspecified order
    //! (not necessarily sequenced in time).
    /*!
+    Callers must not insert or erase clips through the reference; use AddClip
+    and RemoveAndReturnClip, which keep the index of clips up to date
     @post all pointers are non-null
     */
    WaveClipHolders &GetClips() { return mClips; }
@@ -604,7 +617,8 @@ protected:
    //
 
    /*!
-    * Do not call `mClips.push_back` directly. Use `InsertClip` instead.
+    * Do not call `mClips.push_back` or `mClips.erase` directly. Use
+    * `InsertClip` or `EraseClip` instead.
     * @invariant all are non-null and match `this->GetWidth()`
     */
    WaveClipHolders mClips;
@@ -637,11 +651,28 @@ private:
    //! `mClips.push_back`.
    void InsertClip(WaveClipHolder clip);
 
+   //! Use this instead of `mClips.erase`
+   //! @return the clip, which is destroyed if the caller ignores it
+   WaveClipHolder EraseClip(WaveClipHolders::iterator it);
+
+   //! Index of mClips by play region, rebuilt if outdated
+   /*!
+    Safe to call from several threads, which may each rebuild it
+    */
+   std::shared_ptr<const WaveClipIndex> GetClipIndex() const;
+
    SampleBlockFactoryPtr mpFactory;
 
    wxCriticalSection mFlushCriticalSection;
    wxCriticalSection mAppendCriticalSection;
    double mLegacyProjectFileOffset;
+
+   //! Given to each of mClips, which advance it when their play regions
+   //! change; also advanced when clips are inserted or erased
+   const std::shared_ptr<std::atomic<size_t>> mpClipsVersion{
+      std::make_shared<std::atomic<size_t>>(0) };
+   //! Accessed only with std::atomic_load and std::atomic_store
+   mutable std::shared_ptr<const WaveClipIndex> mpClipIndex;
 };
 
 ENUMERATE_TRACK_TYPE(WaveTrack);
@@ -0,0 +1,87 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SequenceTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "Sequence.h"
+#include "TestSampleBlockFactory.h"
+#include "WaveTrack.h"
+
+#include <numeric>
+
+namespace {
+//! Small integers, so that sums in any order are exact
+std::vector<float> MakeSamples(size_t count)
+{
+   std::vector<float> samples(count);
+   for (size_t ii = 0; ii < count; ++ii)
+      samples[ii] = float(int(ii % 13) - 5);
+   return samples;
+}
+
+double Sum(const std::vector<float> &samples, size_t start, size_t len)
+{
+   return std::accumulate(
+      samples.begin() + start, samples.begin() + start + len, 0.0);
+}
+}
+
+TEST_CASE("Sequence::GetSum sums whole and partial blocks")
+{
+   constexpr size_t blockSize = 10, nBlocks = 5;
+   const auto pFactory = std::make_shared<TestSampleBlockFactory>();
+   Sequence sequence{ pFactory, SampleFormats{ floatSample, floatSample } };
+   const auto samples = MakeSamples(blockSize * nBlocks);
+   for (size_t b = 0; b < nBlocks; ++b)
+      sequence.AppendSharedBlock(pFactory->Create(
+         reinterpret_cast<constSamplePtr>(samples.data() + b * blockSize),
+         blockSize, floatSample));
+
+   REQUIRE(sequence.GetSum(0, 0, true) == 0);
+   REQUIRE(sequence.GetSum(0, samples.size(), true) ==
+      Sum(samples, 0, samples.size()));
+   REQUIRE(pFactory->wholeBlockSums == nBlocks);
+
+   for (size_t start : { 0, 1, 9, 10, 11, 25, 49 })
+      for (size_t len : { 1, 2, 9, 10, 11, 20, 30 }) {
+         if (start + len > samples.size())
+            continue;
+         REQUIRE(sequence.GetSum(start, len, true) ==
+            Sum(samples, start, len));
+      }
+
+   // Partial blocks at both ends, whole blocks between
+   const auto count = pFactory->wholeBlockSums;
+   REQUIRE(sequence.GetSum(5, 40, true) == Sum(samples, 5, 40));
+   REQUIRE(pFactory->wholeBlockSums == count + 3);
+}
+
+TEST_CASE("WaveTrack::GetMean averages samples over time ranges")
+{
+   constexpr double rate = 1000;
+   const auto pFactory = std::make_shared<TestSampleBlockFactory>();
+   const auto track = std::make_shared<WaveTrack>(pFactory, floatSample, rate);
+   // Several blocks of the track's own size, and a partial one
+   const auto count = 2 * track->GetMaxBlockSize() + 777;
+   const auto samples = MakeSamples(count);
+   track->Append(reinterpret_cast<constSamplePtr>(samples.data()),
+      floatSample, count);
+   track->Flush();
+
+   const auto mean = [&](size_t start, size_t len) {
+      return Sum(samples, start, len) / len;
+   };
+   const auto end = count / rate;
+   REQUIRE(track->GetMean(0, end) == Approx(mean(0, count)));
+   REQUIRE(track->GetMean(0.5, 0.5) == 0);
+   REQUIRE(track->GetMean(0.25, 1.75) == Approx(mean(250, 1500)));
+   REQUIRE(track->GetMean(0.001, end - 0.001) == Approx(mean(1, count - 2)));
+   // Beyond the end, only the samples count
+   REQUIRE(track->GetMean(end - 1, end + 10) ==
+      Approx(mean(count - 1000, 1000)));
+}
@@ -0,0 +1,105 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramTileCacheTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "SpectrogramTileCache.h"
+#include "TestSampleBlockFactory.h"
+
+namespace {
+constexpr size_t nBins = 4;
+constexpr size_t columnBytes = nBins * sizeof(float);
+const SpectrogramTileCache::Key key{ 0, 0, 256, 1, 0, 44100.0 };
+
+std::vector<float> Column(float value)
+{
+   return std::vector<float>(nBins, value);
+}
+
+bool Finds(SpectrogramTileCache &cache, const SampleBlockPtr &pBlock,
+   size_t frame, float value)
+{
+   std::vector<float> out(nBins);
+   return cache.Find(pBlock, key, 1, frame, out.data(), nBins) &&
+      out == Column(value);
+}
+}
+
+TEST_CASE("SpectrogramTileCache finds what was inserted")
+{
+   TestSampleBlockFactory factory;
+   const auto pBlock = MakeConstantBlock(factory, 4, 0);
+   SpectrogramTileCache cache{ 1 << 20 };
+   REQUIRE(cache.IsEnabled());
+
+   cache.Insert(pBlock, key, 1, 3, Column(3).data(), nBins);
+   REQUIRE(Finds(cache, pBlock, 3, 3));
+   // Another frame of the same tile, another hop, and other settings
+   REQUIRE(!Finds(cache, pBlock, 4, 3));
+   std::vector<float> out(nBins);
+   REQUIRE(!cache.Find(pBlock, key, 2, 3, out.data(), nBins));
+   auto otherKey = key;
+   otherKey.windowSize *= 2;
+   REQUIRE(!cache.Find(pBlock, otherKey, 1, 3, out.data(), nBins));
+}
+
+TEST_CASE("SpectrogramTileCache evicts the least recently used tile")
+{
+   TestSampleBlockFactory factory;
+   const auto pBlock1 = MakeConstantBlock(factory, 4, 0);
+   const auto pBlock2 = MakeConstantBlock(factory, 4, 0);
+   const auto pBlock3 = MakeConstantBlock(factory, 4, 0);
+   // Room for the columns of two tiles
+   SpectrogramTileCache cache{ 2 * columnBytes };
+
+   cache.Insert(pBlock1, key, 1, 0, Column(1).data(), nBins);
+   cache.Insert(pBlock2, key, 1, 0, Column(2).data(), nBins);
+   // Use the older tile, so that the other is evicted next
+   REQUIRE(Finds(cache, pBlock1, 0, 1));
+   cache.Insert(pBlock3, key, 1, 0, Column(3).data(), nBins);
+
+   REQUIRE(Finds(cache, pBlock1, 0, 1));
+   REQUIRE(!Finds(cache, pBlock2, 0, 2));
+   REQUIRE(Finds(cache, pBlock3, 0, 3));
+
+   // Another column of a cached tile also evicts others
+   cache.Insert(pBlock3, key, 1, 1, Column(4).data(), nBins);
+   REQUIRE(!Finds(cache, pBlock1, 0, 1));
+   REQUIRE(Finds(cache, pBlock3, 0, 3));
+   REQUIRE(Finds(cache, pBlock3, 1, 4));
+}
+
+TEST_CASE("SpectrogramTileCache ignores tiles of destroyed blocks")
+{
+   TestSampleBlockFactory factory;
+   // Keeps the memory of the block, so that another shared pointer can
+   // have the same address, as if a new block were made there
+   const auto pOwner = MakeConstantBlock(factory, 4, 0);
+   SampleBlockPtr pBlock{ pOwner.get(), [](SampleBlock*){} };
+   SpectrogramTileCache cache{ 1 << 20 };
+
+   cache.Insert(pBlock, key, 1, 0, Column(1).data(), nBins);
+   REQUIRE(Finds(cache, pBlock, 0, 1));
+
+   pBlock.reset();
+   const SampleBlockPtr pReused{ pOwner.get(), [](SampleBlock*){} };
+   REQUIRE(!Finds(cache, pReused, 0, 1));
+
+   cache.Insert(pReused, key, 1, 0, Column(2).data(), nBins);
+   REQUIRE(Finds(cache, pReused, 0, 2));
+}
+
+TEST_CASE("SpectrogramTileCache with no budget stores nothing")
+{
+   TestSampleBlockFactory factory;
+   const auto pBlock = MakeConstantBlock(factory, 4, 0);
+   SpectrogramTileCache cache{ 0 };
+   REQUIRE(!cache.IsEnabled());
+   cache.Insert(pBlock, key, 1, 0, Column(1).data(), nBins);
+   REQUIRE(!Finds(cache, pBlock, 0, 1));
+}
@@ -0,0 +1,77 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SummaryPyramidTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "Sequence.h"
+#include "SummaryPyramid.h"
+#include "TestSampleBlockFactory.h"
+
+namespace {
+BlockArray MakeBlocks(SampleBlockFactory &factory, size_t nBlocks)
+{
+   constexpr size_t blockSize = 4;
+   BlockArray blocks;
+   for (size_t b = 0; b < nBlocks; ++b)
+      blocks.emplace_back(MakeConstantBlock(factory, blockSize, b),
+         b * blockSize);
+   return blocks;
+}
+}
+
+TEST_CASE("SummaryPyramid::Update ignores the blocks while the version holds")
+{
+   TestSampleBlockFactory factory;
+   auto blocks = MakeBlocks(factory, 1000);
+   SummaryPyramid pyramid;
+   pyramid.Update(blocks, 1, true);
+   REQUIRE(pyramid.Query(0, blocks.size()).max == 999);
+
+   blocks[500].sb = MakeConstantBlock(factory, 4, 5000);
+   pyramid.Update(blocks, 1, true);
+   REQUIRE(pyramid.Query(0, blocks.size()).max == 999);
+
+   pyramid.Update(blocks, 2, true);
+   REQUIRE(pyramid.Query(0, blocks.size()).max == 5000);
+   REQUIRE(pyramid.Query(0, 500).max == 499);
+}
+
+TEST_CASE("SummaryPyramid::Update summarizes only the changed blocks")
+{
+   for (size_t nBlocks : { 100, 10000 }) {
+      TestSampleBlockFactory factory;
+      auto blocks = MakeBlocks(factory, nBlocks);
+      SummaryPyramid pyramid;
+      pyramid.Update(blocks, 1, true);
+      REQUIRE(factory.wholeBlockStatistics == nBlocks);
+
+      blocks[nBlocks / 2].sb = MakeConstantBlock(factory, 4, -1);
+      pyramid.Update(blocks, 2, true);
+      REQUIRE(factory.wholeBlockStatistics == nBlocks + 1);
+      REQUIRE(pyramid.Query(0, nBlocks).min == -1);
+   }
+}
+
+TEST_CASE("Sequence::SummarizeBlocks revalidates only after edits")
+{
+   const auto pFactory = std::make_shared<TestSampleBlockFactory>();
+   Sequence sequence{ pFactory, SampleFormats{ floatSample, floatSample } };
+   constexpr size_t nBlocks = 1000;
+   for (size_t b = 0; b < nBlocks; ++b)
+      sequence.AppendSharedBlock(MakeConstantBlock(*pFactory, 4, b));
+
+   REQUIRE(sequence.SummarizeBlocks(0, nBlocks, true).max == nBlocks - 1);
+   const auto count = pFactory->wholeBlockStatistics;
+   for (size_t b = 0; b < nBlocks; ++b)
+      REQUIRE(sequence.SummarizeBlocks(b, b + 1, true).max == b);
+   REQUIRE(pFactory->wholeBlockStatistics == count);
+
+   sequence.AppendSharedBlock(MakeConstantBlock(*pFactory, 4, nBlocks));
+   REQUIRE(sequence.SummarizeBlocks(0, nBlocks + 1, true).max == nBlocks);
+   REQUIRE(pFactory->wholeBlockStatistics == count + 1);
+}
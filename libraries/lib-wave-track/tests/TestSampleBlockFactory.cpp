@@ -0,0 +1,126 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  TestSampleBlockFactory.cpp
+
+**********************************************************************/
+#include "TestSampleBlockFactory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+
+namespace {
+class TestSampleBlock final : public SampleBlock
+{
+public:
+   TestSampleBlock(TestSampleBlockFactory &factory, SampleBlockID id,
+      std::vector<float> samples)
+      : mFactory{ factory }, mID{ id }, mSamples{ std::move(samples) }
+   {}
+
+   void CloseLock() noexcept override {}
+   SampleBlockID GetBlockID() const override { return mID; }
+   BlockSampleView GetFloatSampleView() override
+   {
+      return std::make_shared<std::vector<float>>(mSamples);
+   }
+   size_t GetSampleCount() const override { return mSamples.size(); }
+   bool GetSummary256(float *dest, size_t, size_t numframes) override
+   {
+      std::fill(dest, dest + 3 * numframes, 0.0f);
+      return false;
+   }
+   bool GetSummary64k(float *dest, size_t, size_t numframes) override
+   {
+      std::fill(dest, dest + 3 * numframes, 0.0f);
+      return false;
+   }
+   size_t GetSpaceUsage() const override
+   {
+      return mSamples.size() * sizeof(float);
+   }
+   void SaveXML(XMLWriter &) override {}
+
+protected:
+   size_t DoGetSamples(samplePtr dest, sampleFormat destformat,
+      size_t sampleoffset, size_t numsamples) override
+   {
+      CopySamples(
+         reinterpret_cast<constSamplePtr>(mSamples.data() + sampleoffset),
+         floatSample, dest, destformat, numsamples);
+      return numsamples;
+   }
+   MinMaxRMS DoGetMinMaxRMS(size_t start, size_t len) override
+   {
+      return Statistics(start, len);
+   }
+   MinMaxRMS DoGetMinMaxRMS() const override
+   {
+      ++mFactory.wholeBlockStatistics;
+      return Statistics(0, mSamples.size());
+   }
+   using SampleBlock::DoGetSum;
+   double DoGetSum() override
+   {
+      ++mFactory.wholeBlockSums;
+      return SampleBlock::DoGetSum();
+   }
+
+private:
+   MinMaxRMS Statistics(size_t start, size_t len) const
+   {
+      float min = FLT_MAX, max = -FLT_MAX;
+      double sumsq = 0;
+      for (auto ii = start; ii < start + len; ++ii) {
+         min = std::min(min, mSamples[ii]);
+         max = std::max(max, mSamples[ii]);
+         sumsq += double(mSamples[ii]) * mSamples[ii];
+      }
+      return { min, max, len ? float(std::sqrt(sumsq / len)) : 0.0f };
+   }
+
+   TestSampleBlockFactory &mFactory;
+   const SampleBlockID mID;
+   const std::vector<float> mSamples;
+};
+}
+
+auto TestSampleBlockFactory::GetActiveBlockIDs() -> SampleBlockIDs
+{
+   return {};
+}
+
+SampleBlockPtr TestSampleBlockFactory::DoCreate(
+   constSamplePtr src, size_t numsamples, sampleFormat srcformat)
+{
+   std::vector<float> samples(numsamples);
+   CopySamples(src, srcformat,
+      reinterpret_cast<samplePtr>(samples.data()), floatSample, numsamples);
+   return std::make_shared<TestSampleBlock>(
+      *this, mNextID++, std::move(samples));
+}
+
+SampleBlockPtr TestSampleBlockFactory::DoCreateSilent(
+   size_t numsamples, sampleFormat)
+{
+   return std::make_shared<TestSampleBlock>(
+      *this, -static_cast<SampleBlockID>(numsamples),
+      std::vector<float>(numsamples));
+}
+
+SampleBlockPtr TestSampleBlockFactory::DoCreateFromXML(
+   sampleFormat, const AttributesList&)
+{
+   return nullptr;
+}
+
+SampleBlockPtr MakeConstantBlock(
+   SampleBlockFactory &factory, size_t numsamples, float value)
+{
+   std::vector<float> samples(numsamples, value);
+   return factory.Create(reinterpret_cast<constSamplePtr>(samples.data()),
+      numsamples, floatSample);
+}
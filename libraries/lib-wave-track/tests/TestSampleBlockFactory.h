@@ -0,0 +1,41 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  TestSampleBlockFactory.h
+
+**********************************************************************/
+#pragma once
+
+#include "SampleBlock.h"
+
+#include <vector>
+
+//! Keeps samples in memory as floats, and computes their statistics as the
+//! project's blocks do, counting how often whole-block statistics are asked
+class TestSampleBlockFactory final : public SampleBlockFactory
+{
+public:
+   SampleBlockIDs GetActiveBlockIDs() override;
+
+   //! Calls of GetMinMaxRMS() for whole blocks
+   size_t wholeBlockStatistics = 0;
+   //! Calls of GetSum() for whole blocks
+   size_t wholeBlockSums = 0;
+
+protected:
+   SampleBlockPtr DoCreate(
+      constSamplePtr src, size_t numsamples, sampleFormat srcformat) override;
+   SampleBlockPtr
+   DoCreateSilent(size_t numsamples, sampleFormat srcformat) override;
+   SampleBlockPtr
+   DoCreateFromXML(sampleFormat srcformat, const AttributesList&) override;
+
+private:
+   SampleBlockID mNextID = 1;
+};
+
+//! Make a block of numsamples float samples, all equal to value
+SampleBlockPtr MakeConstantBlock(
+   SampleBlockFactory &factory, size_t numsamples, float value);
@@ -0,0 +1,155 @@
+/*  SPDX-License-Identifier: GPL-2.0-or-later */
+/*!********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WaveClipIndexTest.cpp
+
+**********************************************************************/
+#include <catch2/catch.hpp>
+
+#include "TestSampleBlockFactory.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+
+#include <algorithm>
+
+namespace {
+constexpr double rate = 10;
+constexpr size_t clipLength = 10;
+
+//! A clip of one second, all of whose samples are value
+WaveClip *MakeClip(WaveTrack &track, double start, float value)
+{
+   const auto clip = track.CreateClip(start);
+   const std::vector<float> samples(clipLength, value);
+   constSamplePtr buffers[]{
+      reinterpret_cast<constSamplePtr>(samples.data()) };
+   clip->Append(buffers, floatSample, clipLength, 1, floatSample);
+   clip->Flush();
+   return clip;
+}
+
+//! Samples of the track, which show which clip covers each position
+std::vector<float> GetSamples(const WaveTrack &track, size_t len)
+{
+   std::vector<float> samples(len);
+   samplePtr buffers[]{ reinterpret_cast<samplePtr>(samples.data()) };
+   track.Get(0, 1, buffers, floatSample, 0, len, false);
+   return samples;
+}
+
+//! Expected samples, for clips given by start sample and value
+std::vector<float> Expected(size_t len,
+   std::initializer_list<std::pair<size_t, float>> clips)
+{
+   std::vector<float> samples(len);
+   for (const auto &[start, value] : clips)
+      std::fill(samples.begin() + start, samples.begin() + start + clipLength,
+         value);
+   return samples;
+}
+
+std::shared_ptr<WaveTrack> MakeTrack()
+{
+   return std::make_shared<WaveTrack>(
+      std::make_shared<TestSampleBlockFactory>(), floatSample, rate);
+}
+}
+
+TEST_CASE("WaveTrack finds clips after clips are inserted and removed")
+{
+   const auto track = MakeTrack();
+   const auto a = MakeClip(*track, 0, 1);
+   const auto b = MakeClip(*track, 2, 2);
+   // Query before each edit, so that an index of the old clips exists
+   REQUIRE(track->GetClipAtTime(0.5) == a);
+   REQUIRE(track->GetClipAtTime(2.5) == b);
+   REQUIRE(track->GetClipAtTime(4.5) == nullptr);
+
+   // Inserted before the others in time, but last in the array
+   const auto c = MakeClip(*track, 4, 3);
+   const auto d = MakeClip(*track, -2, 4);
+   REQUIRE(track->GetClipAtTime(4.5) == c);
+   REQUIRE(track->GetClipAtTime(-1.5) == d);
+   REQUIRE((track->SortedClipArray() == WaveClipPointers{ d, a, b, c }));
+   REQUIRE(GetSamples(*track, 60) ==
+      Expected(60, { { 0, 1 }, { 20, 2 }, { 40, 3 } }));
+
+   auto pB = track->RemoveAndReturnClip(b);
+   REQUIRE(pB.get() == b);
+   REQUIRE(track->GetClipAtTime(2.5) == nullptr);
+   REQUIRE((track->SortedClipArray() == WaveClipPointers{ d, a, c }));
+   REQUIRE(GetSamples(*track, 60) ==
+      Expected(60, { { 0, 1 }, { 40, 3 } }));
+
+   // Put back elsewhere
+   pB->SetPlayStartTime(3);
+   REQUIRE(track->AddClip(pB));
+   REQUIRE(track->GetClipAtTime(2.5) == nullptr);
+   REQUIRE(track->GetClipAtTime(3.5) == b);
+   REQUIRE((track->SortedClipArray() == WaveClipPointers{ d, a, b, c }));
+   REQUIRE(GetSamples(*track, 60) ==
+      Expected(60, { { 0, 1 }, { 30, 2 }, { 40, 3 } }));
+}
+
+TEST_CASE("WaveTrack finds clips after clips are shifted")
+{
+   const auto track = MakeTrack();
+   const auto a = MakeClip(*track, 0, 1);
+   const auto b = MakeClip(*track, 2, 2);
+   REQUIRE((track->SortedClipArray() == WaveClipPointers{ a, b }));
+
+   // Move one clip past the other
+   a->Offset(5);
+   REQUIRE(track->GetClipAtTime(0.5) == nullptr);
+   REQUIRE(track->GetClipAtTime(5.5) == a);
+   REQUIRE((track->SortedClipArray() == WaveClipPointers{ b, a }));
+   REQUIRE(GetSamples(*track, 60) ==
+      Expected(60, { { 20, 2 }, { 50, 1 } }));
+
+   b->SetPlayStartTime(3);
+   REQUIRE(track->GetClipAtTime(2.5) == nullptr);
+   REQUIRE(track->GetClipAtTime(3.5) == b);
+   REQUIRE(GetSamples(*track, 60) ==
+      Expected(60, { { 30, 2 }, { 50, 1 } }));
+
+   // Move all clips, so that the first starts at 1
+   track->SetOffset(1);
+   REQUIRE(track->GetClipAtTime(1.5) == b);
+   REQUIRE(track->GetClipAtTime(3.5) == a);
+   REQUIRE(track->GetClipAtTime(5.5) == nullptr);
+   REQUIRE((track->SortedClipArray() == WaveClipPointers{ b, a }));
+   REQUIRE(GetSamples(*track, 60) ==
+      Expected(60, { { 10, 2 }, { 30, 1 } }));
+
+   // Changes of length also move the end
+   a->InsertSilence(3.5, 1);
+   REQUIRE(track->GetClipAtTime(4.5) == a);
+   REQUIRE(track->GetClipAtTime(5.5) == nullptr);
+}
+
+TEST_CASE("WaveTrack finds clips after the rate changes")
+{
+   const auto track = MakeTrack();
+   const auto a = MakeClip(*track, 0, 1);
+   const auto b = MakeClip(*track, 2, 2);
+   REQUIRE(track->GetClipAtTime(1.5) == nullptr);
+   REQUIRE(GetSamples(*track, 40) ==
+      Expected(40, { { 0, 1 }, { 20, 2 } }));
+
+   // Halving the rate doubles the lengths and the times of the clips, but
+   // leaves their positions in samples
+   track->SetRate(rate / 2);
+   REQUIRE(track->GetClipAtTime(1.5) == a);
+   REQUIRE(track->GetClipAtTime(2.5) == nullptr);
+   REQUIRE(track->GetClipAtTime(5.5) == b);
+   REQUIRE(GetSamples(*track, 40) ==
+      Expected(40, { { 0, 1 }, { 20, 2 } }));
+
+   // Moving a clip at the new rate moves it by fewer samples
+   b->Offset(-1);
+   REQUIRE(track->GetClipAtTime(3.5) == b);
+   REQUIRE(GetSamples(*track, 40) ==
+      Expected(40, { { 0, 1 }, { 15, 2 } }));
+}
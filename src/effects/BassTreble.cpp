@@ -191,6 +191,11 @@ EffectType EffectBassTreble::GetType() const
    return EffectTypeProcess;
 }
 
+bool EffectBassTreble::ProcessesTracksInParallel() const
+{
+   return true;
+}
+
 auto EffectBassTreble::RealtimeSupport() const -> RealtimeSince
 {
    return RealtimeSince::After_3_1;
@@ -245,6 +245,9 @@ struct EffectDistortion::Instance
    size_t ProcessBlock(EffectSettings& settings,
       const float* const* inBlock, float* const* outBlock, size_t blockLen)  override;
 
+   std::optional<SampleCount> GetHistoryLength(
+      const EffectSettings &settings, double sampleRate) const override;
+
    bool RealtimeInitialize(EffectSettings& settings, double) override;
 
    bool RealtimeAddProcessor(EffectSettings& settings,
@@ -353,6 +356,21 @@ EffectType EffectDistortion::GetType() const
    return EffectTypeProcess;
 }
 
+bool EffectDistortion::ProcessesTracksInParallel() const
+{
+   return true;
+}
+
+auto EffectDistortion::Instance::GetHistoryLength(
+   const EffectSettings &settings, double) const -> std::optional<SampleCount>
+{
+   // The DC blocking filter keeps a running sum, which does not restart
+   // exactly in the middle of a track
+   if (GetSettings(settings).mDCBlock)
+      return {};
+   return 0;
+}
+
 auto EffectDistortion::RealtimeSupport() const -> RealtimeSince
 {
    return RealtimeSince::After_3_1;
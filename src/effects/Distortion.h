@@ -106,6 +106,7 @@ public:
 
    struct Editor;
    struct Instance;
+   bool ProcessesTracksInParallel() const override;
    std::shared_ptr<EffectInstance> MakeInstance() const override;
 
 private:
@@ -22,6 +22,7 @@
 #include "EffectEditor.h"
 #include "LoadEffects.h"
 
+#include <algorithm>
 #include <math.h>
 
 
@@ -159,6 +160,8 @@ bool EffectFindClipping::ProcessOne(LabelTrack * lt,
    decltype(len) s = 0, startrun = 0, stoprun = 0, samps = 0;
    decltype(blockSize) block = 0;
    double startTime = -1.0;
+   // Samples before this position may be clipped, as the summaries showed
+   decltype(len) mayClipEnd = 0;
 
    while (s < len) {
       if (block == 0) {
@@ -169,6 +172,41 @@ bool EffectFindClipping::ProcessOne(LabelTrack * lt,
             break;
          }
 
+         if (s >= mayClipEnd) {
+            // Use the min and max of each sample block, kept in memory, to
+            // pass over the spans that cannot be clipped without reading them
+            const auto span =
+               limitSampleBufferSize( wt->GetBestBlockSize(start + s), len - s );
+            const auto range = wt->GetMinMax(
+               wt->LongSamplesToTime(start + s),
+               wt->LongSamplesToTime(start + s + span));
+            if (range.first > -MAX_AUDIO && range.second < MAX_AUDIO) {
+               // Do as the loop below does for span unclipped samples
+               if (startrun >= mStart) {
+                  const auto needed = std::max<sampleCount>(mStop - stoprun, 1);
+                  if (needed <= span) {
+                     samps += needed;
+                     lt->AddLabel(SelectedRegion(startTime,
+                                                wt->LongSamplesToTime(start + s + needed - 1 - mStop)),
+                                 wxString::Format(wxT("%lld of %lld"), startrun.as_long_long(), (samps - mStop).as_long_long()));
+                     startrun = 0;
+                     stoprun = 0;
+                     samps = 0;
+                  }
+                  else {
+                     stoprun += span;
+                     samps += span;
+                  }
+               }
+               else {
+                  startrun = 0;
+               }
+               s += span;
+               continue;
+            }
+            mayClipEnd = s + span;
+         }
+
          block = limitSampleBufferSize( blockSize, len - s );
 
          wt->GetFloats(buffer.get(), start + s, block);
@@ -453,13 +453,9 @@ void EffectLoudness::LoadBufferBlock(TrackIterRange<WaveTrack> range,
 /// (for loudness).
 bool EffectLoudness::AnalyseBufferBlock()
 {
-   for(size_t i = 0; i < mTrackBufferLen; i++)
-   {
-      mLoudnessProcessor->ProcessSampleFromChannel(mTrackBuffer[0][i], 0);
-      if(mProcStereo)
-         mLoudnessProcessor->ProcessSampleFromChannel(mTrackBuffer[1][i], 1);
-      mLoudnessProcessor->NextSample();
-   }
+   const float *const channels[] =
+      { mTrackBuffer[0].get(), mTrackBuffer[1].get() };
+   mLoudnessProcessor->ProcessBuffers(channels, mTrackBufferLen);
 
    if(!UpdateProgress())
       return false;
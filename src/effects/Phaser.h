@@ -107,6 +107,7 @@ private:
 
    struct Instance;
 
+   bool ProcessesTracksInParallel() const override;
    std::shared_ptr<EffectInstance> MakeInstance() const override;
 
    const EffectParameterMethods& Parameters() const override;
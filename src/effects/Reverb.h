@@ -86,6 +86,7 @@ public:
 
    struct Instance;
 
+   bool ProcessesTracksInParallel() const override;
    std::shared_ptr<EffectInstance> MakeInstance() const override;
 
 private:
@@ -83,8 +83,8 @@ bool GetWaveDisplay(const Sequence &sequence,
 
    auto srcX = s0;
    decltype(srcX) nextSrcX = 0;
-   int lastRmsDenom = 0;
-   int lastDivisor = 0;
+   // Samples already combined into the last assigned column
+   double lastNumSamples = 0;
    auto whereNow = std::min(s1 - 1, where[0]);
    decltype(whereNow) whereNext = 0;
    // Loop over block files, opening and reading and closing each
@@ -121,15 +121,40 @@ bool GetWaveDisplay(const Sequence &sequence,
                 (whereNext = std::min(s1 - 1, where[nextPixel])) < nextSrcX)
             ++nextPixel;
       }
-      if (nextPixel == pixel)
+      if (nextPixel == pixel) {
          // The entire block's samples fall within one pixel column.
          // Either it's a rare odd block at the end, or else,
          // we must be really zoomed out!
-         // Omit the entire block's contents from min/max/rms
-         // calculation, which is not correct, but correctness might not
-         // be worth the compute time if this happens every pixel
-         // column. -- PRL
+         // Combine this and all following blocks that also lie within the
+         // column at once, from the pyramid of whole-block summaries, so
+         // that the cost does not grow with the number of blocks.
+         // (pixel > 0, because where[0] lies in block0.)
+         const auto limit = (pixel < len)
+            ? std::min(s1 - 1, where[pixel])
+            : s1 - 1;
+         const unsigned bNext =
+            std::max<int>(b, sequence.FindBlock(limit));
+         // Omit a partial block at the end, which is not correct, but it is
+         // rare and at most one block per display
+         if (bNext == b)
+            continue;
+         const auto values = sequence.SummarizeBlocks(b, bNext, false);
+         const int lastPixel = pixel - 1;
+         float &lastMin = min[lastPixel];
+         lastMin = std::min(lastMin, values.min);
+         float &lastMax = max[lastPixel];
+         lastMax = std::max(lastMax, values.max);
+         float &lastRms = rms[lastPixel];
+         const auto numSamples = lastNumSamples + values.count.as_double();
+         lastRms = sqrt(
+            (lastRms * lastRms * lastNumSamples + values.sumsq) / numSamples);
+         lastNumSamples = numSamples;
+
+         // Resume at the block containing limit
+         b = bNext - 1;
+         nextSrcX = blocks[bNext].start;
          continue;
+      }
       if (nextPixel == len)
          whereNext = s1;
 
@@ -201,11 +226,12 @@ bool GetWaveDisplay(const Sequence &sequence,
             float &lastMax = max[lastPixel];
             lastMax = std::max(lastMax, values.max);
             float &lastRms = rms[lastPixel];
-            int lastNumSamples = lastRmsDenom * lastDivisor;
+            const auto numSamples = lastNumSamples + diff * divisor;
             lastRms = sqrt(
                (lastRms * lastRms * lastNumSamples + values.sumsq * divisor) /
-               (lastNumSamples + diff * divisor)
+               numSamples
             );
+            lastNumSamples = numSamples;
 
             filePosition = midPosition;
          }
@@ -249,8 +275,7 @@ bool GetWaveDisplay(const Sequence &sequence,
       wxASSERT(pixel == nextPixel);
       whereNow = whereNext;
       pixel = nextPixel;
-      lastDivisor = divisor;
-      lastRmsDenom = rmsDenom;
+      lastNumSamples = rmsDenom * divisor;
    } // for each block file
 
    wxASSERT(pixel == len);
@@ -12,10 +12,14 @@
 
 #include "../../../../prefs/SpectrogramSettings.h"
 #include "RealFFTf.h"
+#include "Sequence.h"
 #include "Spectrum.h"
 #include "WaveClipUtilities.h"
 #include "WaveTrack.h"
 #include "WideSampleSequence.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 
 namespace {
@@ -101,11 +105,6 @@ bool SpecCache::CalculateOneSpectrum
     const std::vector<float> &gainFactors,
     float* __restrict scratch, float* __restrict out) const
 {
-   bool result = false;
-   const bool reassignment =
-      (settings.algorithm == SpectrogramSettings::algReassignment);
-   const size_t windowSizeSetting = settings.WindowSize();
-
    sampleCount from;
 
    // xx may be for a column that is out of the visible bounds, but only
@@ -123,6 +122,26 @@ bool SpecCache::CalculateOneSpectrum
    else
       from = where[xx];
 
+   return CalculateSpectrumAt(settings, sequence, from, xx, numSamples,
+      offset, rate, pixelsPerSecond, lowerBoundX, upperBoundX,
+      gainFactors, scratch, out);
+}
+
+bool SpecCache::CalculateSpectrumAt
+   (const SpectrogramSettings &settings,
+    const WideSampleSequence &sequence,
+    sampleCount from,
+    const int xx, const sampleCount numSamples,
+    double offset, double rate, double pixelsPerSecond,
+    int lowerBoundX, int upperBoundX,
+    const std::vector<float> &gainFactors,
+    float* __restrict scratch, float* __restrict out) const
+{
+   bool result = false;
+   const bool reassignment =
+      (settings.algorithm == SpectrogramSettings::algReassignment);
+   const size_t windowSizeSetting = settings.WindowSize();
+
    const bool autocorrelation =
       settings.algorithm == SpectrogramSettings::algPitchEAC;
    const size_t zeroPaddingFactorSetting = settings.ZeroPaddingFactor();
@@ -319,6 +338,52 @@ bool SpecCache::CalculateOneSpectrum
    return result;
 }
 
+bool SpecCache::CalculateTiledSpectrum
+   (const SpectrogramSettings &settings,
+    const WideSampleSequence &sequence,
+    const WaveClip &clip, const SpectrogramTileCache::Key &key,
+    size_t hop,
+    const int xx, const sampleCount numSamples,
+    double offset, double rate, double pixelsPerSecond,
+    const std::vector<float> &gainFactors,
+    float* __restrict scratch, float* __restrict out) const
+{
+   // Sample positions relative to the start of the clip's sequence, as in
+   // where[]
+   const auto sequenceStart = clip.GetSequenceStartSample();
+   const auto playStart = clip.GetPlayStartSample() - sequenceStart;
+   const auto playEnd = clip.GetPlayEndSample() - sequenceStart;
+   const auto center = where[xx];
+   if (center < playStart || center >= playEnd)
+      return false;
+
+   const auto &clipSequence = *clip.GetSequence(0);
+   const auto &block =
+      clipSequence.GetBlockArray()[clipSequence.FindBlock(center)];
+   const auto frame = ((center - block.start).as_size_t() + hop / 2) / hop;
+   const auto snapped = block.start + sampleCount(frame * hop);
+
+   // Samples outside the play region, as read through the track, are not
+   // those of the block
+   const auto windowSize = settings.WindowSize();
+   const auto from = snapped - sampleCount(windowSize >> 1);
+   const auto blockEnd = block.start + block.sb->GetSampleCount();
+   if (from < std::max(block.start, playStart) ||
+       from + windowSize > std::min(blockEnd, playEnd))
+      return false;
+
+   const auto nBins = settings.NBins();
+   float *const results = &out[nBins * xx];
+   auto &cache = SpectrogramTileCache::Get();
+   if (!cache.Find(block.sb, key, hop, frame, results, nBins)) {
+      CalculateSpectrumAt(settings, sequence, snapped, xx, numSamples,
+         offset, rate, pixelsPerSecond, xx, xx + 1,
+         gainFactors, scratch, out);
+      cache.Insert(block.sb, key, hop, frame, results, nBins);
+   }
+   return true;
+}
+
 void SpecCache::Grow(size_t len_, SpectrogramSettings& settings,
                        double pixelsPerSecond, double start_)
 {
@@ -332,6 +397,8 @@ void SpecCache::Grow(size_t len_, SpectrogramSettings& settings,
    // Sample counts corresponding to the columns, and to one past the end.
    where.resize(len_ + 1);
 
+   valid.assign(len_, 0);
+
    len = len_;
    algorithm = settings.algorithm;
    pps = pixelsPerSecond;
@@ -342,10 +409,12 @@ void SpecCache::Grow(size_t len_, SpectrogramSettings& settings,
    frequencyGain = settings.frequencyGain;
 }
 
-void SpecCache::Populate(
+bool SpecCache::Populate(
    const SpectrogramSettings& settings, const WideSampleSequence& sequence,
-   int copyBegin, int copyEnd, size_t numPixels, sampleCount numSamples,
-   double offset, double rate, double pixelsPerSecond)
+   size_t numPixels, sampleCount numSamples,
+   double offset, double rate, double pixelsPerSecond,
+   std::chrono::steady_clock::time_point deadline,
+   const WaveClip *pClip)
 {
    const int &frequencyGainSetting = settings.frequencyGain;
    const size_t windowSizeSetting = settings.WindowSize();
@@ -362,109 +431,154 @@ void SpecCache::Populate(
 
    const size_t bufferSize = fftLen;
    const size_t scratchSize = reassignment ? 3 * bufferSize : bufferSize;
-   std::vector<float> scratch(scratchSize);
+
+   // Find the ranges of columns to compute anew.  After a scroll there are
+   // at most two, before and after the copied portion.
+   std::vector<std::pair<int, int>> ranges;
+   for (int xx = 0; xx < (int)numPixels;) {
+      if (valid[xx]) {
+         ++xx;
+         continue;
+      }
+      const int lowerBoundX = xx;
+      while (xx < (int)numPixels && !valid[xx])
+         ++xx;
+      ranges.emplace_back(lowerBoundX, xx);
+   }
+   if (ranges.empty())
+      return true;
 
    std::vector<float> gainFactors;
    if (!autocorrelation)
       ComputeSpectrogramGainFactors(fftLen, rate, frequencyGainSetting, gainFactors);
 
-   // Loop over the ranges before and after the copied portion and compute anew.
-   // One of the ranges may be empty.
-   for (int jj = 0; jj < 2; ++jj) {
-      const int lowerBoundX = jj == 0 ? 0 : copyEnd;
-      const int upperBoundX = jj == 0 ? copyBegin : numPixels;
+   if (!reassignment) {
+      // Columns are independent; divide the ranges into tiles that the
+      // worker threads claim, roughly from left to right
+      constexpr int tileWidth = 16;
+      std::vector<std::pair<int, int>> tiles;
+      for (auto [lowerBoundX, upperBoundX] : ranges)
+         for (auto xx = lowerBoundX; xx < upperBoundX; xx += tileWidth)
+            tiles.emplace_back(xx, std::min(xx + tileWidth, upperBoundX));
+
+      // A decorator of the sequence, such as CachingPlayableSequence, may
+      // not be shared among threads, but the sequence it decorates may be
+      const auto &source = sequence.GetDecorated();
+
+      // The grid for the tile cache is the greatest power of two not more
+      // than half the samples per pixel, so snapping moves the center of a
+      // column by at most a quarter pixel
+      const SpectrogramTileCache::Key key{
+         settings.algorithm, settings.windowType, settings.WindowSize(),
+         settings.ZeroPaddingFactor(), settings.frequencyGain, rate };
+      size_t hop = 0;
+      if (pClip && pixelsPerSecond > 0 &&
+          SpectrogramTileCache::Get().IsEnabled()) {
+         const double samplesPerPixel = rate / pixelsPerSecond;
+         hop = 1;
+         while (4 * hop <= samplesPerPixel)
+            hop *= 2;
+      }
 
-// todo(mhodgkinson): I don't find an option to define _OPENMP anywhere. Is this
-// still of interest?
-#ifdef _OPENMP
-      // Storage for mutable per-thread data.
-      // private clause ensures one copy per thread
-      struct ThreadLocalStorage {
-         ThreadLocalStorage()  { }
-         ~ThreadLocalStorage() { }
-
-         void init(SampleTrackCache &waveTrackCache, size_t scratchSize) {
-            if (!cache) {
-               cache = std::make_unique<SampleTrackCache>(waveTrackCache.GetTrack());
-               scratch.resize(scratchSize);
-            }
+      std::atomic<bool> expired{ false };
+      WorkerPool::Get().ParallelFor(tiles.size(), [&](size_t iTile){
+         if (expired.load(std::memory_order_relaxed))
+            return;
+         if (std::chrono::steady_clock::now() >= deadline) {
+            expired.store(true, std::memory_order_relaxed);
+            return;
+         }
+         const auto [lowerBoundX, upperBoundX] = tiles[iTile];
+         // Reused by all tiles that a thread computes, in this draw and later,
+         // without reallocation; but zero padding must start out zero
+         static thread_local std::vector<float> scratch;
+         scratch.assign(scratchSize, 0.0f);
+         for (auto xx = lowerBoundX; xx < upperBoundX; ++xx) {
+            if (hop > 0 && CalculateTiledSpectrum(
+               settings, source, *pClip, key, hop, xx, numSamples,
+               offset, rate, pixelsPerSecond,
+               gainFactors, &scratch[0], &freq[0]))
+               continue;
+            CalculateOneSpectrum(
+               settings, source, xx, numSamples,
+               offset, rate, pixelsPerSecond,
+               lowerBoundX, upperBoundX,
+               gainFactors, &scratch[0], &freq[0]);
          }
-         std::unique_ptr<SampleTrackCache> cache;
-         std::vector<float> scratch;
-      } tls;
+         std::fill(valid.begin() + lowerBoundX, valid.begin() + upperBoundX, 1);
+      });
+      return !expired.load();
+   }
 
-      #pragma omp parallel for private(tls)
-#endif
+   // Reassignment scatters power into neighboring columns, so compute
+   // serially, and always complete
+   std::vector<float> scratch(scratchSize);
+   for (auto [lowerBoundX, upperBoundX] : ranges) {
       for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
-      {
-#ifdef _OPENMP
-         tls.init(waveTrackCache, scratchSize);
-         SampleTrackCache& cache = *tls.cache;
-         float* buffer = &tls.scratch[0];
-#else
-         float* buffer = &scratch[0];
-#endif
          CalculateOneSpectrum(
             settings, sequence, xx, numSamples,
             offset, rate, pixelsPerSecond,
             lowerBoundX, upperBoundX,
-            gainFactors, buffer, &freq[0]);
+            gainFactors, &scratch[0], &freq[0]);
+
+      // Need to look beyond the edges of the range to accumulate more
+      // time reassignments.
+      // I'm not sure what's a good stopping criterion?
+      auto xx = lowerBoundX;
+      const double pixelsPerSample = pixelsPerSecond / rate;
+      const int limit = std::min((int)(0.5 + fftLen * pixelsPerSample), 100);
+      for (int ii = 0; ii < limit; ++ii)
+      {
+         const bool result =
+            CalculateOneSpectrum(
+               settings, sequence, --xx, numSamples,
+               offset, rate, pixelsPerSecond,
+               lowerBoundX, upperBoundX,
+               gainFactors, &scratch[0], &freq[0]);
+         if (!result)
+            break;
       }
 
-      if (reassignment) {
-         // Need to look beyond the edges of the range to accumulate more
-         // time reassignments.
-         // I'm not sure what's a good stopping criterion?
-         auto xx = lowerBoundX;
-         const double pixelsPerSample = pixelsPerSecond / rate;
-         const int limit = std::min((int)(0.5 + fftLen * pixelsPerSample), 100);
-         for (int ii = 0; ii < limit; ++ii)
-         {
-            const bool result =
-               CalculateOneSpectrum(
-                  settings, sequence, --xx, numSamples,
-                  offset, rate, pixelsPerSecond,
-                  lowerBoundX, upperBoundX,
-                  gainFactors, &scratch[0], &freq[0]);
-            if (!result)
-               break;
-         }
+      xx = upperBoundX;
+      for (int ii = 0; ii < limit; ++ii)
+      {
+         const bool result =
+            CalculateOneSpectrum(
+               settings, sequence, xx++, numSamples,
+               offset, rate, pixelsPerSecond,
+               lowerBoundX, upperBoundX,
+               gainFactors, &scratch[0], &freq[0]);
+         if (!result)
+            break;
+      }
 
-         xx = upperBoundX;
-         for (int ii = 0; ii < limit; ++ii)
-         {
-            const bool result =
-               CalculateOneSpectrum(
-                  settings, sequence, xx++, numSamples,
-                  offset, rate, pixelsPerSecond,
-                  lowerBoundX, upperBoundX,
-                  gainFactors, &scratch[0], &freq[0]);
-            if (!result)
-               break;
+      // Now Convert to dB terms.  Do this only after accumulating
+      // power values, which may cross columns with the time correction.
+      for (xx = lowerBoundX; xx < upperBoundX; ++xx) {
+         float *const results = &freq[nBins * xx];
+         for (size_t ii = 0; ii < nBins; ++ii) {
+            float &power = results[ii];
+            if (power <= 0)
+               power = -160.0;
+            else
+               power = 10.0*log10f(power);
          }
-
-         // Now Convert to dB terms.  Do this only after accumulating
-         // power values, which may cross columns with the time correction.
-#ifdef _OPENMP
-         #pragma omp parallel for
-#endif
-         for (xx = lowerBoundX; xx < upperBoundX; ++xx) {
-            float *const results = &freq[nBins * xx];
-            for (size_t ii = 0; ii < nBins; ++ii) {
-               float &power = results[ii];
-               if (power <= 0)
-                  power = -160.0;
-               else
-                  power = 10.0*log10f(power);
-            }
-            if (!gainFactors.empty()) {
-               // Apply a frequency-dependent gain factor
-               for (size_t ii = 0; ii < nBins; ++ii)
-                  results[ii] += gainFactors[ii];
-            }
+         if (!gainFactors.empty()) {
+            // Apply a frequency-dependent gain factor
+            for (size_t ii = 0; ii < nBins; ++ii)
+               results[ii] += gainFactors[ii];
          }
       }
+      std::fill(valid.begin() + lowerBoundX, valid.begin() + upperBoundX, 1);
    }
+   return true;
+}
+
+bool SpecCache::IsComplete(size_t numPixels) const
+{
+   numPixels = std::min(numPixels, valid.size());
+   return std::all_of(valid.begin(), valid.begin() + numPixels,
+      [](unsigned char flag){ return flag != 0; });
 }
 
 bool WaveClipSpectrumCache::GetSpectrogram(const WaveClip &clip,
@@ -473,7 +587,8 @@ bool WaveClipSpectrumCache::GetSpectrogram(const WaveClip &clip,
    SpectrogramSettings& settings,
    const sampleCount *& where,
    size_t numPixels,
-   double t0, double pixelsPerSecond)
+   double t0, double pixelsPerSecond,
+   std::chrono::steady_clock::time_point deadline)
 {
    t0 += clip.GetTrimLeft();
 
@@ -491,7 +606,8 @@ bool WaveClipSpectrumCache::GetSpectrogram(const WaveClip &clip,
 
    if (match &&
        mSpecCache->start == t0 &&
-       mSpecCache->len >= numPixels) {
+       mSpecCache->len >= numPixels &&
+       mSpecCache->IsComplete(numPixels)) {
       spectrogram = &mSpecCache->freq[0];
       where = &mSpecCache->where[0];
 
@@ -535,7 +651,10 @@ bool WaveClipSpectrumCache::GetSpectrogram(const WaveClip &clip,
       ));
    }
 
-   // Resize the cache, keep the contents unchanged.
+   // Resize the cache, keep the contents unchanged, except for the flags of
+   // valid columns, which are copied below
+   std::vector<unsigned char> oldValid;
+   oldValid.swap(mSpecCache->valid);
    mSpecCache->Grow(numPixels, settings, pixelsPerSecond, t0);
    mSpecCache->leftTrim = clip.GetTrimLeft();
    mSpecCache->rightTrim = clip.GetTrimRight();
@@ -550,6 +669,9 @@ bool WaveClipSpectrumCache::GetSpectrogram(const WaveClip &clip,
       memmove(&mSpecCache->freq[nBins * copyBegin],
                &mSpecCache->freq[nBins * (copyBegin + oldX0)],
                nBins * (copyEnd - copyBegin) * sizeof(float));
+      std::copy(oldValid.begin() + copyBegin + oldX0,
+         oldValid.begin() + copyEnd + oldX0,
+         mSpecCache->valid.begin() + copyBegin);
    }
 
    // Reassignment accumulates, so it needs a zeroed buffer
@@ -576,10 +698,10 @@ bool WaveClipSpectrumCache::GetSpectrogram(const WaveClip &clip,
       t0, rate, samplesPerPixel);
 
    mSpecCache->Populate
-      (settings, sequence, copyBegin, copyEnd, numPixels,
+      (settings, sequence, numPixels,
        // We want the length of only one channel of samples:
        clip.GetSequenceSamplesCount() / clip.GetWidth(),
-       clip.GetSequenceStartTime(), rate, pixelsPerSecond);
+       clip.GetSequenceStartTime(), rate, pixelsPerSecond, deadline, &clip);
 
    mSpecCache->dirty = mDirty;
    spectrogram = &mSpecCache->freq[0];
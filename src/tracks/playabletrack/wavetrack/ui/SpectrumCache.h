@@ -15,8 +15,10 @@ class sampleCount;
 class SpectrogramSettings;
 class WideSampleSequence;
 
+#include <chrono>
 #include <vector>
 #include "MemoryX.h"
+#include "SpectrogramTileCache.h"
 #include "WaveClip.h" // to inherit WaveClipListener
 
 using Floats = ArrayOf<float>;
@@ -53,15 +55,62 @@ public:
        float* __restrict scratch,
        float* __restrict out) const;
 
+   // Calculate one column of the spectrum, for a window centered at from
+   bool CalculateSpectrumAt
+      (const SpectrogramSettings &settings,
+       const WideSampleSequence &sequence,
+       sampleCount from,
+       const int xx, sampleCount numSamples,
+       double offset, double rate, double pixelsPerSecond,
+       int lowerBoundX, int upperBoundX,
+       const std::vector<float> &gainFactors,
+       float* __restrict scratch,
+       float* __restrict out) const;
+
+   //! Calculate one column of the spectrum through SpectrogramTileCache,
+   //! with the center snapped to a grid of multiples of hop samples
+   /*!
+    Not for reassignment.
+
+    @return false, computing nothing, if the window of the column is not
+    contained in the play region and in one sample block of clip
+    */
+   bool CalculateTiledSpectrum
+      (const SpectrogramSettings &settings,
+       const WideSampleSequence &sequence,
+       const WaveClip &clip, const SpectrogramTileCache::Key &key,
+       size_t hop,
+       const int xx, sampleCount numSamples,
+       double offset, double rate, double pixelsPerSecond,
+       const std::vector<float> &gainFactors,
+       float* __restrict scratch,
+       float* __restrict out) const;
+
    // Grow the cache while preserving the (possibly now invalid!) contents
+   // of freq; all columns are marked not valid
    void Grow(size_t len_, SpectrogramSettings& settings,
       double pixelsPerSecond, double start_);
 
-   // Calculate the dirty columns at the begin and end of the cache
-   void Populate(
+   //! Calculate the columns not yet valid, using the worker threads
+   /*!
+    Stops early, leaving some columns not valid, if the deadline passes.
+    Reassignment, whose columns are not independent, is always completed.
+
+    If pClip is not null, columns are looked up in, or added to,
+    SpectrogramTileCache when possible.
+
+    @return whether all of the first numPixels columns are valid
+    */
+   bool Populate(
       const SpectrogramSettings& settings, const WideSampleSequence& sequence,
-      int copyBegin, int copyEnd, size_t numPixels, sampleCount numSamples,
-      double offset, double rate, double pixelsPerSecond);
+      size_t numPixels, sampleCount numSamples,
+      double offset, double rate, double pixelsPerSecond,
+      std::chrono::steady_clock::time_point deadline =
+         std::chrono::steady_clock::time_point::max(),
+      const WaveClip *pClip = nullptr);
+
+   //! Whether all of the first numPixels columns are valid
+   bool IsComplete(size_t numPixels) const;
 
    size_t       len { 0 }; // counts pixels, not samples
    int          algorithm;
@@ -75,6 +124,8 @@ public:
    int          frequencyGain;
    std::vector<float> freq;
    std::vector<sampleCount> where;
+   //! Nonzero for each column of freq that is computed
+   std::vector<unsigned char> valid;
 
    int          dirty;
 };
@@ -118,6 +169,9 @@ struct WaveClipSpectrumCache final : WaveClipListener
    void Invalidate() override; // NOFAIL-GUARANTEE
 
    /** Getting high-level data for screen display */
+   // If the deadline passes, some columns may be left for later calls, as
+   // indicated by mSpecCache->valid; the return value is whether anything
+   // changed
    // PRL:
    // > only the 0th channel of sequence is really used
    // > In the interim, this still works correctly for WideSampleSequence backed
@@ -126,7 +180,9 @@ struct WaveClipSpectrumCache final : WaveClipListener
       const WaveClip& clip, const WideSampleSequence& sequence,
       const float*& spectrogram, SpectrogramSettings& spectrogramSettings,
       const sampleCount*& where, size_t numPixels, double t0,
-      double pixelsPerSecond);
+      double pixelsPerSecond,
+      std::chrono::steady_clock::time_point deadline =
+         std::chrono::steady_clock::time_point::max());
 };
 
 #endif
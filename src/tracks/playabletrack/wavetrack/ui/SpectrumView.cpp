@@ -28,6 +28,7 @@ Paul Licameli split from WaveChannelView.cpp
 #include "NumberScale.h"
 #include "../../../../TrackArt.h"
 #include "../../../../TrackArtist.h"
+#include "../../../../TrackPanel.h"
 #include "../../../../TrackPanelDrawingContext.h"
 #include "ViewInfo.h"
 #include "WaveClip.h"
@@ -36,6 +37,7 @@ Paul Licameli split from WaveChannelView.cpp
 #include "../../../../prefs/SpectrogramSettings.h"
 #include "../../../../ProjectSettings.h"
 #include "WaveTrackLocation.h"
+#include "BasicUI.h"
 
 #include <wx/dcmemory.h>
 #include <wx/graphics.h>
@@ -321,13 +323,19 @@ ChooseColorSet( float bin0, float bin1, float selBinLo,
    return  AColor::ColorGradientTimeSelected;
 }
 
-void DrawClipSpectrum(TrackPanelDrawingContext &context,
+// Time allowed for computing the spectrograms of all clips of a track in one
+// paint event; the remaining columns are left for the next paint
+constexpr auto SpectrogramTimeBudget = std::chrono::milliseconds{ 50 };
+
+//! @return false if some columns of the spectrogram were not yet computed
+bool DrawClipSpectrum(TrackPanelDrawingContext &context,
                                    const WideSampleSequence &sequence,
                                    const WaveTrack* track,
                                    const WaveClip *clip,
                                    const wxRect &rect,
                                    const std::shared_ptr<SpectralData> &mpSpectralData,
-                                   bool selected)
+                                   bool selected,
+                                   std::chrono::steady_clock::time_point deadline)
 {
    auto &dc = context.dc;
    const auto artist = TrackArtist::Get( context );
@@ -345,7 +353,7 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    {
       auto clipRect = ClipParameters::GetClipRect(*clip, zoomInfo, rect);
       TrackArt::DrawClipFolded(dc, clipRect);
-      return;
+      return true;
    }
 
    if (!track)
@@ -353,7 +361,7 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
       // TODO: rewrite GetSpectrumBounds so it is
       // not a member of WaveTrack, but fetch UI related ClientData
       // attachments; then this downcast from SampleTrack will not be needed.
-      return;
+      return true;
 
    auto &settings = SpectrogramSettings::Get(*track);
    const bool autocorrelation = (settings.algorithm == SpectrogramSettings::algPitchEAC);
@@ -366,7 +374,7 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    // The "hiddenMid" rect contains the part of the display actually
    // containing the waveform, as it appears without the fisheye.  If it's empty, we're done.
    if (hiddenMid.width <= 0) {
-      return;
+      return true;
    }
 
    const double &t0 = params.t0;
@@ -408,7 +416,7 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    // more, but for now this is not bad.  -dmazzoni
    wxImage image((int)mid.width, (int)mid.height);
    if (!image.IsOk())
-      return;
+      return true;
 #ifdef EXPERIMENTAL_SPECTROGRAM_OVERLAY
    image.SetAlpha();
    unsigned char *alpha = image.GetAlpha();
@@ -424,7 +432,7 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
       const double pps = averagePixelsPerSample * rate;
       updated = WaveClipSpectrumCache::Get(*clip).GetSpectrogram(
          *clip, sequence, freq, settings, where, (size_t)hiddenMid.width, t0,
-         pps);
+         pps, deadline);
    }
    auto nBins = settings.NBins();
 
@@ -475,6 +483,9 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
 #endif //EXPERIMENTAL_FFT_Y_GRID
 
    auto &clipCache = WaveClipSpectrumCache::Get( *clip );
+   const auto &validColumns = clipCache.mSpecCache->valid;
+   const bool complete =
+      clipCache.mSpecCache->IsComplete((size_t)hiddenMid.width);
    if (!updated && clipCache.mSpecPxCache->valid &&
       ((int)clipCache.mSpecPxCache->len == hiddenMid.height * hiddenMid.width)
       && scaleType == clipCache.mSpecPxCache->scaleType
@@ -602,6 +613,13 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
          bool inMaximum = false;
 #endif //EXPERIMENTAL_FIND_NOTES
 
+         if (!validColumns[xx]) {
+            // Not yet computed; leave a blank column until the next paint
+            std::fill_n(&clipCache.mSpecPxCache->values[xx * hiddenMid.height],
+               hiddenMid.height, 0.0f);
+            continue;
+         }
+
          for (int yy = 0; yy < hiddenMid.height; ++yy) {
             const float bin     = bins[yy];
             const float nextBin = bins[yy+1];
@@ -681,7 +699,7 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
       }
       specCache.Populate
          (settings, sequence,
-          0, 0, numPixels,
+          numPixels,
           clip->GetPlaySamplesCount(),
           tOffset, rate,
           0 // FIXME: PRL -- make reassignment work with fisheye
@@ -852,11 +870,13 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
       auto clipRect = ClipParameters::GetClipRect(*clip, zoomInfo, rect);
       TrackArt::DrawClipEdges(dc, clipRect, selected);
    }
+
+   return complete;
 }
 
 }
 
-void SpectrumView::DoDraw(TrackPanelDrawingContext& context,
+bool SpectrumView::DoDraw(TrackPanelDrawingContext& context,
                                 const WaveTrack* track,
                                 const WaveClip* selectedClip,
                                 const wxRect & rect )
@@ -868,13 +888,18 @@ void SpectrumView::DoDraw(TrackPanelDrawingContext& context,
       context, rect, track, blankSelectedBrush, blankBrush );
 
    const CachingPlayableSequence cachingSequence { *track };
+   // One budget for all clips, so that many clips don't delay the paint
+   const auto deadline =
+      std::chrono::steady_clock::now() + SpectrogramTimeBudget;
+   bool complete = true;
    for (const auto &clip: track->GetClips()){
-      DrawClipSpectrum(
+      complete = DrawClipSpectrum(
          context, cachingSequence, track, clip.get(), rect, mpSpectralData,
-         clip.get() == selectedClip);
+         clip.get() == selectedClip, deadline) && complete;
    }
 
    DrawBoldBoundaries( context, track, rect );
+   return complete;
 }
 
 void SpectrumView::Draw(
@@ -907,7 +932,14 @@ void SpectrumView::Draw(
       wxASSERT(waveChannelView.use_count());
 
       auto seletedClip = waveChannelView->GetSelectedClip().lock();
-      DoDraw( context, wt.get(), seletedClip.get(), rect );
+      if (!DoDraw( context, wt.get(), seletedClip.get(), rect ))
+         // Paint again soon, to continue computing the spectrogram
+         BasicUI::CallAfter([wTrack = std::weak_ptr<Track>(FindTrack())]{
+            if (auto pTrack = wTrack.lock())
+               if (auto pList = pTrack->GetOwner())
+                  if (auto pProject = pList->GetOwner())
+                     TrackPanel::Get(*pProject).RefreshTrack(pTrack.get());
+         });
 
 #if defined(__WXMAC__)
       dc.GetGraphicsContext()->SetAntialiasMode(aamode);
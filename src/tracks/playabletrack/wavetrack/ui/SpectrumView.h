@@ -143,7 +143,8 @@ private:
       TrackPanelDrawingContext &context,
       const wxRect &rect, unsigned iPass ) override;
 
-   void DoDraw( TrackPanelDrawingContext &context,
+   //! @return false if some of the spectrogram remains to be computed
+   bool DoDraw( TrackPanelDrawingContext &context,
       const WaveTrack *track,
       const WaveClip* selectedClip,
       const wxRect & rect );